@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/rbtree_demo.dir/main.cpp.o"
+  "CMakeFiles/rbtree_demo.dir/main.cpp.o.d"
+  "rbtree_demo"
+  "rbtree_demo.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/rbtree_demo.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_allocators.dir/test_allocators.cpp.o"
+  "CMakeFiles/test_allocators.dir/test_allocators.cpp.o.d"
+  "test_allocators"
+  "test_allocators.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/test_allocators.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
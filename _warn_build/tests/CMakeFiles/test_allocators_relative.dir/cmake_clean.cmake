@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_allocators_relative.dir/test_allocators.cpp.o"
+  "CMakeFiles/test_allocators_relative.dir/test_allocators.cpp.o.d"
+  "test_allocators_relative"
+  "test_allocators_relative.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/test_allocators_relative.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_dumper.dir/test_dumper.cpp.o"
+  "CMakeFiles/test_dumper.dir/test_dumper.cpp.o.d"
+  "test_dumper"
+  "test_dumper.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/test_dumper.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
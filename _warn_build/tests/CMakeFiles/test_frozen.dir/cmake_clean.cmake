@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_frozen.dir/test_frozen.cpp.o"
+  "CMakeFiles/test_frozen.dir/test_frozen.cpp.o.d"
+  "test_frozen"
+  "test_frozen.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/test_frozen.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
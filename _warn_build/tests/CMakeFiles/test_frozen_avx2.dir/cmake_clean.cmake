@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_frozen_avx2.dir/test_frozen.cpp.o"
+  "CMakeFiles/test_frozen_avx2.dir/test_frozen.cpp.o.d"
+  "test_frozen_avx2"
+  "test_frozen_avx2.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/test_frozen_avx2.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
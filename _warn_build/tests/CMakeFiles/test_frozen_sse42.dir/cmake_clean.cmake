@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_frozen_sse42.dir/test_frozen.cpp.o"
+  "CMakeFiles/test_frozen_sse42.dir/test_frozen.cpp.o.d"
+  "test_frozen_sse42"
+  "test_frozen_sse42.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/test_frozen_sse42.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_map.dir/test_map.cpp.o"
+  "CMakeFiles/test_map.dir/test_map.cpp.o.d"
+  "test_map"
+  "test_map.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/test_map.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_mapped.dir/test_mapped.cpp.o"
+  "CMakeFiles/test_mapped.dir/test_mapped.cpp.o.d"
+  "test_mapped"
+  "test_mapped.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/test_mapped.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_orderstat.dir/test_orderstat.cpp.o"
+  "CMakeFiles/test_orderstat.dir/test_orderstat.cpp.o.d"
+  "test_orderstat"
+  "test_orderstat.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/test_orderstat.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/test_sharded.dir/test_sharded.cpp.o"
+  "CMakeFiles/test_sharded.dir/test_sharded.cpp.o.d"
+  "test_sharded"
+  "test_sharded.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/test_sharded.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,36 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo/tests
+# Build directory: /root/repo/_warn_build/tests
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(allocators "/root/repo/_warn_build/tests/test_allocators")
+set_tests_properties(allocators PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;5;add_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test(dumper "/root/repo/_warn_build/tests/test_dumper")
+set_tests_properties(dumper PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;5;add_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test(map "/root/repo/_warn_build/tests/test_map")
+set_tests_properties(map PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;5;add_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test(persistent "/root/repo/_warn_build/tests/test_persistent")
+set_tests_properties(persistent PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;5;add_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test(sharded "/root/repo/_warn_build/tests/test_sharded")
+set_tests_properties(sharded PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;5;add_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test(snapshot "/root/repo/_warn_build/tests/test_snapshot")
+set_tests_properties(snapshot PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;5;add_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test(threadpool "/root/repo/_warn_build/tests/test_threadpool")
+set_tests_properties(threadpool PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;5;add_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test(allocators_relative "/root/repo/_warn_build/tests/test_allocators_relative")
+set_tests_properties(allocators_relative PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;12;add_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test(orderstat "/root/repo/_warn_build/tests/test_orderstat")
+set_tests_properties(orderstat PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;18;add_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test(concurrent "/root/repo/_warn_build/tests/test_concurrent")
+set_tests_properties(concurrent PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;24;add_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test(mapped "/root/repo/_warn_build/tests/test_mapped")
+set_tests_properties(mapped PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;30;add_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test(stats "/root/repo/_warn_build/tests/test_stats")
+set_tests_properties(stats PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;36;add_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test(frozen "/root/repo/_warn_build/tests/test_frozen")
+set_tests_properties(frozen PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;41;add_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test(frozen_sse42 "/root/repo/_warn_build/tests/test_frozen_sse42")
+set_tests_properties(frozen_sse42 PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;50;add_test;/root/repo/tests/CMakeLists.txt;0;")
+add_test(frozen_avx2 "/root/repo/_warn_build/tests/test_frozen_avx2")
+set_tests_properties(frozen_avx2 PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/tests/CMakeLists.txt;56;add_test;/root/repo/tests/CMakeLists.txt;0;")
@@ -0,0 +1,92 @@
+﻿////////////////////////////////////////////////////////////////////////////////
+/// \file
+/// \brief     Указатель для публикации узлов читателям без блокировок
+/// \author    Kupchenko Viktor
+/// \version   0.1.0
+/// \date      01.05.2017
+///            This is a part of the course "Algorithms and Data Structures"
+///            provided by  the School of Software Engineering of the Faculty
+///            of Computer Science at the Higher School of Economics.
+///
+/// Обычный указатель, который один поток меняет, а другие в это же время
+/// читают, — гонка данных, даже если каждое отдельное значение читатель видит
+/// целиком. Здесь запись идет с release, а чтение с acquire: читатель, увидевший
+/// новый адрес, видит и все, что писатель записал в цель до того, как на нее
+/// сослался, — например, ключ только что построенного узла.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef XI_ATOMICPTR_H
+#define XI_ATOMICPTR_H
+
+#include <atomic>
+
+
+namespace xi
+{
+
+
+/** \brief Указатель на \c T с записью release и чтением acquire.
+ *
+ *  Ведет себя как обычный \c T*, так же как \c xi::RelPtr: неявно приводится к нему,
+ *  разыменовывается через \c ->, принимает присваивание \c T*. Каждое обращение — отдельная
+ *  атомарная операция, так что согласованность нескольких связей сразу он не дает; ее
+ *  обеспечивает тот, кто читает (см. \c xi::ConcurrentRBTree). На x86 и запись, и чтение
+ *  остаются обычными \c mov, но компилятор их не переставляет и не объединяет.
+ *
+ *  \tparam T Тип цели.
+ */
+    template<typename T>
+    class AtomicPtr
+    {
+    public:
+        AtomicPtr()
+                : _ptr(nullptr)
+        {}
+
+        /** \brief Указатель на \c target. Инициализация не публикует: объект еще никому не виден. */
+        explicit AtomicPtr(T *target)
+                : _ptr(target)
+        {}
+
+        AtomicPtr(const AtomicPtr &other)
+                : _ptr(other.get())
+        {}
+
+        AtomicPtr &operator=(const AtomicPtr &other)
+        {
+            set(other.get());
+            return *this;
+        }
+
+        AtomicPtr &operator=(T *target)
+        {
+            set(target);
+            return *this;
+        }
+
+    public:
+        /** \brief Возвращает адрес цели или \c nullptr вместе со всем, что было записано в цель до публикации. */
+        T *get() const
+        { return _ptr.load(std::memory_order_acquire); }
+
+        operator T *() const
+        { return get(); }
+
+        T *operator->() const
+        { return get(); }
+
+    protected:
+        /** \brief Публикует \c target: записи, сделанные до этого, видны тому, кто прочтет новый адрес. */
+        void set(T *target)
+        { _ptr.store(target, std::memory_order_release); }
+
+    protected:
+        std::atomic<T *> _ptr;                       ///< Адрес цели.
+    }; // class AtomicPtr
+
+
+} // namespace xi
+
+
+#endif // XI_ATOMICPTR_H
@@ -0,0 +1,107 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  bench_alloc.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Стоимость выделения узлов: вставка и удаление в дереве с обычным
+// std::allocator, с пуловым xi::PoolAllocator и с std::pmr-ресурсом.
+//
+// Сборка: g++ -std=c++17 -O2 -I.. bench_alloc.cpp -o bench_alloc
+// Запуск: ./bench_alloc [число ключей]
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <memory>
+
+#include "../rbtree.h"
+#include "../nodepool.h"
+#include "benchutil.h"
+
+
+using namespace xibench;
+
+
+/** \brief Вставляет, а затем удаляет все ключи, замеряя каждую фазу отдельно. */
+template<typename Tree>
+void churn(const char *name, Tree &tree, const std::vector<int> &ins, const std::vector<int> &rem)
+{
+    char label[64];
+
+    Timer ti;
+    for (std::size_t i = 0; i < ins.size(); ++i)
+        tree.insert(ins[i]);
+    std::snprintf(label, sizeof(label), "%s insert", name);
+    report(label, ins.size(), ti.seconds());
+
+    Timer tr;
+    for (std::size_t i = 0; i < rem.size(); ++i)
+        tree.remove(rem[i]);
+    std::snprintf(label, sizeof(label), "%s remove", name);
+    report(label, rem.size(), tr.seconds());
+}
+
+
+/** \brief Чистая стоимость выделения/освобождения одного куска размером с узел. */
+template<typename Alloc>
+void rawAlloc(const char *name, Alloc alloc, std::size_t n)
+{
+    typedef std::allocator_traits<Alloc> Traits;
+    std::vector<typename Traits::pointer> ptrs(n);
+
+    Timer t;
+    for (int round = 0; round < 4; ++round)
+    {
+        for (std::size_t i = 0; i < n; ++i)
+            ptrs[i] = Traits::allocate(alloc, 1);
+        for (std::size_t i = 0; i < n; ++i)
+            Traits::deallocate(alloc, ptrs[i], 1);
+    }
+    report(name, n * 8, t.seconds());
+}
+
+
+// Кусок ровно того размера, который занимает узел RBTree<int>
+struct NodeSized
+{
+    char bytes[sizeof(xi::RBTree<int>::Node)];
+};
+
+
+int main(int argc, char **argv)
+{
+    std::size_t n = sizeArg(argc, argv, 1000000);
+    std::vector<int> ins = shuffledKeys(n, 1);
+    std::vector<int> rem = shuffledKeys(n, 2);
+
+    std::printf("== raw node-sized allocate+deallocate\n");
+    rawAlloc("std::allocator", std::allocator<NodeSized>(), n);
+    rawAlloc("xi::PoolAllocator", xi::PoolAllocator<NodeSized>(), n);
+#ifdef RBTREE_HAS_PMR
+    {
+        std::pmr::unsynchronized_pool_resource res;
+        rawAlloc("pmr::unsynchronized_pool_resource", std::pmr::polymorphic_allocator<NodeSized>(&res), n);
+    }
+#endif
+
+    std::printf("== tree churn, %zu random keys\n", n);
+    {
+        xi::RBTree<int> tree;
+        churn("std::allocator", tree, ins, rem);
+    }
+    {
+        xi::RBTree<int, std::less<int>, xi::PoolAllocator<int> > tree;
+        churn("xi::PoolAllocator", tree, ins, rem);
+        // второй проход идет целиком по списку свободных узлов
+        churn("xi::PoolAllocator (warm)", tree, ins, rem);
+    }
+#ifdef RBTREE_HAS_PMR
+    {
+        std::pmr::unsynchronized_pool_resource res;
+        xi::pmr::RBTree<int> tree(&res);
+        churn("pmr::unsynchronized_pool_resource", tree, ins, rem);
+    }
+#endif
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  bench_append.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Вставка с подсказкой: дописывание возрастающих ключей через insert(end(), k)
+// против обычного insert(k), вставка почти упорядоченного потока с подсказкой
+// "после предыдущего" и то же самое для std::set.
+//
+// Сборка: g++ -std=c++17 -O2 -I.. bench_append.cpp -o bench_append
+// Запуск: ./bench_append [число ключей]
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <set>
+
+#include "../rbtree.h"
+#include "benchutil.h"
+
+
+using namespace xibench;
+
+
+/** \brief Возрастающие ключи, в которых каждый \c swapEvery-й соседний переставлен местами. */
+static std::vector<int> nearlySorted(std::size_t n, std::size_t swapEvery)
+{
+    std::vector<int> keys(n);
+    for (std::size_t i = 0; i < n; ++i)
+        keys[i] = (int) i;
+    for (std::size_t i = 0; i + 1 < n; i += swapEvery)
+        std::swap(keys[i], keys[i + 1]);
+    return keys;
+}
+
+
+int main(int argc, char **argv)
+{
+    std::size_t n = sizeArg(argc, argv, 2000000);
+
+    std::printf("-- ascending keys\n");
+    {
+        Timer t;
+        xi::RBTree<int> tree;
+        for (std::size_t i = 0; i < n; ++i)
+            tree.insert((int) i);
+        report("RBTree::insert(k)", n, t.seconds());
+    }
+    {
+        Timer t;
+        xi::RBTree<int> tree;
+        for (std::size_t i = 0; i < n; ++i)
+            tree.insert(tree.end(), (int) i);
+        report("RBTree::insert(end(), k)", n, t.seconds());
+    }
+    {
+        Timer t;
+        std::set<int> set;
+        for (std::size_t i = 0; i < n; ++i)
+            set.insert(set.end(), (int) i);
+        report("std::set::insert(end(), k)", n, t.seconds());
+    }
+
+    // Подсказка — место сразу за предыдущим ключом; при перестановке она на шаг неверна
+    std::printf("-- nearly sorted keys, hint after previous\n");
+    const std::vector<int> keys = nearlySorted(n, 8);
+    {
+        Timer t;
+        xi::RBTree<int> tree;
+        for (std::size_t i = 0; i < n; ++i)
+            tree.insert(keys[i]);
+        report("RBTree::insert(k)", n, t.seconds());
+    }
+    {
+        Timer t;
+        xi::RBTree<int> tree;
+        xi::RBTree<int>::const_iterator hint = tree.end();
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            hint = tree.insert(hint, keys[i]);
+            ++hint;
+        }
+        report("RBTree::insert(hint, k)", n, t.seconds());
+    }
+    {
+        Timer t;
+        std::set<int> set;
+        std::set<int>::const_iterator hint = set.end();
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            hint = set.insert(hint, keys[i]);
+            ++hint;
+        }
+        report("std::set::insert(hint, k)", n, t.seconds());
+    }
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  bench_batch.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Пропускная способность поиска в дереве много больше кэша: find() по одному
+// против findBatch() пачками разного размера. Внутри пачки findBatch() ведет
+// по RBTree::BATCH_GROUP поисков в ногу с prefetch следующих узлов, поэтому
+// пачки меньше группы перекрывают меньше промахов.
+//
+// Сборка: g++ -std=c++17 -O2 -I.. bench_batch.cpp -o bench_batch
+// Запуск: ./bench_batch [число ключей] [максимальный размер пачки]
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+
+#include "../rbtree.h"
+#include "benchutil.h"
+
+
+using namespace xibench;
+
+
+int main(int argc, char **argv)
+{
+    std::size_t n = sizeArg(argc, argv, 8000000);
+    std::size_t maxBatch = argc > 2 ? (std::size_t) std::strtoull(argv[2], nullptr, 10) : 1024;
+    const std::size_t PROBES = 4000000;
+
+    // четные ключи: половина поисков — промахи
+    std::vector<int> keys = shuffledKeys(n);
+    xi::RBTree<int> tree;
+    for (std::size_t i = 0; i < n; ++i)
+        tree.insert(keys[i] * 2);
+
+    std::vector<int> probes(PROBES);
+    std::mt19937 rng(7);
+    for (std::size_t i = 0; i < PROBES; ++i)
+        probes[i] = (int) (rng() % (2 * n));
+
+    std::vector<const xi::RBTree<int>::Node *> out(PROBES);
+
+    double single;
+    {
+        Timer t;
+        for (std::size_t i = 0; i < PROBES; ++i)
+            out[i] = tree.find(probes[i]);
+        single = (double) PROBES / t.seconds() / 1e6;
+    }
+
+    std::printf("%zu keys, %zu lookups, group of %zu\n", n, PROBES, xi::RBTree<int>::BATCH_GROUP);
+    std::printf("%10s %14s %9s\n", "batch", "Mlookups/s", "speedup");
+    std::printf("%10s %14.2f %8.2fx\n", "find()", single, 1.0);
+
+    for (std::size_t batch = 1; batch <= maxBatch; batch *= 2)
+    {
+        Timer t;
+        for (std::size_t i = 0; i < PROBES; i += batch)
+            tree.findBatch(probes.data() + i, batch < PROBES - i ? batch : PROBES - i, out.data() + i);
+        double mops = (double) PROBES / t.seconds() / 1e6;
+
+        std::printf("%10zu %14.2f %8.2fx\n", batch, mops, mops / single);
+    }
+
+    std::size_t hits = 0;
+    for (std::size_t i = 0; i < PROBES; ++i)
+        hits += out[i] != nullptr;
+    doNotOptimize(hits);
+
+    return 0;
+}
@@ -0,0 +1,54 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  bench_build.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Прогрев дерева из уже отсортированных ключей: insert() по одному против
+// RBTree::buildFromSorted().
+//
+// Сборка: g++ -std=c++17 -O2 -I.. bench_build.cpp -o bench_build
+// Запуск: ./bench_build [максимальное число ключей]
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+
+#include "../rbtree.h"
+#include "benchutil.h"
+
+
+using namespace xibench;
+
+
+int main(int argc, char **argv)
+{
+    std::size_t maxN = sizeArg(argc, argv, 4000000);
+
+    std::printf("%12s %16s %16s %9s\n", "keys", "insert", "buildFromSorted", "speedup");
+    for (std::size_t n = 1000; n <= maxN; n *= 4)
+    {
+        std::vector<int> keys(n);
+        for (std::size_t i = 0; i < n; ++i)
+            keys[i] = (int) i;
+
+        double ins;
+        {
+            Timer t;
+            xi::RBTree<int> tree;
+            for (std::size_t i = 0; i < n; ++i)
+                tree.insert(keys[i]);
+            ins = t.seconds();
+        }
+
+        double build;
+        {
+            Timer t;
+            xi::RBTree<int> tree = xi::RBTree<int>::buildFromSorted(keys.begin(), keys.end());
+            build = t.seconds();
+        }
+
+        std::printf("%12zu %13.3f ms %13.3f ms %8.1fx\n", n, ins * 1e3, build * 1e3, ins / build);
+    }
+
+    return 0;
+}
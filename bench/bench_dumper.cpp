@@ -0,0 +1,97 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  bench_dumper.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Цена политики отладочных событий: вставка и удаление в случайном порядке
+// с политикой по умолчанию (RBTreeNoDumper), с RBTreeVirtualDumper без
+// слушателя (ветвление на каждом событии, как было до политик) и со
+// слушателем, который только считает события (виртуальный вызов).
+// Политика по умолчанию должна совпадать с деревом без событий вовсе.
+// Дерево по умолчанию небольшое, чтобы время не тонуло в промахах кеша.
+//
+// Сборка: g++ -std=c++17 -O2 -I.. bench_dumper.cpp -o bench_dumper
+// Запуск: ./bench_dumper [число ключей]
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+
+#include "../rbtree.h"
+#include "benchutil.h"
+
+
+using namespace xibench;
+
+
+typedef xi::RBTreeVirtualDumper<int, std::less<int> > Virtual;
+typedef xi::RBTree<int> PlainTree;
+typedef xi::RBTree<int, std::less<int>, std::allocator<int>, Virtual> VirtualTree;
+
+static const int ROUNDS = 50;
+
+
+/** \brief Слушатель, который только считает события. */
+struct CountingDumper : xi::IRBTreeDumper<int, std::less<int> >
+{
+    std::size_t events;
+
+    CountingDumper()
+            : events(0)
+    {}
+
+    void rbTreeEvent(RBTreeDumperEvent, TTree *, TTreeNode *)
+    { ++events; }
+};
+
+
+/** \brief Вставляет \c ins и удаляет \c rem в дереве \c tree \c rounds раз; время — на одну операцию. */
+template<typename Tree>
+void churn(const char *name, Tree &tree, const std::vector<int> &ins, const std::vector<int> &rem, int rounds)
+{
+    double total = 0;
+    for (int r = 0; r < rounds; ++r)
+    {
+        Timer t;
+        for (std::size_t i = 0; i < ins.size(); ++i)
+            tree.insert(ins[i]);
+        for (std::size_t i = 0; i < rem.size(); ++i)
+            tree.remove(rem[i]);
+        total += t.seconds();
+    }
+    report(name, (ins.size() + rem.size()) * rounds, total);
+}
+
+
+int main(int argc, char **argv)
+{
+    std::size_t n = sizeArg(argc, argv, 20000);
+    std::vector<int> ins = shuffledKeys(n, 1);
+    std::vector<int> rem = shuffledKeys(n, 2);
+
+    std::printf("sizeof(RBTree): %zu with RBTreeNoDumper, %zu with RBTreeVirtualDumper\n",
+                sizeof(PlainTree), sizeof(VirtualTree));
+    std::printf("== insert + remove every key, %zu keys\n", n);
+
+    // Порядок чередуется, чтобы прогрев кеша и аллокатора не достался кому-то одному
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        {
+            PlainTree tree;
+            churn("RBTreeNoDumper", tree, ins, rem, ROUNDS);
+        }
+        {
+            VirtualTree tree;
+            churn("RBTreeVirtualDumper, no listener", tree, ins, rem, ROUNDS);
+        }
+        {
+            CountingDumper dumper;
+            VirtualTree tree;
+            tree.getDumper().setDumper(&dumper);
+            churn("RBTreeVirtualDumper, counting", tree, ins, rem, ROUNDS);
+            doNotOptimize(dumper.events);
+        }
+    }
+
+    return 0;
+}
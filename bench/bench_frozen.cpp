@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  bench_frozen.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Точечный поиск случайных ключей (половина — промахи): RBTree::find()
+// против std::lower_bound() по отсортированному вектору и FrozenRBTree::find()
+// после RBTree::freeze(). Поиск внутри блока векторный для того набора
+// инструкций, с которым собран бенчмарк (bench_frozen_avx2 — с -mavx2).
+//
+// Сборка: g++ -std=c++17 -O2 -I.. bench_frozen.cpp -o bench_frozen
+// Запуск: ./bench_frozen [максимальное число ключей]
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cstdio>
+
+#include "../rbfrozen.h"
+#include "../rbtree.h"
+#include "benchutil.h"
+
+
+using namespace xibench;
+
+
+/** \brief Наносекунды на поиск каждого из \c probes через \c find. */
+template<typename Find>
+static double timeFind(const std::vector<int> &probes, Find find)
+{
+    std::size_t hits = 0;
+    Timer t;
+    for (std::size_t i = 0; i < probes.size(); ++i)
+        hits += find(probes[i]);
+    double sec = t.seconds();
+
+    doNotOptimize(hits);
+    return sec * 1e9 / (double) probes.size();
+}
+
+
+int main(int argc, char **argv)
+{
+    std::size_t maxN = sizeArg(argc, argv, 16000000);
+    const std::size_t PROBES = 2000000;
+
+    std::printf("%12s %12s %12s %12s %9s %9s\n", "keys", "RBTree", "sorted vec", "frozen", "vs tree", "vs vec");
+    for (std::size_t n = 1000; n <= maxN; n *= 4)
+    {
+        // четные ключи: нечетные пробы — промахи
+        std::vector<int> keys = shuffledKeys(n);
+        xi::RBTree<int> tree;
+        for (std::size_t i = 0; i < n; ++i)
+            tree.insert(keys[i] * 2);
+
+        std::vector<int> sorted(tree.begin(), tree.end());
+        xi::FrozenRBTree<int> frozen = tree.freeze();
+
+        std::vector<int> probes(PROBES);
+        std::mt19937 rng(7);
+        for (std::size_t i = 0; i < PROBES; ++i)
+            probes[i] = (int) (rng() % (2 * n));
+
+        double t = timeFind(probes, [&tree](int k) { return tree.find(k) != nullptr; });
+        double v = timeFind(probes, [&sorted](int k) {
+            std::vector<int>::const_iterator it = std::lower_bound(sorted.begin(), sorted.end(), k);
+            return it != sorted.end() && *it == k;
+        });
+        double f = timeFind(probes, [&frozen](int k) { return frozen.find(k) != nullptr; });
+
+        std::printf("%12zu %9.1f ns %9.1f ns %9.1f ns %8.1fx %8.1fx\n", n, t, v, f, t / f, v / f);
+    }
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  bench_ingest.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Загрузка потока строковых ключей с повторами (0%, 50% и 90% дубликатов):
+// insert() с перехватом исключения против tryInsert() с перемещением ключа
+// и против std::set::insert().
+//
+// Сборка: g++ -std=c++17 -O2 -I.. bench_ingest.cpp -o bench_ingest
+// Запуск: ./bench_ingest [длина потока]
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#include "../rbtree.h"
+#include "benchutil.h"
+
+
+using namespace xibench;
+
+
+/** \brief Поток из n ключей, доля dupPercent из которых повторяет уже встречавшиеся. */
+static std::vector<std::string> makeStream(std::size_t n, unsigned dupPercent)
+{
+    std::vector<int> ids = shuffledKeys(n);
+    std::mt19937 rng(7);
+
+    std::vector<std::string> stream;
+    stream.reserve(n);
+    std::size_t fresh = 0;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        std::size_t id;
+        if (fresh && rng() % 100 < dupPercent)
+            id = ids[rng() % fresh];
+        else
+            id = ids[fresh++];
+
+        stream.push_back("ingest/record/" + std::to_string(id) + "/payload");
+    }
+
+    return stream;
+}
+
+
+int main(int argc, char **argv)
+{
+    std::size_t n = sizeArg(argc, argv, 1000000);
+
+    const unsigned dupRates[] = {0, 50, 90};
+    for (unsigned d = 0; d < 3; ++d)
+    {
+        std::printf("-- %u%% duplicates\n", dupRates[d]);
+        const std::vector<std::string> stream = makeStream(n, dupRates[d]);
+
+        {
+            Timer t;
+            xi::RBTree<std::string> tree;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                try
+                {
+                    tree.insert(stream[i]);
+                }
+                catch (const std::invalid_argument &)
+                {
+                }
+            }
+            report("RBTree::insert + catch", n, t.seconds());
+        }
+
+        {
+            // Ключи копируются заранее, чтобы замер видел только перемещение в узел
+            std::vector<std::string> keys(stream);
+            Timer t;
+            xi::RBTree<std::string> tree;
+            for (std::size_t i = 0; i < n; ++i)
+                tree.tryInsert(std::move(keys[i]));
+            report("RBTree::tryInsert(&&)", n, t.seconds());
+        }
+
+        {
+            std::vector<std::string> keys(stream);
+            Timer t;
+            std::set<std::string> set;
+            for (std::size_t i = 0; i < n; ++i)
+                set.insert(std::move(keys[i]));
+            report("std::set::insert(&&)", n, t.seconds());
+        }
+    }
+
+    return 0;
+}
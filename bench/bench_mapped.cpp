@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  bench_mapped.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Готовность дерева после перезапуска: набор n случайных ключей через
+// insert(), RBTree::load() снимка с формой и повторное открытие MappedRBTree.
+// Последнее не читает элементы, так что первые find() после открытия
+// (холодные страницы) замеряются отдельно. Плюс цена точки сохранности sync():
+// после набора всего дерева и после нескольких вставок в большой файл, где она
+// должна зависеть от числа измененных страниц, а не от размера файла.
+// Раскладка с 32-битными связями требует арены, так что обычное дерево
+// здесь тоже держит узлы в xi::ArenaAllocator.
+//
+// Сборка: g++ -std=c++17 -O2 -DRBTREE_RELATIVE_LINKS -I.. bench_mapped.cpp -o bench_mapped
+// Запуск: ./bench_mapped [максимальное число ключей] [каталог для файлов]
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <string>
+
+#include "../nodepool.h"
+#include "../rbmapped.h"
+#include "../rbtree.h"
+#include "benchutil.h"
+
+
+using namespace xibench;
+
+
+typedef xi::ArenaAllocator<int> Arena;
+typedef xi::RBTree<int, std::less<int>, Arena> HeapTree;
+
+
+int main(int argc, char **argv)
+{
+    std::size_t maxN = sizeArg(argc, argv, 4000000);
+    std::string dir = argc > 2 ? argv[2] : ".";
+    std::string snapshot = dir + "/bench_mapped.snapshot", mapped = dir + "/bench_mapped.tree";
+
+    std::vector<int> keys = shuffledKeys(maxN);
+
+    std::printf("%12s %12s %12s %12s %12s %12s %12s\n", "keys", "insert", "load", "reopen", "1000 finds", "sync",
+                "small sync");
+    for (std::size_t n = 1000; n <= maxN; n *= 4)
+    {
+        std::remove(mapped.c_str());
+
+        double ins, sync;
+        {
+            HeapTree tree((Arena(n)));
+            Timer t;
+            for (std::size_t i = 0; i < n; ++i)
+                tree.insert(keys[i]);
+            ins = t.seconds();
+            tree.save(snapshot.c_str());
+
+            xi::MappedRBTree<int> mtree(mapped.c_str());
+            for (std::size_t i = 0; i < n; ++i)
+                mtree.insert(keys[i]);
+            Timer s;
+            mtree.sync();
+            sync = s.seconds();
+        }
+
+        double load;
+        {
+            Timer t;
+            HeapTree tree = HeapTree::load(snapshot.c_str(), std::less<int>(), Arena(n));
+            load = t.seconds();
+            doNotOptimize(tree.size());
+        }
+
+        double reopen, finds, smallSync;
+        {
+            Timer t;
+            xi::MappedRBTree<int> mtree(mapped.c_str());
+            reopen = t.seconds();
+
+            Timer f;
+            std::size_t hits = 0;
+            for (std::size_t i = 0; i < 1000; ++i)
+                hits += mtree.find(keys[i * 7919 % n]) != nullptr;
+            finds = f.seconds();
+            if (hits != 1000 || mtree.size() != n)
+                std::printf("mapped tree lost keys: %zu hits, size %zu\n", hits, mtree.size());
+
+            // Несколько вставок трогают единицы страниц; отрицательных ключей в дереве нет
+            const int ROUNDS = 10, INSERTS = 10;
+            Timer s;
+            for (int r = 0; r < ROUNDS; ++r)
+            {
+                for (int i = 0; i < INSERTS; ++i)
+                    mtree.insert(-1 - (r * INSERTS + i));
+                mtree.sync();
+            }
+            smallSync = s.seconds() / ROUNDS;
+        }
+
+        std::printf("%12zu %9.3f ms %9.3f ms %9.3f ms %9.3f ms %9.3f ms %9.3f ms\n",
+                    n, ins * 1e3, load * 1e3, reopen * 1e3, finds * 1e3, sync * 1e3, smallSync * 1e3);
+    }
+
+    std::remove(snapshot.c_str());
+    std::remove(mapped.c_str());
+    return 0;
+}
@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  bench_nodesize.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Память на элемент и скорость find() для текущей раскладки узла. Раскладка
+// выбирается при компиляции, поэтому для сравнения бенчмарк собирается трижды:
+// как есть, с RBTREE_COMPACT_NODES (цвет в бите указателя на отца) и с
+// RBTREE_RELATIVE_LINKS (32-битные связи, узлы в одной арене; пуловый и
+// обычный аллокаторы с такой раскладкой не годятся и пропускаются). Узел
+// с 32-битными связями меньше, но каждый переход по связи стоит сложения,
+// так что по скорости find() раскладка не обязана выигрывать.
+//
+// Сборка: g++ -std=c++17 -O2 -I.. bench_nodesize.cpp -o bench_nodesize
+//         g++ -std=c++17 -O2 -DRBTREE_COMPACT_NODES -I.. bench_nodesize.cpp -o bench_nodesize_compact
+//         g++ -std=c++17 -O2 -DRBTREE_RELATIVE_LINKS -I.. bench_nodesize.cpp -o bench_nodesize_relative
+// Запуск: ./bench_nodesize [число ключей для find()]
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "../rbtree.h"
+#include "../nodepool.h"
+#include "benchutil.h"
+
+
+using namespace xibench;
+
+
+/** \brief Строит дерево из ключей \c keys и замеряет find() всех ключей \c probes. */
+template<typename Tree>
+void timeFind(const char *name, Tree &tree, const std::vector<int> &keys, const std::vector<int> &probes)
+{
+    for (std::size_t i = 0; i < keys.size(); ++i)
+        tree.insert((std::uint64_t) keys[i]);
+
+    Timer t;
+    std::size_t hits = 0;
+    for (std::size_t i = 0; i < probes.size(); ++i)
+        hits += tree.find((std::uint64_t) probes[i]) != nullptr;
+    doNotOptimize(hits);
+    report(name, probes.size(), t.seconds());
+}
+
+
+/** \brief Печатает размер узла дерева с элементами типа T и сколько байт на него отдаст пул. */
+template<typename T>
+void reportSize(const char *name)
+{
+    typedef typename xi::RBTree<T, std::less<T>, xi::ArenaAllocator<T> >::Node Node;
+
+    // Кусок пула выровнен по max_align_t, так что экономия видна не для всех элементов
+    xi::NodePool pool(sizeof(Node));
+    std::printf("%-14s %12zu %12zu\n", name, sizeof(Node), pool.getChunkSize());
+}
+
+
+int main(int argc, char **argv)
+{
+    std::size_t n = sizeArg(argc, argv, 4000000);
+
+#if defined(RBTREE_COMPACT_NODES)
+    std::printf("layout: compact (color in parent pointer)\n");
+#elif defined(RBTREE_RELATIVE_LINKS)
+    std::printf("layout: relative (32-bit links)\n");
+#else
+    std::printf("layout: plain (separate color field)\n");
+#endif
+
+    std::printf("%-14s %12s %12s\n", "element", "sizeof(Node)", "pool B/elem");
+    reportSize<int>("int");
+    reportSize<std::uint64_t>("uint64_t");
+    reportSize<double>("double");
+    reportSize<std::string>("std::string");
+
+    // find() по дереву, не помещающемуся в кеш: узлы меньше — промахов меньше, но связь дороже
+    std::vector<int> keys = shuffledKeys(n);
+    std::vector<int> probes = shuffledKeys(n, 7);
+#ifndef RBTREE_RELATIVE_LINKS
+    {
+        xi::RBTree<std::uint64_t, std::less<std::uint64_t>, xi::PoolAllocator<std::uint64_t> > tree;
+        timeFind("find (uint64_t, pool)", tree, keys, probes);
+    }
+#endif
+    {
+        typedef xi::ArenaAllocator<std::uint64_t> Arena;
+        xi::RBTree<std::uint64_t, std::less<std::uint64_t>, Arena> tree((Arena(n)));
+        timeFind("find (uint64_t, arena)", tree, keys, probes);
+    }
+
+    return 0;
+}
@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  bench_pqueue.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Дерево как очередь работ, разбираемая с минимального ключа: смесь вставок
+// и извлечения минимума. RBTree::popMin() против remove(min) с поиском,
+// std::set (begin() + erase()) и std::priority_queue.
+//
+// Сборка: g++ -std=c++17 -O2 -I.. bench_pqueue.cpp -o bench_pqueue
+// Запуск: ./bench_pqueue [размер очереди]
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <functional>
+#include <queue>
+#include <set>
+
+#include "../rbtree.h"
+#include "benchutil.h"
+
+
+using namespace xibench;
+
+
+int main(int argc, char **argv)
+{
+    std::size_t n = sizeArg(argc, argv, 1000000);
+
+    // Очередь держится на уровне n: каждое извлечение сопровождается вставкой нового ключа больше извлеченного
+    const std::vector<int> keys = shuffledKeys(n);
+    std::mt19937 rng(15);
+    std::vector<int> deltas(n);
+    for (std::size_t i = 0; i < n; ++i)
+        deltas[i] = 1 + (int) (rng() % n);
+
+    long long sum = 0;
+    {
+        xi::RBTree<int> tree;
+        for (std::size_t i = 0; i < n; ++i)
+            tree.insert(keys[i] * 4);
+        Timer t;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            int k = tree.popMin();
+            sum += k;
+            tree.tryInsert(k + deltas[i] * 4 + 1);
+        }
+        report("RBTree popMin + tryInsert", n, t.seconds());
+    }
+    {
+        xi::RBTree<int> tree;
+        for (std::size_t i = 0; i < n; ++i)
+            tree.insert(keys[i] * 4);
+        Timer t;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            // Прежний путь: минимум по итератору и удаление с повторным поиском
+            int k = *tree.begin();
+            tree.remove(k);
+            sum += k;
+            tree.tryInsert(k + deltas[i] * 4 + 1);
+        }
+        report("RBTree *begin() + remove + tryInsert", n, t.seconds());
+    }
+    {
+        std::set<int> set;
+        for (std::size_t i = 0; i < n; ++i)
+            set.insert(keys[i] * 4);
+        Timer t;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            int k = *set.begin();
+            set.erase(set.begin());
+            sum += k;
+            set.insert(k + deltas[i] * 4 + 1);
+        }
+        report("std::set begin + erase + insert", n, t.seconds());
+    }
+    {
+        std::priority_queue<int, std::vector<int>, std::greater<int> > pq;
+        for (std::size_t i = 0; i < n; ++i)
+            pq.push(keys[i] * 4);
+        Timer t;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            int k = pq.top();
+            pq.pop();
+            sum += k;
+            pq.push(k + deltas[i] * 4 + 1);
+        }
+        report("std::priority_queue top + pop + push", n, t.seconds());
+    }
+
+    // Полный разбор очереди
+    std::printf("-- drain\n");
+    {
+        xi::RBTree<int> tree;
+        for (std::size_t i = 0; i < n; ++i)
+            tree.insert(keys[i]);
+        Timer t;
+        while (tree.size())
+            sum += tree.popMin();
+        report("RBTree popMin", n, t.seconds());
+    }
+    {
+        std::set<int> set(keys.begin(), keys.end());
+        Timer t;
+        while (!set.empty())
+        {
+            sum += *set.begin();
+            set.erase(set.begin());
+        }
+        report("std::set erase(begin())", n, t.seconds());
+    }
+    {
+        std::priority_queue<int, std::vector<int>, std::greater<int> > pq(keys.begin(), keys.end());
+        Timer t;
+        while (!pq.empty())
+        {
+            sum += pq.top();
+            pq.pop();
+        }
+        report("std::priority_queue pop", n, t.seconds());
+    }
+
+    doNotOptimize(sum);
+    return 0;
+}
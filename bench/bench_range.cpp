@@ -0,0 +1,85 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  bench_range.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Запросы "все ключи из [lo, hi)": RBTree::forEachInRange, проход по
+// итераторам RBTree от lower_bound и тот же проход по std::set.
+//
+// Сборка: g++ -std=c++17 -O2 -I.. bench_range.cpp -o bench_range
+// Запуск: ./bench_range [число ключей]
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <set>
+
+#include "../rbtree.h"
+#include "benchutil.h"
+
+
+using namespace xibench;
+
+
+int main(int argc, char **argv)
+{
+    std::size_t n = sizeArg(argc, argv, 1000000);
+    std::vector<int> keys = shuffledKeys(n);
+
+    xi::RBTree<int> tree;
+    std::set<int> ref;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        tree.insert(keys[i]);
+        ref.insert(keys[i]);
+    }
+
+    std::mt19937 rng(7);
+    const int widths[] = {1, 16, 256, 4096};
+
+    for (std::size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w)
+    {
+        int width = widths[w];
+        // держим суммарное число просмотренных ключей примерно постоянным
+        std::size_t queries = 4000000 / (width + 16);
+        std::vector<int> los(queries);
+        for (std::size_t q = 0; q < queries; ++q)
+            los[q] = (int) (rng() % n);
+
+        std::size_t ops = queries;
+        char label[64];
+        long long sum = 0;
+
+        Timer tv;
+        for (std::size_t q = 0; q < queries; ++q)
+            tree.forEachInRange(los[q], los[q] + width, [&sum](int k) { sum += k; });
+        std::snprintf(label, sizeof(label), "w=%-5d RBTree::forEachInRange", width);
+        report(label, ops, tv.seconds());
+
+        Timer ti;
+        for (std::size_t q = 0; q < queries; ++q)
+            for (xi::RBTree<int>::const_iterator it = tree.lower_bound(los[q]);
+                 it != tree.end() && *it < los[q] + width; ++it)
+                sum += *it;
+        std::snprintf(label, sizeof(label), "w=%-5d RBTree iterators", width);
+        report(label, ops, ti.seconds());
+
+        Timer ts;
+        for (std::size_t q = 0; q < queries; ++q)
+            for (std::set<int>::const_iterator it = ref.lower_bound(los[q]);
+                 it != ref.end() && *it < los[q] + width; ++it)
+                sum += *it;
+        std::snprintf(label, sizeof(label), "w=%-5d std::set iterators", width);
+        report(label, ops, ts.seconds());
+
+        Timer tc;
+        for (std::size_t q = 0; q < queries; ++q)
+            sum += (long long) tree.countInRange(los[q], los[q] + width);
+        std::snprintf(label, sizeof(label), "w=%-5d RBTree::countInRange", width);
+        report(label, ops, tc.seconds());
+
+        doNotOptimize(sum);
+    }
+
+    return 0;
+}
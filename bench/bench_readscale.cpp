@@ -0,0 +1,202 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  bench_readscale.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Масштабирование чтения по числу потоков (1..64) при редких записях: читатели
+// ищут случайные ключи, а один писатель раз в 50 мкс вставляет и удаляет ключ.
+// Сравниваются RBTree за std::mutex, RBTree за std::shared_mutex и
+// ConcurrentRBTree (читатели без блокировок, освобождение по эпохам).
+// Все деревья собраны с RBTREE_ATOMIC_LINKS, которого требует ConcurrentRBTree.
+//
+// Сборка: g++ -std=c++17 -O2 -pthread -DRBTREE_ATOMIC_LINKS -I.. bench_readscale.cpp -o bench_readscale
+// Запуск: ./bench_readscale [число ключей] [максимум потоков] [мс на замер]
+////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+#include "../rbconcurrent.h"
+#include "../rbtree.h"
+#include "benchutil.h"
+
+
+using namespace xibench;
+
+
+/** \brief Дерево за одним мьютексом — так его сейчас и защищают. */
+struct MutexTree
+{
+    static const char *name()
+    { return "RBTree + std::mutex"; }
+
+    xi::RBTree<int> tree;
+    mutable std::mutex lock;
+
+    bool contains(int k) const
+    {
+        std::lock_guard<std::mutex> g(lock);
+        return tree.find(k) != nullptr;
+    }
+
+    void insert(int k)
+    {
+        std::lock_guard<std::mutex> g(lock);
+        tree.tryInsert(k);
+    }
+
+    void remove(int k)
+    {
+        std::lock_guard<std::mutex> g(lock);
+        if (tree.find(k))
+            tree.remove(k);
+    }
+};
+
+
+/** \brief Дерево за блокировкой читателей-писателя. */
+struct SharedMutexTree
+{
+    static const char *name()
+    { return "RBTree + std::shared_mutex"; }
+
+    xi::RBTree<int> tree;
+    mutable std::shared_mutex lock;
+
+    bool contains(int k) const
+    {
+        std::shared_lock<std::shared_mutex> g(lock);
+        return tree.find(k) != nullptr;
+    }
+
+    void insert(int k)
+    {
+        std::unique_lock<std::shared_mutex> g(lock);
+        tree.tryInsert(k);
+    }
+
+    void remove(int k)
+    {
+        std::unique_lock<std::shared_mutex> g(lock);
+        if (tree.find(k))
+            tree.remove(k);
+    }
+};
+
+
+/** \brief Один писатель и читатели без блокировок. */
+struct EpochTree
+{
+    static const char *name()
+    { return "ConcurrentRBTree"; }
+
+    xi::ConcurrentRBTree<int> tree;
+
+    bool contains(int k) const
+    { return tree.contains(k); }
+
+    void insert(int k)
+    { tree.tryInsert(k); }
+
+    void remove(int k)
+    { tree.tryRemove(k); }
+};
+
+
+/** \brief Миллионы поисков в секунду у \c threads читателей за \c ms миллисекунд. */
+template<typename T>
+static double measure(T &t, std::size_t n, std::size_t threads, int ms)
+{
+    std::atomic<bool> stop(false);
+    std::atomic<std::size_t> total(0);
+
+    std::vector<std::thread> readers;
+    for (std::size_t r = 0; r < threads; ++r)
+        readers.push_back(std::thread([&t, &stop, &total, n, r]() {
+            std::mt19937 rng((unsigned) r + 1);
+            std::size_t ops = 0, hits = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                // пачками, чтобы проверка флага не мерилась вместе с поиском
+                for (int i = 0; i < 64; ++i)
+                    hits += t.contains((int) (rng() % (2 * n)));
+                ops += 64;
+            }
+            doNotOptimize(hits);
+            total += ops;
+        }));
+
+    // Писатель: ключи за пределами [0, 2n), чтобы не менять долю попаданий читателей
+    std::thread writer([&t, &stop, n]() {
+        int k = (int) (2 * n);
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            t.insert(k);
+            t.remove(k);
+            ++k;
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    });
+
+    Timer timer;
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    stop = true;
+    double sec = timer.seconds();
+
+    for (std::size_t r = 0; r < readers.size(); ++r)
+        readers[r].join();
+    writer.join();
+
+    return (double) total.load() / sec / 1e6;
+}
+
+
+template<typename T>
+static void run(const std::vector<int> &keys, std::size_t maxThreads, int ms)
+{
+    T t;
+    for (std::size_t i = 0; i < keys.size(); ++i)
+        t.insert(keys[i]);
+
+    std::printf("%s\n", T::name());
+    std::printf("%8s %14s %9s\n", "threads", "Mlookups/s", "speedup");
+
+    double base = 0;
+    for (std::size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        double mops = measure(t, keys.size(), threads, ms);
+        if (threads == 1)
+            base = mops;
+        std::printf("%8zu %14.2f %8.2fx\n", threads, mops, mops / base);
+
+        if (threads < maxThreads && threads * 2 > maxThreads)
+            threads = maxThreads / 2;
+    }
+    std::printf("\n");
+}
+
+
+int main(int argc, char **argv)
+{
+    std::size_t n = sizeArg(argc, argv, 1000000);
+    std::size_t maxThreads = argc > 2 ? (std::size_t) std::strtoull(argv[2], nullptr, 10) : 64;
+    int ms = argc > 3 ? std::atoi(argv[3]) : 300;
+    if (!maxThreads)
+        maxThreads = 1;
+
+    // ключи через один: половина поисков попадает, половина промахивается
+    std::vector<int> keys = shuffledKeys(n);
+    for (std::size_t i = 0; i < n; ++i)
+        keys[i] *= 2;
+
+    std::printf("%zu keys, hardware threads: %u\n\n", n, std::thread::hardware_concurrency());
+    run<MutexTree>(keys, maxThreads, ms);
+    run<SharedMutexTree>(keys, maxThreads, ms);
+    run<EpochTree>(keys, maxThreads, ms);
+
+    return 0;
+}
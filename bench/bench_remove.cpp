@@ -0,0 +1,60 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  bench_remove.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Удаление в чистом виде: дерево строится заранее, замеряется только
+// серия remove() в случайном порядке. Ключи — int и "тяжелые" std::string,
+// для которых каждое лишнее конструирование Element особенно заметно.
+//
+// Сборка: g++ -std=c++17 -O2 -I.. bench_remove.cpp -o bench_remove
+// Запуск: ./bench_remove [число ключей]
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <string>
+
+#include "../rbtree.h"
+#include "benchutil.h"
+
+
+using namespace xibench;
+
+
+/** \brief Строит дерево из \c keys и замеряет удаление ключей в порядке \c order. */
+template<typename Key>
+void removeAll(const char *name, const std::vector<Key> &keys, const std::vector<int> &order, int rounds)
+{
+    double total = 0;
+    for (int r = 0; r < rounds; ++r)
+    {
+        xi::RBTree<Key> tree;
+        for (std::size_t i = 0; i < keys.size(); ++i)
+            tree.insert(keys[i]);
+
+        Timer t;
+        for (std::size_t i = 0; i < order.size(); ++i)
+            tree.remove(keys[order[i]]);
+        total += t.seconds();
+    }
+    report(name, order.size() * rounds, total);
+}
+
+
+int main(int argc, char **argv)
+{
+    std::size_t n = sizeArg(argc, argv, 500000);
+    std::vector<int> ins = shuffledKeys(n, 1);
+    std::vector<int> order = shuffledKeys(n, 2);
+
+    std::vector<std::string> strs(n);
+    for (std::size_t i = 0; i < n; ++i)
+        strs[i] = "some-long-key-prefix-that-defeats-sso/" + std::to_string(ins[i]);
+
+    std::printf("== remove every key, %zu keys\n", n);
+    removeAll("int remove", ins, order, 3);
+    removeAll("std::string remove", strs, order, 3);
+
+    return 0;
+}
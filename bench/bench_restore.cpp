@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  bench_restore.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Перезапуск сервиса: дерево из n случайных ключей заново набирается
+// insert() против RBTree::load() снимка с формой и без нее. Для int файл
+// читается через mmap, для std::string — потоком.
+//
+// Сборка: g++ -std=c++17 -O2 -I.. bench_restore.cpp -o bench_restore
+// Запуск: ./bench_restore [максимальное число ключей] [путь к временному файлу]
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <string>
+
+#include "../rbtree.h"
+#include "benchutil.h"
+
+
+using namespace xibench;
+
+
+/** \brief Секунды на загрузку снимка \c path; заодно сверяет размер. */
+template<typename T>
+static double timeLoad(const char *path, std::size_t expected)
+{
+    Timer t;
+    xi::RBTree<T> tree = xi::RBTree<T>::load(path);
+    double sec = t.seconds();
+
+    if (tree.size() != expected)
+        std::printf("size mismatch: %zu != %zu\n", tree.size(), expected);
+    return sec;
+}
+
+
+template<typename T>
+static void run(const char *name, const std::vector<T> &keys, const char *path)
+{
+    std::printf("%s\n", name);
+    std::printf("%12s %14s %14s %14s %9s\n", "keys", "insert", "load+shape", "load", "speedup");
+
+    for (std::size_t n = 1000; n <= keys.size(); n *= 4)
+    {
+        xi::RBTree<T> tree;
+        double ins;
+        {
+            Timer t;
+            for (std::size_t i = 0; i < n; ++i)
+                tree.insert(keys[i]);
+            ins = t.seconds();
+        }
+
+        tree.save(path, true);
+        double shaped = timeLoad<T>(path, n);
+
+        tree.save(path, false);
+        double plain = timeLoad<T>(path, n);
+
+        std::printf("%12zu %11.3f ms %11.3f ms %11.3f ms %8.1fx\n",
+                    n, ins * 1e3, shaped * 1e3, plain * 1e3, ins / shaped);
+    }
+    std::printf("\n");
+}
+
+
+int main(int argc, char **argv)
+{
+    std::size_t maxN = sizeArg(argc, argv, 4000000);
+    const char *path = argc > 2 ? argv[2] : "bench_restore.snapshot";
+
+    std::vector<int> keys = shuffledKeys(maxN);
+    run("int (mmap)", keys, path);
+
+    std::vector<std::string> strs(maxN);
+    for (std::size_t i = 0; i < maxN; ++i)
+        strs[i] = "key:" + std::to_string(keys[i]);
+    run("std::string (stream)", strs, path);
+
+    std::remove(path);
+    return 0;
+}
@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  bench_setops.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Масштабирование unionWith/intersectWith/differenceWith по числу потоков:
+// два дерева по n случайных ключей из [0, 2n), от 1 потока (без пула) до N.
+//
+// Сборка: g++ -std=c++17 -O2 -pthread -I.. bench_setops.cpp -o bench_setops
+// Запуск: ./bench_setops [число ключей в каждом дереве] [максимум потоков]
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <thread>
+
+#include "../rbsetops.h"
+#include "benchutil.h"
+
+
+using namespace xibench;
+
+typedef xi::RBTree<int> Tree;
+
+
+/** \brief Отсортированные n различных ключей из [0, 2n). */
+static std::vector<int> randomSet(std::size_t n, unsigned seed)
+{
+    std::vector<int> keys = shuffledKeys(2 * n, seed);
+    keys.resize(n);
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+
+/** \brief Время одной операции \c op над свежими деревьями из \c a и \c b. */
+static double timeOp(int op, const std::vector<int> &a, const std::vector<int> &b, xi::WorkStealingPool *pool)
+{
+    Tree x = Tree::buildFromSorted(a.begin(), a.end());
+    Tree y = Tree::buildFromSorted(b.begin(), b.end());
+
+    Timer t;
+    if (op == 0)
+        x.unionWith(std::move(y), pool);
+    else if (op == 1)
+        x.intersectWith(std::move(y), pool);
+    else
+        x.differenceWith(std::move(y), pool);
+    double sec = t.seconds();
+
+    doNotOptimize(x.getRoot());
+    return sec;
+}
+
+
+int main(int argc, char **argv)
+{
+    std::size_t n = sizeArg(argc, argv, 2000000);
+    std::size_t maxThreads = std::thread::hardware_concurrency();
+    if (argc > 2)
+        maxThreads = (std::size_t) std::strtoull(argv[2], nullptr, 10);
+    if (!maxThreads)
+        maxThreads = 1;
+
+    std::vector<int> a = randomSet(n, 1);
+    std::vector<int> b = randomSet(n, 2);
+
+    std::printf("%zu + %zu keys, hardware threads: %u\n", n, n, std::thread::hardware_concurrency());
+    std::printf("%8s %14s %14s %14s %9s\n", "threads", "union", "intersection", "difference", "speedup");
+
+    double base = 0;
+    for (std::size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        // Вызывающий поток тоже работает, так что рабочих в пуле на один меньше
+        xi::WorkStealingPool pool(threads - 1);
+        xi::WorkStealingPool *p = threads > 1 ? &pool : nullptr;
+
+        double u = timeOp(0, a, b, p);
+        double i = timeOp(1, a, b, p);
+        double d = timeOp(2, a, b, p);
+        if (threads == 1)
+            base = u + i + d;
+
+        std::printf("%8zu %11.2f ms %11.2f ms %11.2f ms %8.2fx\n", threads, u * 1e3, i * 1e3, d * 1e3,
+                    base / (u + i + d));
+
+        if (threads < maxThreads && threads * 2 > maxThreads)
+            threads = maxThreads / 2;
+    }
+
+    return 0;
+}
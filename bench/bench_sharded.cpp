@@ -0,0 +1,124 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  bench_sharded.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Масштабирование параллельной вставки по числу потоков: n равномерно
+// случайных ключей делятся между потоками поровну. RBTree за одним мьютексом
+// против ShardedRBTree (границы выбираются по выборке сами, как только
+// в первом шарде наберется достаточно ключей).
+//
+// Сборка: g++ -std=c++17 -O2 -pthread -I.. bench_sharded.cpp -o bench_sharded
+// Запуск: ./bench_sharded [число ключей] [максимум потоков] [число шардов]
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include "../rbsharded.h"
+#include "../rbtree.h"
+#include "benchutil.h"
+
+
+using namespace xibench;
+
+
+/** \brief Дерево за одним мьютексом. */
+struct MutexTree
+{
+    xi::RBTree<int> tree;
+    std::mutex lock;
+
+    explicit MutexTree(std::size_t)
+    {}
+
+    void insert(int k)
+    {
+        std::lock_guard<std::mutex> g(lock);
+        tree.tryInsert(k);
+    }
+
+    std::size_t size() const
+    { return tree.size(); }
+};
+
+
+struct ShardedTree
+{
+    xi::ShardedRBTree<int> tree;
+
+    explicit ShardedTree(std::size_t shards)
+            : tree(shards)
+    {}
+
+    void insert(int k)
+    { tree.tryInsert(k); }
+
+    std::size_t size() const
+    { return tree.size(); }
+};
+
+
+/** \brief Секунды на вставку всех \c keys в свежий контейнер \c threads потоками. */
+template<typename T>
+static double timeInsert(const std::vector<int> &keys, std::size_t threads, std::size_t shards)
+{
+    T t(shards);
+    std::size_t per = keys.size() / threads;
+
+    Timer timer;
+    std::vector<std::thread> workers;
+    for (std::size_t w = 0; w < threads; ++w)
+    {
+        std::size_t from = w * per, to = w + 1 == threads ? keys.size() : from + per;
+        workers.push_back(std::thread([&t, &keys, from, to]() {
+            for (std::size_t i = from; i < to; ++i)
+                t.insert(keys[i]);
+        }));
+    }
+    for (std::size_t w = 0; w < workers.size(); ++w)
+        workers[w].join();
+    double sec = timer.seconds();
+
+    if (t.size() != keys.size())
+        std::printf("size mismatch: %zu != %zu\n", t.size(), keys.size());
+    return sec;
+}
+
+
+int main(int argc, char **argv)
+{
+    std::size_t n = sizeArg(argc, argv, 4000000);
+    std::size_t maxThreads = std::thread::hardware_concurrency();
+    if (argc > 2)
+        maxThreads = (std::size_t) std::strtoull(argv[2], nullptr, 10);
+    if (!maxThreads)
+        maxThreads = 1;
+    std::size_t shards = argc > 3 ? (std::size_t) std::strtoull(argv[3], nullptr, 10) : 64;
+
+    std::vector<int> keys = shuffledKeys(n);
+
+    std::printf("%zu keys, %zu shards, hardware threads: %u\n", n, shards, std::thread::hardware_concurrency());
+    std::printf("%8s %16s %9s %16s %9s\n", "threads", "mutex Mops/s", "speedup", "sharded Mops/s", "speedup");
+
+    double baseMutex = 0, baseSharded = 0;
+    for (std::size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        double m = (double) n / timeInsert<MutexTree>(keys, threads, shards) / 1e6;
+        double s = (double) n / timeInsert<ShardedTree>(keys, threads, shards) / 1e6;
+        if (threads == 1)
+        {
+            baseMutex = m;
+            baseSharded = s;
+        }
+
+        std::printf("%8zu %16.2f %8.2fx %16.2f %8.2fx\n", threads, m, m / baseMutex, s, s / baseSharded);
+
+        if (threads < maxThreads && threads * 2 > maxThreads)
+            threads = maxThreads / 2;
+    }
+
+    return 0;
+}
@@ -0,0 +1,532 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  bench_suite.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Сводный бенчмарк для отлова регрессий: insert, find, remove и полный проход
+// у RBTree и у std::set (база) на ключах int, uint64_t и std::string, порядках
+// sequential (по возрастанию), random (перестановка), zipf (вставка в случайном
+// порядке, поиск по закону Ципфа, удаление от самых популярных к редким) и
+// adversarial (зигзаг от краев к середине; у строк вдобавок длинный общий
+// префикс) и размерах от 1K до 100M. С ключом --map сравниваются RBMap и std::map.
+//
+// Для каждой операции печатается ns/op, для вставки — байт на элемент (по
+// CountingAllocator, без накладных расходов malloc), а там, где доступны
+// аппаратные счетчики, — такты, инструкции, промахи кэша и предсказателя на
+// операцию. Последний столбец — время относительно std::set (std::map).
+// Маленькие размеры прогоняются несколько раз, чтобы набрать ~1M операций.
+//
+// Сборка: cmake -S .. -B build && cmake --build build --target bench_suite
+// Запуск: ./bench_suite [--keys=int,u64,str] [--patterns=seq,rand,zipf,adv]
+//                       [--min=1000] [--max=1000000] [--map]
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+
+#include "../rbmap.h"
+#include "../rbtree.h"
+#include "benchutil.h"
+
+
+using namespace xibench;
+
+
+namespace
+{
+
+    // Ключи
+
+    /** \brief Строит i-й по порядку ключ типа K; \c hard — вариант для adversarial. */
+    template<typename K>
+    struct KeyMaker;
+
+    template<>
+    struct KeyMaker<int>
+    {
+        static const char *name()
+        { return "int"; }
+
+        static int make(std::size_t i, bool)
+        { return (int) i; }
+    };
+
+    template<>
+    struct KeyMaker<std::uint64_t>
+    {
+        static const char *name()
+        { return "u64"; }
+
+        // монотонно и с большими промежутками, чтобы ключи не были подряд идущими числами
+        static std::uint64_t make(std::size_t i, bool)
+        { return (std::uint64_t) i * 2654435761u; }
+    };
+
+    template<>
+    struct KeyMaker<std::string>
+    {
+        static const char *name()
+        { return "str"; }
+
+        // у adversarial все ключи делят префикс в 48 символов: каждое сравнение его пробегает
+        static std::string make(std::size_t i, bool hard)
+        {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%012zu", i);
+            return (hard ? std::string(48, 'k') : std::string("key")) + buf;
+        }
+    };
+
+
+    // Порядки операций
+
+    enum Pattern
+    {
+        P_SEQUENTIAL,
+        P_RANDOM,
+        P_ZIPF,
+        P_ADVERSARIAL,
+        P_COUNT
+    };
+
+    const char *const PATTERN_NAMES[P_COUNT] = {"seq", "rand", "zipf", "adv"};
+
+    /** \brief Индексы ключей (в порядке возрастания ключей) для вставки, поиска и удаления. */
+    struct Workload
+    {
+        std::vector<std::uint32_t> insertOrder;
+        std::vector<std::uint32_t> findOrder;
+        std::vector<std::uint32_t> removeOrder;
+    };
+
+    std::vector<std::uint32_t> permutation(std::size_t n, unsigned seed)
+    {
+        std::vector<std::uint32_t> res(n);
+        for (std::size_t i = 0; i < n; ++i)
+            res[i] = (std::uint32_t) i;
+        std::shuffle(res.begin(), res.end(), std::mt19937(seed));
+        return res;
+    }
+
+    /** \brief Зигзаг 0, n-1, 1, n-2, ...: вставки попеременно в оба края дерева. */
+    std::vector<std::uint32_t> zigzag(std::size_t n)
+    {
+        std::vector<std::uint32_t> res;
+        res.reserve(n);
+        for (std::size_t lo = 0, hi = n; lo < hi;)
+        {
+            res.push_back((std::uint32_t) lo++);
+            if (lo < hi)
+                res.push_back((std::uint32_t) --hi);
+        }
+        return res;
+    }
+
+    Workload makeWorkload(Pattern p, std::size_t n)
+    {
+        Workload w;
+        switch (p)
+        {
+            case P_SEQUENTIAL:
+                w.insertOrder.resize(n);
+                for (std::size_t i = 0; i < n; ++i)
+                    w.insertOrder[i] = (std::uint32_t) i;
+                w.findOrder = w.insertOrder;
+                w.removeOrder = w.insertOrder;
+                break;
+
+            case P_RANDOM:
+                w.insertOrder = permutation(n, 1);
+                w.findOrder = permutation(n, 2);
+                w.removeOrder = permutation(n, 3);
+                break;
+
+            case P_ZIPF:
+            {
+                // популярность раздается ключам случайно, иначе горячие ключи лежали бы рядом
+                std::vector<std::uint32_t> byRank = permutation(n, 4);
+                ZipfGenerator zipf(n);
+                w.insertOrder = permutation(n, 1);
+                w.findOrder.resize(n);
+                for (std::size_t i = 0; i < n; ++i)
+                    w.findOrder[i] = byRank[zipf()];
+                w.removeOrder = byRank;
+                break;
+            }
+
+            default:
+                w.insertOrder = zigzag(n);
+                w.findOrder = w.insertOrder;
+                // удаление всегда самого левого узла — худший случай для перебалансировки
+                w.removeOrder.resize(n);
+                for (std::size_t i = 0; i < n; ++i)
+                    w.removeOrder[i] = (std::uint32_t) i;
+                break;
+        }
+        return w;
+    }
+
+
+    // Контейнеры
+
+    template<typename K>
+    struct TreeSet
+    {
+        typedef xi::RBTree<K, std::less<K>, CountingAllocator<K> > Container;
+
+        static const char *name()
+        { return "RBTree"; }
+
+        static void insert(Container &c, const K &k)
+        { c.insert(k); }
+
+        static bool find(const Container &c, const K &k)
+        { return c.find(k) != nullptr; }
+
+        static void remove(Container &c, const K &k)
+        { c.remove(k); }
+
+        static const K &keyOf(const K &k)
+        { return k; }
+    };
+
+    template<typename K>
+    struct StdSet
+    {
+        typedef std::set<K, std::less<K>, CountingAllocator<K> > Container;
+
+        static const char *name()
+        { return "std::set"; }
+
+        static void insert(Container &c, const K &k)
+        { c.insert(k); }
+
+        static bool find(const Container &c, const K &k)
+        { return c.find(k) != c.end(); }
+
+        static void remove(Container &c, const K &k)
+        { c.erase(k); }
+
+        static const K &keyOf(const K &k)
+        { return k; }
+    };
+
+    template<typename K>
+    struct TreeMap
+    {
+        typedef std::pair<const K, std::size_t> Value;
+        typedef xi::RBMap<K, std::size_t, std::less<K>, CountingAllocator<Value> > Container;
+
+        static const char *name()
+        { return "RBMap"; }
+
+        static void insert(Container &c, const K &k)
+        { c.tryEmplace(k, (std::size_t) 1); }
+
+        static bool find(const Container &c, const K &k)
+        { return c.contains(k); }
+
+        static void remove(Container &c, const K &k)
+        { c.remove(k); }
+
+        static const K &keyOf(const Value &v)
+        { return v.first; }
+    };
+
+    template<typename K>
+    struct StdMap
+    {
+        typedef std::pair<const K, std::size_t> Value;
+        typedef std::map<K, std::size_t, std::less<K>, CountingAllocator<Value> > Container;
+
+        static const char *name()
+        { return "std::map"; }
+
+        static void insert(Container &c, const K &k)
+        { c.emplace(k, (std::size_t) 1); }
+
+        static bool find(const Container &c, const K &k)
+        { return c.find(k) != c.end(); }
+
+        static void remove(Container &c, const K &k)
+        { c.erase(k); }
+
+        static const K &keyOf(const Value &v)
+        { return v.first; }
+    };
+
+
+    // Замеры
+
+    enum Op
+    {
+        OP_INSERT,
+        OP_FIND,
+        OP_SCAN,
+        OP_REMOVE,
+        OP_COUNT
+    };
+
+    const char *const OP_NAMES[OP_COUNT] = {"insert", "find", "scan", "remove"};
+
+    /** \brief Накопленные время и счетчики одной операции по всем повторам. */
+    struct Sample
+    {
+        double sec;
+        std::size_t ops;
+        std::uint64_t counters[PerfCounters::PC_COUNT];
+
+        Sample()
+                : sec(0), ops(0)
+        {
+            for (int i = 0; i < PerfCounters::PC_COUNT; ++i)
+                counters[i] = 0;
+        }
+
+        void add(const Timer &t, std::size_t n, const PerfCounters &perf)
+        {
+            sec += t.seconds();
+            ops += n;
+            for (int i = 0; i < PerfCounters::PC_COUNT; ++i)
+                counters[i] += perf.get((PerfCounters::Counter) i);
+        }
+
+        double nsPerOp() const
+        { return ops ? sec * 1e9 / (double) ops : 0; }
+
+        double perOp(PerfCounters::Counter c) const
+        { return ops ? (double) counters[c] / (double) ops : 0; }
+    };
+
+    struct Result
+    {
+        Sample ops[OP_COUNT];
+        double bytesPerElem;
+    };
+
+    std::size_t sink = 0;
+
+    std::size_t scanWeight(int k)
+    { return (std::size_t) k; }
+
+    std::size_t scanWeight(std::uint64_t k)
+    { return (std::size_t) k; }
+
+    std::size_t scanWeight(const std::string &k)
+    { return k.size(); }
+
+    /** \brief Прогоняет все операции над контейнером \c Impl, повторяя их \c reps раз. */
+    template<typename Impl, typename K>
+    Result run(const std::vector<K> &keys, const Workload &w, std::size_t reps, PerfCounters &perf)
+    {
+        Result res;
+        res.bytesPerElem = 0;
+        std::size_t n = keys.size();
+
+        for (std::size_t r = 0; r < reps; ++r)
+        {
+            std::size_t before = liveBytes();
+            {
+                typename Impl::Container c;
+
+                perf.start();
+                Timer ti;
+                for (std::size_t i = 0; i < n; ++i)
+                    Impl::insert(c, keys[w.insertOrder[i]]);
+                perf.stop();
+                res.ops[OP_INSERT].add(ti, n, perf);
+                res.bytesPerElem = (double) (liveBytes() - before) / (double) n;
+
+                std::size_t hits = 0;
+                perf.start();
+                Timer tf;
+                for (std::size_t i = 0; i < n; ++i)
+                    hits += Impl::find(c, keys[w.findOrder[i]]);
+                perf.stop();
+                res.ops[OP_FIND].add(tf, n, perf);
+                sink += hits;
+
+                std::size_t sum = 0;
+                perf.start();
+                Timer ts;
+                for (typename Impl::Container::const_iterator it = c.begin(); it != c.end(); ++it)
+                    sum += scanWeight(Impl::keyOf(*it));
+                perf.stop();
+                res.ops[OP_SCAN].add(ts, n, perf);
+                sink += sum;
+
+                perf.start();
+                Timer tr;
+                for (std::size_t i = 0; i < n; ++i)
+                    Impl::remove(c, keys[w.removeOrder[i]]);
+                perf.stop();
+                res.ops[OP_REMOVE].add(tr, n, perf);
+            }
+        }
+        return res;
+    }
+
+    void printHeader(const PerfCounters &perf)
+    {
+        std::printf("%-4s %-5s %10s %-7s %-9s %10s %8s", "key", "order", "n", "op", "impl", "ns/op", "B/elem");
+        if (perf.isAvailable())
+            std::printf(" %9s %9s %9s %9s", "cyc/op", "ins/op", "llc/op", "brm/op");
+        std::printf(" %7s\n", "vs std");
+    }
+
+    void printRow(const char *key, Pattern p, std::size_t n, Op op, const char *impl,
+                  const Result &res, const Result &base, const PerfCounters &perf)
+    {
+        const Sample &s = res.ops[op];
+        std::printf("%-4s %-5s %10zu %-7s %-9s %10.1f", key, PATTERN_NAMES[p], n, OP_NAMES[op], impl, s.nsPerOp());
+        if (op == OP_INSERT)
+            std::printf(" %8.1f", res.bytesPerElem);
+        else
+            std::printf(" %8s", "");
+
+        if (perf.isAvailable())
+        {
+            for (int c = 0; c < PerfCounters::PC_COUNT; ++c)
+            {
+                if (perf.has((PerfCounters::Counter) c))
+                    std::printf(" %9.2f", s.perOp((PerfCounters::Counter) c));
+                else
+                    std::printf(" %9s", "n/a");
+            }
+        }
+
+        std::printf(" %7.2f\n", s.nsPerOp() / base.ops[op].nsPerOp());
+    }
+
+    /** \brief Настройки из командной строки. */
+    struct Options
+    {
+        bool keys[3];
+        bool patterns[P_COUNT];
+        std::size_t minSize;
+        std::size_t maxSize;
+        bool maps;
+
+        Options()
+                : minSize(1000), maxSize(1000000), maps(false)
+        {
+            for (int i = 0; i < 3; ++i)
+                keys[i] = true;
+            for (int i = 0; i < P_COUNT; ++i)
+                patterns[i] = true;
+        }
+    };
+
+    /** \brief Разбирает список через запятую: отмечает в \c flags имена, найденные в \c names. */
+    void parseList(const char *list, const char *const *names, bool *flags, int count)
+    {
+        for (int i = 0; i < count; ++i)
+            flags[i] = false;
+
+        std::string s(list);
+        for (std::size_t pos = 0; pos <= s.size();)
+        {
+            std::size_t comma = s.find(',', pos);
+            if (comma == std::string::npos)
+                comma = s.size();
+
+            std::string item = s.substr(pos, comma - pos);
+            for (int i = 0; i < count; ++i)
+                if (item == names[i])
+                    flags[i] = true;
+            pos = comma + 1;
+        }
+    }
+
+    const char *const KEY_NAMES[3] = {"int", "u64", "str"};
+
+    template<typename K, template<typename> class Tree, template<typename> class Base>
+    void runKeyType(const Options &opt, PerfCounters &perf)
+    {
+        for (std::size_t n = 1000; n <= opt.maxSize && n <= 100000000; n *= 10)
+        {
+            if (n < opt.minSize)
+                continue;
+
+            for (int p = 0; p < P_COUNT; ++p)
+            {
+                if (!opt.patterns[p])
+                    continue;
+
+                bool hard = p == P_ADVERSARIAL;
+                std::vector<K> keys(n);
+                for (std::size_t i = 0; i < n; ++i)
+                    keys[i] = KeyMaker<K>::make(i, hard);
+
+                Workload w = makeWorkload((Pattern) p, n);
+                std::size_t reps = n < 1000000 ? 1000000 / n : 1;
+
+                Result base = run<Base<K> >(keys, w, reps, perf);
+                Result tree = run<Tree<K> >(keys, w, reps, perf);
+
+                for (int op = 0; op < OP_COUNT; ++op)
+                {
+                    printRow(KeyMaker<K>::name(), (Pattern) p, n, (Op) op, Base<K>::name(), base, base, perf);
+                    printRow(KeyMaker<K>::name(), (Pattern) p, n, (Op) op, Tree<K>::name(), tree, base, perf);
+                }
+                std::fflush(stdout);
+            }
+        }
+    }
+
+    template<typename K>
+    void runKeyType(const Options &opt, PerfCounters &perf)
+    {
+        if (opt.maps)
+            runKeyType<K, TreeMap, StdMap>(opt, perf);
+        else
+            runKeyType<K, TreeSet, StdSet>(opt, perf);
+    }
+
+} // namespace
+
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        if (!std::strncmp(arg, "--keys=", 7))
+            parseList(arg + 7, KEY_NAMES, opt.keys, 3);
+        else if (!std::strncmp(arg, "--patterns=", 11))
+            parseList(arg + 11, PATTERN_NAMES, opt.patterns, P_COUNT);
+        else if (!std::strncmp(arg, "--min=", 6))
+            opt.minSize = (std::size_t) std::strtoull(arg + 6, nullptr, 10);
+        else if (!std::strncmp(arg, "--max=", 6))
+            opt.maxSize = (std::size_t) std::strtoull(arg + 6, nullptr, 10);
+        else if (!std::strcmp(arg, "--map"))
+            opt.maps = true;
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--keys=int,u64,str] [--patterns=seq,rand,zipf,adv] "
+                                 "[--min=N] [--max=N] [--map]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    PerfCounters perf;
+    if (!perf.isAvailable())
+        std::printf("# hardware counters are not available, reporting time and memory only\n");
+    printHeader(perf);
+
+    if (opt.keys[0])
+        runKeyType<int>(opt, perf);
+    if (opt.keys[1])
+        runKeyType<std::uint64_t>(opt, perf);
+    if (opt.keys[2])
+        runKeyType<std::string>(opt, perf);
+
+    doNotOptimize(sink);
+    return 0;
+}
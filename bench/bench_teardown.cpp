@@ -0,0 +1,56 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  bench_teardown.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Время разрушения дерева в зависимости от его размера: итеративный обход
+// для обычного аллокатора и сброс пула за O(1) для xi::PoolAllocator.
+//
+// Сборка: g++ -std=c++17 -O2 -I.. bench_teardown.cpp -o bench_teardown
+// Запуск: ./bench_teardown [максимальное число ключей]
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <string>
+
+#include "../rbtree.h"
+#include "../nodepool.h"
+#include "benchutil.h"
+
+
+using namespace xibench;
+
+
+/** \brief Заполняет дерево ключами и замеряет только clear(). */
+template<typename Tree>
+double teardown(const std::vector<int> &keys)
+{
+    Tree tree;
+    for (std::size_t i = 0; i < keys.size(); ++i)
+        tree.insert(keys[i]);
+
+    Timer t;
+    tree.clear();
+    return t.seconds();
+}
+
+
+int main(int argc, char **argv)
+{
+    std::size_t maxN = sizeArg(argc, argv, 4000000);
+
+    typedef xi::RBTree<int> PlainTree;
+    typedef xi::RBTree<int, std::less<int>, xi::PoolAllocator<int> > PooledTree;
+
+    std::printf("%12s %16s %16s\n", "keys", "std::allocator", "PoolAllocator");
+    for (std::size_t n = 1000; n <= maxN; n *= 4)
+    {
+        std::vector<int> keys = shuffledKeys(n);
+        double plain = teardown<PlainTree>(keys);
+        double pooled = teardown<PooledTree>(keys);
+        std::printf("%12zu %13.3f ms %13.3f ms\n", n, plain * 1e3, pooled * 1e3);
+    }
+
+    return 0;
+}
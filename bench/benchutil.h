@@ -0,0 +1,297 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  benchutil.h
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Общие мелочи для бенчмарков: таймер, генерация ключей, вывод строки отчета,
+// распределение Ципфа, аллокатор со счетчиком байт и аппаратные счетчики
+// (perf_event_open, только Linux; если ядро их не дает, счетчики просто недоступны).
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef XI_BENCHUTIL_H
+#define XI_BENCHUTIL_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/perf_event.h>)
+#define XIBENCH_HAS_PERF
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+
+namespace xibench
+{
+
+
+/** \brief Простой таймер на steady_clock. */
+    class Timer
+    {
+    public:
+        Timer()
+                : _start(std::chrono::steady_clock::now())
+        {}
+
+        /** \brief Секунды, прошедшие с момента создания. */
+        double seconds() const
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+        }
+
+    protected:
+        std::chrono::steady_clock::time_point _start;
+    };
+
+
+/** \brief Возвращает перемешанную перестановку чисел [0, n). */
+    inline std::vector<int> shuffledKeys(std::size_t n, unsigned seed = 42)
+    {
+        std::vector<int> keys(n);
+        for (std::size_t i = 0; i < n; ++i)
+            keys[i] = (int) i;
+        std::shuffle(keys.begin(), keys.end(), std::mt19937(seed));
+        return keys;
+    }
+
+
+/** \brief Печатает строку отчета: имя, число операций и наносекунды на операцию. */
+    inline void report(const char *name, std::size_t ops, double sec)
+    {
+        std::printf("%-40s %12zu ops %10.1f ns/op\n", name, ops, sec * 1e9 / (double) ops);
+    }
+
+
+/** \brief Размер задачи из первого аргумента командной строки, иначе \c def. */
+    inline std::size_t sizeArg(int argc, char **argv, std::size_t def)
+    {
+        if (argc > 1)
+            return (std::size_t) std::strtoull(argv[1], nullptr, 10);
+        return def;
+    }
+
+
+/** \brief Не дает компилятору выбросить вычисленное значение. */
+    template<typename T>
+    inline void doNotOptimize(const T &val)
+    {
+        asm volatile("" : : "r,m"(val) : "memory");
+    }
+
+
+/** \brief Генератор рангов [0, n) с распределением Ципфа (алгоритм Грея и др., как в YCSB).
+ *
+ *  Ранг 0 — самый частый. Дзета-функция считается один раз за O(n), а каждая выборка — за O(1)
+ *  и без таблиц, так что годится и для сотен миллионов рангов.
+ */
+    class ZipfGenerator
+    {
+    public:
+        explicit ZipfGenerator(std::size_t n, double theta = 0.99, unsigned seed = 42)
+                : _n(n), _theta(theta), _rng(seed), _uni(0.0, 1.0)
+        {
+            double zeta2 = 1.0 + std::pow(0.5, theta);
+            _zetaN = 0;
+            for (std::size_t i = 1; i <= n; ++i)
+                _zetaN += 1.0 / std::pow((double) i, theta);
+
+            _alpha = 1.0 / (1.0 - theta);
+            _eta = (1.0 - std::pow(2.0 / (double) n, 1.0 - theta)) / (1.0 - zeta2 / _zetaN);
+        }
+
+        std::size_t operator()()
+        {
+            double u = _uni(_rng);
+            double uz = u * _zetaN;
+            if (uz < 1.0)
+                return 0;
+            if (uz < 1.0 + std::pow(0.5, _theta))
+                return 1;
+
+            std::size_t r = (std::size_t) ((double) _n * std::pow(_eta * u - _eta + 1.0, _alpha));
+            return r < _n ? r : _n - 1;
+        }
+
+    protected:
+        std::size_t _n;
+        double _theta;
+        double _zetaN, _alpha, _eta;
+        std::mt19937_64 _rng;
+        std::uniform_real_distribution<double> _uni;
+    };
+
+
+/** \brief Счетчик байт, выданных всеми \c CountingAllocator и еще не возвращенных. */
+    inline std::size_t &liveBytes()
+    {
+        static std::size_t bytes = 0;
+        return bytes;
+    }
+
+
+/** \brief \c std::allocator, который ведет \c liveBytes(). Так память на элемент у дерева и у
+ *  \c std::set меряется одинаково — без накладных расходов самого malloc.
+ */
+    template<typename T>
+    class CountingAllocator : public std::allocator<T>
+    {
+    public:
+        typedef T value_type;
+
+        template<typename U>
+        struct rebind
+        {
+            typedef CountingAllocator<U> other;
+        };
+
+    public:
+        CountingAllocator()
+        {}
+
+        template<typename U>
+        CountingAllocator(const CountingAllocator<U> &)
+        {}
+
+        T *allocate(std::size_t n)
+        {
+            liveBytes() += n * sizeof(T);
+            return std::allocator<T>::allocate(n);
+        }
+
+        void deallocate(T *p, std::size_t n)
+        {
+            liveBytes() -= n * sizeof(T);
+            std::allocator<T>::deallocate(p, n);
+        }
+
+        bool operator==(const CountingAllocator &) const
+        { return true; }
+
+        bool operator!=(const CountingAllocator &) const
+        { return false; }
+    };
+
+
+/** \brief Аппаратные счетчики текущего потока: такты, инструкции, промахи кэша и предсказателя.
+ *
+ *  Работают через perf_event_open(). Если ядро или права (perf_event_paranoid) их не дают, или
+ *  платформа не Linux, \c isAvailable() ложно, а значения нулевые.
+ */
+    class PerfCounters
+    {
+    public:
+        enum Counter
+        {
+            PC_CYCLES,
+            PC_INSTRUCTIONS,
+            PC_CACHE_MISSES,
+            PC_BRANCH_MISSES,
+            PC_COUNT
+        };
+
+    public:
+        PerfCounters()
+        {
+            for (int i = 0; i < PC_COUNT; ++i)
+            {
+                _fd[i] = -1;
+                _values[i] = 0;
+            }
+
+#ifdef XIBENCH_HAS_PERF
+            const std::uint64_t configs[PC_COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                     PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+            for (int i = 0; i < PC_COUNT; ++i)
+            {
+                perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.size = sizeof(attr);
+                attr.config = configs[i];
+                attr.disabled = 1;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                _fd[i] = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            }
+#endif
+        }
+
+        ~PerfCounters()
+        {
+#ifdef XIBENCH_HAS_PERF
+            for (int i = 0; i < PC_COUNT; ++i)
+                if (_fd[i] >= 0)
+                    close(_fd[i]);
+#endif
+        }
+
+        /** \brief Есть ли хоть один счетчик. */
+        bool isAvailable() const
+        {
+            for (int i = 0; i < PC_COUNT; ++i)
+                if (_fd[i] >= 0)
+                    return true;
+            return false;
+        }
+
+        /** \brief Доступен ли счетчик \c c. */
+        bool has(Counter c) const
+        { return _fd[c] >= 0; }
+
+        void start()
+        {
+#ifdef XIBENCH_HAS_PERF
+            for (int i = 0; i < PC_COUNT; ++i)
+                if (_fd[i] >= 0)
+                {
+                    ioctl(_fd[i], PERF_EVENT_IOC_RESET, 0);
+                    ioctl(_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+                }
+#endif
+        }
+
+        void stop()
+        {
+#ifdef XIBENCH_HAS_PERF
+            for (int i = 0; i < PC_COUNT; ++i)
+                if (_fd[i] >= 0)
+                {
+                    ioctl(_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+                    std::uint64_t v = 0;
+                    _values[i] = read(_fd[i], &v, sizeof(v)) == (ssize_t) sizeof(v) ? v : 0;
+                }
+#endif
+        }
+
+        /** \brief Значение счетчика \c c между последними \c start() и \c stop(). */
+        std::uint64_t get(Counter c) const
+        { return _values[c]; }
+
+    protected:
+        PerfCounters(const PerfCounters &);
+        PerfCounters &operator=(const PerfCounters &);
+
+    protected:
+        int _fd[PC_COUNT];
+        std::uint64_t _values[PC_COUNT];
+    };
+
+
+} // namespace xibench
+
+
+#endif // XI_BENCHUTIL_H
@@ -0,0 +1,500 @@
+﻿////////////////////////////////////////////////////////////////////////////////
+/// \file
+/// \brief     Пул узлов фиксированного размера и аллокатор поверх него
+/// \author    Kupchenko Viktor
+/// \version   0.1.0
+/// \date      01.05.2017
+///            This is a part of the course "Algorithms and Data Structures"
+///            provided by  the School of Software Engineering of the Faculty
+///            of Computer Science at the Higher School of Economics.
+///
+/// Пул раздает куски одинакового размера из крупных слабов, а освобожденные
+/// куски складывает в односвязный список свободных, откуда их и берет в первую
+/// очередь. Для дерева это означает, что вставка и удаление почти никогда не
+/// доходят до malloc/free, а узлы лежат в памяти плотно.
+///
+/// Арена устроена так же, но все объекты лежат в одном массиве заданной емкости
+/// вплотную, без округления до max_align_t. Это нужно узлам с относительными
+/// связями (RBTREE_RELATIVE_LINKS): смещения между узлами одной арены заведомо
+/// помещаются в 32 бита, а весь массив узлов можно скопировать или сохранить
+/// одним куском.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef XI_NODEPOOL_H
+#define XI_NODEPOOL_H
+
+#include <cstddef>          // std::size_t, std::max_align_t
+#include <cstdint>          // std::uint64_t
+#include <cstring>          // std::memcpy
+#include <memory>           // std::shared_ptr
+#include <new>              // ::operator new, std::bad_alloc
+#include <stdexcept>        // std::length_error
+#include <type_traits>      // std::true_type
+#include <utility>          // std::pair
+#include <vector>
+
+
+namespace xi
+{
+
+
+/** \brief Нетипизированный пул кусков фиксированного размера.
+ *
+ *  Память берется у системы слабами по \c chunksPerSlab кусков и возвращается
+ *  только в деструкторе пула. Пул не потокобезопасен.
+ */
+    class NodePool
+    {
+    public:
+        /** \brief Создает пул кусков размера \c chunkSize (округляется до выравнивания). */
+        explicit NodePool(std::size_t chunkSize, std::size_t chunksPerSlab = 1024)
+                : _chunkSize(roundUp(chunkSize)), _chunksPerSlab(chunksPerSlab ? chunksPerSlab : 1),
+                  _freeList(nullptr), _curSlab(0), _bump(nullptr), _bumpEnd(nullptr)
+        {}
+
+        ~NodePool()
+        {
+            for (std::size_t i = 0; i < _slabs.size(); ++i)
+                ::operator delete(_slabs[i]);
+        }
+
+    public:
+        /** \brief Выдает один кусок: сперва из списка свободных, затем из текущего слаба. */
+        void *allocate()
+        {
+            if (_freeList)
+            {
+                FreeChunk *chunk = _freeList;
+                _freeList = chunk->next;
+                return chunk;
+            }
+
+            if (_bump == _bumpEnd)
+                nextSlab();
+
+            void *res = _bump;
+            _bump += _chunkSize;
+            return res;
+        }
+
+        /** \brief Возвращает кусок в список свободных. */
+        void deallocate(void *p)
+        {
+            FreeChunk *chunk = static_cast<FreeChunk *>(p);
+            chunk->next = _freeList;
+            _freeList = chunk;
+        }
+
+        /** \brief Забывает обо всех выданных кусках за O(1): список свободных обнуляется,
+         *  а раздача начинается снова с первого слаба. Сами слабы остаются за пулом и
+         *  идут в дело повторно. Деструкторы объектов в кусках, разумеется, не вызываются.
+         */
+        void reset()
+        {
+            _freeList = nullptr;
+            _curSlab = 0;
+            _bump = _bumpEnd = nullptr;
+        }
+
+        /** \brief Размер одного куска после выравнивания. */
+        std::size_t getChunkSize() const
+        { return _chunkSize; }
+
+        /** \brief Сколько байт пул на данный момент забрал у системы. */
+        std::size_t getReservedBytes() const
+        { return _slabs.size() * _chunkSize * _chunksPerSlab; }
+
+    protected:
+        /** \brief Элемент списка свободных кусков, живет прямо в освобожденной памяти. */
+        struct FreeChunk
+        {
+            FreeChunk *next;
+        };
+
+        static std::size_t roundUp(std::size_t sz)
+        {
+            const std::size_t align = alignof(std::max_align_t);
+            if (sz < sizeof(FreeChunk))
+                sz = sizeof(FreeChunk);
+            return (sz + align - 1) / align * align;
+        }
+
+        /** \brief Переходит на следующий слаб, при необходимости запрашивая новый. */
+        void nextSlab()
+        {
+            if (_curSlab == _slabs.size())
+            {
+                // сначала резервируем место в векторе, чтобы не потерять слаб при исключении
+                _slabs.reserve(_slabs.size() + 1);
+                _slabs.push_back(static_cast<char *>(::operator new(_chunkSize * _chunksPerSlab)));
+            }
+
+            _bump = _slabs[_curSlab++];
+            _bumpEnd = _bump + _chunkSize * _chunksPerSlab;
+        }
+
+    protected:
+        NodePool(const NodePool &);                  ///< КК не доступен.
+        NodePool &operator=(const NodePool &);       ///< Оператор присваивания недоступен.
+
+    protected:
+        std::size_t _chunkSize;                      ///< Размер куска с учетом выравнивания.
+        std::size_t _chunksPerSlab;                  ///< Сколько кусков помещается в один слаб.
+
+        FreeChunk *_freeList;                        ///< Голова списка освобожденных кусков.
+
+        std::vector<char *> _slabs;                  ///< Все слабы, полученные у системы.
+        std::size_t _curSlab;                        ///< Индекс следующего еще не начатого слаба.
+        char *_bump;                                 ///< Первый не выданный байт текущего слаба.
+        char *_bumpEnd;                              ///< Конец текущего слаба.
+    }; // class NodePool
+
+
+/** \brief Набор ресурсов (пулов, арен) по одному на размер объекта.
+ *
+ *  Это общее состояние всех копий аллокатора и всех его перепривязок: аллокатор для \c T
+ *  берет из набора ресурс под \c sizeof(T), а перепривязанный к другому типу того же размера
+ *  получает тот же самый ресурс. Ресурсы создаются по первому запросу и живут до разрушения
+ *  набора; адреса их при этом не меняются. Набор, как и ресурсы, не потокобезопасен.
+ *
+ *  \tparam Resource Ресурс с конструктором <tt>Resource(std::size_t objSize, std::size_t param)</tt>.
+ */
+    template<typename Resource>
+    class SizedResources
+    {
+    public:
+        /** \brief \c param передается конструктору каждого ресурса вторым аргументом. */
+        explicit SizedResources(std::size_t param)
+                : _param(param)
+        {}
+
+        ~SizedResources()
+        {
+            for (std::size_t i = 0; i < _items.size(); ++i)
+                delete _items[i].second;
+        }
+
+    public:
+        /** \brief Ресурс под объекты размера \c objSize; заводится, если его еще нет. */
+        Resource &get(std::size_t objSize)
+        {
+            for (std::size_t i = 0; i < _items.size(); ++i)
+                if (_items[i].first == objSize)
+                    return *_items[i].second;
+
+            // сначала резервируем место в векторе, чтобы не потерять ресурс при исключении
+            _items.reserve(_items.size() + 1);
+            _items.push_back(std::make_pair(objSize, new Resource(objSize, _param)));
+            return *_items.back().second;
+        }
+
+        /** \brief Второй аргумент конструкторов ресурсов. */
+        std::size_t getParam() const
+        { return _param; }
+
+    protected:
+        SizedResources(const SizedResources &);                  ///< КК не доступен.
+        SizedResources &operator=(const SizedResources &);       ///< Оператор присваивания недоступен.
+
+    protected:
+        std::size_t _param;                                      ///< Второй аргумент конструкторов ресурсов.
+        std::vector<std::pair<std::size_t, Resource *> > _items; ///< Размер объекта и его ресурс.
+    }; // class SizedResources
+
+
+/** \brief Аллокатор в стиле STL, раздающий одиночные объекты из \c NodePool.
+ *
+ *  Запросы ровно на один объект обслуживаются пулом, все остальные уходят в
+ *  обычный \c operator \c new. Копии аллокатора и его перепривязки к другим типам
+ *  (\c rebind) разделяют один набор пулов (\c SizedResources), по пулу на размер объекта,
+ *  и потому равны между собой: деревья, созданные с копиями одного аллокатора, можно
+ *  склеивать и объединять. Аллокатор, созданный по умолчанию, заводит новый набор.
+ *
+ *  \tparam T Тип выделяемых объектов.
+ *  \tparam ChunksPerSlab Сколько объектов запрашивать у системы за раз.
+ */
+    template<typename T, std::size_t ChunksPerSlab = 1024>
+    class PoolAllocator
+    {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "PoolAllocator doesn't support over-aligned types");
+
+        template<typename U, std::size_t C>
+        friend class PoolAllocator;
+
+    public:
+        typedef T value_type;
+        typedef std::true_type propagate_on_container_move_assignment;
+        typedef std::true_type propagate_on_container_swap;
+
+        template<typename U>
+        struct rebind
+        {
+            typedef PoolAllocator<U, ChunksPerSlab> other;
+        };
+
+        /** \brief Набор пулов, общий для копий и перепривязок. */
+        typedef SizedResources<NodePool> Pools;
+
+    public:
+        PoolAllocator()
+                : _pools(std::make_shared<Pools>(ChunksPerSlab)), _pool(&_pools->get(sizeof(T)))
+        {}
+
+        /** \brief Перепривязка с другого типа: набор пулов тот же, пул — под размер \c T. */
+        template<typename U>
+        PoolAllocator(const PoolAllocator<U, ChunksPerSlab> &other)
+                : _pools(other._pools), _pool(&_pools->get(sizeof(T)))
+        {}
+
+    public:
+        T *allocate(std::size_t n)
+        {
+            if (n == 1)
+                return static_cast<T *>(_pool->allocate());
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+        }
+
+        void deallocate(T *p, std::size_t n)
+        {
+            if (n == 1)
+                _pool->deallocate(p);
+            else
+                ::operator delete(p);
+        }
+
+        /** \brief Разом освобождает все объекты своего пула, если набором пулов не владеет никто,
+         *  кроме этого аллокатора (и, значит, его единственного контейнера).
+         *
+         *  \returns истину, если пул сброшен, и ложь, если набор разделяется с другими копиями
+         *  или перепривязками и освобождать объекты надо поштучно.
+         */
+        bool releaseAll()
+        {
+            if (_pools.use_count() != 1)
+                return false;
+
+            _pool->reset();
+            return true;
+        }
+
+        /** \brief Возвращает пул, из которого аллокатор выдает объекты. */
+        NodePool &getPool() const
+        { return *_pool; }
+
+        template<typename U>
+        bool operator==(const PoolAllocator<U, ChunksPerSlab> &other) const
+        { return _pools == other._pools; }
+
+        template<typename U>
+        bool operator!=(const PoolAllocator<U, ChunksPerSlab> &other) const
+        { return _pools != other._pools; }
+
+    protected:
+        std::shared_ptr<Pools> _pools;               ///< Разделяемый копиями и перепривязками набор пулов.
+        NodePool *_pool;                             ///< Пул под размер \c T из \c _pools.
+    }; // class PoolAllocator
+
+
+/** \brief Нетипизированная арена: куски фиксированного размера вплотную в одном массиве.
+ *
+ *  Массив заданной емкости выделяется целиком при первой выдаче и дальше не растет, чтобы
+ *  выданные адреса оставались в силе; когда он исчерпан, \c allocate() генерирует \c std::bad_alloc.
+ *  Освобожденные куски идут в список свободных и выдаются повторно. Массив не бывает больше
+ *  \c MAX_BYTES, так что любые два куска арены достижимы 32-битными связями \c RelPtr.
+ *  Арена не потокобезопасна.
+ */
+    class NodeArena
+    {
+    public:
+        /** \brief Предел размера массива: +-8 ГБ — досягаемость \c RelPtr со смещением \c std::int32_t. */
+        static const std::uint64_t MAX_BYTES = std::uint64_t(1) << 33;
+
+    public:
+        /** \brief Создает арену на \c capacity кусков размера \c objSize (не меньше указателя).
+         *
+         *  Генерирует \c std::length_error, если массив вышел бы больше \c MAX_BYTES.
+         */
+        NodeArena(std::size_t objSize, std::size_t capacity)
+                : _slotSize(objSize < sizeof(void *) ? sizeof(void *) : objSize), _capacity(capacity),
+                  _base(nullptr), _used(0), _freeList(nullptr)
+        {
+            if (capacity > MAX_BYTES / _slotSize)
+                throw std::length_error("Arena is too large for 32-bit relative links!");
+        }
+
+        ~NodeArena()
+        { ::operator delete(_base); }
+
+    public:
+        /** \brief Выдает один кусок: сперва из списка свободных, затем следующий по порядку. */
+        void *allocate()
+        {
+            if (_freeList)
+            {
+                // Кусок не обязан быть выровнен под указатель: ссылку на следующий читаем побайтно
+                void *res = _freeList;
+                std::memcpy(&_freeList, res, sizeof(_freeList));
+                return res;
+            }
+
+            // Дальше емкости не растем: перевыделение массива сдвинуло бы живые объекты
+            if (_used == _capacity)
+                throw std::bad_alloc();
+
+            if (!_base)
+                _base = static_cast<char *>(::operator new(_capacity * _slotSize));
+            return _base + _slotSize * _used++;
+        }
+
+        /** \brief Возвращает кусок в список свободных. */
+        void deallocate(void *p)
+        {
+            std::memcpy(p, &_freeList, sizeof(_freeList));
+            _freeList = p;
+        }
+
+        /** \brief Забывает обо всех выданных кусках за O(1); массив остается за ареной. */
+        void reset()
+        {
+            _used = 0;
+            _freeList = nullptr;
+        }
+
+        /** \brief Сколько кусков помещается в арену. */
+        std::size_t getCapacity() const
+        { return _capacity; }
+
+        /** \brief Размер одного куска. */
+        std::size_t getSlotSize() const
+        { return _slotSize; }
+
+        /** \brief Начало массива (\c nullptr, пока ничего не выдавалось). */
+        const void *getBase() const
+        { return _base; }
+
+        /** \brief Сколько байт от начала массива уже тронуто выдачей (включая освобожденные куски). */
+        std::size_t getUsedBytes() const
+        { return _used * _slotSize; }
+
+    protected:
+        NodeArena(const NodeArena &);                ///< КК не доступен.
+        NodeArena &operator=(const NodeArena &);     ///< Оператор присваивания недоступен.
+
+    protected:
+        std::size_t _slotSize;                       ///< Размер куска.
+        std::size_t _capacity;                       ///< Сколько кусков можно выдать.
+        char *_base;                                 ///< Массив кусков или nullptr, пока он не нужен.
+        std::size_t _used;                           ///< Сколько кусков от начала массива уже выдавалось.
+        void *_freeList;                             ///< Голова списка освобожденных кусков.
+    }; // class NodeArena
+
+
+/** \brief Аллокатор в стиле STL, раздающий одиночные объекты из \c NodeArena.
+ *
+ *  Запросы не на один объект, как и у \c PoolAllocator, уходят в обычный \c operator \c new.
+ *  Копии и перепривязки к другим типам разделяют один набор арен, по арене той же емкости
+ *  (в объектах) на размер объекта, и равны между собой.
+ *
+ *  Все узлы дерева лежат в одной арене, поэтому только такие аллокаторы (с \c is_arena,
+ *  см. \c AllocatorIsArena в rbtree.h) годятся для RBTREE_RELATIVE_LINKS.
+ *
+ *  \tparam T Тип выделяемых объектов.
+ */
+    template<typename T>
+    class ArenaAllocator
+    {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "ArenaAllocator doesn't support over-aligned types");
+
+        template<typename U>
+        friend class ArenaAllocator;
+
+    public:
+        typedef T value_type;
+        typedef std::true_type propagate_on_container_move_assignment;
+        typedef std::true_type propagate_on_container_swap;
+
+        /** \brief Одиночные объекты лежат в одном массиве не больше \c NodeArena::MAX_BYTES. */
+        typedef std::true_type is_arena;
+
+        template<typename U>
+        struct rebind
+        {
+            typedef ArenaAllocator<U> other;
+        };
+
+        /** \brief Набор арен, общий для копий и перепривязок. */
+        typedef SizedResources<NodeArena> Arenas;
+
+        /** \brief Емкость арены по умолчанию (в объектах). Память под нее берется при первой выдаче. */
+        static const std::size_t DEFAULT_CAPACITY = std::size_t(1) << 20;
+
+    public:
+        explicit ArenaAllocator(std::size_t capacity = DEFAULT_CAPACITY)
+                : _arenas(std::make_shared<Arenas>(capacity)), _arena(&_arenas->get(sizeof(T)))
+        {}
+
+        /** \brief Перепривязка с другого типа: набор арен тот же, арена — под размер \c T. */
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U> &other)
+                : _arenas(other._arenas), _arena(&_arenas->get(sizeof(T)))
+        {}
+
+    public:
+        T *allocate(std::size_t n)
+        {
+            if (n == 1)
+                return static_cast<T *>(_arena->allocate());
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+        }
+
+        void deallocate(T *p, std::size_t n)
+        {
+            if (n == 1)
+                _arena->deallocate(p);
+            else
+                ::operator delete(p);
+        }
+
+        /** \brief Разом освобождает все объекты своей арены, если набор арен больше никем не
+         *  разделяется (см. \c PoolAllocator).
+         */
+        bool releaseAll()
+        {
+            if (_arenas.use_count() != 1)
+                return false;
+
+            _arena->reset();
+            return true;
+        }
+
+        /** \brief Сколько объектов помещается в арену. */
+        std::size_t getCapacity() const
+        { return _arena->getCapacity(); }
+
+        /** \brief Начало массива объектов арены. */
+        const void *getBase() const
+        { return _arena->getBase(); }
+
+        /** \brief Сколько байт от начала массива уже тронуто выдачей (включая освобожденные объекты). */
+        std::size_t getUsedBytes() const
+        { return _arena->getUsedBytes(); }
+
+        template<typename U>
+        bool operator==(const ArenaAllocator<U> &other) const
+        { return _arenas == other._arenas; }
+
+        template<typename U>
+        bool operator!=(const ArenaAllocator<U> &other) const
+        { return _arenas != other._arenas; }
+
+    protected:
+        std::shared_ptr<Arenas> _arenas;             ///< Разделяемый копиями и перепривязками набор арен.
+        NodeArena *_arena;                           ///< Арена под размер \c T из \c _arenas.
+    }; // class ArenaAllocator
+
+
+} // namespace xi
+
+
+#endif // XI_NODEPOOL_H
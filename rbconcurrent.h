@@ -0,0 +1,404 @@
+﻿////////////////////////////////////////////////////////////////////////////////
+/// \file
+/// \brief     Дерево с одним писателем и читателями без блокировок
+/// \author    Kupchenko Viktor
+/// \version   0.1.0
+/// \date      01.05.2017
+///            This is a part of the course "Algorithms and Data Structures"
+///            provided by  the School of Software Engineering of the Faculty
+///            of Computer Science at the Higher School of Economics.
+///
+/// Писатели (вставка и удаление) выполняются по одному под мьютексом, а
+/// читатели спускаются по дереву, ничего не блокируя. Чтобы спуск не наткнулся
+/// на уже освобожденный узел, читатель на время поиска входит в эпоху
+/// (xi::EpochManager), а удаленные писателем узлы освобождаются, только когда
+/// из всех более ранних эпох читатели уже вышли.
+///
+/// Узлы на месте не копируются, и ключи в них не меняются, так что найденный
+/// узел с нужным ключом — всегда честный ответ, даже если в это время идет
+/// поворот. Промах же мог случиться из-за того, что писатель посреди поворота
+/// или transplant() переподвешивал нужный узел. Поэтому писатель ведет счетчик
+/// изменений (seqlock): нечетный — изменение идет, и читатель, промахнувшись,
+/// сверяет его с тем, что видел в начале спуска. Не совпало — спуск повторяется,
+/// а после нескольких неудач читатель ищет под мьютексом писателя.
+///
+/// Сами связи узлов и корень при этом должны быть атомарными, иначе чтение
+/// указателя, который писатель в этот момент меняет, — гонка данных. Поэтому
+/// дерево собирается с RBTREE_ATOMIC_LINKS (см. rbtree.h), который задается
+/// до подключения заголовков: писатель публикует связи с release, а читатель
+/// читает их с acquire и вместе с новым узлом видит и его ключ.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef XI_RBCONCURRENT_H
+#define XI_RBCONCURRENT_H
+
+#include <atomic>
+#include <cstddef>          // std::size_t
+#include <cstdint>          // std::uint64_t
+#include <functional>       // std::less
+#include <memory>           // std::allocator
+#include <mutex>
+#include <thread>           // std::this_thread::yield
+#include <vector>
+
+#include "rbtree.h"
+
+
+namespace xi
+{
+
+
+/** \brief Учет эпох для отложенного освобождения памяти (epoch-based reclamation).
+ *
+ *  Читатель на время работы занимает ячейку и записывает в нее текущую эпоху. Писатель, отцепив
+ *  узел, сдвигает эпоху и помечает узел старым ее значением; узел можно освобождать, когда
+ *  метка меньше эпохи любого из активных читателей (\c getMinActive()).
+ */
+    class EpochManager
+    {
+    public:
+        /** \brief Сколько читателей может одновременно находиться внутри эпохи. Лишние ждут. */
+        static const std::size_t SLOTS = 128;
+
+        /** \brief Эпоха, которой меньше любой метки: ни одного активного читателя. */
+        static const std::uint64_t NO_READERS = ~(std::uint64_t) 0;
+
+    public:
+        EpochManager()
+                : _epoch(1)
+        {
+            for (std::size_t i = 0; i < SLOTS; ++i)
+                _slots[i].epoch.store(0, std::memory_order_relaxed);
+        }
+
+    public:
+        /** \brief Входит в текущую эпоху. \returns номер занятой ячейки для \c leave(). */
+        std::size_t enter()
+        {
+            std::size_t start = threadHint();
+            while (true)
+            {
+                for (std::size_t k = 0; k < SLOTS; ++k)
+                {
+                    Slot &slot = _slots[(start + k) % SLOTS];
+                    std::uint64_t idle = 0;
+                    if (slot.epoch.load(std::memory_order_relaxed) == 0 &&
+                        slot.epoch.compare_exchange_strong(idle, _epoch.load(std::memory_order_acquire)))
+                    {
+                        // Либо писатель увидит нашу ячейку, либо мы увидим все, что он отцепил до ее проверки
+                        std::atomic_thread_fence(std::memory_order_seq_cst);
+                        return (start + k) % SLOTS;
+                    }
+                }
+                std::this_thread::yield();
+            }
+        }
+
+        /** \brief Выходит из эпохи, освобождая ячейку \c slot. */
+        void leave(std::size_t slot)
+        { _slots[slot].epoch.store(0, std::memory_order_release); }
+
+        /** \brief Сдвигает эпоху. \returns метку для узла, отцепленного до вызова. */
+        std::uint64_t advance()
+        { return _epoch.fetch_add(1); }
+
+        /** \brief Наименьшая эпоха среди активных читателей или \c NO_READERS. */
+        std::uint64_t getMinActive() const
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            std::uint64_t res = NO_READERS;
+            for (std::size_t i = 0; i < SLOTS; ++i)
+            {
+                std::uint64_t e = _slots[i].epoch.load(std::memory_order_acquire);
+                if (e && e < res)
+                    res = e;
+            }
+            return res;
+        }
+
+    protected:
+        /** \brief Ячейка читателя на отдельной кэш-линии, чтобы читатели не мешали друг другу. */
+        struct alignas(64) Slot
+        {
+            std::atomic<std::uint64_t> epoch;        ///< Эпоха входа или 0, если ячейка свободна.
+        };
+
+        /** \brief С какой ячейки потоку начинать поиск свободной: у каждого потока своя. */
+        static std::size_t threadHint()
+        {
+            static std::atomic<std::size_t> next(0);
+            thread_local std::size_t hint = next.fetch_add(1, std::memory_order_relaxed);
+            return hint;
+        }
+
+    protected:
+        EpochManager(const EpochManager &);                  ///< КК не доступен.
+        EpochManager &operator=(const EpochManager &);       ///< Оператор присваивания недоступен.
+
+    protected:
+        Slot _slots[SLOTS];                          ///< Ячейки читателей.
+        std::atomic<std::uint64_t> _epoch;           ///< Текущая эпоха, начинается с 1.
+    }; // class EpochManager
+
+
+/** \brief Красно-черное дерево для одного писателя и многих читателей без блокировок.
+ *
+ *  \c tryInsert() и \c tryRemove() можно звать из любых потоков — они выстраиваются в очередь
+ *  на мьютексе. \c contains(), \c lookup() и \c ReadGuard::find() не берут блокировок и не пишут
+ *  в разделяемую с писателем память, кроме собственной ячейки эпохи.
+ *
+ *  \tparam Element Тип элементов; элемент узла после вставки не меняется.
+ *  \tparam Compar Компаратор, как у \c RBTree.
+ *  \tparam Allocator Аллокатор, как у \c RBTree; освобождение узлов откладывается до конца эпохи.
+ */
+    template<typename Element, typename Compar = std::less<Element>, typename Allocator = std::allocator<Element> >
+    class ConcurrentRBTree : protected RBTree<Element, Compar, Allocator>
+    {
+#ifndef RBTREE_ATOMIC_LINKS
+        static_assert(sizeof(Element) == 0,
+                      "ConcurrentRBTree requires RBTREE_ATOMIC_LINKS: readers walk the links while the writer rotates");
+#endif
+
+    public:
+        typedef RBTree<Element, Compar, Allocator> Tree;
+        typedef typename Tree::Node Node;
+
+        /** \brief Сколько отцепленных узлов копить, прежде чем пытаться их освободить. */
+        static const std::size_t RECLAIM_BATCH = 64;
+
+        /** \brief Сколько раз повторять спуск после сорванной проверки, прежде чем взять мьютекс. */
+        static const int OPTIMISTIC_ATTEMPTS = 8;
+
+        /** \brief Предел длины спуска. Высота красно-черного дерева не больше 2·log2(n + 1), так что
+         *  длиннее путь бывает, только если читатель посреди поворотов забрел в цикл.
+         */
+        static const std::size_t MAX_DEPTH = 2 * 8 * sizeof(std::size_t);
+
+        /** \brief Пребывание читателя в эпохе: пока объект жив, найденные им элементы не освобождаются. */
+        class ReadGuard
+        {
+        public:
+            explicit ReadGuard(const ConcurrentRBTree &tree)
+                    : _tree(tree), _slot(tree._epochs.enter())
+            {}
+
+            ~ReadGuard()
+            { _tree._epochs.leave(_slot); }
+
+            /** \brief Элемент, эквивалентный \c key, или nullptr. Указатель годен, пока жив \c ReadGuard. */
+            template<typename K>
+            const Element *find(const K &key) const
+            {
+                const Node *nd = _tree.findConcurrent(key);
+                return nd ? &nd->getKey() : nullptr;
+            }
+
+        protected:
+            ReadGuard(const ReadGuard &);                    ///< КК не доступен.
+            ReadGuard &operator=(const ReadGuard &);         ///< Оператор присваивания недоступен.
+
+        protected:
+            const ConcurrentRBTree &_tree;
+            std::size_t _slot;
+        }; // class ConcurrentRBTree::ReadGuard
+
+    public:
+        explicit ConcurrentRBTree(const Compar &compar = Compar(), const Allocator &alloc = Allocator())
+                : Tree(compar, alloc), _seq(0)
+        {}
+
+        /** \brief Освобождает и живые, и отложенные узлы. Читателей в этот момент быть не должно. */
+        ~ConcurrentRBTree()
+        {
+            for (std::size_t i = 0; i < _retired.size(); ++i)
+                this->destroyNode(_retired[i].node);
+        }
+
+    public:
+        // Писатель
+
+        /** \brief Вставляет \c key, если эквивалентного ему нет. \returns признак того, что вставка состоялась. */
+        bool tryInsert(const Element &key)
+        {
+            std::lock_guard<std::mutex> lock(_writeLock);
+
+            Node *parent;
+            bool goLeft;
+            if (this->findInsertPos(key, parent, goLeft))
+                return false;
+
+            // Узел строится до начала изменения, а связь на него attachNode() записывает с release, публикуя и ключ
+            Node *nd = this->createNode(key);
+            beginWrite();
+            this->attachNode(nd, parent, goLeft);
+            endWrite();
+            return true;
+        }
+
+        /** \brief Удаляет элемент, эквивалентный \c key, если он есть. Узел освобождается позже,
+         *  когда до него не сможет добраться ни один читатель.
+         *  \returns признак того, что элемент был.
+         */
+        template<typename K>
+        bool tryRemove(const K &key)
+        {
+            std::lock_guard<std::mutex> lock(_writeLock);
+
+            Node *nd = (Node *) this->findNode(key, Tree::SP_REMOVE);
+            if (!nd)
+                return false;
+
+            beginWrite();
+            this->unlinkNode(nd);
+            endWrite();
+
+            retire(nd);
+            return true;
+        }
+
+        /** \brief Освобождает отложенные узлы, которые уже никто не может видеть.
+         *  \returns сколько узлов еще ждут своей очереди.
+         */
+        std::size_t reclaim()
+        {
+            std::lock_guard<std::mutex> lock(_writeLock);
+            reclaimRetired();
+            return _retired.size();
+        }
+
+        /** \brief Число элементов. Берет мьютекс писателя. */
+        std::size_t size() const
+        {
+            std::lock_guard<std::mutex> lock(_writeLock);
+            return Tree::size();
+        }
+
+    public:
+        // Читатели
+
+        /** \brief Есть ли в дереве элемент, эквивалентный \c key. Без блокировок. */
+        template<typename K>
+        bool contains(const K &key) const
+        {
+            ReadGuard guard(*this);
+            return guard.find(key) != nullptr;
+        }
+
+        /** \brief Копирует в \c out элемент, эквивалентный \c key. \returns признак того, что он нашелся. */
+        template<typename K>
+        bool lookup(const K &key, Element &out) const
+        {
+            ReadGuard guard(*this);
+            const Element *el = guard.find(key);
+            if (!el)
+                return false;
+
+            out = *el;
+            return true;
+        }
+
+        /** \brief Дерево, на котором построена обертка. Читать его напрямую можно, только когда писателей нет. */
+        const Tree &getTree() const
+        { return *this; }
+
+    protected:
+        /** \brief Отцепленный писателем узел и эпоха, после которой его можно освободить. */
+        struct Retired
+        {
+            Node *node;
+            std::uint64_t epoch;
+        };
+
+        /** \brief Изменение пошло: счетчик нечетный, и все записи в узлы — после него. */
+        void beginWrite()
+        {
+            _seq.store(_seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+
+        /** \brief Изменение закончено: счетчик снова четный и публикует все записи. */
+        void endWrite()
+        { _seq.store(_seq.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+        /** \brief Откладывает освобождение узла \c nd до выхода читателей из текущей эпохи. */
+        void retire(Node *nd)
+        {
+            Retired r = {nd, _epochs.advance()};
+            _retired.push_back(r);
+
+            if (_retired.size() >= RECLAIM_BATCH)
+                reclaimRetired();
+        }
+
+        /** \brief Освобождает узлы с меткой меньше эпохи любого читателя. Метки растут, так что это префикс. */
+        void reclaimRetired()
+        {
+            std::uint64_t minActive = _epochs.getMinActive();
+
+            std::size_t freed = 0;
+            while (freed < _retired.size() && _retired[freed].epoch < minActive)
+                this->destroyNode(_retired[freed++].node);
+
+            _retired.erase(_retired.begin(), _retired.begin() + freed);
+        }
+
+        /** \brief Поиск без блокировок; вызывающий должен находиться в эпохе.
+         *
+         *  Спуск как у \c lower_bound(): одно сравнение на уровень и проверка эквивалентности в конце.
+         *  Корень и связи читаются с acquire (RBTREE_ATOMIC_LINKS), так что ключ каждого узла на пути
+         *  записан раньше, чем на узел сослались.
+         */
+        template<typename K>
+        const Node *findConcurrent(const K &key) const
+        {
+            for (int attempt = 0; attempt < OPTIMISTIC_ATTEMPTS; ++attempt)
+            {
+                std::uint64_t seq = _seq.load(std::memory_order_acquire);
+
+                const Node *cand = nullptr;
+                const Node *cur = this->_root;
+                std::size_t depth = 0;
+                while (cur && depth++ < MAX_DEPTH)
+                {
+                    if (!this->_compar(cur->getKey(), key))
+                    {
+                        cand = cur;
+                        cur = cur->getLeft();
+                    }
+                    else
+                        cur = cur->getRight();
+                }
+
+                // Узел с таким ключом в дереве был, даже если сейчас его переподвешивают
+                if (cand && !this->_compar(key, cand->getKey()))
+                    return cand;
+
+                // Промах верен, только если за время спуска писатель ничего не трогал
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (!cur && !(seq & 1) && _seq.load(std::memory_order_relaxed) == seq)
+                    return nullptr;
+            }
+
+            // Писатель слишком активен: ищем, пока он стоит
+            std::lock_guard<std::mutex> lock(_writeLock);
+            return this->findNode(key);
+        }
+
+    protected:
+        ConcurrentRBTree(const ConcurrentRBTree &);                  ///< КК не доступен.
+        ConcurrentRBTree &operator=(const ConcurrentRBTree &);       ///< Оператор присваивания недоступен.
+
+    protected:
+        mutable EpochManager _epochs;                ///< Эпохи читателей.
+        std::atomic<std::uint64_t> _seq;             ///< Счетчик изменений писателя; нечетный — идет изменение.
+        mutable std::mutex _writeLock;               ///< Очередь писателей и запасной путь читателей.
+        std::vector<Retired> _retired;               ///< Отцепленные, но еще не освобожденные узлы.
+    }; // class ConcurrentRBTree
+
+
+} // namespace xi
+
+
+#endif // XI_RBCONCURRENT_H
@@ -0,0 +1,413 @@
+﻿////////////////////////////////////////////////////////////////////////////////
+/// \file
+/// \brief     Неизменяемое дерево поиска, уложенное блоками по линии кэша
+/// \author    Kupchenko Viktor
+/// \version   0.1.0
+/// \date      01.05.2017
+///            This is a part of the course "Algorithms and Data Structures"
+///            provided by  the School of Software Engineering of the Faculty
+///            of Computer Science at the Higher School of Economics.
+///
+/// RBTree::find() на большом дереве упирается в промахи кэша: каждый узел
+/// лежит где-то в куче, и на каждом уровне спуск ждет память. Для таблиц,
+/// которые почти не меняются, RBTree::freeze() строит статическое B+-дерево
+/// (S+-дерево): элементы лежат отсортированным массивом, разбитым на блоки по
+/// BLOCK штук, а над ним — уровни разделителей теми же блоками. Спуск тогда
+/// читает один блок на уровень, уровней в log_16(n) раз меньше, чем у
+/// двоичного дерева, а следующие блоки не зависят от адресов в памяти.
+///
+/// Внутри блока ищется число элементов, меньших ключа. Для целых размером 4 и
+/// 8 байт, float и double с компаратором std::less это делается сравнением
+/// всего блока векторными инструкциями SSE2/SSE4.2/AVX2 (смотря что включено
+/// при компиляции), для прочих — двоичным поиском с компаратором дерева.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef XI_RBFROZEN_H
+#define XI_RBFROZEN_H
+
+#include <algorithm>        // std::lower_bound
+#include <cstddef>          // std::size_t
+#include <cstdint>          // std::uintptr_t, std::uint32_t, std::uint64_t
+#include <functional>       // std::less
+#include <new>              // placement new
+#include <type_traits>      // std::enable_if, std::is_integral
+#include <utility>          // std::move, std::swap
+#include <vector>
+
+#include "rbtree.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+
+namespace xi
+{
+
+
+/** \brief Поиск внутри блока статического дерева: сколько из \c Block отсортированных элементов
+ *  меньше ключа. Общий вариант — двоичный поиск с компаратором.
+ */
+    template<typename Element, typename Compar, std::size_t Block, typename Enable = void>
+    struct FrozenBlockSearch
+    {
+        static std::size_t rank(const Element *block, const Element &key, const Compar &compar)
+        { return (std::size_t) (std::lower_bound(block, block + Block, key, compar) - block); }
+    };
+
+#if defined(__SSE2__)
+
+/** \brief Целые по 4 байта: все 16 элементов блока сравниваются сразу. Беззнаковые сдвигаются
+ *  на 2^31, чтобы подошло знаковое сравнение.
+ */
+    template<typename Element>
+    struct FrozenBlockSearch<Element, std::less<Element>, 16,
+            typename std::enable_if<std::is_integral<Element>::value && sizeof(Element) == 4>::type>
+    {
+        static std::size_t rank(const Element *block, const Element &key, const std::less<Element> &)
+        {
+            const int bias = std::is_signed<Element>::value ? 0 : (int) 0x80000000u;
+#ifdef __AVX2__
+            __m256i b8 = _mm256_set1_epi32(bias);
+            __m256i x8 = _mm256_xor_si256(_mm256_set1_epi32((int) key), b8);
+            const __m256i *q = reinterpret_cast<const __m256i *>(block);
+            __m256i c0 = _mm256_cmpgt_epi32(x8, _mm256_xor_si256(_mm256_load_si256(q), b8));
+            __m256i c1 = _mm256_cmpgt_epi32(x8, _mm256_xor_si256(_mm256_load_si256(q + 1), b8));
+            unsigned mask = (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(c0)) |
+                            (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(c1)) << 8;
+#else
+            const __m128i *p = reinterpret_cast<const __m128i *>(block);
+            __m128i b = _mm_set1_epi32(bias);
+            __m128i x = _mm_xor_si128(_mm_set1_epi32((int) key), b);
+            __m128i c0 = _mm_cmpgt_epi32(x, _mm_xor_si128(_mm_load_si128(p), b));
+            __m128i c1 = _mm_cmpgt_epi32(x, _mm_xor_si128(_mm_load_si128(p + 1), b));
+            __m128i c2 = _mm_cmpgt_epi32(x, _mm_xor_si128(_mm_load_si128(p + 2), b));
+            __m128i c3 = _mm_cmpgt_epi32(x, _mm_xor_si128(_mm_load_si128(p + 3), b));
+
+            // Маски сужаются до байта на элемент, и одна movemask собирает все 16 бит
+            __m128i packed = _mm_packs_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3));
+            unsigned mask = (unsigned) _mm_movemask_epi8(packed);
+#endif
+            return (std::size_t) __builtin_popcount(mask);
+        }
+    };
+
+/** \brief float: то же сравнение с плавающей точкой. */
+    template<>
+    struct FrozenBlockSearch<float, std::less<float>, 16>
+    {
+        static std::size_t rank(const float *block, const float &key, const std::less<float> &)
+        {
+            __m128 x = _mm_set1_ps(key);
+            unsigned mask = (unsigned) _mm_movemask_ps(_mm_cmplt_ps(_mm_load_ps(block), x)) |
+                            (unsigned) _mm_movemask_ps(_mm_cmplt_ps(_mm_load_ps(block + 4), x)) << 4 |
+                            (unsigned) _mm_movemask_ps(_mm_cmplt_ps(_mm_load_ps(block + 8), x)) << 8 |
+                            (unsigned) _mm_movemask_ps(_mm_cmplt_ps(_mm_load_ps(block + 12), x)) << 12;
+            return (std::size_t) __builtin_popcount(mask);
+        }
+    };
+
+/** \brief double: по два элемента на регистр SSE2 или по четыре на AVX. */
+    template<>
+    struct FrozenBlockSearch<double, std::less<double>, 16>
+    {
+        static std::size_t rank(const double *block, const double &key, const std::less<double> &)
+        {
+            unsigned mask = 0;
+#ifdef __AVX__
+            __m256d x = _mm256_set1_pd(key);
+            for (int i = 0; i < 4; ++i)
+                mask |= (unsigned) _mm256_movemask_pd(_mm256_cmp_pd(_mm256_load_pd(block + 4 * i), x, _CMP_LT_OQ))
+                        << (4 * i);
+#else
+            __m128d x = _mm_set1_pd(key);
+            for (int i = 0; i < 8; ++i)
+                mask |= (unsigned) _mm_movemask_pd(_mm_cmplt_pd(_mm_load_pd(block + 2 * i), x)) << (2 * i);
+#endif
+            return (std::size_t) __builtin_popcount(mask);
+        }
+    };
+
+#if defined(__SSE4_2__)
+
+/** \brief Целые по 8 байт: нужно сравнение 64-битных целых из SSE4.2 (или AVX2). */
+    template<typename Element>
+    struct FrozenBlockSearch<Element, std::less<Element>, 16,
+            typename std::enable_if<std::is_integral<Element>::value && sizeof(Element) == 8>::type>
+    {
+        static std::size_t rank(const Element *block, const Element &key, const std::less<Element> &)
+        {
+            const long long bias = std::is_signed<Element>::value ? 0 : (long long) 0x8000000000000000ull;
+            unsigned mask = 0;
+#ifdef __AVX2__
+            __m256i b = _mm256_set1_epi64x(bias);
+            __m256i x = _mm256_xor_si256(_mm256_set1_epi64x((long long) key), b);
+            const __m256i *p = reinterpret_cast<const __m256i *>(block);
+            for (int i = 0; i < 4; ++i)
+            {
+                __m256i c = _mm256_cmpgt_epi64(x, _mm256_xor_si256(_mm256_load_si256(p + i), b));
+                mask |= (unsigned) _mm256_movemask_pd(_mm256_castsi256_pd(c)) << (4 * i);
+            }
+#else
+            __m128i b = _mm_set1_epi64x(bias);
+            __m128i x = _mm_xor_si128(_mm_set1_epi64x((long long) key), b);
+            const __m128i *p = reinterpret_cast<const __m128i *>(block);
+            for (int i = 0; i < 8; ++i)
+            {
+                __m128i c = _mm_cmpgt_epi64(x, _mm_xor_si128(_mm_load_si128(p + i), b));
+                mask |= (unsigned) _mm_movemask_pd(_mm_castsi128_pd(c)) << (2 * i);
+            }
+#endif
+            return (std::size_t) __builtin_popcount(mask);
+        }
+    };
+
+#endif // __SSE4_2__
+
+#endif // __SSE2__
+
+
+/** \brief Неизменяемое множество в виде статического B+-дерева (см. описание файла).
+ *
+ *  Листья — все элементы по возрастанию одним массивом, разбитым на блоки по \c BLOCK; последний
+ *  блок добит копиями максимума. Над листьями — уровни внутренних узлов по \c BLOCK разделителей:
+ *  j-й разделитель узла — максимум его j-го ребенка (у несуществующих детей — общий максимум).
+ *  Уровни лежат подряд от корня к листьям в одном выровненном по линии кэша куске памяти, дети
+ *  узла p — узлы p·BLOCK + j следующего уровня, так что указателей нет вовсе. Памяти поверх самих
+ *  элементов — около 1/(BLOCK - 1).
+ *
+ *  Итераторы — указатели на элементы листьев, поэтому диапазоны перебираются подряд по памяти.
+ *
+ *  \tparam Element Тип элементов.
+ *  \tparam Compar Компаратор.
+ */
+    template<typename Element, typename Compar = std::less<Element> >
+    class FrozenRBTree
+    {
+    public:
+        typedef const Element *const_iterator;
+        typedef FrozenBlockSearch<Element, Compar, 16> BlockSearch;
+
+        /** \brief Элементов в блоке: 64 байта для 4-байтовых ключей. */
+        static const std::size_t BLOCK = 16;
+
+        /** \brief Выравнивание блоков. */
+        static const std::size_t ALIGNMENT = 64;
+
+    public:
+        explicit FrozenRBTree(const Compar &compar = Compar())
+                : _compar(compar), _raw(nullptr), _data(nullptr), _keys(nullptr), _size(0), _total(0)
+        {}
+
+        /** \brief Строит дерево из \c n элементов, которые \c first выдает строго по возрастанию. */
+        template<typename InputIt>
+        FrozenRBTree(InputIt first, std::size_t n, const Compar &compar = Compar())
+                : _compar(compar), _raw(nullptr), _data(nullptr), _keys(nullptr), _size(0), _total(0)
+        { build(first, n); }
+
+        FrozenRBTree(FrozenRBTree &&other)
+                : _compar(other._compar), _raw(nullptr), _data(nullptr), _keys(nullptr), _size(0), _total(0)
+        { swap(other); }
+
+        FrozenRBTree &operator=(FrozenRBTree &&other)
+        {
+            FrozenRBTree tmp(std::move(other));
+            swap(tmp);
+            return *this;
+        }
+
+        ~FrozenRBTree()
+        { release(); }
+
+    public:
+        /** \brief Элемент, эквивалентный \c key, или nullptr. */
+        const Element *find(const Element &key) const
+        {
+            std::size_t i = lowerBoundIndex(key);
+            return (i < _size && !_compar(key, _keys[i])) ? _keys + i : nullptr;
+        }
+
+        /** \brief Первый элемент не меньше \c key. */
+        const_iterator lower_bound(const Element &key) const
+        { return _keys + lowerBoundIndex(key); }
+
+        /** \brief Первый элемент больше \c key. */
+        const_iterator upper_bound(const Element &key) const
+        {
+            std::size_t i = lowerBoundIndex(key);
+            return _keys + ((i < _size && !_compar(key, _keys[i])) ? i + 1 : i);
+        }
+
+        /** \brief Вызывает \c visitor(elem) для каждого элемента из полуинтервала [lo, hi) по возрастанию.
+         *  Два спуска и проход по листьям подряд.
+         */
+        template<typename Visitor>
+        void forEachInRange(const Element &lo, const Element &hi, Visitor visitor) const
+        {
+            if (!_compar(lo, hi))
+                return;
+
+            for (const Element *it = lower_bound(lo), *last = lower_bound(hi); it != last; ++it)
+                visitor(*it);
+        }
+
+        /** \brief Число элементов в полуинтервале [lo, hi) за O(log n). */
+        std::size_t countInRange(const Element &lo, const Element &hi) const
+        { return _compar(lo, hi) ? (std::size_t) (lower_bound(hi) - lower_bound(lo)) : 0; }
+
+        const_iterator begin() const
+        { return _keys; }
+
+        const_iterator end() const
+        { return _keys + _size; }
+
+        std::size_t size() const
+        { return _size; }
+
+        bool isEmpty() const
+        { return _size == 0; }
+
+        /** \brief Сколько байт занимают листья и внутренние уровни вместе. */
+        std::size_t getMemoryUsage() const
+        { return _total * sizeof(Element); }
+
+        void swap(FrozenRBTree &other)
+        {
+            std::swap(_compar, other._compar);
+            std::swap(_raw, other._raw);
+            std::swap(_data, other._data);
+            std::swap(_keys, other._keys);
+            std::swap(_size, other._size);
+            std::swap(_total, other._total);
+            _levels.swap(other._levels);
+        }
+
+    protected:
+        /** \brief Индекс первого элемента не меньше \c key: по одному блоку на уровень. */
+        std::size_t lowerBoundIndex(const Element &key) const
+        {
+            // Ключ больше максимума сразу уходит в конец: ниже каждый выбранный ребенок уже не меньше ключа
+            if (!_size || _compar(_keys[_size - 1], key))
+                return _size;
+
+            std::size_t node = 0;
+            for (std::size_t lv = 0; lv < _levels.size(); ++lv)
+                node = node * BLOCK + BlockSearch::rank(_data + _levels[lv] + node * BLOCK, key, _compar);
+
+            return node * BLOCK + BlockSearch::rank(_keys + node * BLOCK, key, _compar);
+        }
+
+        template<typename InputIt>
+        void build(InputIt first, std::size_t n)
+        {
+            if (!n)
+                return;
+
+            // Число узлов на уровнях снизу вверх: листовые блоки, затем по BLOCK детей на узел
+            std::vector<std::size_t> counts(1, (n + BLOCK - 1) / BLOCK);
+            while (counts.back() > 1)
+                counts.push_back((counts.back() + BLOCK - 1) / BLOCK);
+
+            // Сверху вниз: корень первым, листья последними
+            std::size_t total = 0;
+            for (std::size_t lv = counts.size(); lv-- > 1;)
+            {
+                _levels.push_back(total);
+                total += counts[lv] * BLOCK;
+            }
+            std::size_t leafStart = total;
+            total += counts[0] * BLOCK;
+
+            _raw = ::operator new(total * sizeof(Element) + ALIGNMENT);
+            _data = reinterpret_cast<Element *>(
+                    (reinterpret_cast<std::uintptr_t>(_raw) + ALIGNMENT - 1) & ~(std::uintptr_t) (ALIGNMENT - 1));
+            _keys = _data + leafStart;
+
+            // Элементы конструируются по порядку, и при исключении разрушается ровно сделанное
+            std::size_t built = 0;
+            try
+            {
+                for (; built < n; ++built, ++first)
+                    new(_keys + built) Element(*first);
+                for (std::size_t i = n; i < counts[0] * BLOCK; ++i, ++built)
+                    new(_keys + i) Element(_keys[n - 1]);
+
+                // Разделители снизу вверх: максимум ребенка — его последний элемент
+                const Element *below = _keys;
+                std::size_t belowCount = counts[0];
+                for (std::size_t lv = _levels.size(); lv-- > 0;)
+                {
+                    Element *level = _data + _levels[lv];
+                    std::size_t slots = counts[_levels.size() - lv] * BLOCK;
+                    for (std::size_t j = 0; j < slots; ++j, ++built)
+                        new(level + j) Element(j < belowCount ? below[j * BLOCK + BLOCK - 1] : _keys[n - 1]);
+
+                    below = level;
+                    belowCount = counts[_levels.size() - lv];
+                }
+            }
+            catch (...)
+            {
+                destroyBuilt(built, leafStart, counts[0] * BLOCK);
+                ::operator delete(_raw);
+                _raw = nullptr;
+                _data = _keys = nullptr;
+                _levels.clear();
+                throw;
+            }
+
+            _size = n;
+            _total = total;
+        }
+
+        /** \brief Разрушает первые \c built сконструированных элементов: сначала листья, потом уровни снизу вверх. */
+        void destroyBuilt(std::size_t built, std::size_t leafStart, std::size_t leafSlots)
+        {
+            for (std::size_t i = 0; i < built && i < leafSlots; ++i)
+                _keys[i].~Element();
+            built = built > leafSlots ? built - leafSlots : 0;
+
+            for (std::size_t lv = _levels.size(); lv-- > 0 && built;)
+            {
+                std::size_t end = lv + 1 < _levels.size() ? _levels[lv + 1] : leafStart;
+                for (std::size_t i = _levels[lv]; i < end && built; ++i, --built)
+                    _data[i].~Element();
+            }
+        }
+
+        void release()
+        {
+            if (!_raw)
+                return;
+
+            for (std::size_t i = 0; i < _total; ++i)
+                _data[i].~Element();
+            ::operator delete(_raw);
+            _raw = nullptr;
+        }
+
+    protected:
+        FrozenRBTree(const FrozenRBTree &);
+        FrozenRBTree &operator=(const FrozenRBTree &);
+
+    protected:
+        Compar _compar;
+        void *_raw;                                  ///< Выделенная память (до выравнивания).
+        Element *_data;                              ///< Начало уровней, выровненное на ALIGNMENT.
+        Element *_keys;                              ///< Листья: элементы по возрастанию.
+        std::size_t _size;                           ///< Число элементов (без добивки).
+        std::size_t _total;                          ///< Число сконструированных мест всех уровней.
+        std::vector<std::size_t> _levels;            ///< Начала внутренних уровней в _data, от корня.
+    }; // class FrozenRBTree
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    FrozenRBTree<Element, Compar> RBTree<Element, Compar, Allocator, Dumper>::freeze() const
+    { return FrozenRBTree<Element, Compar>(begin(), size(), _compar); }
+
+
+} // namespace xi
+
+
+#endif // XI_RBFROZEN_H
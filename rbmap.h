@@ -0,0 +1,344 @@
+﻿////////////////////////////////////////////////////////////////////////////////
+/// \file
+/// \brief     Упорядоченный словарь на красно-черном дереве
+/// \author    Kupchenko Viktor
+/// \version   0.1.0
+/// \date      01.05.2017
+///            This is a part of the course "Algorithms and Data Structures"
+///            provided by  the School of Software Engineering of the Faculty
+///            of Computer Science at the Higher School of Economics.
+///
+/// Словарь хранит в узлах xi::RBTree пары std::pair<const Key, Value> и
+/// сравнивает их только по ключу. Вставка, перебалансировка и удаление — те же,
+/// что у дерева; словарь добавляет изменяемое значение и операции, которые
+/// находят место для ключа одним спуском: operator[], insertOrAssign(), tryEmplace().
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef XI_RBMAP_H
+#define XI_RBMAP_H
+
+#include <functional>       // std::less
+#include <iterator>         // std::bidirectional_iterator_tag
+#include <memory>           // std::allocator
+#include <stdexcept>        // std::invalid_argument, std::out_of_range
+#include <tuple>            // std::forward_as_tuple
+#include <utility>          // std::pair, std::piecewise_construct
+
+#include "rbtree.h"
+
+
+namespace xi
+{
+
+
+/** \brief Компаратор пар словаря: сравнивает только ключи.
+ *
+ *  Прозрачен: с любой стороны может стоять как пара, так и сам ключ (или то, что умеет
+ *  сравнивать \c Compar), поэтому дерево ищет по ключу без временной пары. Если у \c Compar
+ *  есть трехстороннее \c compare(), оно пробрасывается, и поиск обходится одним сравнением на уровень.
+ */
+    template<typename Key, typename Value, typename Compar>
+    class MapKeyCompare
+    {
+    public:
+        typedef void is_transparent;
+        typedef std::pair<const Key, Value> value_type;
+
+    protected:
+        // Ключ пары или сам аргумент, если это уже ключ; объявлены до compare(), где нужны в типе результата
+        static const Key &keyOf(const value_type &v)
+        { return v.first; }
+
+        template<typename K>
+        static const K &keyOf(const K &k)
+        { return k; }
+
+    public:
+        explicit MapKeyCompare(const Compar &compar = Compar())
+                : _compar(compar)
+        {}
+
+        template<typename A, typename B>
+        bool operator()(const A &a, const B &b) const
+        { return _compar(keyOf(a), keyOf(b)); }
+
+        // Параметр C нужен, чтобы отсутствие Compar::compare() отсекало только эту перегрузку, а не весь класс
+        template<typename A, typename B, typename C = Compar>
+        auto compare(const A &a, const B &b) const -> decltype(std::declval<const C &>().compare(keyOf(a), keyOf(b)))
+        { return _compar.compare(keyOf(a), keyOf(b)); }
+
+        /** \brief Исходный компаратор ключей. */
+        const Compar &getKeyCompare() const
+        { return _compar; }
+
+    protected:
+        Compar _compar;                                ///< Компаратор ключей.
+    }; // class MapKeyCompare
+
+
+/** \brief Упорядоченный словарь: ключи уникальны, значения можно менять на месте.
+ *
+ *  \tparam Key Тип ключа.
+ *  \tparam Value Тип значения.
+ *  \tparam Compar Компаратор ключей, по умолчанию \c std::less.
+ *  \tparam Allocator Аллокатор пар в стиле STL, перепривязывается к узлу дерева как у \c RBTree.
+ */
+    template<typename Key, typename Value, typename Compar = std::less<Key>,
+            typename Allocator = std::allocator<std::pair<const Key, Value> > >
+    class RBMap : protected RBTree<std::pair<const Key, Value>, MapKeyCompare<Key, Value, Compar>, Allocator>
+    {
+    public:
+        typedef Key key_type;
+        typedef Value mapped_type;
+        typedef std::pair<const Key, Value> value_type;
+        typedef Compar key_compare;
+        typedef Allocator allocator_type;
+        typedef std::size_t size_type;
+
+        /** \brief Дерево, на котором построен словарь. */
+        typedef RBTree<value_type, MapKeyCompare<Key, Value, Compar>, Allocator> Tree;
+        typedef typename Tree::Node Node;
+        typedef typename Tree::const_iterator const_iterator;
+
+        /** \brief Двунаправленный итератор, через который можно менять значение (но не ключ). */
+        class Iterator
+        {
+            friend class RBMap;
+
+        public:
+            typedef std::bidirectional_iterator_tag iterator_category;
+            typedef typename RBMap::value_type value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef value_type *pointer;
+            typedef value_type &reference;
+
+        public:
+            Iterator()
+            {}
+
+            // Узлы словаря константными не бывают, так что снимать const с пары законно
+            reference operator*() const
+            { return const_cast<reference>(*_it); }
+
+            pointer operator->() const
+            { return &**this; }
+
+            Iterator &operator++()
+            {
+                ++_it;
+                return *this;
+            }
+
+            Iterator operator++(int)
+            {
+                Iterator res(*this);
+                ++_it;
+                return res;
+            }
+
+            Iterator &operator--()
+            {
+                --_it;
+                return *this;
+            }
+
+            Iterator operator--(int)
+            {
+                Iterator res(*this);
+                --_it;
+                return res;
+            }
+
+            bool operator==(const Iterator &other) const
+            { return _it == other._it; }
+
+            bool operator!=(const Iterator &other) const
+            { return _it != other._it; }
+
+            /** \brief Итератор только для чтения на тот же элемент. */
+            operator const_iterator() const
+            { return _it; }
+
+        protected:
+            explicit Iterator(const const_iterator &it)
+                    : _it(it)
+            {}
+
+        protected:
+            const_iterator _it;                        ///< Итератор дерева, на котором все и держится.
+        }; // class RBMap::Iterator
+
+        typedef Iterator iterator;
+
+    public:
+        explicit RBMap(const Compar &compar = Compar(), const Allocator &alloc = Allocator())
+                : Tree(MapKeyCompare<Key, Value, Compar>(compar), alloc)
+        {}
+
+        RBMap(RBMap &&other)
+                : Tree(std::move(other))
+        {}
+
+        RBMap &operator=(RBMap &&other)
+        {
+            Tree::operator=(std::move(other));
+            return *this;
+        }
+
+    public:
+        // Доступ по ключу
+
+        /** \brief Возвращает значение по ключу \c key; если ключа нет, вставляет значение по умолчанию.
+         *  Место ищется одним спуском, и он же дает место для вставки.
+         */
+        Value &operator[](const Key &key)
+        { return tryEmplace(key).first->second; }
+
+        /** \brief То же, что \c operator[](const Key&), но новый ключ перемещается в узел. */
+        Value &operator[](Key &&key)
+        { return tryEmplace(std::move(key)).first->second; }
+
+        /** \brief Возвращает значение по ключу \c key. Если ключа нет, генерируется \c std::out_of_range. */
+        Value &at(const Key &key)
+        {
+            const Node *nd = this->findNode(key);
+            if (!nd)
+                throw std::out_of_range("Key doesn't exist!");
+
+            return const_cast<Value &>(nd->getKey().second);
+        }
+
+        const Value &at(const Key &key) const
+        { return const_cast<RBMap *>(this)->at(key); }
+
+        /** \brief Записывает \c value по ключу \c key: присваивает, если ключ есть, иначе вставляет пару.
+         *
+         *  \returns пару из итератора на элемент и признака того, что элемент вставлен.
+         */
+        template<typename M>
+        std::pair<iterator, bool> insertOrAssign(const Key &key, M &&value)
+        { return insertOrAssignImpl(key, std::forward<M>(value)); }
+
+        template<typename M>
+        std::pair<iterator, bool> insertOrAssign(Key &&key, M &&value)
+        { return insertOrAssignImpl(std::move(key), std::forward<M>(value)); }
+
+        /** \brief Вставляет пару с ключом \c key и значением, построенным из \c args, если ключа еще нет.
+         *
+         *  В отличие от \c RBTree::emplace(), ключ известен заранее, так что узел создается только
+         *  при свободном месте, а \c args при дубликате не трогаются вовсе.
+         *  \returns пару из итератора на элемент с ключом \c key и признака того, что вставка состоялась.
+         */
+        template<typename... Args>
+        std::pair<iterator, bool> tryEmplace(const Key &key, Args &&... args)
+        { return tryEmplaceImpl(key, std::forward<Args>(args)...); }
+
+        template<typename... Args>
+        std::pair<iterator, bool> tryEmplace(Key &&key, Args &&... args)
+        { return tryEmplaceImpl(std::move(key), std::forward<Args>(args)...); }
+
+        /** \brief Удаляет элемент с ключом \c key. Если ключа нет, генерируется \c std::invalid_argument. */
+        void remove(const Key &key)
+        {
+            Node *nd = (Node *) this->findNode(key, Tree::SP_REMOVE);
+            if (!nd)
+                throw std::invalid_argument("Key doesn't exist!");
+
+            this->unlinkNode(nd);
+            this->destroyNode(nd);
+        }
+
+    public:
+        // Поиск и обход
+
+        /** \brief Итератор на элемент с ключом \c key или \c end(). */
+        iterator find(const Key &key)
+        { return iterator(this->makeIterator(this->findNode(key))); }
+
+        const_iterator find(const Key &key) const
+        { return this->makeIterator(this->findNode(key)); }
+
+        /** \brief Есть ли в словаре ключ \c key. */
+        bool contains(const Key &key) const
+        { return this->findNode(key) != nullptr; }
+
+        iterator lower_bound(const Key &key)
+        { return iterator(this->makeIterator(this->lowerBoundNode(key))); }
+
+        const_iterator lower_bound(const Key &key) const
+        { return this->makeIterator(this->lowerBoundNode(key)); }
+
+        iterator upper_bound(const Key &key)
+        { return iterator(this->makeIterator(this->upperBoundNode(key))); }
+
+        const_iterator upper_bound(const Key &key) const
+        { return this->makeIterator(this->upperBoundNode(key)); }
+
+        iterator begin()
+        { return iterator(Tree::begin()); }
+
+        iterator end()
+        { return iterator(Tree::end()); }
+
+        using Tree::begin;
+        using Tree::end;
+        using Tree::cbegin;
+        using Tree::cend;
+
+        using Tree::size;
+        using Tree::isEmpty;
+        using Tree::clear;
+        using Tree::min;
+        using Tree::max;
+        using Tree::popMin;
+        using Tree::popMax;
+        using Tree::getAllocator;
+
+        /** \brief Дерево, на котором построен словарь, только для чтения. */
+        const Tree &getTree() const
+        { return *this; }
+
+    protected:
+        template<typename K, typename M>
+        std::pair<iterator, bool> insertOrAssignImpl(K &&key, M &&value)
+        {
+            Node *parent;
+            bool goLeft;
+            Node *dup = this->findInsertPos(key, parent, goLeft);
+            if (dup)
+            {
+                const_cast<Value &>(dup->getKey().second) = std::forward<M>(value);
+                return std::make_pair(iterator(this->makeIterator(dup)), false);
+            }
+
+            Node *nd = this->createNode(std::forward<K>(key), std::forward<M>(value));
+            this->attachNode(nd, parent, goLeft);
+            return std::make_pair(iterator(this->makeIterator(nd)), true);
+        }
+
+        template<typename K, typename... Args>
+        std::pair<iterator, bool> tryEmplaceImpl(K &&key, Args &&... args)
+        {
+            Node *parent;
+            bool goLeft;
+            Node *dup = this->findInsertPos(key, parent, goLeft);
+            if (dup)
+                return std::make_pair(iterator(this->makeIterator(dup)), false);
+
+            Node *nd = this->createNode(std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                                        std::forward_as_tuple(std::forward<Args>(args)...));
+            this->attachNode(nd, parent, goLeft);
+            return std::make_pair(iterator(this->makeIterator(nd)), true);
+        }
+
+    protected:
+        RBMap(const RBMap &);                          ///< КК не доступен.
+        RBMap &operator=(const RBMap &);               ///< Оператор присваивания недоступен.
+    }; // class RBMap
+
+
+} // namespace xi
+
+
+#endif // XI_RBMAP_H
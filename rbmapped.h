@@ -0,0 +1,719 @@
+﻿////////////////////////////////////////////////////////////////////////////////
+/// \file
+/// \brief     Дерево, узлы которого лежат в отображенном в память файле
+/// \author    Kupchenko Viktor
+/// \version   0.1.0
+/// \date      01.05.2017
+///            This is a part of the course "Algorithms and Data Structures"
+///            provided by  the School of Software Engineering of the Faculty
+///            of Computer Science at the Higher School of Economics.
+///
+/// Узлы обычного RBTree раздает xi::MappedAllocator из файла, отображенного
+/// через mmap, а связи между ними — самоотносительные смещения (раскладка
+/// RBTREE_RELATIVE_LINKS). Поэтому файл не зависит от адреса, по которому он
+/// отображен: при следующем открытии дерево готово сразу, без чтения и
+/// разбора элементов. Вставка, удаление и перебалансировка — те же, что у
+/// RBTree, из rbtree.hpp.
+///
+/// Точка сохранности — MappedRBTree::sync() (и закрытие дерева). Отображение
+/// частное, поэтому до нее изменения живут только в памяти процесса, а файл
+/// хранит дерево прошлой точки сохранности. sync() переносит измененные
+/// страницы через журнал повторения (файл «<имя>.redo»): упавший процесс
+/// оставляет на диске либо прошлое дерево, либо зафиксированный журнал,
+/// который доигрывается при следующем открытии.
+///
+/// Требуется RBTREE_RELATIVE_LINKS до подключения rbtree.h и POSIX mmap.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef XI_RBMAPPED_H
+#define XI_RBMAPPED_H
+
+#include <cstddef>          // std::size_t
+#include <cstdint>          // std::uint64_t, std::uintptr_t
+#include <cstring>          // std::memcpy, std::memcmp, std::memset
+#include <functional>       // std::less
+#include <memory>           // std::shared_ptr
+#include <new>              // std::bad_alloc
+#include <stdexcept>        // std::runtime_error
+#include <string>
+#include <type_traits>      // std::is_trivially_copyable
+#include <vector>
+
+#include "rbtree.h"
+
+#ifndef RBTREE_RELATIVE_LINKS
+#error "rbmapped.h requires RBTREE_RELATIVE_LINKS: raw node addresses don't survive remapping"
+#endif
+
+#ifndef RBTREE_HAS_MMAP
+#error "rbmapped.h requires POSIX mmap"
+#endif
+
+#include <fcntl.h>          // open
+#include <sys/file.h>       // flock
+#include <sys/mman.h>       // mmap, madvise, munmap
+#include <sys/stat.h>       // fstat
+#include <unistd.h>         // close, fsync, ftruncate, pread, pwrite, sysconf, unlink
+
+
+namespace xi
+{
+
+
+/** \brief Файл, отображенный в память и нарезанный на места одинакового размера.
+ *
+ *  Файл начинается с заголовка (\c Header), за ним идут места. Все учетные данные — граница
+ *  выданной части, список свободных мест, корень и размер дерева — хранятся в самом заголовке
+ *  смещениями от начала файла, так что переживают закрытие. Размер файла (емкость) задается
+ *  при создании и дальше растет только при повторном открытии: перенос отображения сдвинул бы
+ *  живые узлы. Файл открывается одним владельцем (\c flock).
+ *
+ *  Отображение частное (\c MAP_PRIVATE): изменения остаются в памяти процесса, и файл на диске
+ *  все время хранит состояние последней точки сохранности. \c sync() находит измененные страницы,
+ *  записывает их в журнал повторения (файл с суффиксом \c logSuffix()), фиксирует журнал, затем
+ *  переносит страницы в файл и очищает журнал. Упавший до фиксации \c sync() оставляет прежнее
+ *  состояние, после фиксации — журнал, который доигрывается при следующем открытии (или следующем
+ *  \c sync(), если ошибка не была фатальной для процесса).
+ */
+    class MappedNodeFile
+    {
+    public:
+        static const std::uint32_t VERSION = 2;
+
+        /** \brief Предел емкости: дальше 32-битные смещения \c RelPtr между узлами не дотягиваются. */
+        static const std::uint64_t MAX_CAPACITY = std::uint64_t(8) << 30;
+
+        /** \brief Суффикс имени журнала повторения рядом с файлом дерева. */
+        static const char *logSuffix()
+        { return ".redo"; }
+
+        /** \brief Заголовок файла. Порядок байт машинный. */
+        struct Header
+        {
+            char magic[8];                           ///< "XIRBMAPD".
+            std::uint32_t version;                   ///< Версия формата.
+            std::uint32_t reserved;                  ///< Ноль.
+            std::uint64_t byteOrder;                 ///< \c RBTreeSnapshotHeader::BYTE_ORDER_MARK.
+            std::uint64_t layout;                    ///< Описание раскладки узла; должно совпасть при открытии.
+            std::uint64_t slotSize;                  ///< Размер места под узел.
+            std::uint64_t dataOffset;                ///< Смещение первого места.
+            std::uint64_t capacity;                  ///< Размер файла.
+            std::uint64_t used;                      ///< Граница тронутых мест.
+            std::uint64_t freeHead;                  ///< Первое свободное место или 0.
+            std::uint64_t root;                      ///< Корень дерева на момент sync() или 0.
+            std::uint64_t count;                     ///< Размер дерева на момент sync().
+        };
+
+        /** \brief Заголовок журнала повторения. Журнал зафиксирован, если \c pages не ноль.
+         *
+         *  За заголовком идут \c pages записей: смещение страницы в файле дерева и ее содержимое.
+         *  Заголовок пишется последним и меньше сектора, так что на диске он либо старый, либо новый.
+         */
+        struct LogHeader
+        {
+            char magic[8];                           ///< "XIRBREDO".
+            std::uint64_t pageSize;                  ///< Размер страницы в записях.
+            std::uint64_t pages;                     ///< Число записей; 0 — журнал пуст.
+        };
+
+    public:
+        /** \brief Открывает файл \c path или создает его, если файла нет или он пуст.
+         *
+         *  Зафиксированный журнал, оставшийся от прерванного \c sync(), сначала доигрывается.
+         *  \param slotSize размер места (округляется вверх до 8 байт).
+         *  \param capacity желаемый размер файла; у существующего файла он только увеличивается.
+         *  \param layout описание раскладки узла, записывается при создании и сверяется при открытии.
+         *  Генерирует \c std::runtime_error, если файл не открывается или чужой.
+         */
+        MappedNodeFile(const char *path, std::size_t slotSize, std::size_t capacity, std::uint64_t layout)
+                : _fd(-1), _logFd(-1), _logPath(std::string(path) + logSuffix()), _logClean(false),
+                  _base(nullptr), _pageSize((std::size_t) ::sysconf(_SC_PAGESIZE))
+        {
+            _fd = ::open(path, O_RDWR | O_CREAT, 0644);
+            if (_fd < 0)
+                throw std::runtime_error("Can't open mapped tree file!");
+
+            try
+            {
+                open(roundUp(slotSize, 8), capacity, layout);
+            }
+            catch (...)
+            {
+                if (_logFd >= 0)
+                    ::close(_logFd);
+                ::close(_fd);
+                throw;
+            }
+        }
+
+        /** \brief Снимает отображение. Пустой журнал удаляется, зафиксированный остается для открытия. */
+        ~MappedNodeFile()
+        {
+            ::munmap(_base, (std::size_t) header().capacity);
+            if (_logClean)
+                ::unlink(_logPath.c_str());
+            ::close(_logFd);
+            ::close(_fd);
+        }
+
+    public:
+        /** \brief Выдает место из списка свободных или с границы; нет места — \c std::bad_alloc. */
+        void *allocate()
+        {
+            Header &h = header();
+            if (h.freeHead)
+            {
+                void *p = at(h.freeHead);
+                std::memcpy(&h.freeHead, p, sizeof(h.freeHead));
+                return p;
+            }
+
+            if (h.capacity - h.used < h.slotSize)
+                throw std::bad_alloc();
+
+            void *p = at(h.used);
+            h.used += h.slotSize;
+            return p;
+        }
+
+        /** \brief Возвращает место в список свободных; сам список живет в освобожденных местах. */
+        void deallocate(void *p)
+        {
+            Header &h = header();
+            std::memcpy(p, &h.freeHead, sizeof(h.freeHead));
+            h.freeHead = offsetOf(p);
+        }
+
+        /** \brief Разом освобождает все места. */
+        void reset()
+        {
+            header().used = header().dataOffset;
+            header().freeHead = 0;
+        }
+
+        /** \brief Точка сохранности: записывает корень \c root и размер \c count и переносит на диск
+         *  все страницы, которые отличаются от файла, через журнал повторения.
+         *
+         *  Измененные страницы на Linux берутся из таблицы страниц процесса (8 байт на страницу, файл
+         *  не читается), а где ее нет — сравнением тронутой части отображения с файлом, O(used) чтения.
+         *  Сами страницы пишутся дважды: в журнал и в файл. При ошибке — \c std::runtime_error, а на диске
+         *  остается либо прежнее состояние, либо зафиксированный журнал с новым.
+         */
+        void sync(const void *root, std::uint64_t count)
+        {
+            // Запись даже того же значения делает страницу заголовка частной копией, то есть измененной
+            Header &h = header();
+            std::uint64_t rootOffset = root ? offsetOf(root) : 0;
+            if (h.root != rootOffset)
+                h.root = rootOffset;
+            if (h.count != count)
+                h.count = count;
+
+            // Неудачный sync() мог оставить зафиксированный журнал и файл, перенесенный не до конца.
+            // Журнал сперва доигрывается: очистить его сразу значило бы потерять и прежнее, и новое дерево
+            if (!_logClean)
+                replayLog();
+
+            std::vector<std::uint64_t> dirty;
+            collectDirty(dirty);
+            if (dirty.empty())
+                return;
+
+            // Заголовок журнала может попасть на диск, даже если writeLog() не дошел до конца
+            _logClean = false;
+            writeLog(dirty);
+
+            for (std::size_t i = 0; i < dirty.size(); ++i)
+                writeAll(_fd, at(dirty[i]), _pageSize, dirty[i]);
+            syncFile(_fd);
+
+            clearLog();
+
+            // Файл теперь совпадает с памятью: частные копии страниц можно отдать, они перечитаются из файла
+            for (std::size_t i = 0; i < dirty.size(); ++i)
+                ::madvise(at(dirty[i]), _pageSize, MADV_DONTNEED);
+        }
+
+    public:
+        /** \brief Адрес по смещению от начала файла. */
+        void *at(std::uint64_t offset) const
+        { return _base + offset; }
+
+        /** \brief Смещение адреса \c p от начала файла. */
+        std::uint64_t offsetOf(const void *p) const
+        { return (std::uint64_t) (static_cast<const char *>(p) - _base); }
+
+        const Header &getHeader() const
+        { return header(); }
+
+        std::size_t getSlotSize() const
+        { return (std::size_t) header().slotSize; }
+
+    protected:
+        /** \brief Сколько страниц сравнивается и пишется в журнал за один системный вызов. */
+        static const std::size_t BATCH_PAGES = 16;
+
+        Header &header() const
+        { return *reinterpret_cast<Header *>(_base); }
+
+        static std::uint64_t roundUp(std::uint64_t sz, std::uint64_t unit)
+        { return (sz + unit - 1) / unit * unit; }
+
+        void open(std::size_t slotSize, std::size_t capacity, std::uint64_t layout)
+        {
+            if (::flock(_fd, LOCK_EX | LOCK_NB) != 0)
+                throw std::runtime_error("Mapped tree file is already open!");
+
+            _logFd = ::open(_logPath.c_str(), O_RDWR | O_CREAT, 0644);
+            if (_logFd < 0)
+                throw std::runtime_error("Can't open mapped tree redo log!");
+            replayLog();
+
+            struct stat st;
+            if (::fstat(_fd, &st) != 0)
+                throw std::runtime_error("Can't open mapped tree file!");
+
+            Header h;
+            bool fresh = st.st_size == 0;
+            if (fresh)
+            {
+                std::memset(&h, 0, sizeof(h));
+                std::memcpy(h.magic, "XIRBMAPD", sizeof(h.magic));
+                h.version = VERSION;
+                h.byteOrder = RBTreeSnapshotHeader::BYTE_ORDER_MARK;
+                h.layout = layout;
+                h.slotSize = slotSize;
+                h.dataOffset = roundUp(sizeof(Header), 64);
+                h.used = h.dataOffset;
+            }
+            else
+            {
+                if (::pread(_fd, &h, sizeof(h), 0) != (ssize_t) sizeof(h) ||
+                    std::memcmp(h.magic, "XIRBMAPD", sizeof(h.magic)) != 0 || h.version != VERSION ||
+                    h.byteOrder != RBTreeSnapshotHeader::BYTE_ORDER_MARK)
+                    throw std::runtime_error("Not a mapped tree file!");
+                if (h.layout != layout || h.slotSize != slotSize)
+                    throw std::runtime_error("Mapped tree file was written for another node layout!");
+                if (h.used > h.capacity)
+                    throw std::runtime_error("Mapped tree file is corrupted!");
+            }
+
+            // Емкость только растет: выданные места должны остаться в файле. Файл мог вырасти раньше,
+            // чем на диск попал заголовок с новой емкостью, — тогда верен размер файла
+            std::uint64_t cap = capacity > h.capacity ? capacity : h.capacity;
+            if ((std::uint64_t) st.st_size > cap)
+                cap = (std::uint64_t) st.st_size;
+            cap = roundUp(cap, _pageSize);
+            if (cap > MAX_CAPACITY)
+                throw std::runtime_error("Mapped tree capacity is too large!");
+            if (cap < h.dataOffset + slotSize)
+                cap = roundUp(h.dataOffset + slotSize, _pageSize);
+
+            // Новый файл сразу становится на диске пустым деревом; частное отображение сюда не пишет
+            if (cap != h.capacity)
+            {
+                h.capacity = cap;
+                if (cap != (std::uint64_t) st.st_size && ::ftruncate(_fd, (off_t) cap) != 0)
+                    throw std::runtime_error("Can't resize mapped tree file!");
+                writeAll(_fd, &h, sizeof(h), 0);
+                syncFile(_fd);
+            }
+
+            void *p = ::mmap(nullptr, (std::size_t) cap, PROT_READ | PROT_WRITE, MAP_PRIVATE, _fd, 0);
+            if (p == MAP_FAILED)
+                throw std::runtime_error("Can't map tree file!");
+            _base = static_cast<char *>(p);
+        }
+
+        /** \brief Собирает в \c dirty смещения страниц тронутой части, измененных с прошлой точки сохранности. */
+        void collectDirty(std::vector<std::uint64_t> &dirty) const
+        {
+            std::uint64_t end = roundUp(header().used, _pageSize);
+            if (!collectCopied(dirty, end))
+                collectDiffering(dirty, end);
+        }
+
+        /** \brief Находит измененные страницы по /proc/self/pagemap. \returns false, если он недоступен.
+         *
+         *  На страницу частного отображения, в которую писали, ядро ставит анонимную копию: в pagemap
+         *  у нее сброшен бит «страница файла» (61), а вытесненная копия лежит в подкачке (бит 62).
+         *  После \c sync() копии отдаются через \c MADV_DONTNEED, так что каждая копия — изменение
+         *  после прошлой точки сохранности (возможно, записавшее те же байты).
+         */
+        bool collectCopied(std::vector<std::uint64_t> &dirty, std::uint64_t end) const
+        {
+#ifdef __linux__
+            const std::uint64_t PRESENT = std::uint64_t(1) << 63;
+            const std::uint64_t SWAPPED = std::uint64_t(1) << 62;
+            const std::uint64_t FILE_PAGE = std::uint64_t(1) << 61;
+            const std::size_t BATCH = 512;
+
+            // Открывается на каждый вызов: дескриптор, открытый до fork(), смотрел бы на родителя
+            int fd = ::open("/proc/self/pagemap", O_RDONLY);
+            if (fd < 0)
+                return false;
+
+            std::uint64_t entries[BATCH];
+            std::uint64_t first = (std::uint64_t) reinterpret_cast<std::uintptr_t>(_base) / _pageSize;
+            std::uint64_t pages = end / _pageSize;
+            std::size_t found = dirty.size();
+            bool ok = true;
+            for (std::uint64_t pg = 0; ok && pg < pages; pg += BATCH)
+            {
+                std::size_t n = (std::size_t) (pages - pg < BATCH ? pages - pg : BATCH);
+                std::size_t bytes = n * sizeof(std::uint64_t);
+                ok = ::pread(fd, entries, bytes, (off_t) ((first + pg) * sizeof(std::uint64_t))) == (ssize_t) bytes;
+
+                for (std::size_t k = 0; ok && k < n; ++k)
+                    if ((entries[k] & SWAPPED) || ((entries[k] & PRESENT) && !(entries[k] & FILE_PAGE)))
+                        dirty.push_back((pg + k) * _pageSize);
+            }
+            ::close(fd);
+
+            if (!ok)
+                dirty.resize(found);
+            return ok;
+#else
+            (void) dirty;
+            (void) end;
+            return false;
+#endif
+        }
+
+        /** \brief Находит измененные страницы сравнением отображения с файлом. */
+        void collectDiffering(std::vector<std::uint64_t> &dirty, std::uint64_t end) const
+        {
+            std::vector<char> buf(BATCH_PAGES * _pageSize);
+
+            for (std::uint64_t off = 0; off < end; off += buf.size())
+            {
+                std::size_t len = (std::size_t) (end - off < buf.size() ? end - off : buf.size());
+                readAll(_fd, buf.data(), len, off);
+
+                for (std::size_t pg = 0; pg < len; pg += _pageSize)
+                    if (std::memcmp(buf.data() + pg, at(off + pg), _pageSize) != 0)
+                        dirty.push_back(off + pg);
+            }
+        }
+
+        /** \brief Пишет в журнал страницы \c dirty и фиксирует его: сначала записи, затем заголовок. */
+        void writeLog(const std::vector<std::uint64_t> &dirty)
+        {
+            std::size_t entry = sizeof(std::uint64_t) + _pageSize;
+            std::vector<char> buf(BATCH_PAGES * entry);
+
+            std::uint64_t pos = sizeof(LogHeader);
+            for (std::size_t i = 0; i < dirty.size(); i += BATCH_PAGES)
+            {
+                std::size_t n = dirty.size() - i < BATCH_PAGES ? dirty.size() - i : BATCH_PAGES;
+                for (std::size_t k = 0; k < n; ++k)
+                {
+                    std::memcpy(buf.data() + k * entry, &dirty[i + k], sizeof(std::uint64_t));
+                    std::memcpy(buf.data() + k * entry + sizeof(std::uint64_t), at(dirty[i + k]), _pageSize);
+                }
+                writeAll(_logFd, buf.data(), n * entry, pos);
+                pos += n * entry;
+            }
+            syncFile(_logFd);
+
+            LogHeader lh;
+            std::memcpy(lh.magic, "XIRBREDO", sizeof(lh.magic));
+            lh.pageSize = _pageSize;
+            lh.pages = dirty.size();
+            writeAll(_logFd, &lh, sizeof(lh), 0);
+            syncFile(_logFd);
+        }
+
+        /** \brief Переносит в файл дерева страницы зафиксированного журнала, если он есть, и очищает журнал. */
+        void replayLog()
+        {
+            LogHeader lh;
+            if (::pread(_logFd, &lh, sizeof(lh), 0) != (ssize_t) sizeof(lh) ||
+                std::memcmp(lh.magic, "XIRBREDO", sizeof(lh.magic)) != 0 || lh.pages == 0)
+            {
+                _logClean = true;
+                return;
+            }
+            if (lh.pageSize != _pageSize)
+                throw std::runtime_error("Mapped tree redo log was written with another page size!");
+
+            std::size_t entry = sizeof(std::uint64_t) + _pageSize;
+            std::vector<char> buf(entry);
+            for (std::uint64_t i = 0; i < lh.pages; ++i)
+            {
+                readAll(_logFd, buf.data(), entry, sizeof(LogHeader) + i * entry);
+
+                std::uint64_t off;
+                std::memcpy(&off, buf.data(), sizeof(off));
+                writeAll(_fd, buf.data() + sizeof(off), _pageSize, off);
+            }
+            syncFile(_fd);
+
+            clearLog();
+        }
+
+        /** \brief Снимает фиксацию с журнала, и только после этого его записи можно перезаписывать. */
+        void clearLog()
+        {
+            LogHeader lh;
+            std::memset(&lh, 0, sizeof(lh));
+            writeAll(_logFd, &lh, sizeof(lh), 0);
+            syncFile(_logFd);
+            _logClean = true;
+        }
+
+        static void writeAll(int fd, const void *data, std::size_t len, std::uint64_t off)
+        {
+            const char *p = static_cast<const char *>(data);
+            while (len)
+            {
+                ssize_t n = ::pwrite(fd, p, len, (off_t) off);
+                if (n <= 0)
+                    throw std::runtime_error("Can't write mapped tree file!");
+                p += n;
+                len -= (std::size_t) n;
+                off += (std::uint64_t) n;
+            }
+        }
+
+        static void readAll(int fd, void *data, std::size_t len, std::uint64_t off)
+        {
+            char *p = static_cast<char *>(data);
+            while (len)
+            {
+                ssize_t n = ::pread(fd, p, len, (off_t) off);
+                if (n <= 0)
+                    throw std::runtime_error("Can't read mapped tree file!");
+                p += n;
+                len -= (std::size_t) n;
+                off += (std::uint64_t) n;
+            }
+        }
+
+        static void syncFile(int fd)
+        {
+            if (::fsync(fd) != 0)
+                throw std::runtime_error("Can't sync mapped tree file!");
+        }
+
+    protected:
+        MappedNodeFile(const MappedNodeFile &);
+        MappedNodeFile &operator=(const MappedNodeFile &);
+
+    protected:
+        int _fd;                                     ///< Дескриптор файла; держит блокировку flock.
+        int _logFd;                                  ///< Дескриптор журнала повторения.
+        std::string _logPath;
+        bool _logClean;                              ///< Журнал на диске не зафиксирован: его можно переписывать.
+        char *_base;                                 ///< Начало отображения.
+        std::size_t _pageSize;
+    }; // class MappedNodeFile
+
+
+/** \brief Аллокатор в стиле STL, раздающий одиночные объекты из \c MappedNodeFile.
+ *
+ *  Как и \c ArenaAllocator, выдает из файла только одиночные объекты не больше места, остальные
+ *  запросы уходят в обычный \c operator \c new. В отличие от него копии и перепривязки к другому
+ *  типу разделяют один и тот же файл: дерево перепривязывает аллокатор элементов к узлам.
+ *
+ *  \tparam T Тип выделяемых объектов.
+ */
+    template<typename T>
+    class MappedAllocator
+    {
+        template<typename U>
+        friend class MappedAllocator;
+
+    public:
+        typedef T value_type;
+        typedef std::true_type propagate_on_container_move_assignment;
+        typedef std::true_type propagate_on_container_swap;
+
+        /** \brief Все места лежат в одном отображении не больше \c MappedNodeFile::MAX_CAPACITY байт. */
+        typedef std::true_type is_arena;
+
+        template<typename U>
+        struct rebind
+        {
+            typedef MappedAllocator<U> other;
+        };
+
+    public:
+        /** \brief Открывает или создает файл (см. \c MappedNodeFile). */
+        MappedAllocator(const char *path, std::size_t slotSize, std::size_t capacity, std::uint64_t layout)
+                : _file(std::make_shared<MappedNodeFile>(path, slotSize, capacity, layout))
+        {}
+
+        template<typename U>
+        MappedAllocator(const MappedAllocator<U> &other)
+                : _file(other._file)
+        {}
+
+    public:
+        T *allocate(std::size_t n)
+        {
+            if (n == 1 && sizeof(T) <= _file->getSlotSize())
+                return static_cast<T *>(_file->allocate());
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+        }
+
+        void deallocate(T *p, std::size_t n)
+        {
+            if (n == 1 && sizeof(T) <= _file->getSlotSize())
+                _file->deallocate(p);
+            else
+                ::operator delete(p);
+        }
+
+        /** \brief Разом освобождает все места, если файл больше никем не разделяется (см. \c PoolAllocator). */
+        bool releaseAll()
+        {
+            if (_file.use_count() != 1)
+                return false;
+
+            _file->reset();
+            return true;
+        }
+
+        MappedNodeFile &getFile() const
+        { return *_file; }
+
+        bool operator==(const MappedAllocator &other) const
+        { return _file == other._file; }
+
+        bool operator!=(const MappedAllocator &other) const
+        { return _file != other._file; }
+
+    protected:
+        std::shared_ptr<MappedNodeFile> _file;       ///< Разделяемый копиями файл.
+    }; // class MappedAllocator
+
+
+/** \brief Красно-черное дерево в файле: переживает перезапуск процесса и открывается за O(log n).
+ *
+ *  Элементы хранятся в узлах байтовыми копиями, поэтому должны быть тривиально копируемыми и не
+ *  ссылаться на память процесса. Компаратор при повторном открытии должен быть тем же. Из одного
+ *  файла одновременно может работать только одно дерево.
+ *
+ *  \tparam Element Тип элементов.
+ *  \tparam Compar Компаратор.
+ */
+    template<typename Element, typename Compar = std::less<Element> >
+    class MappedRBTree : protected RBTree<Element, Compar, MappedAllocator<Element> >
+    {
+        static_assert(std::is_trivially_copyable<Element>::value,
+                      "MappedRBTree stores elements as raw bytes in a file");
+
+    public:
+        typedef RBTree<Element, Compar, MappedAllocator<Element> > Tree;
+        typedef typename Tree::Node Node;
+        typedef typename Tree::const_iterator const_iterator;
+        typedef typename Tree::const_reverse_iterator const_reverse_iterator;
+
+        /** \brief Емкость файла по умолчанию. Файл разреженный: место на диске занимают только узлы. */
+        static const std::size_t DEFAULT_CAPACITY = std::size_t(1) << 30;
+
+    public:
+        /** \brief Открывает дерево из файла \c path или создает пустое, если файла нет.
+         *
+         *  \param capacity размер файла; дерево не вырастет больше, чем в него помещается.
+         */
+        explicit MappedRBTree(const char *path, std::size_t capacity = DEFAULT_CAPACITY,
+                              const Compar &compar = Compar())
+                : Tree(compar, MappedAllocator<Element>(path, sizeof(Node), capacity, getLayout()))
+        {
+            const MappedNodeFile::Header &h = file().getHeader();
+            if (h.root)
+                this->resetRoot(static_cast<Node *>(file().at(h.root)), (std::size_t) h.count);
+        }
+
+        /** \brief Закрывает дерево с точкой сохранности; узлы остаются в файле. */
+        ~MappedRBTree()
+        {
+            try
+            {
+                sync();
+            }
+            catch (...)
+            {
+                // На диске осталось прошлое дерево или зафиксированный журнал с новым
+            }
+
+            // Базовому деструктору дерево отдается пустым, чтобы узлы в файле уцелели
+            this->resetRoot(nullptr, 0);
+        }
+
+    public:
+        // Изменения: на диск попадают только в точке сохранности
+
+        using Tree::insert;
+        using Tree::tryInsert;
+        using Tree::remove;
+        using Tree::popMin;
+        using Tree::popMax;
+
+        /** \brief Очищает дерево за O(1): все места файла разом становятся свободными. */
+        using Tree::clear;
+
+        /** \brief Точка сохранности: после возврата файл на диске содержит текущее дерево. */
+        void sync()
+        { file().sync(this->_root, this->size()); }
+
+    public:
+        // Чтение
+
+        using Tree::find;
+        using Tree::isEmpty;
+        using Tree::size;
+        using Tree::min;
+        using Tree::max;
+        using Tree::getRoot;
+        using Tree::begin;
+        using Tree::end;
+        using Tree::cbegin;
+        using Tree::cend;
+        using Tree::rbegin;
+        using Tree::rend;
+        using Tree::lower_bound;
+        using Tree::upper_bound;
+        using Tree::equal_range;
+        using Tree::forEachInRange;
+        using Tree::countInRange;
+#ifdef RBTREE_WITH_ORDER_STATISTICS
+        using Tree::select;
+        using Tree::rank;
+#endif
+
+        /** \brief Размер файла. */
+        std::size_t getCapacity() const
+        { return (std::size_t) file().getHeader().capacity; }
+
+        /** \brief Сколько байт файла уже тронуто узлами (включая освобожденные). */
+        std::size_t getUsedBytes() const
+        { return (std::size_t) file().getHeader().used; }
+
+    protected:
+        MappedNodeFile &file() const
+        { return this->_nodeAlloc.getFile(); }
+
+        /** \brief Описание раскладки узла для заголовка файла: размер элемента и набор полей. */
+        static std::uint64_t getLayout()
+        {
+            std::uint64_t layout = (std::uint64_t) sizeof(Element) << 8 | alignof(Node);
+#ifdef RBTREE_WITH_ORDER_STATISTICS
+            layout |= std::uint64_t(1) << 63;
+#endif
+            return layout;
+        }
+
+    protected:
+        MappedRBTree(const MappedRBTree &);
+        MappedRBTree &operator=(const MappedRBTree &);
+    }; // class MappedRBTree
+
+
+} // namespace xi
+
+
+#endif // XI_RBMAPPED_H
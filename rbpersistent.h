@@ -0,0 +1,557 @@
+﻿////////////////////////////////////////////////////////////////////////////////
+/// \file
+/// \brief     Персистентное красно-черное дерево с копированием пути
+/// \author    Kupchenko Viktor
+/// \version   0.1.0
+/// \date      01.05.2017
+///            This is a part of the course "Algorithms and Data Structures"
+///            provided by  the School of Software Engineering of the Faculty
+///            of Computer Science at the Higher School of Economics.
+///
+/// У xi::RBTree узлы знают отца, и поэтому разделять их между версиями нельзя.
+/// Здесь узел знает только детей и считает ссылки на себя, так что версии
+/// дерева делят все общие поддеревья, а снимок (snapshot()) — это просто
+/// еще одна ссылка на корень, O(1).
+///
+/// Изменение версии идет от корня вниз и перед записью в узел проверяет, не
+/// разделяется ли он: узел, на который ссылаются только по исключительно
+/// принадлежащему этой версии пути, меняется на месте, а разделяемый сперва
+/// копируется (дети копии получают по лишней ссылке). Итого вставка и удаление
+/// копируют O(log n) узлов, если снимки есть, и ни одного, если их нет.
+/// Перебалансировка — обычная снизу вверх, только без ссылок на отца: путь
+/// хранится стеком адресов полей-ссылок.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef XI_RBPERSISTENT_H
+#define XI_RBPERSISTENT_H
+
+#include <atomic>
+#include <cstddef>          // std::size_t
+#include <functional>       // std::less
+#include <memory>           // std::allocator, std::allocator_traits
+#include <utility>          // std::forward
+#include <vector>
+
+
+namespace xi
+{
+
+
+/** \brief Персистентное красно-черное дерево: каждая копия — независимая версия, копирование за O(1).
+ *
+ *  Версию меняет один поток. Снимки, сделанные им через \c snapshot() (или конструктором копирования),
+ *  можно отдавать другим потокам и читать без блокировок, пока версия продолжает меняться:
+ *  разделяемые узлы никогда не изменяются, а счетчики ссылок атомарные, так что и уничтожать снимок
+ *  можно в любом потоке. Аллокатор при этом должен быть потокобезопасным, как \c std::allocator.
+ *
+ *  \tparam Element Тип элементов.
+ *  \tparam Compar Компаратор, как у \c RBTree.
+ *  \tparam Allocator Аллокатор в стиле STL, перепривязывается к узлу.
+ */
+    template<typename Element, typename Compar = std::less<Element>, typename Allocator = std::allocator<Element> >
+    class PersistentRBTree
+    {
+    public:
+        /** \brief Узел: элемент, цвет, дети и число ссылок на узел (от отцов и от версий-корней). */
+        class Node
+        {
+            friend class PersistentRBTree;
+
+        public:
+            const Node *getLeft() const
+            { return _left; }
+
+            const Node *getRight() const
+            { return _right; }
+
+            const Element &getKey() const
+            { return _key; }
+
+            bool isRed() const
+            { return _red; }
+
+            bool isBlack() const
+            { return !_red; }
+
+        public:
+            /** \brief Одиночный красный узел с элементом из \c args (открыт для аллокатора). */
+            template<typename... Args>
+            explicit Node(Args &&... args)
+                    : _key(std::forward<Args>(args)...), _left(nullptr), _right(nullptr), _refs(1), _red(true)
+            {}
+
+        protected:
+            Element _key;
+            Node *_left;
+            Node *_right;
+            std::atomic<std::size_t> _refs;          ///< Сколько ссылок (отцов и корней версий) на узел.
+            bool _red;
+        }; // class PersistentRBTree::Node
+
+        typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Node> NodeAllocator;
+        typedef std::allocator_traits<NodeAllocator> NodeAllocTraits;
+
+        /** \brief Предел высоты дерева: 2·log2(n + 1) при n, умещающемся в size_t. */
+        static const std::size_t MAX_HEIGHT = 2 * 8 * sizeof(std::size_t);
+
+    public:
+        explicit PersistentRBTree(const Compar &compar = Compar(), const Allocator &alloc = Allocator())
+                : _compar(compar), _nodeAlloc(alloc), _root(nullptr), _count(0)
+        {}
+
+        /** \brief Новая версия, совпадающая с \c other: одна ссылка на его корень, O(1). */
+        PersistentRBTree(const PersistentRBTree &other)
+                : _compar(other._compar), _nodeAlloc(other._nodeAlloc), _root(other._root), _count(other._count)
+        { addRef(_root); }
+
+        PersistentRBTree(PersistentRBTree &&other)
+                : _compar(other._compar), _nodeAlloc(other._nodeAlloc), _root(other._root), _count(other._count)
+        {
+            other._root = nullptr;
+            other._count = 0;
+        }
+
+        PersistentRBTree &operator=(const PersistentRBTree &other)
+        {
+            addRef(other._root);
+            release(_root);
+            _compar = other._compar;
+            _nodeAlloc = other._nodeAlloc;
+            _root = other._root;
+            _count = other._count;
+            return *this;
+        }
+
+        PersistentRBTree &operator=(PersistentRBTree &&other)
+        {
+            if (this != &other)
+            {
+                release(_root);
+                _compar = other._compar;
+                _nodeAlloc = other._nodeAlloc;
+                _root = other._root;
+                _count = other._count;
+                other._root = nullptr;
+                other._count = 0;
+            }
+            return *this;
+        }
+
+        /** \brief Отпускает корень; узлы, больше не нужные ни одной версии, освобождаются. */
+        ~PersistentRBTree()
+        { release(_root); }
+
+    public:
+        /** \brief Неизменяемая на время жизни версия, равная текущей. O(1). */
+        PersistentRBTree snapshot() const
+        { return PersistentRBTree(*this); }
+
+        /** \brief Вставляет \c key, если эквивалентного ему нет. Копирует только разделяемые узлы пути.
+         *  \returns признак того, что вставка состоялась.
+         */
+        bool tryInsert(const Element &key)
+        {
+            if (find(key))
+                return false;
+
+            Node **path[MAX_HEIGHT + 2];
+            std::size_t d = 0;
+            path[0] = &_root;
+            while (*path[d])
+            {
+                Node *nd = own(*path[d]);
+                path[d + 1] = _compar(key, nd->_key) ? &nd->_left : &nd->_right;
+                ++d;
+            }
+
+            *path[d] = createNode(key);
+            ++_count;
+            rebalanceInsert(path, d);
+            return true;
+        }
+
+        /** \brief Удаляет элемент, эквивалентный \c key, если он есть. \returns признак того, что он был. */
+        bool tryRemove(const Element &key)
+        {
+            if (!find(key))
+                return false;
+
+            Node **path[MAX_HEIGHT + 3];
+            std::size_t d = 0;
+            path[0] = &_root;
+            while (true)
+            {
+                Node *nd = own(*path[d]);
+                if (_compar(key, nd->_key))
+                    path[d + 1] = &nd->_left;
+                else if (_compar(nd->_key, key))
+                    path[d + 1] = &nd->_right;
+                else
+                    break;
+                ++d;
+            }
+
+            unlink(path, d);
+            --_count;
+            return true;
+        }
+
+        /** \brief Удаляет все элементы этой версии; снимки не затрагиваются. */
+        void clear()
+        {
+            release(_root);
+            _root = nullptr;
+            _count = 0;
+        }
+
+    public:
+        /** \brief Элемент, эквивалентный \c key, или nullptr. Указатель годен, пока жива версия. */
+        const Element *find(const Element &key) const
+        {
+            const Node *cur = _root;
+            while (cur)
+            {
+                if (_compar(key, cur->_key))
+                    cur = cur->_left;
+                else if (_compar(cur->_key, key))
+                    cur = cur->_right;
+                else
+                    return &cur->_key;
+            }
+            return nullptr;
+        }
+
+        bool contains(const Element &key) const
+        { return find(key) != nullptr; }
+
+        std::size_t size() const
+        { return _count; }
+
+        bool isEmpty() const
+        { return !_root; }
+
+        /** \brief Вызывает \c visitor(elem) для всех элементов по возрастанию. */
+        template<typename Visitor>
+        void forEach(Visitor visitor) const
+        {
+            const Node *stack[MAX_HEIGHT + 1];
+            std::size_t top = 0;
+            const Node *cur = _root;
+            while (cur || top)
+            {
+                for (; cur; cur = cur->_left)
+                    stack[top++] = cur;
+
+                cur = stack[--top];
+                visitor(cur->_key);
+                cur = cur->_right;
+            }
+        }
+
+        /** \brief Вызывает \c visitor(elem) для элементов из [lo, hi) по возрастанию за O(log n + k). */
+        template<typename Visitor>
+        void forEachInRange(const Element &lo, const Element &hi, Visitor visitor) const
+        {
+            // Стек хранит только узлы не меньше lo: левее них спуск уже не нужен
+            const Node *stack[MAX_HEIGHT + 1];
+            std::size_t top = 0;
+            const Node *cur = _root;
+            while (cur || top)
+            {
+                while (cur)
+                    if (_compar(cur->_key, lo))
+                        cur = cur->_right;
+                    else
+                    {
+                        stack[top++] = cur;
+                        cur = cur->_left;
+                    }
+
+                if (!top)
+                    break;
+
+                cur = stack[--top];
+                if (!_compar(cur->_key, hi))
+                    break;
+
+                visitor(cur->_key);
+                cur = cur->_right;
+            }
+        }
+
+        /** \brief Корень версии, для отладки и проверок. */
+        const Node *getRoot() const
+        { return _root; }
+
+        Allocator getAllocator() const
+        { return Allocator(_nodeAlloc); }
+
+    protected:
+        template<typename... Args>
+        Node *createNode(Args &&... args)
+        {
+            Node *nd = NodeAllocTraits::allocate(_nodeAlloc, 1);
+            try
+            {
+                NodeAllocTraits::construct(_nodeAlloc, nd, std::forward<Args>(args)...);
+            }
+            catch (...)
+            {
+                NodeAllocTraits::deallocate(_nodeAlloc, nd, 1);
+                throw;
+            }
+            return nd;
+        }
+
+        void destroyNode(Node *nd)
+        {
+            NodeAllocTraits::destroy(_nodeAlloc, nd);
+            NodeAllocTraits::deallocate(_nodeAlloc, nd, 1);
+        }
+
+        static void addRef(Node *nd)
+        {
+            if (nd)
+                nd->_refs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /** \brief Отпускает ссылку на \c nd; освобождает узлы, на которые ссылок не осталось. Без рекурсии. */
+        void release(Node *nd)
+        {
+            std::vector<Node *> pending;
+            while (true)
+            {
+                if (nd && nd->_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    if (nd->_right)
+                        pending.push_back(nd->_right);
+                    Node *left = nd->_left;
+                    destroyNode(nd);
+                    nd = left;
+                    continue;
+                }
+
+                if (pending.empty())
+                    break;
+                nd = pending.back();
+                pending.pop_back();
+            }
+        }
+
+        /** \brief Делает узел в поле \c slot исключительной собственностью версии и возвращает его.
+         *
+         *  Поле должно принадлежать узлу, который уже исключительно наш (или быть \c _root). Если на узел
+         *  ссылается кто-то еще, в поле кладется его копия, а с оригинала снимается наша ссылка.
+         */
+        Node *own(Node *&slot)
+        {
+            Node *nd = slot;
+            if (nd->_refs.load(std::memory_order_acquire) == 1)
+                return nd;
+
+            Node *copy = createNode(nd->_key);
+            copy->_red = nd->_red;
+            copy->_left = nd->_left;
+            copy->_right = nd->_right;
+            addRef(copy->_left);
+            addRef(copy->_right);
+
+            slot = copy;
+            release(nd);
+            return copy;
+        }
+
+        static bool isRed(const Node *nd)
+        { return nd && nd->_red; }
+
+        /** \brief Левый поворот поддерева в поле \c slot; оба узла должны быть нашими. */
+        static void rotLeft(Node *&slot)
+        {
+            Node *x = slot;
+            Node *y = x->_right;
+            x->_right = y->_left;
+            y->_left = x;
+            slot = y;
+        }
+
+        /** \brief Правый поворот поддерева в поле \c slot; оба узла должны быть нашими. */
+        static void rotRight(Node *&slot)
+        {
+            Node *x = slot;
+            Node *y = x->_left;
+            x->_left = y->_right;
+            y->_right = x;
+            slot = y;
+        }
+
+        /** \brief Перебалансировка после вставки красного узла в поле \c path[d]. Все узлы пути — наши. */
+        void rebalanceInsert(Node **path[], std::size_t d)
+        {
+            while (d >= 2)
+            {
+                Node *nd = *path[d];
+                Node *dad = *path[d - 1];
+                if (!dad->_red)
+                    break;
+
+                Node *grandpa = *path[d - 2];
+                bool dadIsLeft = grandpa->_left == dad;
+                Node *&uncleSlot = dadIsLeft ? grandpa->_right : grandpa->_left;
+
+                // Красный дядя: перекрашиваем и поднимаемся на два уровня
+                if (isRed(uncleSlot))
+                {
+                    own(uncleSlot)->_red = false;
+                    dad->_red = false;
+                    grandpa->_red = true;
+                    d -= 2;
+                    continue;
+                }
+
+                // Черный дядя: один или два поворота, и на этом все
+                if (dadIsLeft)
+                {
+                    if (dad->_right == nd)
+                        rotLeft(*path[d - 1]);
+                    rotRight(*path[d - 2]);
+                }
+                else
+                {
+                    if (dad->_left == nd)
+                        rotRight(*path[d - 1]);
+                    rotLeft(*path[d - 2]);
+                }
+
+                (*path[d - 2])->_red = false;
+                grandpa->_red = true;
+                break;
+            }
+
+            _root->_red = false;
+        }
+
+        /** \brief Вынимает из дерева узел в поле \c path[d] и перебалансирует. Узлы пути — наши.
+         *
+         *  Узел с двумя детьми заменяется преемником: сам узел-преемник переезжает на его место, так что
+         *  элементы не копируются и не перемещаются.
+         */
+        void unlink(Node **path[], std::size_t d)
+        {
+            Node *del = *path[d];
+            bool removedRed;
+
+            if (!del->_left || !del->_right)
+            {
+                removedRed = del->_red;
+                *path[d] = del->_left ? del->_left : del->_right;
+            }
+            else
+            {
+                // Спуск к преемнику тоже делает узлы нашими: перебалансировка пойдет от его места
+                std::size_t delDepth = d;
+                path[++d] = &del->_right;
+                while (own(*path[d])->_left)
+                {
+                    path[d + 1] = &(*path[d])->_left;
+                    ++d;
+                }
+
+                Node *succ = *path[d];
+                removedRed = succ->_red;
+                *path[d] = succ->_right;
+
+                succ->_left = del->_left;
+                succ->_right = del->_right;
+                succ->_red = del->_red;
+                *path[delDepth] = succ;
+
+                // Поле, через которое путь шел из удаляемого узла, теперь принадлежит преемнику
+                path[delDepth + 1] = &succ->_right;
+            }
+
+            // Ссылки на детей перешли к другим узлам, так что освобождаем только сам узел
+            del->_left = del->_right = nullptr;
+            release(del);
+
+            if (!removedRed)
+                rebalanceRemove(path, d);
+        }
+
+        /** \brief Перебалансировка после удаления черного узла: в поддереве \c path[d] не хватает черного. */
+        void rebalanceRemove(Node **path[], std::size_t d)
+        {
+            while (d > 0 && !isRed(*path[d]))
+            {
+                Node *dad = *path[d - 1];
+                bool isLeft = path[d] == &dad->_left;
+                Node *bro = own(isLeft ? dad->_right : dad->_left);
+
+                // Красный брат: поворотом делаем братом его черного ребенка, а отец спускается на уровень
+                if (bro->_red)
+                {
+                    bro->_red = false;
+                    dad->_red = true;
+                    if (isLeft)
+                        rotLeft(*path[d - 1]);
+                    else
+                        rotRight(*path[d - 1]);
+
+                    path[d] = isLeft ? &bro->_left : &bro->_right;
+                    path[d + 1] = isLeft ? &dad->_left : &dad->_right;
+                    ++d;
+                    bro = own(isLeft ? dad->_right : dad->_left);
+                }
+
+                Node *&nearSlot = isLeft ? bro->_left : bro->_right;
+                Node *&farSlot = isLeft ? bro->_right : bro->_left;
+
+                // Оба племянника черные: брат краснеет, нехватка поднимается к отцу
+                if (!isRed(nearSlot) && !isRed(farSlot))
+                {
+                    bro->_red = true;
+                    --d;
+                    continue;
+                }
+
+                // Красный только ближний племянник: поворотом делаем его братом
+                Node *&broSlot = isLeft ? dad->_right : dad->_left;
+                if (!isRed(farSlot))
+                {
+                    own(nearSlot)->_red = false;
+                    bro->_red = true;
+                    if (isLeft)
+                        rotRight(broSlot);
+                    else
+                        rotLeft(broSlot);
+                    bro = broSlot;
+                }
+
+                // Красный дальний племянник: поворот вокруг отца восстанавливает черную высоту
+                Node *&far = isLeft ? bro->_right : bro->_left;
+                bro->_red = dad->_red;
+                dad->_red = false;
+                own(far)->_red = false;
+                if (isLeft)
+                    rotLeft(*path[d - 1]);
+                else
+                    rotRight(*path[d - 1]);
+                return;
+            }
+
+            if (*path[d])
+                own(*path[d])->_red = false;
+        }
+
+    protected:
+        Compar _compar;                              ///< Компаратор элементов.
+        NodeAllocator _nodeAlloc;                    ///< Аллокатор узлов.
+        Node *_root;                                 ///< Корень версии; версия держит на него одну ссылку.
+        std::size_t _count;                          ///< Число элементов версии.
+    }; // class PersistentRBTree
+
+
+} // namespace xi
+
+
+#endif // XI_RBPERSISTENT_H
@@ -0,0 +1,194 @@
+﻿////////////////////////////////////////////////////////////////////////////////
+/// \file
+/// \brief     Теоретико-множественные операции над RBTree с параллельной рекурсией
+/// \author    Kupchenko Viktor
+/// \version   0.1.0
+/// \date      01.05.2017
+///            This is a part of the course "Algorithms and Data Structures"
+///            provided by  the School of Software Engineering of the Faculty
+///            of Computer Science at the Higher School of Economics.
+///
+/// Определения RBTree::unionWith(), intersectWith() и differenceWith() вынесены
+/// сюда, чтобы rbtree.h не тянул за собой пул потоков (<thread>, <mutex>,
+/// <condition_variable>): он нужен только тем, кто пользуется этими операциями.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef XI_RBSETOPS_H
+#define XI_RBSETOPS_H
+
+#include <cstddef>          // std::size_t
+#include <stdexcept>        // std::invalid_argument
+#include <utility>          // std::move
+
+#include "rbtree.h"
+#include "threadpool.h"     // xi::WorkStealingPool
+
+
+namespace xi
+{
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::unionWith(RBTree &&other, WorkStealingPool *pool, std::size_t grain)
+    {
+        combineWith(SO_UNION, std::move(other), pool, grain);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::intersectWith(RBTree &&other, WorkStealingPool *pool, std::size_t grain)
+    {
+        combineWith(SO_INTERSECTION, std::move(other), pool, grain);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::differenceWith(RBTree &&other, WorkStealingPool *pool, std::size_t grain)
+    {
+        combineWith(SO_DIFFERENCE, std::move(other), pool, grain);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::combineWith(SetOperation op, RBTree &&other, WorkStealingPool *pool,
+                                                                 std::size_t grain)
+    {
+        if (!(_nodeAlloc == other._nodeAlloc))
+            throw std::invalid_argument("Can't combine trees with different allocators!");
+
+        // Дерево с самим собой: объединение и пересечение ничего не меняют
+        if (this == &other)
+        {
+            if (op == SO_DIFFERENCE)
+                clear();
+            return;
+        }
+
+        // Поддерево черной высоты b содержит не меньше 2^b - 1 узлов: ищем первую высоту, где это больше grain
+        std::size_t forkBh = (std::size_t) -1;
+        if (pool && pool->getWorkerCount())
+            for (forkBh = 0; forkBh < sizeof(std::size_t) * 8 - 1 && (std::size_t(1) << forkBh) <= grain; ++forkBh)
+                ;
+
+        Node *t1 = _root;
+        Node *t2 = other._root;
+        std::size_t total = addSizes(getCount(), other.getCount());
+        _root = nullptr;
+        other.resetRoot(nullptr, 0);
+
+        // Рекурсия портит _root рабочего дерева, так что свой дампер она не дергает
+        RBTree work(_compar, _nodeAlloc, SiblingTag());
+        NodeList garbage;
+        std::size_t bh;
+        Node *res = work.combineNodes(op, t1, blackHeight(t1), t2, blackHeight(t2), bh, garbage, pool, forkBh);
+        work._root = nullptr;
+        mergeStats(work);
+
+        if (res)
+        {
+            res->_parent = nullptr;
+            res->setBlack();
+        }
+        // Каждый узел обоих деревьев попал либо в результат, либо в мусор — размер сходится по мусору
+        resetRoot(res, total);
+
+        // Лишние узлы освобождаем уже здесь, в одном потоке
+        for (Node *nd = garbage.head; nd;)
+        {
+            Node *next = nd->_parent;
+            std::size_t freed = destroySubtree(nd);
+            if (getCount() != UNKNOWN_SIZE)
+                setCount(getCount() - freed);
+            nd = next;
+        }
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    typename RBTree<Element, Compar, Allocator, Dumper>::Node *
+    RBTree<Element, Compar, Allocator, Dumper>::combineNodes(SetOperation op, Node *t1, std::size_t bh1,
+                                                             Node *t2, std::size_t bh2, std::size_t &bh,
+                                                             NodeList &garbage, WorkStealingPool *pool, std::size_t forkBh)
+    {
+        // Одно из поддеревьев пусто: результат — второе поддерево или пустота
+        if (!t1 || !t2)
+        {
+            if (op == SO_UNION)
+            {
+                bh = t1 ? bh1 : bh2;
+                return t1 ? t1 : t2;
+            }
+
+            garbage.push(t2);
+            if (op == SO_DIFFERENCE)
+            {
+                bh = bh1;
+                return t1;
+            }
+
+            garbage.push(t1);
+            bh = 0;
+            return nullptr;
+        }
+
+        // Корень t1 отрываем от детей, t2 режем по его ключу
+        Node *l1 = t1->_left;
+        Node *r1 = t1->_right;
+        std::size_t childBh = bh1 - (t1->isBlack() ? 1 : 0);
+
+        if (l1)
+            l1->_parent = nullptr;
+        if (r1)
+            r1->_parent = nullptr;
+        t1->_left = t1->_right = nullptr;
+
+        Node *l2, *r2, *mid = nullptr;
+        std::size_t bhL2, bhR2;
+        splitNodes(t2, bh2, t1->_key, l2, bhL2, r2, bhR2, mid);
+
+        // Эквивалентный узел из t2 не нужен ни одной операции: ключ, если он выживет, несет t1
+        garbage.push(mid);
+
+        Node *l, *r;
+        std::size_t bhL, bhR;
+        if (childBh >= forkBh)
+        {
+            // Правую ветвь отдаем пулу со своим рабочим деревом и своим списком мусора
+            NodeList rightGarbage;
+            pool->invoke(
+                    [&]()
+                    {
+                        l = combineNodes(op, l1, childBh, l2, bhL2, bhL, garbage, pool, forkBh);
+                    },
+                    [&]()
+                    {
+                        RBTree work(_compar, _nodeAlloc, SiblingTag());
+                        r = work.combineNodes(op, r1, childBh, r2, bhR2, bhR, rightGarbage, pool, forkBh);
+                        work._root = nullptr;
+
+                        // Счетчики атомарные, так что ветви сливают их в общее рабочее дерево без блокировок
+                        mergeStats(work);
+                    });
+            garbage.splice(rightGarbage);
+        }
+        else
+        {
+            l = combineNodes(op, l1, childBh, l2, bhL2, bhL, garbage, pool, forkBh);
+            r = combineNodes(op, r1, childBh, r2, bhR2, bhR, garbage, pool, forkBh);
+        }
+
+        // Корень t1 остается в объединении всегда, в пересечении — если нашелся в t2, в разности — если нет
+        bool keep = (op == SO_UNION) || ((op == SO_INTERSECTION) == (mid != nullptr));
+        if (keep)
+            return joinNodes(l, bhL, t1, r, bhR, bh);
+
+        garbage.push(t1);
+        return concatNodes(l, bhL, r, bhR, bh);
+    }
+
+
+} // namespace xi
+
+
+#endif // XI_RBSETOPS_H
@@ -0,0 +1,570 @@
+﻿////////////////////////////////////////////////////////////////////////////////
+/// \file
+/// \brief     Дерево, разбитое по диапазонам ключей на независимо блокируемые части
+/// \author    Kupchenko Viktor
+/// \version   0.1.0
+/// \date      01.05.2017
+///            This is a part of the course "Algorithms and Data Structures"
+///            provided by  the School of Software Engineering of the Faculty
+///            of Computer Science at the Higher School of Economics.
+///
+/// Пространство ключей делится границами на полуинтервалы, и каждый хранится в
+/// своем xi::RBTree (шарде) со своим мьютексом. Писатели в разные шарды друг
+/// другу не мешают. Границы читаются без блокировок из неизменяемой раскладки
+/// (Layout); при смене раскладки старая освобождается по эпохам (xi::EpochManager),
+/// а каждый шард хранит свой полуинтервал сам, так что поток, пришедший по
+/// устаревшей раскладке, под мьютексом шарда это обнаружит и пойдет заново.
+///
+/// Поначалу все ключи лежат в одном шарде. Когда их набирается достаточно,
+/// границы выбираются по выборке ключей (repartition()), а дальше соседние
+/// шарды выравниваются при перекосе: лишняя часть большего отрезается split()
+/// и приклеивается к меньшему join() — за O(log n) плюс проход до новой границы.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef XI_RBSHARDED_H
+#define XI_RBSHARDED_H
+
+#include <algorithm>        // std::sort, std::upper_bound
+#include <atomic>
+#include <cstddef>          // std::size_t
+#include <cstdint>          // std::uint64_t
+#include <functional>       // std::less
+#include <iterator>         // std::next, std::prev
+#include <memory>           // std::allocator, std::unique_ptr
+#include <mutex>
+#include <utility>          // std::pair
+#include <vector>
+
+#include "rbconcurrent.h"   // xi::EpochManager
+#include "rbtree.h"
+
+
+namespace xi
+{
+
+
+/** \brief Упорядоченное множество из нескольких красно-черных деревьев с раздельными блокировками.
+ *
+ *  Операции над одним ключом блокируют только его шард. Обход и запросы по диапазону блокируют
+ *  задетые шарды по возрастанию и видят их согласованный срез.
+ *
+ *  \tparam Element Тип элементов; копируется в границы шардов.
+ *  \tparam Compar Компаратор, как у \c RBTree.
+ *  \tparam Allocator Аллокатор, как у \c RBTree. Шарды пользуются его копиями одновременно из разных
+ *  потоков, а при перераспределении склеиваются, поэтому копии (после \c rebind) должны быть равны
+ *  и потокобезопасны — как \c std::allocator.
+ */
+    template<typename Element, typename Compar = std::less<Element>, typename Allocator = std::allocator<Element> >
+    class ShardedRBTree
+    {
+    public:
+        typedef RBTree<Element, Compar, Allocator> Tree;
+
+        /** \brief Число шардов по умолчанию. */
+        static const std::size_t DEFAULT_SHARDS = 64;
+
+        /** \brief Во сколько раз шард может превышать соседа, прежде чем их выровняют. */
+        static const std::size_t SKEW_FACTOR = 2;
+
+        /** \brief Перекос меньше этого числа элементов не выравнивается вовсе. */
+        static const std::size_t SKEW_SLACK = 1024;
+
+        /** \brief Раз в сколько изменений шард проверяет перекос с соседями. */
+        static const std::size_t CHECK_PERIOD = 256;
+
+        /** \brief Сколько ключей берется в выборку на каждый шард при выборе границ. */
+        static const std::size_t SAMPLES_PER_SHARD = 16;
+
+    public:
+        /** \brief Создает \c shards шардов (не меньше одного); пока границы не выбраны, работает первый. */
+        explicit ShardedRBTree(std::size_t shards = DEFAULT_SHARDS, const Compar &compar = Compar(),
+                               const Allocator &alloc = Allocator())
+                : _compar(compar), _layout(new Layout), _rebalances(0)
+        {
+            if (!shards)
+                shards = 1;
+
+            for (std::size_t i = 0; i < shards; ++i)
+                _shards.push_back(std::unique_ptr<Shard>(new Shard(compar, alloc)));
+            _shards[0]->active = true;
+        }
+
+        /** \brief Освобождает шарды и раскладки. Других потоков в этот момент быть не должно. */
+        ~ShardedRBTree()
+        {
+            delete _layout.load(std::memory_order_relaxed);
+            for (std::size_t i = 0; i < _retired.size(); ++i)
+                delete _retired[i].first;
+        }
+
+    public:
+        // Операции над одним ключом
+
+        /** \brief Вставляет \c key, если эквивалентного ему нет. \returns признак того, что вставка состоялась. */
+        bool tryInsert(const Element &key)
+        {
+            std::size_t idx;
+            bool inserted, check = false;
+            {
+                std::unique_lock<std::mutex> lock;
+                Shard &s = lockOwner(key, lock, idx);
+                inserted = s.tree.tryInsert(key).second;
+                if (inserted)
+                {
+                    s.count.store(s.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    check = s.tick();
+                }
+            }
+
+            // Перекос проверяется уже без блокировки шарда, чтобы не держать ее во время переноса
+            if (check)
+                maybeRebalance(idx);
+            return inserted;
+        }
+
+        /** \brief Удаляет элемент, эквивалентный \c key, если он есть. \returns признак того, что он был. */
+        bool tryRemove(const Element &key)
+        {
+            std::size_t idx;
+            bool removed, check = false;
+            {
+                std::unique_lock<std::mutex> lock;
+                Shard &s = lockOwner(key, lock, idx);
+                removed = s.tree.find(key) != nullptr;
+                if (removed)
+                {
+                    s.tree.remove(key);
+                    s.count.store(s.count.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+                    check = s.tick();
+                }
+            }
+
+            if (check)
+                maybeRebalance(idx);
+            return removed;
+        }
+
+        /** \brief Есть ли элемент, эквивалентный \c key. */
+        bool contains(const Element &key) const
+        {
+            std::size_t idx;
+            std::unique_lock<std::mutex> lock;
+            return lockOwner(key, lock, idx).tree.find(key) != nullptr;
+        }
+
+        /** \brief Число элементов. Во время параллельных изменений — приблизительное. */
+        std::size_t size() const
+        {
+            std::size_t res = 0;
+            for (std::size_t i = 0; i < _shards.size(); ++i)
+                res += _shards[i]->count.load(std::memory_order_relaxed);
+            return res;
+        }
+
+        /** \brief Пусто ли множество (с той же оговоркой, что и \c size()). */
+        bool isEmpty() const
+        { return size() == 0; }
+
+    public:
+        // Обход
+
+        /** \brief Вызывает \c visitor(elem) для всех элементов по возрастанию. Блокирует все шарды на время обхода. */
+        template<typename Visitor>
+        void forEach(Visitor visitor) const
+        {
+            std::vector<std::unique_lock<std::mutex> > locks;
+            lockRange(0, _shards.size(), locks);
+
+            for (std::size_t i = 0; i < _shards.size(); ++i)
+                if (_shards[i]->active)
+                    for (typename Tree::const_iterator it = _shards[i]->tree.begin(); it != _shards[i]->tree.end(); ++it)
+                        visitor(*it);
+        }
+
+        /** \brief Вызывает \c visitor(elem) для элементов из [lo, hi) по возрастанию.
+         *
+         *  Блокируются только шарды, которые пересекаются с диапазоном, в порядке их номеров.
+         */
+        template<typename Visitor>
+        void forEachInRange(const Element &lo, const Element &hi, Visitor visitor) const
+        {
+            if (!_compar(lo, hi))
+                return;
+
+            while (true)
+            {
+                std::pair<std::size_t, std::size_t> span = routeRange(lo, hi);
+                std::vector<std::unique_lock<std::mutex> > locks;
+                lockRange(span.first, span.second + 1, locks);
+
+                // Раскладка могла смениться: соседние шарды смыкаются, так что достаточно проверить края
+                const Shard &first = *_shards[span.first];
+                const Shard &last = *_shards[span.second];
+                if (!first.owns(lo, _compar) || !last.active || (last.hi && _compar(*last.hi, hi)))
+                    continue;
+
+                for (std::size_t i = span.first; i <= span.second; ++i)
+                    _shards[i]->tree.forEachInRange(lo, hi, visitor);
+                return;
+            }
+        }
+
+        /** \brief Число элементов из [lo, hi). */
+        std::size_t countInRange(const Element &lo, const Element &hi) const
+        {
+            std::size_t res = 0;
+            forEachInRange(lo, hi, [&res](const Element &) { ++res; });
+            return res;
+        }
+
+    public:
+        // Раскладка
+
+        /** \brief Выбирает границы шардов по квантилям выборки [first, last) и перераспределяет элементы.
+         *
+         *  Все шарды склеиваются в одно дерево и разрезаются по новым границам: O(k log n) на
+         *  склейки и разрезы плюс пересчет размеров частей (O(n), а с RBTREE_WITH_ORDER_STATISTICS — O(1)).
+         *  Блокирует все шарды.
+         */
+        template<typename InputIt>
+        void repartition(InputIt first, InputIt last)
+        {
+            std::vector<Element> sample(first, last);
+            std::lock_guard<std::mutex> guard(_rebalanceLock);
+
+            std::vector<std::unique_lock<std::mutex> > locks;
+            lockRange(0, _shards.size(), locks);
+            applyBounds(pickBounds(sample));
+        }
+
+        /** \brief То же, но выборка берется из текущего содержимого с равным шагом. */
+        void repartition()
+        {
+            std::lock_guard<std::mutex> guard(_rebalanceLock);
+
+            std::vector<std::unique_lock<std::mutex> > locks;
+            lockRange(0, _shards.size(), locks);
+            applyBounds(pickBounds(sampleContents()));
+        }
+
+        /** \brief Число шардов. */
+        std::size_t getShardCount() const
+        { return _shards.size(); }
+
+        /** \brief Число элементов в шарде \c i (приблизительное во время изменений). */
+        std::size_t getShardSize(std::size_t i) const
+        { return _shards[i]->count.load(std::memory_order_relaxed); }
+
+        /** \brief Сколько раз выравнивались соседние шарды. */
+        std::size_t getRebalanceCount() const
+        { return _rebalances.load(std::memory_order_relaxed); }
+
+    protected:
+        /** \brief Шард: дерево, его мьютекс и полуинтервал [lo, hi) ключей, которые ему принадлежат. */
+        struct alignas(64) Shard
+        {
+            mutable std::mutex lock;
+            Tree tree;
+            std::atomic<std::size_t> count;          ///< Число элементов; пишется под \c lock.
+            std::size_t sinceCheck;                  ///< Изменений после последней проверки перекоса.
+            std::unique_ptr<Element> lo;             ///< Нижняя граница (включительно) или nullptr — нет границы.
+            std::unique_ptr<Element> hi;             ///< Верхняя граница (не включительно) или nullptr.
+            bool active;                             ///< Участвует ли шард в раскладке.
+
+            Shard(const Compar &compar, const Allocator &alloc)
+                    : tree(compar, alloc), count(0), sinceCheck(0), active(false)
+            {}
+
+            /** \brief Принадлежит ли \c key этому шарду. Вызывается под \c lock. */
+            bool owns(const Element &key, const Compar &compar) const
+            { return active && (!lo || !compar(key, *lo)) && (!hi || compar(key, *hi)); }
+
+            /** \brief Отмечает изменение. \returns истину раз в \c CHECK_PERIOD изменений. */
+            bool tick()
+            {
+                if (++sinceCheck < CHECK_PERIOD)
+                    return false;
+
+                sinceCheck = 0;
+                return true;
+            }
+        };
+
+        /** \brief Неизменяемая раскладка: границы между активными шардами по возрастанию. */
+        struct Layout
+        {
+            std::vector<Element> bounds;             ///< bounds[i] — нижняя граница шарда i + 1.
+
+            /** \brief Номер шарда, которому по этой раскладке принадлежит \c key. */
+            std::size_t route(const Element &key, const Compar &compar) const
+            { return std::upper_bound(bounds.begin(), bounds.end(), key, compar) - bounds.begin(); }
+        };
+
+    protected:
+        /** \brief Находит шард ключа \c key и блокирует его, сверяясь с полуинтервалом самого шарда. */
+        Shard &lockOwner(const Element &key, std::unique_lock<std::mutex> &lock, std::size_t &idx) const
+        {
+            while (true)
+            {
+                std::size_t slot = _epochs.enter();
+                idx = _layout.load(std::memory_order_acquire)->route(key, _compar);
+                _epochs.leave(slot);
+
+                Shard &s = *_shards[idx];
+                lock = std::unique_lock<std::mutex>(s.lock);
+                if (s.owns(key, _compar))
+                    return s;
+
+                // Раскладку сменили, пока мы шли к шарду
+                lock.unlock();
+            }
+        }
+
+        /** \brief Номера первого и последнего шардов, задетых диапазоном [lo, hi), по текущей раскладке. */
+        std::pair<std::size_t, std::size_t> routeRange(const Element &lo, const Element &hi) const
+        {
+            std::size_t slot = _epochs.enter();
+            const Layout *layout = _layout.load(std::memory_order_acquire);
+
+            std::size_t first = layout->route(lo, _compar);
+            std::size_t last = std::lower_bound(layout->bounds.begin(), layout->bounds.end(), hi, _compar) -
+                               layout->bounds.begin();
+            _epochs.leave(slot);
+
+            return std::make_pair(first, last < first ? first : last);
+        }
+
+        /** \brief Блокирует шарды [from, to) по возрастанию номеров — в том же порядке, что и все. */
+        void lockRange(std::size_t from, std::size_t to, std::vector<std::unique_lock<std::mutex> > &locks) const
+        {
+            locks.reserve(to - from);
+            for (std::size_t i = from; i < to; ++i)
+                locks.push_back(std::unique_lock<std::mutex>(_shards[i]->lock));
+        }
+
+        /** \brief Выравнивает шард \c idx с соседями, если перекос велик, а выравниванием никто не занят. */
+        void maybeRebalance(std::size_t idx)
+        {
+            std::unique_lock<std::mutex> guard(_rebalanceLock, std::try_to_lock);
+            if (!guard.owns_lock())
+                return;
+
+            std::size_t active = _layout.load(std::memory_order_relaxed)->bounds.size() + 1;
+
+            // Пока шард один, выравнивать не с кем: как только ключей хватит, выбираем границы
+            if (active == 1 && _shards.size() > 1)
+            {
+                if (getShardSize(0) >= _shards.size() * SKEW_SLACK)
+                {
+                    std::vector<std::unique_lock<std::mutex> > locks;
+                    lockRange(0, _shards.size(), locks);
+                    applyBounds(pickBounds(sampleContents()));
+                }
+                return;
+            }
+
+            if (idx >= active)
+                return;
+            if (!(idx > 0 && isSkewed(idx - 1, idx)) && !(idx + 1 < active && isSkewed(idx, idx + 1)))
+                return;
+
+            /* Перенос между соседями сдвигает перекос дальше (например, при вставках по возрастанию все
+             * копится в последнем шарде), поэтому проходим по всем парам, пока перекосы не кончатся,
+             * но не больше, чем число шардов раз */
+            for (std::size_t pass = 0; pass < active; ++pass)
+            {
+                bool moved = false;
+                for (std::size_t i = 0; i + 1 < active; ++i)
+                    if (isSkewed(i, i + 1))
+                    {
+                        rebalancePair(i);
+                        moved = true;
+                    }
+
+                if (!moved)
+                    break;
+            }
+        }
+
+        bool isSkewed(std::size_t a, std::size_t b) const
+        {
+            std::size_t ca = getShardSize(a), cb = getShardSize(b);
+            return ca > SKEW_FACTOR * cb + SKEW_SLACK || cb > SKEW_FACTOR * ca + SKEW_SLACK;
+        }
+
+        /** \brief Переносит половину разницы между шардами \c i и \c i + 1 из большего в меньший.
+         *
+         *  Новая граница \c p находится проходом от края большего дерева, затем большее дерево
+         *  режется по \c p (\c splitFrom(): \c p уходит вместе с большими), а отрезанная часть
+         *  приклеивается к меньшему. Ни разрез, ни склейка без разделителя память не выделяют,
+         *  так что шард не может остаться перенесенным наполовину. Вызывается под \c _rebalanceLock.
+         */
+        void rebalancePair(std::size_t i)
+        {
+            Shard &left = *_shards[i];
+            Shard &right = *_shards[i + 1];
+            std::unique_lock<std::mutex> lockLeft(left.lock);
+            std::unique_lock<std::mutex> lockRight(right.lock);
+
+            std::size_t a = left.count.load(std::memory_order_relaxed);
+            std::size_t b = right.count.load(std::memory_order_relaxed);
+            if (a == b)
+                return;
+
+            std::size_t moved = (a > b ? a - b : b - a) / 2;
+            if (!moved)
+                return;
+
+            // Все, что выделяет память, — до разреза: дальше исключениям взяться неоткуда
+            Element p = a > b ? *std::prev(left.tree.end(), (std::ptrdiff_t) moved)
+                              : *std::next(right.tree.begin(), (std::ptrdiff_t) moved);
+            std::unique_ptr<Element> hi(new Element(p)), lo(new Element(p));
+            std::unique_ptr<Layout> layout(new Layout(*_layout.load(std::memory_order_relaxed)));
+            layout->bounds[i] = p;
+            _retired.reserve(_retired.size() + 1);
+
+            if (a > b)
+            {
+                // p — наименьший из переносимых: он и все большие уходят направо
+                Tree upper = left.tree.splitFrom(p);
+                right.tree = Tree::join(std::move(upper), std::move(right.tree));
+                left.count.store(a - moved, std::memory_order_relaxed);
+                right.count.store(b + moved, std::memory_order_relaxed);
+            }
+            else
+            {
+                // p — наименьший из остающихся: все меньшие уходят налево
+                Tree upper = right.tree.splitFrom(p);
+                left.tree = Tree::join(std::move(left.tree), std::move(right.tree));
+                right.tree = std::move(upper);
+                left.count.store(a + moved, std::memory_order_relaxed);
+                right.count.store(b - moved, std::memory_order_relaxed);
+            }
+
+            left.hi = std::move(hi);
+            right.lo = std::move(lo);
+            publish(layout.release());
+            _rebalances.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /** \brief Подменяет раскладку; старая освобождается, когда ее уже никто не может читать. */
+        void publish(Layout *layout)
+        {
+            Layout *old = _layout.exchange(layout, std::memory_order_acq_rel);
+            _retired.push_back(std::make_pair(old, _epochs.advance()));
+
+            std::uint64_t minActive = _epochs.getMinActive();
+            std::size_t freed = 0;
+            while (freed < _retired.size() && _retired[freed].second < minActive)
+                delete _retired[freed++].first;
+            _retired.erase(_retired.begin(), _retired.begin() + freed);
+        }
+
+        /** \brief Равномерная выборка из содержимого активных шардов. Вызывается под всеми блокировками. */
+        std::vector<Element> sampleContents() const
+        {
+            std::size_t total = 0;
+            for (std::size_t i = 0; i < _shards.size(); ++i)
+                total += _shards[i]->count.load(std::memory_order_relaxed);
+
+            std::size_t want = _shards.size() * SAMPLES_PER_SHARD;
+            std::size_t step = total > want ? total / want : 1;
+
+            std::vector<Element> sample;
+            std::size_t pos = 0;
+            for (std::size_t i = 0; i < _shards.size(); ++i)
+                for (typename Tree::const_iterator it = _shards[i]->tree.begin(); it != _shards[i]->tree.end(); ++it)
+                    if (pos++ % step == 0)
+                        sample.push_back(*it);
+            return sample;
+        }
+
+        /** \brief До (число шардов - 1) различных квантилей выборки по возрастанию. */
+        std::vector<Element> pickBounds(std::vector<Element> sample) const
+        {
+            std::sort(sample.begin(), sample.end(), _compar);
+
+            std::vector<Element> bounds;
+            std::size_t parts = _shards.size();
+            for (std::size_t k = 1; k < parts && !sample.empty(); ++k)
+            {
+                const Element &q = sample[k * sample.size() / parts];
+                if (bounds.empty() || _compar(bounds.back(), q))
+                    bounds.push_back(q);
+            }
+
+            // Граница не может совпасть с минимумом выборки, иначе первый шард заведомо пуст
+            if (!bounds.empty() && !_compar(sample.front(), bounds.front()))
+                bounds.erase(bounds.begin());
+            return bounds;
+        }
+
+        /** \brief Склеивает все шарды в одно дерево и разрезает его по \c bounds. Вызывается под всеми блокировками.
+         *
+         *  Границы и раскладка выделяются заранее, а склейки и разрезы (\c splitFrom()) память не
+         *  выделяют, так что исключение не может застать элементы в промежуточном дереве.
+         */
+        void applyBounds(const std::vector<Element> &bounds)
+        {
+            std::size_t n = _shards.size();
+            std::vector<std::unique_ptr<Element> > lo(n), hi(n);
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                if (i > 0 && i <= bounds.size())
+                    lo[i].reset(new Element(bounds[i - 1]));
+                if (i < bounds.size())
+                    hi[i].reset(new Element(bounds[i]));
+            }
+            std::unique_ptr<Layout> layout(new Layout);
+            layout->bounds = bounds;
+            _retired.reserve(_retired.size() + 1);
+
+            Tree all(std::move(_shards[0]->tree));
+            for (std::size_t i = 1; i < n; ++i)
+                all = Tree::join(std::move(all), std::move(_shards[i]->tree));
+
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                Shard &s = *_shards[i];
+                s.active = i <= bounds.size();
+                s.lo = std::move(lo[i]);
+                s.hi = std::move(hi[i]);
+
+                if (i < bounds.size())
+                {
+                    Tree rest = all.splitFrom(bounds[i]);
+                    s.tree = std::move(all);
+                    all = std::move(rest);
+                }
+                else if (s.active)
+                    s.tree = std::move(all);
+
+                s.count.store(s.tree.size(), std::memory_order_relaxed);
+                s.sinceCheck = 0;
+            }
+
+            publish(layout.release());
+        }
+
+    protected:
+        ShardedRBTree(const ShardedRBTree &);                    ///< КК не доступен.
+        ShardedRBTree &operator=(const ShardedRBTree &);         ///< Оператор присваивания недоступен.
+
+    protected:
+        Compar _compar;                                          ///< Компаратор элементов и границ.
+        std::vector<std::unique_ptr<Shard> > _shards;            ///< Шарды; активные идут первыми.
+
+        std::atomic<Layout *> _layout;                           ///< Текущая раскладка.
+        mutable EpochManager _epochs;                            ///< Эпохи читателей раскладки.
+        std::vector<std::pair<Layout *, std::uint64_t> > _retired;   ///< Старые раскладки и их эпохи.
+
+        std::mutex _rebalanceLock;                               ///< Одно перераспределение за раз.
+        std::atomic<std::size_t> _rebalances;                    ///< Сколько раз выравнивались соседи.
+    }; // class ShardedRBTree
+
+
+} // namespace xi
+
+
+#endif // XI_RBSHARDED_H
@@ -1,445 +1,1841 @@
-﻿////////////////////////////////////////////////////////////////////////////////
-/// \file
-/// \brief     Определение классов красно-черного дерева
-/// \author    Kupchenko Viktor
-/// \version   0.1.0
-/// \date      01.05.2017
-///            This is a part of the course "Algorithms and Data Structures" 
-///            provided by  the School of Software Engineering of the Faculty 
-///            of Computer Science at the Higher School of Economics.
-///
-/// "Реализация" соответствующих методов располагается в файле rbtree.hpp.
-///
-////////////////////////////////////////////////////////////////////////////////
-
-#ifndef RBTREE_WITH_DELETION
-#define RBTREE_WITH_DELETION
-
-
-namespace xi
-{
-
-
-// Предварительное описание
-    template<typename Element, typename Compar>
-    class RBTree;
-
-
-/** \brief Класс-интерфейс, описывающий коллбек-слушателя для событий, происходящих с деревом.
- *
- *  Реализация этого интерфейса и передача его 
- */
-    template<typename Element, typename Compar>
-    class IRBTreeDumper
-    {
-    public:
-        // Объявление типов дерева и узла для упрощения доступа
-        typedef RBTree<Element, Compar> TTree;
-        typedef typename RBTree<Element, Compar>::Node TTreeNode;
-    public:
-        /** \brief Типы событий, на которые реагируем дампер. */
-        enum RBTreeDumperEvent
-        {
-            DE_AFTER_LROT,                  ///< После осуществления левого поворота.
-            DE_AFTER_RROT,                  ///< После осуществления правого поворота.
-            DE_AFTER_BST_INS,               ///< После вставки элемента в BST без перебалансировки.
-            DE_AFTER_INSERT,                ///< После вставки элемента в RBT и перебалансировки.
-            DE_AFTER_RECOLOR1,              ///< После перекраски папы, дедушки и дяди по случаю 1.
-            DE_AFTER_RECOLOR3D,             ///< После перекраски папы случаю 3.
-            DE_AFTER_RECOLOR3G,             ///< После перекраски дедушки случаю 3.
-
-            // если дерево строится с операцией удаления, тогда еще и ...
-#ifdef RBTREE_WITH_DELETION
-            DE_AFTER_BST_REMOVE,            ///< После удаления элемента из BST без перебалансировки.
-            DE_AFTER_REMOVE,                ///< После удаления элемента из RBT и перебалансировки.
-
-            // TODO: сюда при желании можно добавить события, связанные с перекрасной при удалении
-#endif
-        };
-    public:
-        // события
-
-        /** \brief Событие, происходящее с деревом. */
-        virtual void rbTreeEvent(RBTreeDumperEvent ev, TTree *tr, TTreeNode *nd) = 0;
-
-
-    protected:
-        ~IRBTreeDumper()
-        {};
-    }; // class RBTreeDumper
-
-
-    template<typename, typename>
-    class RBTreeTest;
-
-
-/** \brief Главный класс красно-черного дерева.
- *
- *  \tparam Element Определяет тип элементов, хранимых в дереве (тж. ключ, key).
- *  \tparam Compar Функтор, выполняющий сравнение элементов для определения порядка. По умолчанию
- *  реализуется стандартным компаратором \c std::less.
- */
-    template<typename Element, typename Compar = std::less<Element> >
-    class RBTree
-    {
-    public:
-        // Типы на экспорт
-        /** \brief Тип цвета узла дерева. */
-        enum Color
-        {
-            BLACK,
-            RED
-        };
-
-        /** \brief Узел КЧД.
-         *
-         *  Большая часть элементов класса является закрытой для внешнего мира и доступной только
-         *  для самого узла и его потомков. Это сделано с целью инкапсуляции, а само дерево объявлено
-         *  по отношению к данному классу дружественным, чтобы оно имело доступ к своим узлам.
-         */
-        class Node
-        {
-            // Дерево имеет полный доступ к реализации узла!
-            friend class RBTree<Element, Compar>;
-
-            // Специальный подход, позволяющий следующему (шаблонному) классу иметь доступ
-            // к закрытым членам для их тестирования.
-            template<typename, typename>
-            friend
-            class RBTreeTest;
-
-        public:
-
-            /** \brief Определяет варианты принадлежности узла относительно родителя. */
-            enum WhichChild
-            {
-                LEFT,               ///< левый потомок
-                RIGHT,              ///< правый потомок
-                NONE                ///< вообще не потомок
-            };
-        public:
-
-            /** \brief Возвращает константный указатель на левый дочерний узел. */
-            const Node *getLeft() const
-            { return _left; }
-
-            /** \brief Возвращает константный указатель на правый дочерний узел. */
-            const Node *getRight() const
-            { return _right; }
-
-            /** \brief Возвращает константный указатель на родительский узел. */
-            const Node *getParent() const
-            { return _parent; }
-
-            /** \brief Возвращает цвет узла. */
-            Color getColor() const
-            { return _color; }
-
-            /** \brief Возвращает истину, если узел черный, иначе ложь. */
-            bool isBlack() const
-            { return _color == BLACK; }
-
-            /** \brief Возвращает истину, если узел красный, иначе ложь. */
-            bool isRed() const
-            { return _color == RED; }
-
-
-            // хелперные методы получения доп информации о ноде
-
-            /** \brief Возвращает истину, если есть отец и он красный. */
-            bool isDaddyRed() const
-            {
-                if (!_parent)
-                    return false;
-                return (_parent->isRed());
-            }
-
-            /** \brief Возвращает истину, если у нода есть предок, для которого нод является левым ребенком.
-             *  Во всех остальных случаях (нет предка или правый) — ложь.
-             */
-            bool isLeftChild() const
-            {
-                if (!_parent)
-                    return false;
-                return (_parent->_left == this);
-            }
-
-            /** \brief Возвращает истину, если у нода есть предок, для которого нод является правым ребенком.
-             *  Во всех остальных случаях (нет предка или левый) — ложь.
-             */
-            bool isRightChild() const
-            {
-                if (!_parent)
-                    return false;
-                return (_parent->_right == this);
-            }
-
-            /** \brief Определяет, является ли данный узел потомком родителя — левым, правым или не потомком. */
-            WhichChild getWhichChild() const
-            {
-                if (!_parent)
-                    return NONE;
-                if (_parent->_left == this)
-                    return LEFT;
-                return RIGHT;
-            }
-
-
-            /** \brief Возвращает константную ссылку на элемент/ключ, храняющийся в узле. */
-            const Element &getKey() const
-            { return _key; }
-
-        protected:
-
-            Node(const Element &key = Element(),
-                 Node *left = nullptr,
-                 Node *right = nullptr,
-                 Node *parent = nullptr,
-                 Color col = BLACK)
-                    : _key(key), _left(left), _right(right), _parent(parent), _color(col)
-            {
-                // если переданы дочерние элементы, устанавливаем себя их родителем,
-                // но не говорим родителю, что мы его дочерь!
-                if (_left)
-                    _left->_parent = this;
-
-                if (_right)
-                    _right->_parent = this;
-            }
-
-            ~Node();                                 ///< Деструктор нода гарантированно грохнет всех потомков.
-
-        protected:
-            Node(const Node &);                      ///< КК не доступен.
-            Node &operator=(Node &);                 ///< Оператор присваивания недоступен.
-
-        protected:
-            /** \brief Устанавливает левого потомка в \c lf. Если потомок не ноль, делает
-             *  для него текущий нод родителем, а у его предка отключает дочернюю связь.
-             */
-            Node *setLeft(Node *lf);
-
-            /** \brief Устанавливает правого потомка в \c rg аналогично левому.
-             *
-             *  <b style='color:orange'>Для реализации студентами.</b>
-             */
-            Node *setRight(Node *rg);
-
-            /** \brief Делает узел черным. */
-            void setBlack()
-            { _color = BLACK; }
-
-            /** \brief Делает узел красным. */
-            void setRed()
-            { _color = RED; }
-
-
-            // хелперные методы получение родственничков
-
-
-            /** \brief Еще один метод получение папочки: если он есть, возвращает по значению и устанавливает
-             *  значение флага isLeftChild в истину, если данный ребенок левый, иначе в ложь. Если папы нет,
-             *  возвращает null
-             */
-            Node *getDaddy(bool &isLeftChild)
-            {
-                if (!_parent)
-                    return nullptr;
-
-                // определяем, левый ли this детеныш
-                isLeftChild = (_parent->_left == this);
-
-                return _parent;
-            }
-
-            /** \brief Возвращает ребенка этого узла: (isLeft) — левого, иначе правого. */
-            Node *getChild(bool isLeft)
-            { return isLeft ? _left : _right; }
-
-            /** \brief Проверяет, является ли данный узел "правильным" потомком для существующего
-             *  (без проверки) родителя. Для (isLeft) "правильным" является левый узел, для
-             *  (!isLeft) — правый.
-             *  \returns возвращает истину, если проверяемый узел является "правильным".
-             */
-            bool isSpecificChildPrv(bool isLeft) const
-            {
-                // проверяем, является ли левым узлом
-                if (isLeft)
-                    return (_parent->_left == this);
-
-                // иначе проверяем, является ли правым узлом
-                return (_parent->_right == this);
-            }
-
-
-        protected:
-            Element _key;                         ///< Несомая узлом информация.
-            Color _color;                         ///< Цвет элемента.
-
-            Node *_parent;                        ///< Родитель узла.
-            Node *_left;                          ///< Левый потомок.
-            Node *_right;                         ///< Правый потомок.
-        }; // class RBTree::Node
-
-        friend class Node;
-    public:
-        RBTree();                                   ///< Конструктор по умолчанию.
-        ~RBTree();                                  ///< Деструктор.
-
-    public:
-        // Основные операции над деревом
-
-        /** \brief Вставляет элемент \c key в дерево.
-         *
-         *
-         *  <b style='color:orange'>Для реализации студентами.</b>
-         *
-         *  Т.к. дубликаты не допустимы, элемента с ключом \c key в дереве быть не должно. Если
-         *  же такой элемент уже существует, генерируется исключительная ситуация \c std::invalid_argument.
-         */
-        void insert(const Element &key);
-
-#ifdef RBTREE_WITH_DELETION
-
-        /** \brief Ищет узел, соответствующий ключу \c key, и удаляет узел из дерева
-         *  с последующей перебалансировкой.
-         *
-         *  <b style='color:orange'>Для реализации студентами.</b>
-         *
-         *  Если соответствующего ключа нет в дереве, генерирует исключительную ситуацию \c std::invalid_argument.
-         */
-        void remove(const Element &key);
-
-        /** \brief Хелперный метод для удаления, заменяющий один узел другим
-         *
-         * @param before узел, который был
-         * @param after узел, которым надо заменить
-         */
-        void transplant(const Node *before, Node *after);
-
-
-        /** \brief Осуществляет перебалансировку после удаления элемента
-         *
-         */
-        void rebalanceDel(Node* cur);
-
-
-#endif
-
-        /** \brief Ищет элемент \c key в дереве и возвращает соответствующий ему узел.
-         *
-         *  <b style='color:orange'>Для реализации студентами.</b>
-         *
-         *  \returns узел элемента \c key, если он есть в дереве, иначе \c nullptr.
-         */
-        const Node *find(const Element &key);
-
-        /** \brief Возвращает истину, если дерево пусто, ложь иначе. */
-        bool isEmpty() const
-        { return _root == nullptr; }
-
-        /** \brief Возвращает неизменяемый указатель на корневой элемент. */
-        const Node *getRoot() const
-        { return _root; }
-
-    public:
-        // Отладочные операции
-
-        /** \brief Устанавливает отладочный дампер. */
-        void setDumper(IRBTreeDumper<Element, Compar> *dumper)
-        { _dumper = dumper; }
-
-        /** \brief Сбрасывает отладочный дампер. */
-        void resetDumper()
-        { _dumper = nullptr; }
-
-
-    protected:
-
-
-        /** \brief Добавляет новый узел в дерево, как в обычном BST.
-         *
-         *  <b style='color:orange'>Для реализации студентами.</b>
-         *
-         *  Дубликаты не разрешены, исключение то же, что и у \c insert().
-         *  \return Указатель на новодобавленный элемент.
-         */
-        Node *insertNewBstEl(const Element &key);
-
-        /** \brief Выполняет перебалансировку дерева после добавления нового элемента в узел \c nd.
-         *
-         *  <b style='color:orange'>Для реализации студентами.</b>
-         */
-        void rebalance(Node *nd);
-
-        /** \brief Выполняет перебалансировку локальных предков узла \c nd: папы, дяди и дедушки.
-         *
-         *  <b style='color:orange'>Метод может быть реализован студентами в порядке декомпозиции.</b>
-         *
-         *  \returns Новый актуальный узел, для которого могут нарушаться правила.
-         */
-        Node *rebalanceDUG(Node *nd);
-
-        /** \brief Удаляет нод со всеми его потомками, освобождая память из-под них. */
-        void deleteNode(Node *nd);
-
-        /** \brief Вращает поддерево относительно узла \c nd влево.
-         *
-         *  Требование: правый ребенок узла \c nd не должен быть null, иначе генерируется
-         *  исключительная ситуация \c std::invalid_argument.
-         *
-         */
-        void rotLeft(Node *nd);
-
-        /** \brief Вращает поддерево относительно узла \c nd вправо. Условия и ограничения
-          * аналогичны (симметрично) левому вращению.
-          */
-        void rotRight(Node *nd);
-
-
-    protected:
-        RBTree(const RBTree &);                      ///< КК не доступен.
-        RBTree &operator=(RBTree &);                ///< Оператор присваивания недоступен.
-
-    protected:
-        Compar _compar;                             ///< Компаратор сравнения двух элементов.
-
-    protected:
-        // Структура дерева
-
-        /** \brief Реальный корневой элемент дерева. Если \c nullptr, значит дерево пусто.
-         *
-         *  NB: иногда используется реализация, где корень дерева хранится не непосредственно
-         *  в виде выделенного узла, а в виде правого потомка специального сторожевого (sentinel)
-         *  элемента псевдо-корня. Это позволяет несколько упростить запись алгоритма за счет того,
-         *  что исключается необходимость проверки специальных случаев с корнем. Однако это,
-         *  в свою очередь, требует обеспечение корректной проверки, что левый потомок сторожевого
-         *  узла всегда будет иметь порядок -INF, что, в свою очередь, накладывает дополнительные
-         *  ограничения на предикат сравнение элементов, поэтому в настоящей реализации не используется.
-         */
-        Node *_root;
-
-
-    protected:
-        // Секция отладочных компонент
-        IRBTreeDumper<Element, Compar> *_dumper;
-
-
-        // Специальный подход, позволяющий следующему классу иметь доступ к закрытым членам для их тестирования.
-        template<typename, typename>
-        friend
-        class RBTreeTest;
-
-    }; // class RBTree
-
-
-
-} // namespace xi
-
-
-
-// Подключаем "реализационную" часть
-#include "rbtree.hpp"
-
-
+﻿////////////////////////////////////////////////////////////////////////////////
+/// \file
+/// \brief     Определение классов красно-черного дерева
+/// \author    Kupchenko Viktor
+/// \version   0.1.0
+/// \date      01.05.2017
+///            This is a part of the course "Algorithms and Data Structures" 
+///            provided by  the School of Software Engineering of the Faculty 
+///            of Computer Science at the Higher School of Economics.
+///
+/// "Реализация" соответствующих методов располагается в файле rbtree.hpp.
+///
+/// Необязательные возможности включаются макросами до подключения заголовка:
+///   RBTREE_WITH_ORDER_STATISTICS — узлы хранят размер своего поддерева, а дерево
+///                                  умеет select(k)/rank(key) за O(log n).
+///   RBTREE_COMPACT_NODES         — цвет узла хранится в младшем бите указателя на отца,
+///                                  что экономит выравнивание под отдельное поле цвета.
+///   RBTREE_RELATIVE_LINKS        — связи узлов хранятся 32-битными смещениями друг относительно
+///                                  друга (xi::RelPtr). Узлы тогда должны лежать в одном куске
+///                                  памяти не шире +-8 ГБ, поэтому дерево принимает только
+///                                  аллокаторы-арены: xi::ArenaAllocator из nodepool.h и дерево
+///                                  в файле xi::MappedRBTree из rbmapped.h. Раскладка нужна ради
+///                                  переносимости массива узлов (копия, файл), а не скорости:
+///                                  каждый переход по связи стоит лишнего сложения, и find()
+///                                  бывает медленнее, чем с обычными указателями.
+///   RBTREE_ATOMIC_LINKS          — связи узлов и корень дерева атомарные (xi::AtomicPtr): запись
+///                                  публикует с release, чтение — с acquire. Нужен xi::ConcurrentRBTree
+///                                  из rbconcurrent.h, чьи читатели спускаются по дереву во время
+///                                  поворотов писателя. С RBTREE_RELATIVE_LINKS не совмещается.
+///   RBTREE_WITH_STATS            — дерево считает сравнения, повороты, перекраски и итерации
+///                                  перебалансировки, созданные узлы и длины путей find()
+///                                  (см. xi::RBTreeStats). Без макроса счетчиков нет вовсе.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef RBTREE_WITH_DELETION
+#define RBTREE_WITH_DELETION
+
+#include <cstddef>          // std::size_t, std::ptrdiff_t
+#include <cstdint>          // std::uintptr_t, std::uint64_t
+#include <functional>       // std::less
+#include <iosfwd>           // std::istream, std::ostream
+#include <iterator>         // std::bidirectional_iterator_tag, std::reverse_iterator
+#include <memory>           // std::allocator, std::allocator_traits
+#include <type_traits>      // std::is_trivially_destructible
+#include <utility>          // std::declval, std::pair
+
+#include <atomic>           // std::atomic
+
+#ifdef RBTREE_RELATIVE_LINKS
+#ifdef RBTREE_COMPACT_NODES
+#error "RBTREE_COMPACT_NODES and RBTREE_RELATIVE_LINKS can't be combined"
+#endif
+#include "relptr.h"         // xi::RelPtr
+#endif
+
+#ifdef RBTREE_ATOMIC_LINKS
+#ifdef RBTREE_RELATIVE_LINKS
+#error "RBTREE_ATOMIC_LINKS and RBTREE_RELATIVE_LINKS can't be combined"
+#endif
+#include "atomicptr.h"      // xi::AtomicPtr
+#endif
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>  // std::pmr::polymorphic_allocator
+#define RBTREE_HAS_PMR
+#endif
+#if __has_include(<string_view>)
+#include <string_view>      // std::string_view
+#define RBTREE_HAS_STRING_VIEW
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define RBTREE_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define RBTREE_PREFETCH(addr) ((void) 0)
+#endif
+
+#if defined(__has_include) && (defined(__unix__) || defined(__APPLE__))
+#if __has_include(<sys/mman.h>)
+#define RBTREE_HAS_MMAP     // RBTree::load() отображает файл в память
+#endif
+#endif
+
+
+namespace xi
+{
+
+
+// Предварительное описание
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    class RBTree;
+
+    template<typename Element, typename Compar>
+    class FrozenRBTree;
+
+    class WorkStealingPool;
+
+
+/** \brief События, о которых дерево сообщает своей политике событий (\c Dumper, см. \c RBTree). */
+    struct RBTreeDumperEvents
+    {
+        /** \brief Типы событий, на которые реагируем дампер. */
+        enum RBTreeDumperEvent
+        {
+            DE_AFTER_LROT,                  ///< После осуществления левого поворота.
+            DE_AFTER_RROT,                  ///< После осуществления правого поворота.
+            DE_AFTER_BST_INS,               ///< После вставки элемента в BST без перебалансировки.
+            DE_AFTER_INSERT,                ///< После вставки элемента в RBT и перебалансировки.
+            DE_AFTER_RECOLOR1,              ///< После перекраски папы, дедушки и дяди по случаю 1.
+            DE_AFTER_RECOLOR3D,             ///< После перекраски папы случаю 3.
+            DE_AFTER_RECOLOR3G,             ///< После перекраски дедушки случаю 3.
+
+            // если дерево строится с операцией удаления, тогда еще и ...
+#ifdef RBTREE_WITH_DELETION
+            DE_AFTER_BST_REMOVE,            ///< После удаления элемента из BST без перебалансировки.
+            DE_AFTER_REMOVE,                ///< После удаления элемента из RBT и перебалансировки.
+
+            // Перекраски при перебалансировке после удаления; узел события — отец текущего узла
+            DE_AFTER_DEL_RECOLOR1,          ///< После перекраски красного брата и папы (случай 1, дальше поворот).
+            DE_AFTER_DEL_RECOLOR2,          ///< После перекраски брата с черными детьми в красный (случай 2).
+            DE_AFTER_DEL_RECOLOR3,          ///< После перекраски брата и его ближнего ребенка (случай 3).
+            DE_AFTER_DEL_RECOLOR4,          ///< После перекраски брата, папы и дальнего ребенка (случай 4).
+#endif
+        };
+    };
+
+
+/** \brief Политика событий по умолчанию: ничего не делает.
+ *
+ *  Пустая и без состояния, так что дерево с ней не тратит на события ни байта, ни ветвления:
+ *  вызовы \c rbTreeEvent() исчезают при компиляции.
+ */
+    struct RBTreeNoDumper : RBTreeDumperEvents
+    {
+        template<typename Tree, typename Node>
+        void rbTreeEvent(RBTreeDumperEvent, Tree *, Node *)
+        {}
+    };
+
+
+    template<typename Element, typename Compar, typename Allocator>
+    class IRBTreeDumper;
+
+
+/** \brief Политика событий, передающая их слушателю \c IRBTreeDumper, если он назначен.
+ *
+ *  Подключается явно: <tt>RBTree<Element, Compar, Allocator, RBTreeVirtualDumper<Element, Compar, Allocator> ></tt>
+ *  (см. \c IRBTreeDumper::TTree). Слушатель назначается через \c RBTree::setDumper(), как и раньше.
+ *  Рабочие деревья, которые дерево заводит внутри \c split(), \c join() и теоретико-множественных
+ *  операций, слушателя не наследуют.
+ */
+    template<typename Element, typename Compar, typename Allocator = std::allocator<Element> >
+    class RBTreeVirtualDumper : public RBTreeDumperEvents
+    {
+    public:
+        RBTreeVirtualDumper()
+                : _dumper(nullptr)
+        {}
+
+    public:
+        /** \brief Устанавливает отладочный дампер. */
+        void setDumper(IRBTreeDumper<Element, Compar, Allocator> *dumper)
+        { _dumper = dumper; }
+
+        /** \brief Сбрасывает отладочный дампер. */
+        void resetDumper()
+        { _dumper = nullptr; }
+
+        template<typename Tree, typename Node>
+        void rbTreeEvent(RBTreeDumperEvent ev, Tree *tr, Node *nd)
+        {
+            if (_dumper)
+                _dumper->rbTreeEvent(ev, tr, nd);
+        }
+
+    protected:
+        IRBTreeDumper<Element, Compar, Allocator> *_dumper;      ///< Слушатель или nullptr.
+    }; // class RBTreeVirtualDumper
+
+
+/** \brief Класс-интерфейс, описывающий коллбек-слушателя для событий, происходящих с деревом.
+ *
+ *  Реализация этого интерфейса и передача его дереву с политикой \c RBTreeVirtualDumper
+ *  позволяет наблюдать за каждым поворотом и перекраской — например, рисовать дерево по шагам.
+ */
+    template<typename Element, typename Compar, typename Allocator = std::allocator<Element> >
+    class IRBTreeDumper : public RBTreeDumperEvents
+    {
+    public:
+        // Объявление типов дерева и узла для упрощения доступа
+        typedef RBTree<Element, Compar, Allocator, RBTreeVirtualDumper<Element, Compar, Allocator> > TTree;
+        typedef typename TTree::Node TTreeNode;
+    public:
+        // события
+
+        /** \brief Событие, происходящее с деревом. */
+        virtual void rbTreeEvent(RBTreeDumperEvent ev, TTree *tr, TTreeNode *nd) = 0;
+
+
+    protected:
+        ~IRBTreeDumper()
+        {};
+    }; // class RBTreeDumper
+
+
+    template<typename, typename>
+    class RBTreeTest;
+
+
+/** \brief Определяет, умеет ли аллокатор \c Alloc освобождать все свои объекты разом
+ *  (метод \c bool \c releaseAll(), см. \c xi::PoolAllocator).
+ */
+    template<typename Alloc, typename = void>
+    struct AllocatorHasReleaseAll : std::false_type
+    {
+    };
+
+    template<typename Alloc>
+    struct AllocatorHasReleaseAll<Alloc, decltype((void) std::declval<Alloc &>().releaseAll())> : std::true_type
+    {
+    };
+
+
+/** \brief Определяет, кладет ли аллокатор все одиночные объекты в один кусок памяти не шире +-8 ГБ
+ *  (\c typedef \c std::true_type \c is_arena, см. \c xi::ArenaAllocator). Только с таким аллокатором
+ *  32-битные связи RBTREE_RELATIVE_LINKS заведомо дотягиваются от узла до узла.
+ */
+    template<typename Alloc, typename = void>
+    struct AllocatorIsArena : std::false_type
+    {
+    };
+
+    template<typename Alloc>
+    struct AllocatorIsArena<Alloc, typename std::enable_if<Alloc::is_arena::value>::type> : std::true_type
+    {
+    };
+
+
+/** \brief Определяет, умеет ли компаратор \c Compar сравнивать \c A с \c B в три стороны:
+ *  метод \c compare(a, b) возвращает число меньше нуля, ноль или больше нуля. Такой компаратор
+ *  позволяет поиску обходиться одним сравнением на уровень дерева (см. \c xi::StringCompare).
+ */
+    template<typename Compar, typename A, typename B, typename = void>
+    struct ComparHasThreeWay : std::false_type
+    {
+    };
+
+    template<typename Compar, typename A, typename B>
+    struct ComparHasThreeWay<Compar, A, B,
+            decltype((void) (std::declval<const Compar &>().compare(std::declval<const A &>(),
+                                                                    std::declval<const B &>()) < 0))>
+            : std::true_type
+    {
+    };
+
+
+#ifdef RBTREE_HAS_STRING_VIEW
+
+/** \brief Прозрачный компаратор строк с трехсторонним сравнением.
+ *
+ *  Принимает все, что приводится к \c std::string_view, так что дерево \c std::string можно
+ *  искать по \c std::string_view или \c const \c char* без временной строки. По образцу этого
+ *  компаратора легко написать свой, например сравнивающий только префикс ключа.
+ */
+    struct StringCompare
+    {
+        typedef void is_transparent;
+
+        bool operator()(std::string_view a, std::string_view b) const
+        { return a < b; }
+
+        int compare(std::string_view a, std::string_view b) const
+        { return a.compare(b); }
+    };
+
+#endif // RBTREE_HAS_STRING_VIEW
+
+
+#ifdef RBTREE_WITH_STATS
+
+/** \brief Снимок статистики операций дерева (см. \c RBTree::getStats()).
+ *
+ *  Вставками считаются и перебалансировки после склейки через разделитель, и сравнения при
+ *  разрезании (\c split(), теоретико-множественные операции), а удалениями — и отцепление узлов
+ *  при склейке без разделителя и в теоретико-множественных операциях.
+ */
+    struct RBTreeStats
+    {
+        /** \brief Счетчики одного вида операций. */
+        struct Phase
+        {
+            std::uint64_t operations;                  ///< Вставлено, удалено или найдено (find()) узлов.
+            std::uint64_t comparisons;                 ///< Вызовов компаратора при поиске узла или места.
+            std::uint64_t rotations;                   ///< Поворотов при перебалансировке.
+            std::uint64_t recolors;                    ///< Перекрасок узлов при перебалансировке.
+            std::uint64_t fixupIterations;             ///< Итераций цикла перебалансировки.
+        };
+
+        /** \brief Число корзин гистограммы путей; в последнюю попадают все более длинные пути. */
+        static const std::size_t PATH_BUCKETS = 64;
+
+        Phase insert;                                  ///< Вставки.
+        Phase remove;                                  ///< Удаления.
+        Phase lookup;                                  ///< Поиск find(): только операции и сравнения.
+        std::uint64_t nodesAllocated;                  ///< Сколько узлов создано.
+        std::uint64_t findPathLength[PATH_BUCKETS];    ///< [i] — сколько find() прошли ровно i узлов.
+    };
+
+#endif // RBTREE_WITH_STATS
+
+
+/** \brief Заголовок файла со снимком дерева (см. \c RBTree::save()). 64 байта, порядок байт — машинный.
+ *
+ *  За заголовком с \c keysOffset лежат элементы по возрастанию: при \c RAW_KEYS — байтовые копии по
+ *  \c elementSize байт подряд, иначе — то, что пишет сериализатор. Если есть \c HAS_SHAPE, с
+ *  \c shapeOffset идет форма дерева: по 4 бита на узел в прямом порядке обхода (младшая тетрада
+ *  байта — первой), см. \c ShapeBits.
+ */
+    struct RBTreeSnapshotHeader
+    {
+        /** \brief Флаги содержимого файла. */
+        enum Flags
+        {
+            RAW_KEYS = 1,                            ///< Элементы записаны байтовыми копиями фиксированного размера.
+            HAS_SHAPE = 2                            ///< Записана форма дерева, а не только элементы.
+        };
+
+        /** \brief Биты формы одного узла. */
+        enum ShapeBits
+        {
+            SHAPE_LEFT = 1,                          ///< Есть левый ребенок.
+            SHAPE_RIGHT = 2,                         ///< Есть правый ребенок.
+            SHAPE_RED = 4                            ///< Узел красный.
+        };
+
+        static const std::uint32_t VERSION = 1;
+        static const std::uint64_t BYTE_ORDER_MARK = 0x0102030405060708ULL;
+
+        char magic[8];                               ///< "XIRBTREE".
+        std::uint32_t version;                       ///< Версия формата.
+        std::uint32_t flags;                         ///< Комбинация \c Flags.
+        std::uint64_t byteOrder;                     ///< \c BYTE_ORDER_MARK в порядке байт записавшей машины.
+        std::uint64_t count;                         ///< Число элементов.
+        std::uint64_t elementSize;                   ///< sizeof(Element) при \c RAW_KEYS, иначе 0.
+        std::uint64_t keysOffset;                    ///< Смещение элементов от начала файла.
+        std::uint64_t shapeOffset;                   ///< Смещение формы или 0, если ее нет.
+        std::uint64_t reserved;
+    };
+
+
+/** \brief Сериализатор элементов для \c RBTree::save() и \c RBTree::load().
+ *
+ *  Нужен метод \c write(std::ostream&, const Element&) и метод \c read(std::istream&), возвращающий
+ *  элемент. Готовые есть для тривиально копируемых типов (байтовая копия; такие файлы загружаются
+ *  через mmap без чтения в буфер) и для \c std::string (длина и байты). Для прочих типов эту
+ *  структуру надо специализировать или передать в \c save()/\c load() свой сериализатор.
+ */
+    template<typename Element, typename Enable = void>
+    struct RBTreeSerializer;
+
+
+/** \brief Главный класс красно-черного дерева.
+ *
+ *  \tparam Element Определяет тип элементов, хранимых в дереве (тж. ключ, key).
+ *  \tparam Compar Функтор, выполняющий сравнение элементов для определения порядка. По умолчанию
+ *  реализуется стандартным компаратором \c std::less.
+ *  \tparam Allocator Аллокатор в стиле STL. Дерево перепривязывает его к типу узла и берет
+ *  из него память под каждый узел. По умолчанию \c std::allocator; подходит и
+ *  \c std::pmr::polymorphic_allocator, и пуловый \c xi::PoolAllocator из nodepool.h.
+ *  \tparam Dumper Политика отладочных событий (повороты, перекраски, этапы вставки и удаления):
+ *  метод <tt>rbTreeEvent(ev, tree, node)</tt>. По умолчанию \c RBTreeNoDumper, который ничего
+ *  не стоит; слушатель \c IRBTreeDumper подключается политикой \c RBTreeVirtualDumper.
+ */
+    template<typename Element, typename Compar = std::less<Element>, typename Allocator = std::allocator<Element>,
+            typename Dumper = RBTreeNoDumper>
+    class RBTree : protected Dumper
+    {
+    public:
+        // Типы на экспорт
+        /** \brief Тип цвета узла дерева. */
+        enum Color
+        {
+            BLACK,
+            RED
+        };
+
+        /** \brief Узел КЧД.
+         *
+         *  Большая часть элементов класса является закрытой для внешнего мира и доступной только
+         *  для самого узла и его потомков. Это сделано с целью инкапсуляции, а само дерево объявлено
+         *  по отношению к данному классу дружественным, чтобы оно имело доступ к своим узлам.
+         */
+        class Node
+        {
+            // Дерево имеет полный доступ к реализации узла!
+            friend class RBTree<Element, Compar, Allocator, Dumper>;
+
+            // Специальный подход, позволяющий следующему (шаблонному) классу иметь доступ
+            // к закрытым членам для их тестирования.
+            template<typename, typename>
+            friend
+            class RBTreeTest;
+
+        public:
+
+            /** \brief Определяет варианты принадлежности узла относительно родителя. */
+            enum WhichChild
+            {
+                LEFT,               ///< левый потомок
+                RIGHT,              ///< правый потомок
+                NONE                ///< вообще не потомок
+            };
+        public:
+
+            /** \brief Возвращает константный указатель на левый дочерний узел. */
+            const Node *getLeft() const
+            { return _left; }
+
+            /** \brief Возвращает константный указатель на правый дочерний узел. */
+            const Node *getRight() const
+            { return _right; }
+
+            /** \brief Возвращает константный указатель на родительский узел. */
+            const Node *getParent() const
+            { return _parent; }
+
+            /** \brief Возвращает цвет узла. */
+            Color getColor() const
+            {
+#ifdef RBTREE_COMPACT_NODES
+                return _parent.getColor();
+#else
+                return _color;
+#endif
+            }
+
+            /** \brief Возвращает истину, если узел черный, иначе ложь. */
+            bool isBlack() const
+            { return getColor() == BLACK; }
+
+            /** \brief Возвращает истину, если узел красный, иначе ложь. */
+            bool isRed() const
+            { return getColor() == RED; }
+
+
+            // хелперные методы получения доп информации о ноде
+
+            /** \brief Возвращает истину, если есть отец и он красный. */
+            bool isDaddyRed() const
+            {
+                if (!_parent)
+                    return false;
+                return (_parent->isRed());
+            }
+
+            /** \brief Возвращает истину, если у нода есть предок, для которого нод является левым ребенком.
+             *  Во всех остальных случаях (нет предка или правый) — ложь.
+             */
+            bool isLeftChild() const
+            {
+                if (!_parent)
+                    return false;
+                return (_parent->_left == this);
+            }
+
+            /** \brief Возвращает истину, если у нода есть предок, для которого нод является правым ребенком.
+             *  Во всех остальных случаях (нет предка или левый) — ложь.
+             */
+            bool isRightChild() const
+            {
+                if (!_parent)
+                    return false;
+                return (_parent->_right == this);
+            }
+
+            /** \brief Определяет, является ли данный узел потомком родителя — левым, правым или не потомком. */
+            WhichChild getWhichChild() const
+            {
+                if (!_parent)
+                    return NONE;
+                if (_parent->_left == this)
+                    return LEFT;
+                return RIGHT;
+            }
+
+
+            /** \brief Возвращает константную ссылку на элемент/ключ, храняющийся в узле. */
+            const Element &getKey() const
+            { return _key; }
+
+#ifdef RBTREE_WITH_ORDER_STATISTICS
+
+            /** \brief Возвращает число узлов в поддереве с корнем в этом узле (включая его самого). */
+            std::size_t getSize() const
+            { return _size; }
+
+            /** \brief Размер поддерева \c nd с учетом того, что пустое поддерево — nullptr. */
+            static std::size_t sizeOf(const Node *nd)
+            { return nd ? nd->_size : 0; }
+
+#endif // RBTREE_WITH_ORDER_STATISTICS
+
+
+            // хелперные методы обхода по порядку
+
+            /** \brief Возвращает самый левый (минимальный) узел поддерева с корнем в этом узле. */
+            const Node *getLeftmost() const;
+
+            /** \brief Возвращает самый правый (максимальный) узел поддерева с корнем в этом узле. */
+            const Node *getRightmost() const;
+
+            /** \brief Возвращает следующий по порядку узел дерева или nullptr, если этот — максимальный.
+             *  Обход всего дерева такими шагами стоит O(n), т.е. амортизированно O(1) на шаг.
+             */
+            const Node *getNext() const;
+
+            /** \brief Возвращает предыдущий по порядку узел дерева или nullptr, если этот — минимальный. */
+            const Node *getPrev() const;
+
+        protected:
+
+            Node(const Element &key = Element(),
+                 Node *left = nullptr,
+                 Node *right = nullptr,
+                 Node *parent = nullptr,
+                 Color col = BLACK)
+#ifdef RBTREE_COMPACT_NODES
+                    : _key(key), _parent(parent, col), _left(left), _right(right)
+#else
+                    : _key(key), _color(col), _parent(parent), _left(left), _right(right)
+#endif
+            {
+                // если переданы дочерние элементы, устанавливаем себя их родителем,
+                // но не говорим родителю, что мы его дочерь!
+                if (_left)
+                    _left->_parent = this;
+
+                if (_right)
+                    _right->_parent = this;
+
+#ifdef RBTREE_WITH_ORDER_STATISTICS
+                _size = 1 + sizeOf(_left) + sizeOf(_right);
+#endif
+            }
+
+            /** \brief Метка конструктора, строящего ключ на месте из произвольных аргументов. */
+            struct InPlace
+            {
+            };
+
+            /** \brief Одиночный черный узел без связей с ключом, сконструированным из \c args. */
+            template<typename... Args>
+            explicit Node(InPlace, Args &&... args)
+#ifdef RBTREE_COMPACT_NODES
+                    : _key(std::forward<Args>(args)...), _parent(nullptr, BLACK), _left(nullptr), _right(nullptr)
+#else
+                    : _key(std::forward<Args>(args)...), _color(BLACK), _parent(nullptr), _left(nullptr),
+                      _right(nullptr)
+#endif
+            {
+#ifdef RBTREE_WITH_ORDER_STATISTICS
+                _size = 1;
+#endif
+            }
+
+            /** \brief Деструктор потомков не трогает: узлы создает и освобождает само дерево
+             *  через свой аллокатор (см. \c RBTree::destroySubtree()).
+             */
+            ~Node()
+            {}
+
+        protected:
+            Node(const Node &);                      ///< КК не доступен.
+            Node &operator=(Node &);                 ///< Оператор присваивания недоступен.
+
+        protected:
+            /** \brief Устанавливает левого потомка в \c lf. Если потомок не ноль, делает
+             *  для него текущий нод родителем, а у его предка отключает дочернюю связь.
+             */
+            Node *setLeft(Node *lf);
+
+            /** \brief Устанавливает правого потомка в \c rg аналогично левому.
+             *
+             *  <b style='color:orange'>Для реализации студентами.</b>
+             */
+            Node *setRight(Node *rg);
+
+            /** \brief Делает узел черным. */
+            void setBlack()
+            { setColor(BLACK); }
+
+            /** \brief Делает узел красным. */
+            void setRed()
+            { setColor(RED); }
+
+            /** \brief Красит узел в цвет \c col. */
+            void setColor(Color col)
+            {
+#ifdef RBTREE_COMPACT_NODES
+                _parent.setColor(col);
+#else
+                _color = col;
+#endif
+            }
+
+
+            // хелперные методы получение родственничков
+
+
+            /** \brief Еще один метод получение папочки: если он есть, возвращает по значению и устанавливает
+             *  значение флага isLeftChild в истину, если данный ребенок левый, иначе в ложь. Если папы нет,
+             *  возвращает null
+             */
+            Node *getDaddy(bool &isLeftChild)
+            {
+                if (!_parent)
+                    return nullptr;
+
+                // определяем, левый ли this детеныш
+                isLeftChild = (_parent->_left == this);
+
+                return _parent;
+            }
+
+            /** \brief Возвращает ребенка этого узла: (isLeft) — левого, иначе правого. */
+            Node *getChild(bool isLeft)
+            { return isLeft ? _left : _right; }
+
+            /** \brief Проверяет, является ли данный узел "правильным" потомком для существующего
+             *  (без проверки) родителя. Для (isLeft) "правильным" является левый узел, для
+             *  (!isLeft) — правый.
+             *  \returns возвращает истину, если проверяемый узел является "правильным".
+             */
+            bool isSpecificChildPrv(bool isLeft) const
+            {
+                // проверяем, является ли левым узлом
+                if (isLeft)
+                    return (_parent->_left == this);
+
+                // иначе проверяем, является ли правым узлом
+                return (_parent->_right == this);
+            }
+
+
+#ifdef RBTREE_COMPACT_NODES
+
+            /** \brief Указатель на отца, в младшем бите которого хранится цвет узла.
+             *
+             *  Узлы выровнены как минимум по указателю, так что этот бит у настоящего адреса всегда ноль.
+             *  Ссылка ведет себя как обычный \c Node*: неявно приводится к нему, разыменовывается
+             *  через \c ->, а присваивание нового отца цвет не трогает. Поэтому код дерева пишется
+             *  одинаково для обеих раскладок узла.
+             */
+            class ParentLink
+            {
+            public:
+                ParentLink(Node *parent, Color col)
+                        : _bits(reinterpret_cast<std::uintptr_t>(parent) | (col == RED ? RED_BIT : 0))
+                {}
+
+                operator Node *() const
+                { return reinterpret_cast<Node *>(_bits & ~RED_BIT); }
+
+                Node *operator->() const
+                { return *this; }
+
+                /** \brief Меняет отца, сохраняя цвет. */
+                ParentLink &operator=(Node *parent)
+                {
+                    _bits = reinterpret_cast<std::uintptr_t>(parent) | (_bits & RED_BIT);
+                    return *this;
+                }
+
+                /** \brief Берет у \c other только отца: цвет у каждого узла свой. */
+                ParentLink &operator=(const ParentLink &other)
+                { return *this = (Node *) other; }
+
+                Color getColor() const
+                { return (_bits & RED_BIT) ? RED : BLACK; }
+
+                void setColor(Color col)
+                { _bits = (_bits & ~RED_BIT) | (col == RED ? RED_BIT : 0); }
+
+            protected:
+                static const std::uintptr_t RED_BIT = 1;
+
+                std::uintptr_t _bits;             ///< Адрес отца, объединенный с битом цвета.
+            }; // class RBTree::Node::ParentLink
+
+#endif // RBTREE_COMPACT_NODES
+
+            /** \brief Тип связи между узлами: обычный указатель, 32-битное смещение или атомарный указатель.
+             *
+             *  Код дерева работает со связями как с \c Node*, так что от раскладки не зависит.
+             */
+#ifdef RBTREE_RELATIVE_LINKS
+            typedef RelPtr<Node> Link;
+#elif defined(RBTREE_ATOMIC_LINKS)
+            typedef AtomicPtr<Node> Link;
+#else
+            typedef Node *Link;
+#endif
+
+        protected:
+            Element _key;                         ///< Несомая узлом информация.
+#ifdef RBTREE_COMPACT_NODES
+            ParentLink _parent;                   ///< Родитель узла и цвет элемента.
+#else
+            Color _color;                         ///< Цвет элемента.
+
+            Link _parent;                         ///< Родитель узла.
+#endif
+            Link _left;                           ///< Левый потомок.
+            Link _right;                          ///< Правый потомок.
+
+#ifdef RBTREE_WITH_ORDER_STATISTICS
+            std::size_t _size;                    ///< Число узлов в поддереве, включая этот.
+#endif
+        }; // class RBTree::Node
+
+        friend class Node;
+
+
+        /** \brief Двунаправленный итератор по элементам дерева в порядке возрастания.
+         *
+         *  Элементы дерева являются ключами, менять их нельзя, поэтому итератор всегда константный
+         *  (как у \c std::set). Шаги делаются по связям узлов, в том числе по \c _parent, без
+         *  повторного спуска от корня. Итератор \c end() не указывает ни на какой узел, но помнит
+         *  дерево, чтобы из него можно было шагнуть назад к максимальному элементу.
+         */
+        class ConstIterator
+        {
+            friend class RBTree<Element, Compar, Allocator, Dumper>;
+
+        public:
+            typedef std::bidirectional_iterator_tag iterator_category;
+            typedef Element value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef const Element *pointer;
+            typedef const Element &reference;
+
+        public:
+            ConstIterator()
+                    : _node(nullptr), _tree(nullptr)
+            {}
+
+            reference operator*() const
+            { return _node->getKey(); }
+
+            pointer operator->() const
+            { return &_node->getKey(); }
+
+            ConstIterator &operator++()
+            {
+                _node = _node->getNext();
+                return *this;
+            }
+
+            ConstIterator operator++(int)
+            {
+                ConstIterator res(*this);
+                ++(*this);
+                return res;
+            }
+
+            /** \brief Шаг назад; из \c end() попадаем на максимальный элемент. */
+            ConstIterator &operator--()
+            {
+                if (_node)
+                    _node = _node->getPrev();
+                else
+                    _node = _tree->_rightmost;
+                return *this;
+            }
+
+            ConstIterator operator--(int)
+            {
+                ConstIterator res(*this);
+                --(*this);
+                return res;
+            }
+
+            bool operator==(const ConstIterator &other) const
+            { return _node == other._node; }
+
+            bool operator!=(const ConstIterator &other) const
+            { return _node != other._node; }
+
+            /** \brief Возвращает узел, на который указывает итератор (nullptr для \c end()). */
+            const Node *getNode() const
+            { return _node; }
+
+        protected:
+            ConstIterator(const Node *nd, const RBTree *tree)
+                    : _node(nd), _tree(tree)
+            {}
+
+        protected:
+            const Node *_node;                      ///< Текущий узел, nullptr означает \c end().
+            const RBTree *_tree;                    ///< Дерево, по которому идем.
+        }; // class RBTree::ConstIterator
+
+        friend class ConstIterator;
+
+
+        // Типы в стиле STL, чтобы дерево можно было отдавать стандартным алгоритмам
+        typedef Element key_type;
+        typedef Element value_type;
+        typedef Compar key_compare;
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef ConstIterator iterator;
+        typedef ConstIterator const_iterator;
+        typedef std::reverse_iterator<ConstIterator> reverse_iterator;
+        typedef std::reverse_iterator<ConstIterator> const_reverse_iterator;
+
+        /** \brief Тип аллокатора, переданного дереву. */
+        typedef Allocator allocator_type;
+
+    protected:
+        /** \brief Аллокатор, перепривязанный к узлам, и его свойства. */
+        typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Node> NodeAllocator;
+        typedef std::allocator_traits<NodeAllocator> NodeAllocTraits;
+
+#ifdef RBTREE_RELATIVE_LINKS
+        static_assert(AllocatorIsArena<NodeAllocator>::value,
+                      "RBTREE_RELATIVE_LINKS requires an arena allocator (xi::ArenaAllocator, xi::MappedAllocator): "
+                      "32-bit links can't reach nodes scattered over the heap");
+#endif
+
+    public:
+        RBTree();                                   ///< Конструктор по умолчанию.
+        explicit RBTree(const Allocator &alloc);    ///< Конструктор с заданным аллокатором.
+        explicit RBTree(const Compar &compar, const Allocator &alloc = Allocator());
+        ~RBTree();                                  ///< Деструктор.
+
+        /** \brief Перемещающий конструктор: забирает узлы \c other, оставляя его пустым.
+         *
+         *  Аллокатор копируется, а не перемещается, чтобы \c other оставался пригодным к работе.
+         */
+        RBTree(RBTree &&other);
+
+        /** \brief Перемещающее присваивание: освобождает свои узлы и забирает узлы \c other
+         *  вместе с копией его аллокатора.
+         */
+        RBTree &operator=(RBTree &&other);
+
+    public:
+        // Построение
+
+        /** \brief Строит дерево из строго возрастающей (в смысле \c compar) последовательности [first, last) за O(n).
+         *
+         *  Дерево собирается сразу сбалансированным делением пополам, цвета расставляются по уровням:
+         *  все узлы черные, кроме самого нижнего уровня, если он не заполнен целиком. Ни \c rebalance(),
+         *  ни повороты не вызываются, а на каждый элемент приходится одно сравнение — с предыдущим.
+         *  Если последовательность не строго возрастает, генерируется \c std::invalid_argument.
+         *
+         *  \tparam ForwardIt Прямой итератор (последовательность проходится дважды: для подсчета и для чтения).
+         */
+        template<typename ForwardIt>
+        static RBTree buildFromSorted(ForwardIt first, ForwardIt last,
+                                      const Compar &compar = Compar(), const Allocator &alloc = Allocator());
+
+    public:
+        // Сохранение и загрузка
+
+        /** \brief Сохраняет дерево в файл \c path (формат — \c RBTreeSnapshotHeader).
+         *
+         *  Элементы пишутся по возрастанию через \c ser, а если \c withShape, то и форма дерева
+         *  (наличие детей и цвет, 4 бита на узел), чтобы \c load() восстановил ровно это дерево.
+         *  При ошибке записи генерируется \c std::runtime_error.
+         */
+        template<typename Serializer = RBTreeSerializer<Element> >
+        void save(const char *path, bool withShape = true, const Serializer &ser = Serializer()) const;
+
+        /** \brief Загружает дерево, сохраненное \c save(), за O(n) без единого поворота.
+         *
+         *  Файл читается потоком, один раз. Если в нем есть форма, узлы связываются ровно так, как
+         *  были сохранены, иначе дерево строится как в \c buildFromSorted(). Элементы тривиально
+         *  копируемого типа, где есть mmap, берутся прямо из отображенного в память файла.
+         *  Порядок элементов, цвета и черные высоты проверяются; на испорченном или чужом файле
+         *  генерируется \c std::runtime_error.
+         */
+        template<typename Serializer = RBTreeSerializer<Element> >
+        static RBTree load(const char *path, const Compar &compar = Compar(), const Allocator &alloc = Allocator(),
+                           const Serializer &ser = Serializer());
+
+    public:
+        // Склейка и разрезание
+
+        /** \brief Склеивает деревья \c left и \c right через разделитель \c pivot за O(log n).
+         *
+         *  Все элементы \c left должны быть меньше \c pivot, а все элементы \c right — больше.
+         *  Узлы обоих деревьев переходят в результат без копирования, исходные деревья остаются пустыми.
+         *  Низкое дерево подвешивается к ветви высокого на уровне той же черной высоты, после чего
+         *  возможное нарушение "красный под красным" исправляется обычным \c rebalance().
+         *
+         *  Аллокаторы деревьев должны быть равны, иначе, как и при нарушении порядка,
+         *  генерируется \c std::invalid_argument.
+         */
+        static RBTree join(RBTree &&left, const Element &pivot, RBTree &&right);
+
+        /** \brief Склеивает деревья \c left и \c right, все элементы которых упорядочены друг
+         *  относительно друга, за O(log n). Разделителем служит минимальный узел \c right.
+         */
+        static RBTree join(RBTree &&left, RBTree &&right);
+
+        /** \brief Разрезает дерево по ключу \c key за O(log n).
+         *
+         *  В этом дереве остаются элементы, меньшие \c key, а элементы, большие \c key, переходят
+         *  в возвращаемое дерево (с тем же аллокатором). Сам \c key, если он был в дереве, удаляется,
+         *  а в \c found (если передан) записывается, был ли он.
+         */
+        RBTree split(const Element &key, bool *found = nullptr);
+
+        /** \brief Как \c split(), но элемент, эквивалентный \c key, не удаляется, а вместе с большими
+         *  переходит в возвращаемое дерево. Память не выделяется и не освобождается.
+         */
+        RBTree splitFrom(const Element &key);
+
+    public:
+        // Теоретико-множественные операции
+
+        /** \brief Порог по умолчанию (в элементах), начиная с которого ветви рекурсии отдаются пулу. */
+        static const std::size_t DEFAULT_SETOP_GRAIN = 4096;
+
+        /** \brief Добавляет в дерево все элементы \c other, оставляя \c other пустым.
+         *
+         *  Алгоритм "разделяй и властвуй" на склейке: \c other разрезается по корню этого дерева,
+         *  левые и правые половины объединяются рекурсивно, а результаты склеиваются обратно через
+         *  корень. Для деревьев размеров m <= n это O(m log(n/m + 1)) сравнений — от O(log n) для
+         *  одиночного элемента до O(n) для равных размеров. Узлы переходят в результат без
+         *  копирования, а узлы-дубликаты из \c other освобождаются.
+         *
+         *  Если передан \c pool, рекурсивные ветви над поддеревьями не меньше \c grain элементов
+         *  выполняются в нем параллельно (глубина рекурсии O(log n)). Память во время параллельной
+         *  части не выделяется и не освобождается, так что аллокатор не обязан быть потокобезопасным,
+         *  а вот компаратор вызывается из разных потоков одновременно. Аллокаторы деревьев должны быть
+         *  равны, иначе генерируется \c std::invalid_argument.
+         *
+         *  Определения теоретико-множественных операций — в rbsetops.h.
+         */
+        void unionWith(RBTree &&other, WorkStealingPool *pool = nullptr, std::size_t grain = DEFAULT_SETOP_GRAIN);
+
+        /** \brief Оставляет в дереве только элементы, которые есть и в \c other. Остальное — как у \c unionWith(). */
+        void intersectWith(RBTree &&other, WorkStealingPool *pool = nullptr,
+                           std::size_t grain = DEFAULT_SETOP_GRAIN);
+
+        /** \brief Удаляет из дерева все элементы, которые есть в \c other. Остальное — как у \c unionWith(). */
+        void differenceWith(RBTree &&other, WorkStealingPool *pool = nullptr,
+                            std::size_t grain = DEFAULT_SETOP_GRAIN);
+
+    public:
+        // Основные операции над деревом
+
+        /** \brief Вставляет элемент \c key в дерево.
+         *
+         *
+         *  <b style='color:orange'>Для реализации студентами.</b>
+         *
+         *  Т.к. дубликаты не допустимы, элемента с ключом \c key в дереве быть не должно. Если
+         *  же такой элемент уже существует, генерируется исключительная ситуация \c std::invalid_argument.
+         *  Место для элемента ищется до создания узла, так что дубликат не стоит ни выделения памяти,
+         *  ни копирования.
+         */
+        void insert(const Element &key);
+
+        /** \brief Вставляет элемент \c key, перемещая его в узел. Дубликаты — как у \c insert(const Element&). */
+        void insert(Element &&key);
+
+        /** \brief Вставляет элемент \c key, если эквивалентного ему еще нет, без исключений.
+         *
+         *  \returns пару из итератора на элемент дерева, эквивалентный \c key (вставленный или уже
+         *  бывший), и признака того, что вставка состоялась. Узел создается, только если место свободно.
+         */
+        std::pair<const_iterator, bool> tryInsert(const Element &key);
+
+        /** \brief То же, что \c tryInsert(const Element&), но элемент перемещается в узел. */
+        std::pair<const_iterator, bool> tryInsert(Element &&key);
+
+        /** \brief Вставляет элемент \c key с подсказкой: \c hint — элемент, перед которым \c key должен
+         *  встать (как у \c std::set::insert(hint, key)).
+         *
+         *  При верной подсказке место находится за амортизированное O(1), при неверной — поиском
+         *  от подсказки (сначала вверх до поддерева, содержащего \c key, затем вниз), то есть за
+         *  O(log d), где d — расстояние от подсказки до места вставки. Подсказка \c end() при ключе больше
+         *  максимального не требует спуска вовсе: дописывание в конец стоит O(1) плюс перебалансировка.
+         *
+         *  \returns итератор на вставленный элемент или на уже бывший эквивалентный (исключения нет).
+         */
+        const_iterator insert(const_iterator hint, const Element &key);
+
+        /** \brief То же, что \c insert(const_iterator, const Element&), но элемент перемещается в узел. */
+        const_iterator insert(const_iterator hint, Element &&key);
+
+        /** \brief Конструирует элемент из \c args прямо в узле и вставляет его, если эквивалентного нет.
+         *
+         *  Результат — как у \c tryInsert(). Если передан единственный аргумент типа \c Element, это
+         *  и есть \c tryInsert(): сначала поиск, потом узел. Иначе ключ неизвестен, пока элемент не построен,
+         *  поэтому узел создается заранее и при дубликате освобождается (как у \c std::set::emplace()).
+         */
+        template<typename... Args>
+        std::pair<const_iterator, bool> emplace(Args &&... args)
+        { return emplaceImpl(IsSingleElement<Args...>(), std::forward<Args>(args)...); }
+
+#ifdef RBTREE_WITH_DELETION
+
+        /** \brief Ищет узел, соответствующий ключу \c key, и удаляет узел из дерева
+         *  с последующей перебалансировкой.
+         *
+         *  <b style='color:orange'>Для реализации студентами.</b>
+         *
+         *  Если соответствующего ключа нет в дереве, генерирует исключительную ситуацию \c std::invalid_argument.
+         */
+        void remove(const Element &key);
+
+        /** \brief Хелперный метод для удаления, заменяющий один узел другим
+         *
+         * @param before узел, который был
+         * @param after узел, которым надо заменить
+         */
+        void transplant(const Node *before, Node *after);
+
+
+        /** \brief Осуществляет перебалансировку после удаления элемента
+         *
+         * @param cur узел, занявший место удаленного; может быть nullptr
+         * @param parent отец \c cur — нужен, чтобы утряска не теряла дорогу наверх от пустого листа
+         */
+        void rebalanceDel(Node *cur, Node *parent);
+
+
+#endif
+
+        /** \brief Ищет элемент \c key в дереве и возвращает соответствующий ему узел.
+         *
+         *  <b style='color:orange'>Для реализации студентами.</b>
+         *
+         *  Элементы сравниваются только компаратором, \c operator== не нужен: спуск делает одно
+         *  сравнение на уровень, как \c lower_bound(), и еще одно в конце для проверки эквивалентности.
+         *  Если у компаратора есть трехсторонний \c compare() (см. \c ComparHasThreeWay), на уровень
+         *  приходится один его вызов, а поиск останавливается на найденном узле.
+         *
+         *  \returns узел элемента \c key, если он есть в дереве, иначе \c nullptr.
+         */
+        const Node *find(const Element &key) const
+        { return findNode(key); }
+
+        /** \brief Ищет \c n элементов \c keys разом: \c out[i] получает то же, что \c find(keys[i]).
+         *
+         *  Поиски идут группами по \c BATCH_GROUP в ногу: за шаг каждый спускается на один уровень и
+         *  заранее запрашивает (prefetch) узел, в который пойдет следующим. Пока очередь дойдет до
+         *  него снова, узел уже едет из памяти, так что промахи кэша разных поисков перекрываются.
+         *  На дереве, которое не помещается в кэш, это в разы быстрее \c find() по одному.
+         */
+        void findBatch(const Element *keys, std::size_t n, const Node **out) const;
+
+        /** \brief Сколько поисков \c findBatch() ведет в ногу: столько промахов перекрываются. */
+        static const std::size_t BATCH_GROUP = 16;
+
+        /** \brief Ищет элемент, эквивалентный \c key другого типа. Доступно, только если компаратор
+         *  прозрачный (определяет \c is_transparent) и умеет сравнивать \c K с \c Element в обе стороны.
+         */
+        template<typename K, typename C = Compar, typename = typename C::is_transparent>
+        const Node *find(const K &key) const
+        { return findNode(key); }
+
+        /** \brief Удаляет из дерева все элементы.
+         *
+         *  Узлы обходятся итеративно, без рекурсии, за O(n). Если узлы берутся из пула,
+         *  которым дерево владеет единолично, а элементы тривиально разрушаемы, то пул
+         *  просто сбрасывается за O(1), без обхода.
+         */
+        void clear();
+
+        /** \brief Возвращает истину, если дерево пусто, ложь иначе. */
+        bool isEmpty() const
+        { return _root == nullptr; }
+
+        /** \brief Возвращает число элементов в дереве.
+         *
+         *  Счетчик ведется вставкой и удалением, так что обычно это O(1). После \c split() размеры
+         *  частей без RBTREE_WITH_ORDER_STATISTICS заранее неизвестны, и первый вызов пересчитывает
+         *  их обходом за O(n). Пересчет запоминается атомарно, так что \c size() константного дерева,
+         *  как и остальные константные методы, можно звать из нескольких потоков сразу.
+         */
+        std::size_t size() const
+        {
+            std::size_t count = getCount();
+            if (count == UNKNOWN_SIZE)
+            {
+                // Одновременные пересчеты дают одно и то же число, так что гонка между ними безвредна
+                count = countNodes(_root);
+                setCount(count);
+            }
+            return count;
+        }
+
+        /** \brief Возвращает минимальный элемент за O(1).
+         *  Если дерево пусто, генерируется исключительная ситуация \c std::out_of_range.
+         */
+        const Element &min() const;
+
+        /** \brief Возвращает максимальный элемент за O(1). Пустое дерево — как у \c min(). */
+        const Element &max() const;
+
+        /** \brief Извлекает минимальный элемент: узел отцепляется сразу, без поиска по ключу.
+         *
+         *  Элемент перемещается в результат, узел освобождается. Перебалансировка — как у \c remove(),
+         *  то есть амортизированно O(1). Пустое дерево — как у \c min().
+         */
+        Element popMin();
+
+        /** \brief Извлекает максимальный элемент. Все остальное — как у \c popMin(). */
+        Element popMax();
+
+        /** \brief Возвращает неизменяемый указатель на корневой элемент. */
+        const Node *getRoot() const
+        { return _root; }
+
+    public:
+        // Итераторы и поиск границ
+
+        /** \brief Итератор на минимальный элемент. */
+        const_iterator begin() const
+        { return const_iterator(_leftmost, this); }
+
+        /** \brief Итератор за максимальным элементом. */
+        const_iterator end() const
+        { return const_iterator(nullptr, this); }
+
+        const_iterator cbegin() const
+        { return begin(); }
+
+        const_iterator cend() const
+        { return end(); }
+
+        const_reverse_iterator rbegin() const
+        { return const_reverse_iterator(end()); }
+
+        const_reverse_iterator rend() const
+        { return const_reverse_iterator(begin()); }
+
+        const_reverse_iterator crbegin() const
+        { return rbegin(); }
+
+        const_reverse_iterator crend() const
+        { return rend(); }
+
+        /** \brief Возвращает итератор на первый элемент, не меньший \c key, или \c end(). */
+        const_iterator lower_bound(const Element &key) const
+        { return const_iterator(lowerBoundNode(key), this); }
+
+        /** \brief Возвращает итератор на первый элемент, строго больший \c key, или \c end(). */
+        const_iterator upper_bound(const Element &key) const
+        { return const_iterator(upperBoundNode(key), this); }
+
+        /** \brief Возвращает диапазон элементов, эквивалентных \c key: пустой или из одного элемента. */
+        std::pair<const_iterator, const_iterator> equal_range(const Element &key) const
+        { return equalRange(key); }
+
+        // Варианты для ключей другого типа при прозрачном компараторе, как у find()
+
+        template<typename K, typename C = Compar, typename = typename C::is_transparent>
+        const_iterator lower_bound(const K &key) const
+        { return const_iterator(lowerBoundNode(key), this); }
+
+        template<typename K, typename C = Compar, typename = typename C::is_transparent>
+        const_iterator upper_bound(const K &key) const
+        { return const_iterator(upperBoundNode(key), this); }
+
+        template<typename K, typename C = Compar, typename = typename C::is_transparent>
+        std::pair<const_iterator, const_iterator> equal_range(const K &key) const
+        { return equalRange(key); }
+
+    public:
+        // Запросы по диапазону
+
+        /** \brief Вызывает \c visitor(elem) для каждого элемента из полуинтервала [lo, hi) по возрастанию.
+         *
+         *  Поддеревья, целиком лежащие вне диапазона, отсекаются сравнениями с \c lo и \c hi, а
+         *  внутри поддерева, про которое уже известно, что оно не меньше \c lo (или меньше \c hi),
+         *  соответствующая граница больше не проверяется. Итого O(log n + k), где k — число
+         *  найденных элементов. Посетитель передается параметром шаблона и встраивается компилятором.
+         */
+        template<typename Visitor>
+        void forEachInRange(const Element &lo, const Element &hi, Visitor visitor) const;
+
+        /** \brief Возвращает число элементов в полуинтервале [lo, hi).
+         *
+         *  За O(log n + k) обходом диапазона, а с RBTREE_WITH_ORDER_STATISTICS — за O(log n)
+         *  как разность рангов границ.
+         */
+        std::size_t countInRange(const Element &lo, const Element &hi) const;
+
+    public:
+        // Неизменяемая копия для поиска
+
+        /** \brief Копирует элементы обходом по возрастанию в неизменяемое статическое B+-дерево,
+         *  плотно уложенное в память блоками по линии кэша (см. \c FrozenRBTree в rbfrozen.h).
+         *
+         *  Само дерево не меняется; копия от него не зависит. Определение — в rbfrozen.h.
+         */
+        FrozenRBTree<Element, Compar> freeze() const;
+
+#ifdef RBTREE_WITH_ORDER_STATISTICS
+
+    public:
+        // Порядковые статистики
+
+        /** \brief Возвращает итератор на k-й по возрастанию элемент (с нуля) или \c end(),
+         *  если \c k не меньше числа элементов. O(log n).
+         */
+        const_iterator select(std::size_t k) const;
+
+        /** \brief Возвращает число элементов, строго меньших \c key (позицию \c lower_bound(key)). O(log n). */
+        std::size_t rank(const Element &key) const;
+
+#endif // RBTREE_WITH_ORDER_STATISTICS
+
+        /** \brief Возвращает копию аллокатора дерева. */
+        allocator_type getAllocator() const
+        { return allocator_type(_nodeAlloc); }
+
+#ifdef RBTREE_WITH_STATS
+
+    public:
+        // Статистика
+
+        /** \brief Возвращает снимок накопленной статистики.
+         *
+         *  Счетчики атомарные, так что параллельные find() считаются верно, но снимок, снятый во
+         *  время изменений дерева, может быть не согласован между счетчиками.
+         */
+        RBTreeStats getStats() const;
+
+        /** \brief Обнуляет статистику. */
+        void resetStats()
+        { _stats.reset(); }
+
+#endif // RBTREE_WITH_STATS
+
+    public:
+        // Отладочные операции
+
+        /** \brief Политика отладочных событий дерева (например, чтобы назначить слушателя). */
+        Dumper &getDumper()
+        { return *this; }
+
+        /** \brief Устанавливает отладочный дампер. Есть, если его принимает политика \c Dumper
+         *  (\c RBTreeVirtualDumper); у дерева с \c RBTreeNoDumper вызов не компилируется.
+         */
+        template<typename Listener>
+        void setDumper(Listener *dumper)
+        { Dumper::setDumper(dumper); }
+
+        /** \brief Сбрасывает отладочный дампер (см. \c setDumper()). */
+        void resetDumper()
+        { Dumper::resetDumper(); }
+
+
+    protected:
+
+
+        /** \brief Добавляет новый узел в дерево, как в обычном BST.
+         *
+         *  <b style='color:orange'>Для реализации студентами.</b>
+         *
+         *  Дубликаты не разрешены, исключение то же, что и у \c insert().
+         *  \return Указатель на новодобавленный элемент.
+         */
+        Node *insertNewBstEl(const Element &key);
+
+        /** \brief Ищет место для вставки элемента \c key.
+         *
+         *  \returns узел, эквивалентный \c key, если такой уже есть. Иначе nullptr, а в \c parent и
+         *  \c goLeft записывается, куда подвешивать новый узел (\c parent — nullptr, если дерево пусто).
+         */
+        template<typename K>
+        Node *findInsertPos(const K &key, Node *&parent, bool &goLeft) const
+        { return findInsertPos(key, _root, parent, goLeft, ComparHasThreeWay<Compar, K, Element>()); }
+
+        /** \brief Спуск с трехсторонним компаратором от узла \c from: останавливается на эквивалентном узле. */
+        template<typename K>
+        Node *findInsertPos(const K &key, Node *from, Node *&parent, bool &goLeft, std::true_type) const;
+
+        /** \brief Спуск от узла \c from с одним сравнением на уровень и проверкой эквивалентности в конце. */
+        template<typename K>
+        Node *findInsertPos(const K &key, Node *from, Node *&parent, bool &goLeft, std::false_type) const;
+
+        /** \brief Ищет место для вставки \c key, начиная с узла-подсказки \c hint (nullptr — конец дерева).
+         *
+         *  Результат — как у \c findInsertPos(). Если \c key лежит между \c hint и его соседом, место
+         *  рядом с ними, иначе поднимаемся от \c hint до первого поддерева, в границы которого \c key
+         *  заведомо попадает, и спускаемся уже в нем.
+         */
+        Node *findInsertPosNear(const Element &key, Node *hint, Node *&parent, bool &goLeft) const;
+
+        /** \brief Пересчитывает \c _leftmost и \c _rightmost по текущему корню за O(log n). */
+        void updateExtremes()
+        {
+            _leftmost = _root ? (Node *) _root->getLeftmost() : nullptr;
+            _rightmost = _root ? (Node *) _root->getRightmost() : nullptr;
+        }
+
+        /** \brief Делает \c root корнем дерева из \c count узлов и пересчитывает крайние узлы. */
+        void resetRoot(Node *root, std::size_t count)
+        {
+            _root = root;
+            setCount(count);
+            updateExtremes();
+        }
+
+        /** \brief Число узлов в поддереве \c nd: обходом или, с порядковыми статистиками, за O(1). */
+        static std::size_t countNodes(const Node *nd);
+
+        /** \brief Число элементов части после разрезания: с RBTREE_WITH_ORDER_STATISTICS — размер корня,
+         *  иначе \c UNKNOWN_SIZE (досчитает \c size(), если понадобится).
+         */
+        static std::size_t splitCount(const Node *nd)
+        {
+#ifdef RBTREE_WITH_ORDER_STATISTICS
+            return Node::sizeOf(nd);
+#else
+            (void) nd;
+            return UNKNOWN_SIZE;
+#endif
+        }
+
+        /** \brief Число элементов или \c UNKNOWN_SIZE. */
+        std::size_t getCount() const
+        { return _count.load(std::memory_order_relaxed); }
+
+        /** \brief Запоминает число элементов \c count. Константный ради пересчета в \c size(). */
+        void setCount(std::size_t count) const
+        { _count.store(count, std::memory_order_relaxed); }
+
+        /** \brief Сумма двух размеров, неизвестная, если неизвестен хотя бы один. */
+        static std::size_t addSizes(std::size_t a, std::size_t b)
+        { return (a == UNKNOWN_SIZE || b == UNKNOWN_SIZE) ? UNKNOWN_SIZE : a + b; }
+
+        /** \brief Отцепляет крайний узел \c nd, перемещает из него элемент и освобождает узел. */
+        Element popNode(Node *nd);
+
+        /** \brief Подвешивает узел \c nd к \c parent (слева, если \c goLeft) как в BST, без перебалансировки. */
+        void linkNode(Node *nd, Node *parent, bool goLeft);
+
+        /** \brief Подвешивает новый узел \c nd на найденное \c findInsertPos() место и перебалансирует дерево. */
+        void attachNode(Node *nd, Node *parent, bool goLeft);
+
+        /** \brief Вставка элемента, эквивалентного которому нет: поиск места, затем узел из \c key. */
+        template<typename Arg>
+        std::pair<const_iterator, bool> tryInsertImpl(Arg &&key);
+
+        /** \brief Итератор на узел \c nd этого дерева (для производных контейнеров, см. \c RBMap). */
+        const_iterator makeIterator(const Node *nd) const
+        { return const_iterator(nd, this); }
+
+        /** \brief Вставка с подсказкой: поиск места от \c hint, затем узел из \c key. */
+        template<typename Arg>
+        const_iterator insertHintImpl(const_iterator hint, Arg &&key);
+
+        /** \brief Признак того, что в \c emplace() передан ровно один аргумент типа \c Element. */
+        template<typename... Args>
+        struct IsSingleElement : std::false_type
+        {
+        };
+
+        template<typename Arg>
+        struct IsSingleElement<Arg> : std::is_same<typename std::decay<Arg>::type, Element>
+        {
+        };
+
+        /** \brief \c emplace() из готового элемента — это \c tryInsert(). */
+        template<typename Arg>
+        std::pair<const_iterator, bool> emplaceImpl(std::true_type, Arg &&key)
+        { return tryInsertImpl(std::forward<Arg>(key)); }
+
+        /** \brief \c emplace() из аргументов конструктора: узел строится до поиска. */
+        template<typename... Args>
+        std::pair<const_iterator, bool> emplaceImpl(std::false_type, Args &&... args);
+
+        /** \brief Выполняет перебалансировку дерева после добавления нового элемента в узел \c nd.
+         *
+         *  <b style='color:orange'>Для реализации студентами.</b>
+         *
+         *  \returns истину, если черная высота дерева выросла (корень пришлось перекрасить в черный
+         *  или \c nd сам стал корнем). Нужно склейке, чтобы не пересчитывать высоту спуском.
+         */
+        bool rebalance(Node *nd);
+
+        /** \brief Выполняет перебалансировку локальных предков узла \c nd: папы, дяди и дедушки.
+         *
+         *  <b style='color:orange'>Метод может быть реализован студентами в порядке декомпозиции.</b>
+         *
+         *  \returns Новый актуальный узел, для которого могут нарушаться правила.
+         */
+        Node *rebalanceDUG(Node *nd);
+
+        /** \brief Вид операции, на счет которой идет статистика (см. RBTREE_WITH_STATS). */
+        enum StatPhase
+        {
+            SP_INSERT,
+            SP_REMOVE,
+            SP_LOOKUP
+        };
+
+        /** \brief Учитывает \c cmps сравнений; поиск по \c find() попадает еще и в гистограмму путей длины \c path. */
+        void noteSearch(StatPhase phase, std::size_t path, std::size_t cmps) const
+        {
+#ifdef RBTREE_WITH_STATS
+            _stats.phases[phase].comparisons.fetch_add(cmps, std::memory_order_relaxed);
+            if (phase == SP_LOOKUP)
+            {
+                _stats.phases[phase].operations.fetch_add(1, std::memory_order_relaxed);
+                std::size_t bucket = path < RBTreeStats::PATH_BUCKETS ? path : RBTreeStats::PATH_BUCKETS - 1;
+                _stats.findPath[bucket].fetch_add(1, std::memory_order_relaxed);
+            }
+#else
+            (void) phase;
+            (void) path;
+            (void) cmps;
+#endif
+        }
+
+        /** \brief Учитывает один вставленный или удаленный узел. */
+        void noteOperation(StatPhase phase)
+        {
+#ifdef RBTREE_WITH_STATS
+            _stats.phases[phase].operations.fetch_add(1, std::memory_order_relaxed);
+#else
+            (void) phase;
+#endif
+        }
+
+        /** \brief Учитывает один проход перебалансировки: итерации цикла, повороты и перекраски. */
+        void noteFixup(StatPhase phase, std::size_t iterations, std::size_t rotations, std::size_t recolors)
+        {
+#ifdef RBTREE_WITH_STATS
+            _stats.phases[phase].fixupIterations.fetch_add(iterations, std::memory_order_relaxed);
+            _stats.phases[phase].rotations.fetch_add(rotations, std::memory_order_relaxed);
+            _stats.phases[phase].recolors.fetch_add(recolors, std::memory_order_relaxed);
+#else
+            (void) phase;
+            (void) iterations;
+            (void) rotations;
+            (void) recolors;
+#endif
+        }
+
+        /** \brief Переносит в статистику дерева счетчики рабочего дерева \c work, которое операция
+         *  заводила для своих шагов (теоретико-множественные операции, ветви на пуле потоков).
+         */
+        void mergeStats(const RBTree &work)
+        {
+#ifdef RBTREE_WITH_STATS
+            _stats.add(work._stats);
+#else
+            (void) work;
+#endif
+        }
+
+        /** \brief Сообщает политике событий \c Dumper о событии \c ev с узлом \c nd. */
+        void dumpEvent(RBTreeDumperEvents::RBTreeDumperEvent ev, Node *nd)
+        { Dumper::rbTreeEvent(ev, this, nd); }
+
+        /** \brief Поиск узла, эквивалентного \c key; выбирает трехсторонний вариант, если компаратор умеет.
+         *  Сравнения идут в статистику операции \c phase.
+         */
+        template<typename K>
+        const Node *findNode(const K &key, StatPhase phase = SP_LOOKUP) const
+        { return findNode(key, phase, ComparHasThreeWay<Compar, K, Element>()); }
+
+        /** \brief Поиск с трехсторонним компаратором: один вызов \c compare() на уровень. */
+        template<typename K>
+        const Node *findNode(const K &key, StatPhase phase, std::true_type) const;
+
+        /** \brief Поиск через \c lowerBoundNode() и одну проверку эквивалентности в конце. */
+        template<typename K>
+        const Node *findNode(const K &key, StatPhase phase, std::false_type) const;
+
+        /** \brief Первый узел, не меньший \c key, или nullptr. */
+        template<typename K>
+        const Node *lowerBoundNode(const K &key) const
+        {
+            std::size_t path;
+            return lowerBoundNode(key, path);
+        }
+
+        /** \brief То же, что \c lowerBoundNode(const K&), и число пройденных узлов в \c path. */
+        template<typename K>
+        const Node *lowerBoundNode(const K &key, std::size_t &path) const;
+
+        /** \brief Первый узел, строго больший \c key, или nullptr. */
+        template<typename K>
+        const Node *upperBoundNode(const K &key) const;
+
+        /** \brief Общая часть обоих вариантов \c equal_range(). */
+        template<typename K>
+        std::pair<const_iterator, const_iterator> equalRange(const K &key) const;
+
+        /** \brief Обходит по порядку часть поддерева \c nd, попадающую в [lo, hi).
+         *
+         *  Флаги \c loDone и \c hiDone говорят, что все поддерево заведомо не меньше \c lo
+         *  и, соответственно, меньше \c hi, и эту границу сравнивать уже не нужно.
+         */
+        template<typename Visitor>
+        void visitRange(const Node *nd, const Element &lo, const Element &hi, Visitor &visitor,
+                        bool loDone, bool hiDone) const;
+
+        // Поддержка размеров поддеревьев. Без RBTREE_WITH_ORDER_STATISTICS методы пустые
+        // и полностью исчезают при встраивании.
+
+        /** \brief Увеличивает на единицу размеры всех поддеревьев от \c nd до корня. */
+        void growPath(Node *nd)
+        {
+#ifdef RBTREE_WITH_ORDER_STATISTICS
+            for (; nd; nd = nd->_parent)
+                ++nd->_size;
+#else
+            (void) nd;
+#endif
+        }
+
+        /** \brief Уменьшает на единицу размеры всех поддеревьев от \c nd до корня. */
+        void shrinkPath(Node *nd)
+        {
+#ifdef RBTREE_WITH_ORDER_STATISTICS
+            for (; nd; nd = nd->_parent)
+                --nd->_size;
+#else
+            (void) nd;
+#endif
+        }
+
+        /** \brief Пересчитывает размер поддерева \c nd по его детям. */
+        void fixSize(Node *nd)
+        {
+#ifdef RBTREE_WITH_ORDER_STATISTICS
+            nd->_size = 1 + Node::sizeOf(nd->_left) + Node::sizeOf(nd->_right);
+#else
+            (void) nd;
+#endif
+        }
+
+        /** \brief Собирает дерево из \c n возрастающих элементов начиная с \c first и возвращает его корень. */
+        template<typename ForwardIt>
+        Node *buildSortedRoot(ForwardIt first, std::size_t n);
+
+        /** \brief Собирает из следующих \c n элементов \c it идеально сбалансированное поддерево.
+         *
+         *  \param depth глубина корня собираемого поддерева.
+         *  \param redDepth глубина, узлы на которой красятся в красный (нижний неполный уровень).
+         *  \param prev последний уже уложенный в дерево элемент (nullptr, если таких нет),
+         *  с ним сравнивается очередной для проверки строгого возрастания.
+         */
+        template<typename ForwardIt>
+        Node *buildSorted(ForwardIt &it, std::size_t n, std::size_t depth, std::size_t redDepth,
+                          const Element *&prev);
+
+        /** \brief Пишет в \c out форму поддерева \c nd в прямом порядке обхода (см. \c RBTreeSnapshotHeader). */
+        template<typename ShapeWriter>
+        static void saveShape(const Node *nd, ShapeWriter &out);
+
+        /** \brief Собирает поддерево по записанной форме: биты узлов берутся из \c shape в прямом
+         *  порядке, элементы из \c it — по возрастанию.
+         *
+         *  \param remaining сколько элементов еще осталось в файле; форма не может требовать больше.
+         *  \param bh получает черную высоту поддерева.
+         */
+        template<typename KeyIt, typename ShapeReader>
+        Node *buildShaped(KeyIt &it, ShapeReader &shape, std::size_t &remaining, std::size_t depth,
+                          const Element *&prev, std::size_t &bh);
+
+        /** \brief Строит дерево из \c header.count элементов \c it и, если записана, формы \c shape. */
+        template<typename KeyIt, typename ShapeReader>
+        static RBTree restore(const RBTreeSnapshotHeader &header, KeyIt it, ShapeReader &shape,
+                              const Compar &compar, const Allocator &alloc);
+
+        /** \brief Вынимает узел \c nd из дерева с последующей перебалансировкой, но память не освобождает.
+         *  Узел выходит из дерева без связей, его можно освободить или переиспользовать.
+         */
+        void unlinkNode(Node *nd);
+
+        /** \brief Черная высота поддерева \c nd: число черных узлов на пути от него до листа. */
+        static std::size_t blackHeight(const Node *nd);
+
+        /** \brief Склеивает поддеревья \c l и \c r черных высот \c bhL и \c bhR через узел \c k.
+         *
+         *  Использует \c _root как рабочий регистр: на время склейки в нем лежит более высокое
+         *  поддерево, чтобы повороты и \c rebalance() работали как обычно. Корни \c l и \c r
+         *  не должны иметь отцов.
+         *
+         *  \param bh получает черную высоту результата.
+         *  \returns корень склеенного дерева (всегда черный).
+         */
+        Node *joinNodes(Node *l, std::size_t bhL, Node *k, Node *r, std::size_t bhR, std::size_t &bh);
+
+        /** \brief Разрезает поддерево \c t черной высоты \c bh по ключу \c key на части \c l и \c r.
+         *
+         *  Узел с ключом \c key, если есть, возвращается в \c mid отвязанным. Корни частей могут
+         *  оказаться красными, их черная высота посчитана без учета перекраски. Как и \c joinNodes(),
+         *  портит \c _root.
+         */
+        void splitNodes(Node *t, std::size_t bh, const Element &key,
+                        Node *&l, std::size_t &bhL, Node *&r, std::size_t &bhR, Node *&mid);
+
+        /** \brief Склеивает поддеревья \c l и \c r без разделителя: им становится вынутый минимум \c r. */
+        Node *concatNodes(Node *l, std::size_t bhL, Node *r, std::size_t bhR, std::size_t &bh);
+
+        /** \brief Вид теоретико-множественной операции. */
+        enum SetOperation
+        {
+            SO_UNION,
+            SO_INTERSECTION,
+            SO_DIFFERENCE
+        };
+
+        /** \brief Список выброшенных операцией поддеревьев, сцепленных через \c _parent их корней.
+         *
+         *  Узлы копятся в списке, пока идет (возможно, параллельная) рекурсия, а освобождаются
+         *  потом разом в вызывающем потоке.
+         */
+        struct NodeList
+        {
+            Node *head;
+            Node *tail;
+
+            NodeList()
+                    : head(nullptr), tail(nullptr)
+            {}
+
+            /** \brief Добавляет поддерево \c nd (его корень не должен иметь отца). */
+            void push(Node *nd)
+            {
+                if (!nd)
+                    return;
+                nd->_parent = head;
+                head = nd;
+                if (!tail)
+                    tail = nd;
+            }
+
+            /** \brief Забирает все элементы списка \c other. */
+            void splice(NodeList &other)
+            {
+                if (!other.head)
+                    return;
+                other.tail->_parent = head;
+                head = other.head;
+                if (!tail)
+                    tail = other.tail;
+                other.head = other.tail = nullptr;
+            }
+        };
+
+        /** \brief Общая часть \c unionWith(), \c intersectWith() и \c differenceWith(). */
+        void combineWith(SetOperation op, RBTree &&other, WorkStealingPool *pool, std::size_t grain);
+
+        /** \brief Рекурсивно выполняет операцию \c op над поддеревьями \c t1 и \c t2 и возвращает корень результата.
+         *
+         *  Как и \c joinNodes(), использует \c _root как рабочий регистр, поэтому параллельные ветви
+         *  работают каждая со своим временным деревом.
+         *
+         *  \param bh получает черную высоту результата (его корень может оказаться красным).
+         *  \param garbage сюда складываются узлы, не попавшие в результат.
+         *  \param forkBh ветви над поддеревьями \c t1 черной высоты от \c forkBh отдаются пулу.
+         */
+        Node *combineNodes(SetOperation op, Node *t1, std::size_t bh1, Node *t2, std::size_t bh2, std::size_t &bh,
+                           NodeList &garbage, WorkStealingPool *pool, std::size_t forkBh);
+
+        /** \brief Удаляет нод со всеми его потомками, освобождая память из-под них. */
+        void deleteNode(Node *nd);
+
+        /** \brief Выделяет память под узел через аллокатор дерева и конструирует в ней одиночный
+         *  черный узел с ключом, построенным из \c args.
+         */
+        template<typename... Args>
+        Node *createNode(Args &&... args);
+
+        /** \brief Разрушает одиночный узел \c nd и возвращает память аллокатору. Связи не трогает. */
+        void destroyNode(Node *nd);
+
+        /** \brief Освобождает узел \c nd вместе со всеми его потомками. Связи с родителем не трогает.
+         *
+         *  Обход итеративный: спускаемся до листа, освобождаем его и поднимаемся по \c _parent.
+         *  \returns число освобожденных узлов.
+         */
+        std::size_t destroySubtree(Node *nd);
+
+        /** \brief Пытается освободить все узлы дерева разом через аллокатор.
+         *  \returns истину, если получилось, иначе узлы надо освобождать поштучно.
+         */
+        bool releaseAllNodes(std::true_type);
+
+        /** \brief Вариант для аллокаторов и элементов, не допускающих сброса пачкой. */
+        bool releaseAllNodes(std::false_type)
+        { return false; }
+
+        /** \brief Вращает поддерево относительно узла \c nd влево.
+         *
+         *  Требование: правый ребенок узла \c nd не должен быть null, иначе генерируется
+         *  исключительная ситуация \c std::invalid_argument.
+         *
+         */
+        void rotLeft(Node *nd);
+
+        /** \brief Вращает поддерево относительно узла \c nd вправо. Условия и ограничения
+          * аналогичны (симметрично) левому вращению.
+          */
+        void rotRight(Node *nd);
+
+
+    protected:
+        /** \brief Метка конструктора, создающего пустое дерево с уже готовым аллокатором узлов. */
+        struct SiblingTag
+        {
+        };
+
+        /** \brief Пустое дерево, разделяющее аллокатор узлов с другим деревом (нужно при разрезании). */
+        RBTree(const Compar &compar, const NodeAllocator &nodeAlloc, SiblingTag);
+
+        /** \brief Перенимает аллокатор, если он распространяется при перемещении контейнера. */
+        void assignAllocator(const NodeAllocator &alloc, std::true_type)
+        { _nodeAlloc = alloc; }
+
+        /** \brief Аллокатор не распространяется — оставляем свой. */
+        void assignAllocator(const NodeAllocator &, std::false_type)
+        {}
+
+    protected:
+        RBTree(const RBTree &);                      ///< КК не доступен.
+        RBTree &operator=(RBTree &);                ///< Оператор присваивания недоступен.
+
+    protected:
+        Compar _compar;                             ///< Компаратор сравнения двух элементов.
+        NodeAllocator _nodeAlloc;                   ///< Аллокатор узлов дерева.
+
+    protected:
+        // Структура дерева
+
+        /** \brief Реальный корневой элемент дерева. Если \c nullptr, значит дерево пусто.
+         *
+         *  NB: иногда используется реализация, где корень дерева хранится не непосредственно
+         *  в виде выделенного узла, а в виде правого потомка специального сторожевого (sentinel)
+         *  элемента псевдо-корня. Это позволяет несколько упростить запись алгоритма за счет того,
+         *  что исключается необходимость проверки специальных случаев с корнем. Однако это,
+         *  в свою очередь, требует обеспечение корректной проверки, что левый потомок сторожевого
+         *  узла всегда будет иметь порядок -INF, что, в свою очередь, накладывает дополнительные
+         *  ограничения на предикат сравнение элементов, поэтому в настоящей реализации не используется.
+         *
+         *  С RBTREE_ATOMIC_LINKS корень, как и связи узлов, атомарный: с него начинают спуск читатели
+         *  \c ConcurrentRBTree.
+         */
+#ifdef RBTREE_ATOMIC_LINKS
+        AtomicPtr<Node> _root;
+#else
+        Node *_root;
+#endif
+
+        /** \brief Узлы с минимальным и максимальным элементами (nullptr для пустого дерева).
+         *
+         *  Поддерживаются вставкой и удалением за O(1), а операциями, которые меняют дерево целиком
+         *  (слияние, разрезание, построение), пересчитываются спуском по краям.
+         */
+        Node *_leftmost;
+        Node *_rightmost;
+
+        /** \brief Признак того, что число элементов неизвестно и будет пересчитано в \c size(). */
+        static const std::size_t UNKNOWN_SIZE = (std::size_t) -1;
+
+        /** \brief Число элементов дерева или \c UNKNOWN_SIZE. Атомарно только ради ленивого пересчета
+         *  в \c size() const: все обращения — relaxed, то есть обычные чтения и записи.
+         */
+        mutable std::atomic<std::size_t> _count;
+
+
+    protected:
+#ifdef RBTREE_WITH_STATS
+        /** \brief Счетчики одного вида операций, см. \c RBTreeStats::Phase. */
+        struct PhaseCounters
+        {
+            std::atomic<std::uint64_t> operations;
+            std::atomic<std::uint64_t> comparisons;
+            std::atomic<std::uint64_t> rotations;
+            std::atomic<std::uint64_t> recolors;
+            std::atomic<std::uint64_t> fixupIterations;
+        };
+
+        /** \brief Накопленная статистика; атомарная, чтобы не мешали друг другу параллельные find(). */
+        struct StatsCounters
+        {
+            PhaseCounters phases[3];                                        ///< По индексам StatPhase.
+            std::atomic<std::uint64_t> nodesAllocated;
+            std::atomic<std::uint64_t> findPath[RBTreeStats::PATH_BUCKETS];
+
+            StatsCounters()
+            { reset(); }
+
+            void reset();
+
+            /** \brief Прибавляет счетчики \c other, например рабочего дерева операции. */
+            void add(const StatsCounters &other);
+        };
+
+        mutable StatsCounters _stats;                                       ///< Статистика операций.
+#endif // RBTREE_WITH_STATS
+
+
+        // Специальный подход, позволяющий следующему классу иметь доступ к закрытым членам для их тестирования.
+        template<typename, typename>
+        friend
+        class RBTreeTest;
+
+    }; // class RBTree
+
+
+#ifdef RBTREE_HAS_PMR
+
+    namespace pmr
+    {
+        /** \brief Дерево, берущее память у \c std::pmr::memory_resource. */
+        template<typename Element, typename Compar = std::less<Element> >
+        using RBTree = xi::RBTree<Element, Compar, std::pmr::polymorphic_allocator<Element> >;
+    } // namespace pmr
+
+#endif // RBTREE_HAS_PMR
+
+
+} // namespace xi
+
+
+
+// Подключаем "реализационную" часть
+#include "rbtree.hpp"
+
+
 #endif
\ No newline at end of file
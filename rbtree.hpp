@@ -1,566 +1,2427 @@
-﻿////////////////////////////////////////////////////////////////////////////////
-/// \file
-/// \brief     Реализация классов красно-черного дерева
-/// \author    Kupchenko Viktor
-/// \version   0.1.0
-/// \date      01.05.2017
-///            This is a part of the course "Algorithms and Data Structures" 
-///            provided by  the School of Software Engineering of the Faculty 
-///            of Computer Science at the Higher School of Economics.
-///
-/// "Реализация" (шаблонов) методов, описанных в файле rbtree.h
-///
-////////////////////////////////////////////////////////////////////////////////
-
-#include <stdexcept>        // std::invalid_argument
-
-
-namespace xi
-{
-
-
-//==============================================================================
-// class RBTree::Node
-//==============================================================================
-
-
-    template<typename Element, typename Compar>
-    RBTree<Element, Compar>::Node::~Node()
-    {
-        if (_left)
-            delete _left;
-        if (_right)
-            delete _right;
-    }
-
-
-    template<typename Element, typename Compar>
-    typename RBTree<Element, Compar>::Node *RBTree<Element, Compar>::Node::setLeft(Node *lf)
-    {
-        // Предупреждаем повторное присвоение
-        if (_left == lf)
-            return nullptr;
-
-        // Если новый левый — действительный элемент
-        if (lf)
-        {
-            // Если у него был родитель
-            if (lf->_parent)
-            {
-                // Ищем у родителя, кем был этот элемент, и вместо него ставим бублик
-                if (lf->_parent->_left == lf)
-                    lf->_parent->_left = nullptr;
-                else
-                    // Доп. не проверяем, что он был правым, иначе нарушение целостности
-                    lf->_parent->_right = nullptr;
-            }
-
-            // Задаем нового родителя
-            lf->_parent = this;
-        }
-
-        // Если у текущего уже был один левый — отменяем его родительскую связь и вернем его
-        Node *prevLeft = _left;
-        _left = lf;
-
-        if (prevLeft)
-            prevLeft->_parent = nullptr;
-
-        return prevLeft;
-    }
-
-
-    template<typename Element, typename Compar>
-    typename RBTree<Element, Compar>::Node *RBTree<Element, Compar>::Node::setRight(Node *rg)
-    {
-        // Предупреждаем повторное присвоение
-        if (_right == rg)
-            return nullptr;
-
-        // Если новый правый — действительный элемент
-        if (rg)
-        {
-            // Если у него был родитель
-            if (rg->_parent)
-            {
-                // Ищем у родителя, кем был этот элемент, и вместо него ставим бублик
-                if (rg->_parent->_left == rg)
-                    rg->_parent->_left = nullptr;
-                else // Доп. не проверяем, что он был правым, иначе нарушение целостности
-                    rg->_parent->_right = nullptr;
-            }
-
-            // Задаем нового родителя
-            rg->_parent = this;
-        }
-
-        // Если у текущего уже был один левый — отменяем его родительскую связь и вернем его
-        Node *prevRight = _right;
-        _right = rg;
-
-        if (prevRight)
-            prevRight->_parent = nullptr;
-
-        return prevRight;
-    }
-
-
-//==============================================================================
-// class RBTree
-//==============================================================================
-
-    template<typename Element, typename Compar>
-    RBTree<Element, Compar>::RBTree()
-    {
-        _root = nullptr;
-        _dumper = nullptr;
-    }
-
-
-    template<typename Element, typename Compar>
-    RBTree<Element, Compar>::~RBTree()
-    {
-        // Удаляем корень, который удаляет всех детей и так до листьев
-        if (_root)
-            delete _root;
-    }
-
-
-    template<typename Element, typename Compar>
-    void RBTree<Element, Compar>::deleteNode(Node *nd)
-    {
-        // Если переданный узел не существует, просто ничего не делаем, т.к. в вызывающем проверок нет
-        if (!nd)
-            return;
-        if (nd == _root)
-            _root = nullptr;
-        else
-            (nd->isLeftChild() ? nd->_parent->_left : nd->_parent->_right) = nullptr;
-        nd->_parent = nullptr;
-
-        // Потомков убьет в деструкторе
-        delete nd;
-    }
-
-
-    template<typename Element, typename Compar>
-    void RBTree<Element, Compar>::remove(const Element &key)
-    {
-        // Узел, который мы хотим удалить
-        const Node *delNode = find(key);
-
-        if (!delNode)
-            throw new std::invalid_argument("Node with this key doesn't exist!");
-
-        // curNode - узел для запоминания цвета и для замены удаляемого
-        // rebNode - узел для утряски дерева
-        Node *curNode = (Node *) delNode;
-        Node *rebNode;
-        // Чтобы утряска выполнялась верно и мы не получали nullptr
-        // вместо nullptr будет создаваться фейковый узел, который в последствии будет удалён
-        bool delRebNode = false;
-
-        Color col = curNode->_color;
-
-        /* Если детей нет, то будем делать утряску текущей ноды, а после её удалим
-         * Как вариант можно в следующих двух кейсах создавать ноду, если она оказалась nullptr
-         * Но как по мне, куда легче просто оставить текущую ноду */
-        if (!delNode->_left && !delNode->_right)
-        {
-            rebNode = new Node();
-            delRebNode = true;
-            transplant(delNode, rebNode);
-        }// Если нет левого ребенка, меняем с правым,
-        else if (!delNode->_left)
-        {
-            rebNode = delNode->_right;
-            transplant(delNode, delNode->_right);
-        }// Иначе если нет правого ребенка, меняем с левым,
-        else if (!delNode->_right)
-        {
-            rebNode = delNode->_left;
-            transplant(delNode, delNode->_left);
-        }// Иначе находим младшего потомка у правого ребенка delNode.
-        else
-        {
-            curNode = delNode->_right;
-            while (curNode->_left)
-                curNode = curNode->_left;
-
-            col = curNode->_color;
-            rebNode = curNode->_right;
-            // Если ребенка не было, то создаем его (опять же чтобы не встрять с nullptr)
-            if (!rebNode)
-            {
-                rebNode = new Node();
-                rebNode->_parent = curNode;
-                curNode->_right = rebNode;
-                delRebNode = true;
-            }
-
-            if (curNode->_parent != delNode)
-            { /*  Картина примерно такая
-               *      5        7
-               *    2   10 -> 2 10
-               *       7
-               */
-                transplant(curNode, curNode->_right);
-                curNode->_right = delNode->_right;
-                curNode->_right->_parent = curNode;
-            }
-            // Теперь выталкиваем эту ноду на место удаляемой
-            // И отдаем ей всех левых детей.
-            // reminder: у ноды, которую мы поставили, нет левых детей, потому что она самая левая среди правых.
-            transplant(delNode, curNode);
-            curNode->_left = delNode->_left;
-            curNode->_left->_parent = curNode;
-            curNode->_color = delNode->_color;
-        }
-
-        // Если не было 2 детей и был черный цвет
-        // Или если у ноды, поставленной на место бывшей, черный цвет,
-        // То мы могли нарушить баланс, а значит надо потрясти дерево.
-        if (col == BLACK)
-            rebalanceDel(rebNode);
-
-        // Если мы достали снизу красную вершину, то утряска производиться не будет, но корень покрасить надо.
-        _root->setBlack();
-
-        // Если мы делали утряску относительно nullptr листа, то надо убить его
-        if (delRebNode)
-            deleteNode(rebNode);
-    }
-
-
-    template<typename Element, typename Compar>
-    void RBTree<Element, Compar>::transplant(const Node *before, Node *after)
-    {
-        if (!before)
-            throw new std::invalid_argument("Can't transplant nullptr!");
-
-        // Тернарка в тернарке тут выглядит слишком страшно, поэтому оставлю if-else
-        if (!before->_parent)
-            _root = after;
-        else
-            (before->isLeftChild() ? before->_parent->_left : before->_parent->_right) = after;
-
-        if (after)
-            after->_parent = before->_parent;
-    }
-
-
-    template<typename Element, typename Compar>
-    void RBTree<Element, Compar>::rebalanceDel(Node *start)
-    {
-        /* Стоит напомнить, что у нас либо не было 2 детей и был черный цвет
-        * Тогда переданный узел - это тот самый ребенок, который пришел на место удаленной ноды
-        * Либо мы достали с самого низа черную ноду, а утряску делаем относительно её бывшего правого ребенка */
-        Node *cur = start;
-        Node *bro;
-
-        // Мы хотим исправить 3 проблемы ( B <-> black; R <-> red )
-        /* 1. После удаления корень стал красным
-         *   x(B)  del(x)    y(R)
-         *  y(R)     ->
-         *
-         * Тут все совсем просто - цикл не выполнится т.к. мы уже в корне
-         * А последняя строка покрасит корень в черный
-         */
-        /* 2. Если появились 2 красных подряд
-         *    a(B)      del(a)       f(B)
-         *b(B)    c(R)     ->    b(B)    c(R)
-         *     f(B)  d(B)              g(R) d(B)
-         *       g(R)
-         */
-        /* 3. Удаление ноды изменяет количество черных вершин до листа
-         *    a(B)      del(a)       f(B)
-         *b(B)    c(R)     ->    b(B)    c(R)
-         *     f(B)  d(B)             null  d(B)
-         *
-         *  f->c->null содержит 1 черную вершину,
-         *  в то время как путь до остальных листьев содержит по 2 черных вершины
-         */
-
-        /* Удалив черную ноду, мы повесили на всех её потомков дополнительный черный цвет
-         * Чтобы отразить это, немножко пересмотрим параметры наших цветов в методе
-         * cur->isBlack значит, что cur черный + дополнительный черный от потерянного родителя
-         * cur->isRed значит, что cur красный + дополнительный черный от потерянного родителя
-         *
-         * Если cur->isRed, то мы можем завершать цикл, т.к. в конце метода cur красится в черный,
-         * А значит баланс будет восстановлен.
-         */
-        while (cur != _root && cur->isBlack())
-        {   /* Мои любимые тернарки
-            !!! В комментариях рассматривается только левый случай, но правый полностью зеркален !!! */
-
-            bool isLeft = cur->isLeftChild();
-            // Это брат
-            bro = isLeft ? cur->_parent->_right : cur->_parent->_left;
-
-            /* Если брат есть и при том он красный,
-             * То сводим эту ситуацию к остальным
-             * Т.е. делаем брата черным */
-            if (bro && bro->isRed())
-            {
-                // Красим семью и проворачиваем брата вверх
-                bro->setBlack();
-                cur->_parent->setRed();
-                isLeft ? rotLeft(cur->_parent) : rotRight(cur->_parent);
-                bro = isLeft ? cur->_parent->_right : cur->_parent->_left;
-            }
-
-            /* Если у брата два черных ребенка, то мы его самого красим в красный (nullptr это тоже черные дети)
-             * Таким образом мы "забираем" один черный от себя и от брата, после чего переходим к отцу
-             * Если отец был красным, то цикл заканчивается и он красится в черный
-             * Иначе история повторяется */
-            if ((!bro->_left || bro->_left->isBlack()) && (!bro->_right || bro->_right->isBlack()))
-            {
-                bro->setRed();
-                cur = cur->_parent;
-            } else
-            {
-                /* Если у брата правые дети - черные (или nullptr), и есть левый ребенок
-                 * (который красный - мы это выяснили на прошлом шаге)
-                 * То поворачиваем левым ребенком вверх.
-                 * Это нам гарантирует следующий кейс - левый ребенок черный, а правый - красный */
-                if (isLeft ? (bro->_left && (!bro->_right || bro->_right->isBlack())) :
-                    (bro->_right && (!bro->_left || bro->_left->isBlack())))
-                {
-                    (isLeft ? bro->_left : bro->_right)->setBlack();
-                    bro->setRed();
-                    isLeft ? rotRight(bro) : rotLeft(bro);
-                    bro = isLeft ? cur->_parent->_right : cur->_parent->_left;
-                }
-
-                /* Брат черный;
-                 * Левый ребенок брата - черный/nullptr, правый - красный;
-                 * Красим брата в цвет папы, а папу в черный
-                 * Поворачиваем влево относительно папы, тогда брат вылезает вверх,
-                 * Папа забирает на себя лишний черный цвет, заканчиваем цикл. */
-                bro->_color = cur->_parent->_color;
-                cur->_parent->setBlack();
-                /* У брата ТОЧНО есть правый ребенок, поэтому сможем выполнить поворот
-                 * (если бы не было ни одного, выполнился бы второй иф,
-                 * если был бы только левый, то чуть выше мы переводим эту ситуацию к правому ребенку). */
-                (isLeft ? bro->_right : bro->_left)->setBlack();
-                isLeft ? rotLeft(cur->_parent) : rotRight(cur->_parent);
-                cur = _root;
-            }
-        }
-
-        cur->setBlack();
-    }
-
-
-    template<typename Element, typename Compar>
-    void RBTree<Element, Compar>::insert(const Element &key)
-    {
-        Node *newNode = insertNewBstEl(key);
-
-        // отладочное событие
-        if (_dumper)
-            _dumper->rbTreeEvent(IRBTreeDumper<Element, Compar>::DE_AFTER_BST_INS, this, newNode);
-
-        rebalance(newNode);
-
-        // отладочное событие
-        if (_dumper)
-            _dumper->rbTreeEvent(IRBTreeDumper<Element, Compar>::DE_AFTER_INSERT, this, newNode);
-
-    }
-
-
-    template<typename Element, typename Compar>
-    const typename RBTree<Element, Compar>::Node *RBTree<Element, Compar>::find(const Element &key)
-    {
-        Node *cur = nullptr;
-        Node *next = _root;
-        while (next)
-        {
-            cur = next;
-
-            if (cur->_key == key)  // Если в дереве есть такое значение - возвращаем узел с этим значением
-                return cur;
-
-            // Если значение меньше, то надо спускаться влево, иначе вправо
-            next = _compar(key, cur->_key) ? next->_left : next->_right;
-        }
-
-        // Если цикл закончился, значит мы спустились до листьев дерева, а следовательно такого значения нет
-        return nullptr;
-    }
-
-
-    template<typename Element, typename Compar>
-    typename RBTree<Element, Compar>::Node *
-    RBTree<Element, Compar>::insertNewBstEl(const Element &key)
-    {
-        Node *newNode = new Node(key);
-        if (!_root)
-        {
-            _root = newNode;
-            return newNode;
-        }
-
-        /* Ищем место для элемента */
-        Node *cur = nullptr;
-        Node *next = _root;
-        while (next)
-        {
-            cur = next;
-
-            if (cur->_key == newNode->_key)  // Если в дереве есть такое значение - кидаем исключение
-                throw std::invalid_argument("Node with this value already exist!");
-
-            // Если значение меньше, то надо спускаться влево, иначе вправо
-            next = _compar(newNode->_key, cur->_key) ? next->_left : next->_right;
-        }
-
-        (_compar(newNode->_key, cur->_key) ? cur->_left : cur->_right) = newNode;
-        newNode->_parent = cur;
-
-        return newNode;
-    }
-
-    template<typename Element, typename Compar>
-    void RBTree<Element, Compar>::rebalance(Node *nd)
-    {
-
-        if (_root == nd)
-            return;
-
-        nd->setRed();
-
-        if (nd->_parent->isBlack())
-            return;
-
-        // Пока папа красный
-        while (nd->_parent->isRed())
-        {
-            // Является ли папа левым ребенком
-            bool isLeft = nd->_parent->isLeftChild();
-
-            // Если дядя красный (да-да, так выглядит дядя; если папа левый, то он правый, иначе наоборот)
-            Node *unc = isLeft ? nd->_parent->_parent->_right : nd->_parent->_parent->_left;
-            if (unc && unc->isRed())
-            {   // Перекрашиваем семью
-                nd->_parent->setBlack();
-                unc->setBlack();
-                nd->_parent->_parent->setRed();
-                nd = nd->_parent->_parent; // Переходим к дедушке и проверяем его семью
-                // Если это корень, или если мы ребенок корня, то проверка закончена
-                // Корень гарантированно покрасится в черный в конце, а ребенок у корня может быть любой
-                if (!nd->_parent || nd->_parent->isBlack())
-                    break;
-            } else
-            {// Тернарки схлопывают 2 случая в один c:
-                /* Если у нас не прямая ветка, а изгиб, то выворачиваем ребенка наверх, чтобы выпрямить
-                 *          10         10  |     5          5
-                 *        5     ->    8    |       10   ->    8
-                 *          8       5      |      8             10
-                 */
-                if (isLeft ? nd == nd->_parent->_right : nd == nd->_parent->_left)
-                {
-                    nd = nd->_parent;
-                    isLeft ? rotLeft(nd) : rotRight(nd);
-                }
-                // А после спокойно делаем поворот
-                nd->_parent->setBlack();
-                nd->_parent->_parent->setRed();
-                isLeft ? rotRight(nd->_parent->_parent) : rotLeft(nd->_parent->_parent);
-            }
-        }
-
-        _root->setBlack();
-    }
-
-
-    template<typename Element, typename Compar>
-    void RBTree<Element, Compar>::rotLeft(typename RBTree<Element, Compar>::Node *nd)
-    {
-        // Правый потомок, который станет после левого поворота "выше"
-        Node *y = nd->_right;
-
-        if (!y)
-            throw std::invalid_argument("Can't rotate left since the right child is nil");
-
-        /* Перераспределение семейных связей */
-        // y станет родителем для nd
-        y->_parent = nd->_parent;
-
-        // Если это не корень дерева
-        if (y->_parent != nullptr)
-            // Если nd был левым ребенком, то теперь левым ребенком будет y
-            if (nd->_parent->_left == nd)
-                nd->_parent->_left = y;
-                // Иначе правым
-            else nd->_parent->_right = y;
-
-        /* Поворот влево */
-        //      nd
-        //        y
-        //       f g
-        nd->_right = y->_left;
-        if (nd->_right)
-            nd->_right->_parent = nd;
-
-        //       y
-        //    nd   g
-        //      f
-        nd->_parent = y;
-        y->_left = nd;
-
-        if (_root->_parent)
-            _root = _root->_parent;
-
-        // отладочное событие
-        if (_dumper)
-            _dumper->rbTreeEvent(IRBTreeDumper<Element, Compar>::DE_AFTER_LROT, this, nd);
-    }
-
-
-    template<typename Element, typename Compar>
-    void RBTree<Element, Compar>::rotRight(typename RBTree<Element, Compar>::Node *nd)
-    {
-        // Левый потомок, который станет после правого поворота "выше"
-        Node *y = nd->_left;
-
-        if (!y)
-            throw std::invalid_argument("Can't rotate left since the right child is nil");
-
-        /* Перераспределение семейных связей */
-        // y станет родителем для nd
-        y->_parent = nd->_parent;
-
-        // Если это не корень дерева
-        if (y->_parent != nullptr)
-            // Если nd был левым ребенком, то теперь левым ребенком будет y
-            if (nd->_parent->_left == nd)
-                nd->_parent->_left = y;
-                // Иначе правым
-            else nd->_parent->_right = y;
-
-        /* Поворот влево */
-        //      nd
-        //     y
-        //    f g
-        nd->_left = y->_right;
-        if (nd->_left)
-            nd->_left->_parent = nd;
-
-        //       y
-        //     f   nd
-        //        g
-        nd->_parent = y;
-        y->_right = nd;
-
-        if (_root->_parent)
-            _root = _root->_parent;
-
-        // отладочное событие
-        if (_dumper)
-            _dumper->rbTreeEvent(IRBTreeDumper<Element, Compar>::DE_AFTER_LROT, this, nd);
-    }
-
-
+﻿////////////////////////////////////////////////////////////////////////////////
+/// \file
+/// \brief     Реализация классов красно-черного дерева
+/// \author    Kupchenko Viktor
+/// \version   0.1.0
+/// \date      01.05.2017
+///            This is a part of the course "Algorithms and Data Structures" 
+///            provided by  the School of Software Engineering of the Faculty 
+///            of Computer Science at the Higher School of Economics.
+///
+/// "Реализация" (шаблонов) методов, описанных в файле rbtree.h
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstring>          // std::memcpy, std::memcmp, std::memset
+#include <fstream>          // std::ifstream, std::ofstream
+#include <new>              // placement new
+#include <stdexcept>        // std::invalid_argument, std::out_of_range, std::runtime_error
+#include <string>
+
+#ifdef RBTREE_HAS_MMAP
+#include <fcntl.h>          // open
+#include <sys/mman.h>       // mmap, munmap, madvise
+#include <sys/stat.h>       // fstat
+#include <unistd.h>         // close
+#endif
+
+
+namespace xi
+{
+
+
+//==============================================================================
+// class RBTree::Node
+//==============================================================================
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    typename RBTree<Element, Compar, Allocator, Dumper>::Node *RBTree<Element, Compar, Allocator, Dumper>::Node::setLeft(Node *lf)
+    {
+        // Предупреждаем повторное присвоение
+        if (_left == lf)
+            return nullptr;
+
+        // Если новый левый — действительный элемент
+        if (lf)
+        {
+            // Если у него был родитель
+            if (lf->_parent)
+            {
+                // Ищем у родителя, кем был этот элемент, и вместо него ставим бублик
+                if (lf->_parent->_left == lf)
+                    lf->_parent->_left = nullptr;
+                else
+                    // Доп. не проверяем, что он был правым, иначе нарушение целостности
+                    lf->_parent->_right = nullptr;
+            }
+
+            // Задаем нового родителя
+            lf->_parent = this;
+        }
+
+        // Если у текущего уже был один левый — отменяем его родительскую связь и вернем его
+        Node *prevLeft = _left;
+        _left = lf;
+
+        if (prevLeft)
+            prevLeft->_parent = nullptr;
+
+        return prevLeft;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    typename RBTree<Element, Compar, Allocator, Dumper>::Node *RBTree<Element, Compar, Allocator, Dumper>::Node::setRight(Node *rg)
+    {
+        // Предупреждаем повторное присвоение
+        if (_right == rg)
+            return nullptr;
+
+        // Если новый правый — действительный элемент
+        if (rg)
+        {
+            // Если у него был родитель
+            if (rg->_parent)
+            {
+                // Ищем у родителя, кем был этот элемент, и вместо него ставим бублик
+                if (rg->_parent->_left == rg)
+                    rg->_parent->_left = nullptr;
+                else // Доп. не проверяем, что он был правым, иначе нарушение целостности
+                    rg->_parent->_right = nullptr;
+            }
+
+            // Задаем нового родителя
+            rg->_parent = this;
+        }
+
+        // Если у текущего уже был один левый — отменяем его родительскую связь и вернем его
+        Node *prevRight = _right;
+        _right = rg;
+
+        if (prevRight)
+            prevRight->_parent = nullptr;
+
+        return prevRight;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    const typename RBTree<Element, Compar, Allocator, Dumper>::Node *
+    RBTree<Element, Compar, Allocator, Dumper>::Node::getLeftmost() const
+    {
+        const Node *cur = this;
+        while (cur->_left)
+            cur = cur->_left;
+        return cur;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    const typename RBTree<Element, Compar, Allocator, Dumper>::Node *
+    RBTree<Element, Compar, Allocator, Dumper>::Node::getRightmost() const
+    {
+        const Node *cur = this;
+        while (cur->_right)
+            cur = cur->_right;
+        return cur;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    const typename RBTree<Element, Compar, Allocator, Dumper>::Node *
+    RBTree<Element, Compar, Allocator, Dumper>::Node::getNext() const
+    {
+        // Если есть правое поддерево, то следующий — самый левый в нем
+        if (_right)
+            return _right->getLeftmost();
+
+        // Иначе поднимаемся, пока приходим к отцу справа; первый отец, к которому пришли слева, и есть ответ
+        const Node *cur = this;
+        while (cur->_parent && cur->_parent->_right == cur)
+            cur = cur->_parent;
+
+        return cur->_parent;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    const typename RBTree<Element, Compar, Allocator, Dumper>::Node *
+    RBTree<Element, Compar, Allocator, Dumper>::Node::getPrev() const
+    {
+        // Зеркально getNext()
+        if (_left)
+            return _left->getRightmost();
+
+        const Node *cur = this;
+        while (cur->_parent && cur->_parent->_left == cur)
+            cur = cur->_parent;
+
+        return cur->_parent;
+    }
+
+
+//==============================================================================
+// Снимки дерева на диске
+//==============================================================================
+
+/** \brief Байтовая копия тривиально копируемого элемента. */
+    template<typename Element>
+    struct RBTreeSerializer<Element, typename std::enable_if<std::is_trivially_copyable<Element>::value>::type>
+    {
+        /** \brief Размер записи постоянен и равен sizeof(Element): файл можно читать через mmap. */
+        typedef std::true_type IsRaw;
+
+        void write(std::ostream &os, const Element &el) const
+        { os.write(reinterpret_cast<const char *>(&el), sizeof(Element)); }
+
+        Element read(std::istream &is) const
+        {
+            typename std::aligned_storage<sizeof(Element), alignof(Element)>::type buf;
+            is.read(reinterpret_cast<char *>(&buf), sizeof(Element));
+            return *reinterpret_cast<const Element *>(&buf);
+        }
+    };
+
+/** \brief Строка: 64-битная длина и байты. */
+    template<>
+    struct RBTreeSerializer<std::string>
+    {
+        typedef std::false_type IsRaw;
+
+        void write(std::ostream &os, const std::string &el) const
+        {
+            std::uint64_t len = el.size();
+            os.write(reinterpret_cast<const char *>(&len), sizeof(len));
+            os.write(el.data(), (std::streamsize) el.size());
+        }
+
+        std::string read(std::istream &is) const
+        {
+            std::uint64_t len = 0;
+            is.read(reinterpret_cast<char *>(&len), sizeof(len));
+
+            // Длину из файла не принимаем на веру: строка растет по мере чтения
+            std::string res;
+            char buf[4096];
+            while (len && is)
+            {
+                std::size_t chunk = len < sizeof(buf) ? (std::size_t) len : sizeof(buf);
+                is.read(buf, (std::streamsize) chunk);
+                res.append(buf, (std::size_t) is.gcount());
+                len -= chunk;
+            }
+            return res;
+        }
+    };
+
+/** \brief Признак того, что сериализатор пишет байтовые копии фиксированного размера (есть IsRaw). */
+    template<typename Serializer, typename = void>
+    struct SerializerIsRaw : std::false_type
+    {
+    };
+
+    template<typename Serializer>
+    struct SerializerIsRaw<Serializer, typename std::enable_if<Serializer::IsRaw::value>::type> : std::true_type
+    {
+    };
+
+/** \brief Входной итератор по элементам файла: очередной элемент читается сериализатором при
+ *  первом разыменовании. Копии итератора разделяют одно состояние.
+ */
+    template<typename Element, typename Serializer>
+    class SnapshotKeyReader
+    {
+    public:
+        SnapshotKeyReader(std::istream &is, const Serializer &ser)
+                : _is(is), _ser(ser), _loaded(false)
+        {}
+
+        ~SnapshotKeyReader()
+        { drop(); }
+
+        const Element &current()
+        {
+            if (!_loaded)
+            {
+                new(&_buf) Element(_ser.read(_is));
+                _loaded = true;
+                if (!_is)
+                    throw std::runtime_error("Snapshot is truncated!");
+            }
+            return *reinterpret_cast<const Element *>(&_buf);
+        }
+
+        void next()
+        {
+            current();
+            drop();
+        }
+
+        /** \brief Легкий дескриптор для алгоритмов, принимающих итератор по значению. */
+        struct Iterator
+        {
+            SnapshotKeyReader *reader;
+
+            const Element &operator*() const
+            { return reader->current(); }
+
+            Iterator &operator++()
+            {
+                reader->next();
+                return *this;
+            }
+        };
+
+        Iterator begin()
+        {
+            Iterator it = {this};
+            return it;
+        }
+
+    protected:
+        void drop()
+        {
+            if (_loaded)
+                reinterpret_cast<Element *>(&_buf)->~Element();
+            _loaded = false;
+        }
+
+    protected:
+        SnapshotKeyReader(const SnapshotKeyReader &);
+        SnapshotKeyReader &operator=(const SnapshotKeyReader &);
+
+    protected:
+        std::istream &_is;
+        const Serializer &_ser;
+        typename std::aligned_storage<sizeof(Element), alignof(Element)>::type _buf;
+        bool _loaded;
+    };
+
+/** \brief Запись формы: по 4 бита на узел, два узла на байт. */
+    class SnapshotShapeWriter
+    {
+    public:
+        explicit SnapshotShapeWriter(std::ostream &os)
+                : _os(os), _byte(0), _half(false)
+        {}
+
+        void put(unsigned bits)
+        {
+            if (_half)
+            {
+                _byte |= (unsigned char) (bits << 4);
+                _os.put((char) _byte);
+                _byte = 0;
+            }
+            else
+                _byte = (unsigned char) bits;
+            _half = !_half;
+        }
+
+        void flush()
+        {
+            if (_half)
+                _os.put((char) _byte);
+            _half = false;
+        }
+
+    protected:
+        std::ostream &_os;
+        unsigned char _byte;
+        bool _half;
+    };
+
+/** \brief Чтение формы из потока. */
+    class SnapshotStreamShape
+    {
+    public:
+        explicit SnapshotStreamShape(std::istream *is)
+                : _is(is), _byte(0), _half(false)
+        {}
+
+        unsigned next()
+        {
+            if (_half)
+            {
+                _half = false;
+                return _byte >> 4;
+            }
+
+            int c = _is ? _is->get() : EOF;
+            if (c == EOF)
+                throw std::runtime_error("Snapshot is truncated!");
+            _byte = (unsigned char) c;
+            _half = true;
+            return _byte & 0xF;
+        }
+
+    protected:
+        std::istream *_is;
+        unsigned char _byte;
+        bool _half;
+    };
+
+/** \brief Чтение формы из отображенной в память части файла. */
+    class SnapshotMemoryShape
+    {
+    public:
+        SnapshotMemoryShape(const unsigned char *data, std::size_t bytes)
+                : _data(data), _end(data + bytes), _half(false)
+        {}
+
+        unsigned next()
+        {
+            if (_data == _end)
+                throw std::runtime_error("Snapshot is truncated!");
+
+            if (_half)
+            {
+                _half = false;
+                return *_data++ >> 4;
+            }
+            _half = true;
+            return *_data & 0xF;
+        }
+
+    protected:
+        const unsigned char *_data;
+        const unsigned char *_end;
+        bool _half;
+    };
+
+#ifdef RBTREE_HAS_MMAP
+
+/** \brief Файл, отображенный в память только для чтения; отображение снимается в деструкторе. */
+    class SnapshotMapping
+    {
+    public:
+        explicit SnapshotMapping(const char *path)
+                : _data(nullptr), _size(0)
+        {
+            int fd = ::open(path, O_RDONLY);
+            if (fd < 0)
+                throw std::runtime_error("Can't open snapshot!");
+
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && st.st_size > 0)
+            {
+                void *p = ::mmap(nullptr, (std::size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED)
+                {
+                    _data = static_cast<const unsigned char *>(p);
+                    _size = (std::size_t) st.st_size;
+                    ::madvise(p, _size, MADV_SEQUENTIAL);
+                }
+            }
+            ::close(fd);
+        }
+
+        ~SnapshotMapping()
+        {
+            if (_data)
+                ::munmap(const_cast<unsigned char *>(_data), _size);
+        }
+
+        const unsigned char *getData() const
+        { return _data; }
+
+        std::size_t getSize() const
+        { return _size; }
+
+    protected:
+        SnapshotMapping(const SnapshotMapping &);
+        SnapshotMapping &operator=(const SnapshotMapping &);
+
+    protected:
+        const unsigned char *_data;
+        std::size_t _size;
+    };
+
+#endif // RBTREE_HAS_MMAP
+
+
+//==============================================================================
+// class RBTree
+//==============================================================================
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    RBTree<Element, Compar, Allocator, Dumper>::RBTree()
+    {
+        _root = nullptr;
+        _leftmost = _rightmost = nullptr;
+        setCount(0);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    RBTree<Element, Compar, Allocator, Dumper>::RBTree(const Allocator &alloc)
+            : _nodeAlloc(alloc)
+    {
+        _root = nullptr;
+        _leftmost = _rightmost = nullptr;
+        setCount(0);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    RBTree<Element, Compar, Allocator, Dumper>::RBTree(const Compar &compar, const Allocator &alloc)
+            : _compar(compar), _nodeAlloc(alloc)
+    {
+        _root = nullptr;
+        _leftmost = _rightmost = nullptr;
+        setCount(0);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    RBTree<Element, Compar, Allocator, Dumper>::RBTree(RBTree &&other)
+            : Dumper(other), _compar(other._compar), _nodeAlloc(other._nodeAlloc)
+    {
+        _root = other._root;
+        _leftmost = other._leftmost;
+        _rightmost = other._rightmost;
+        setCount(other.getCount());
+
+        other._root = nullptr;
+        other._leftmost = other._rightmost = nullptr;
+        other.setCount(0);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    RBTree<Element, Compar, Allocator, Dumper> &RBTree<Element, Compar, Allocator, Dumper>::operator=(RBTree &&other)
+    {
+        if (this == &other)
+            return *this;
+
+        // Свои узлы возвращаем своему аллокатору, и только потом берем чужой
+        clear();
+
+        _compar = other._compar;
+        Dumper::operator=(other);
+
+        typedef typename NodeAllocTraits::propagate_on_container_move_assignment Propagate;
+        assignAllocator(other._nodeAlloc, Propagate());
+
+        // Узлы можно забрать как есть, только если наш аллокатор способен их освободить
+        if (Propagate::value || _nodeAlloc == other._nodeAlloc)
+        {
+            _root = other._root;
+            _leftmost = other._leftmost;
+            _rightmost = other._rightmost;
+            setCount(other.getCount());
+            other._root = nullptr;
+            other._leftmost = other._rightmost = nullptr;
+            other.setCount(0);
+        }
+        else
+        {
+            // Иначе перекладываем элементы в свои узлы — они уже упорядочены, так что за O(n)
+            std::size_t n = other.size();
+            resetRoot(buildSortedRoot(other.begin(), n), n);
+            other.clear();
+        }
+
+        return *this;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    RBTree<Element, Compar, Allocator, Dumper>::RBTree(const Compar &compar, const NodeAllocator &nodeAlloc, SiblingTag)
+            : _compar(compar), _nodeAlloc(nodeAlloc)
+    {
+        // Рабочие деревья только одалживают чужие узлы, считать их незачем
+        _root = nullptr;
+        _leftmost = _rightmost = nullptr;
+        setCount(UNKNOWN_SIZE);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename ForwardIt>
+    RBTree<Element, Compar, Allocator, Dumper>
+    RBTree<Element, Compar, Allocator, Dumper>::buildFromSorted(ForwardIt first, ForwardIt last,
+                                                                const Compar &compar, const Allocator &alloc)
+    {
+        RBTree res(compar, alloc);
+        std::size_t n = (std::size_t) std::distance(first, last);
+        res.resetRoot(res.buildSortedRoot(first, n), n);
+
+        return res;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename ForwardIt>
+    typename RBTree<Element, Compar, Allocator, Dumper>::Node *
+    RBTree<Element, Compar, Allocator, Dumper>::buildSortedRoot(ForwardIt first, std::size_t n)
+    {
+        if (!n)
+            return nullptr;
+
+        // Высота дерева из n узлов, собранного делением пополам: ceil(log2(n + 1)).
+        // Листья у такого дерева лежат на двух последних уровнях, поэтому, перекрасив
+        // нижний уровень узлов в красный, получаем одинаковую черную высоту всех путей.
+        std::size_t height = 0;
+        while (height < sizeof(std::size_t) * 8 && (n >> height))
+            ++height;
+
+        const Element *prev = nullptr;
+        return buildSorted(first, n, 0, height - 1, prev);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename ForwardIt>
+    typename RBTree<Element, Compar, Allocator, Dumper>::Node *
+    RBTree<Element, Compar, Allocator, Dumper>::buildSorted(ForwardIt &it, std::size_t n, std::size_t depth,
+                                                            std::size_t redDepth, const Element *&prev)
+    {
+        if (!n)
+            return nullptr;
+
+        // Левая половина не больше правой
+        std::size_t leftCount = (n - 1) / 2;
+        Node *left = buildSorted(it, leftCount, depth + 1, redDepth, prev);
+
+        Node *nd;
+        try
+        {
+            if (prev && !_compar(*prev, *it))
+                throw std::invalid_argument("Sequence isn't strictly increasing!");
+
+            nd = createNode(*it);
+        }
+        catch (...)
+        {
+            destroySubtree(left);
+            throw;
+        }
+
+        prev = &nd->_key;
+        ++it;
+
+        nd->_left = left;
+        if (left)
+            left->_parent = nd;
+
+        // Корень не перекрашиваем никогда
+        if (depth && depth == redDepth)
+            nd->setRed();
+
+        Node *right;
+        try
+        {
+            right = buildSorted(it, n - 1 - leftCount, depth + 1, redDepth, prev);
+        }
+        catch (...)
+        {
+            destroySubtree(nd);
+            throw;
+        }
+
+        nd->_right = right;
+        if (right)
+            right->_parent = nd;
+
+        fixSize(nd);
+        return nd;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename Serializer>
+    void RBTree<Element, Compar, Allocator, Dumper>::save(const char *path, bool withShape, const Serializer &ser) const
+    {
+        std::ofstream os(path, std::ios::binary | std::ios::trunc);
+        if (!os)
+            throw std::runtime_error("Can't create snapshot!");
+
+        RBTreeSnapshotHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "XIRBTREE", sizeof(header.magic));
+        header.version = RBTreeSnapshotHeader::VERSION;
+        header.byteOrder = RBTreeSnapshotHeader::BYTE_ORDER_MARK;
+        header.count = size();
+        header.keysOffset = sizeof(header);
+        if (SerializerIsRaw<Serializer>::value)
+        {
+            header.flags |= RBTreeSnapshotHeader::RAW_KEYS;
+            header.elementSize = sizeof(Element);
+        }
+
+        // Заголовок пишется дважды: смещение формы известно, только когда записаны элементы
+        os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (const_iterator it = begin(); it != end(); ++it)
+            ser.write(os, *it);
+
+        if (withShape)
+        {
+            header.flags |= RBTreeSnapshotHeader::HAS_SHAPE;
+            header.shapeOffset = (std::uint64_t) os.tellp();
+
+            SnapshotShapeWriter shape(os);
+            saveShape(_root, shape);
+            shape.flush();
+
+            os.seekp(0);
+            os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        }
+
+        os.flush();
+        if (!os)
+            throw std::runtime_error("Can't write snapshot!");
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename Serializer>
+    RBTree<Element, Compar, Allocator, Dumper>
+    RBTree<Element, Compar, Allocator, Dumper>::load(const char *path, const Compar &compar, const Allocator &alloc,
+                                                     const Serializer &ser)
+    {
+        std::ifstream is(path, std::ios::binary);
+        if (!is)
+            throw std::runtime_error("Can't open snapshot!");
+
+        RBTreeSnapshotHeader header;
+        is.read(reinterpret_cast<char *>(&header), sizeof(header));
+        if (!is || std::memcmp(header.magic, "XIRBTREE", sizeof(header.magic)) != 0 ||
+            header.version != RBTreeSnapshotHeader::VERSION)
+            throw std::runtime_error("Not a tree snapshot!");
+        if (header.byteOrder != RBTreeSnapshotHeader::BYTE_ORDER_MARK)
+            throw std::runtime_error("Snapshot has foreign byte order!");
+
+        bool raw = (header.flags & RBTreeSnapshotHeader::RAW_KEYS) != 0;
+        bool hasShape = (header.flags & RBTreeSnapshotHeader::HAS_SHAPE) != 0;
+        if (raw != SerializerIsRaw<Serializer>::value || (raw && header.elementSize != sizeof(Element)))
+            throw std::runtime_error("Snapshot was written for another element type!");
+
+#ifdef RBTREE_HAS_MMAP
+        // Байтовые копии берем прямо из отображения: ни read(), ни промежуточного буфера
+        if (raw && header.keysOffset % alignof(Element) == 0)
+        {
+            SnapshotMapping map(path);
+            if (map.getData())
+            {
+                if (header.keysOffset > map.getSize() ||
+                    header.count > (map.getSize() - header.keysOffset) / sizeof(Element) ||
+                    (hasShape && header.shapeOffset > map.getSize()))
+                    throw std::runtime_error("Snapshot is truncated!");
+
+                const Element *keys = reinterpret_cast<const Element *>(map.getData() + header.keysOffset);
+                SnapshotMemoryShape shape(hasShape ? map.getData() + header.shapeOffset : nullptr,
+                                          hasShape ? map.getSize() - (std::size_t) header.shapeOffset : 0);
+                return restore(header, keys, shape, compar, alloc);
+            }
+        }
+#endif // RBTREE_HAS_MMAP
+
+        // Элементы и форма лежат в разных местах файла, поэтому форма читается вторым потоком
+        std::ifstream shapeStream;
+        if (hasShape)
+        {
+            shapeStream.open(path, std::ios::binary);
+            shapeStream.seekg((std::streamoff) header.shapeOffset);
+        }
+        SnapshotStreamShape shape(hasShape ? &shapeStream : nullptr);
+
+        is.seekg((std::streamoff) header.keysOffset);
+        SnapshotKeyReader<Element, Serializer> keys(is, ser);
+        return restore(header, keys.begin(), shape, compar, alloc);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename KeyIt, typename ShapeReader>
+    RBTree<Element, Compar, Allocator, Dumper>
+    RBTree<Element, Compar, Allocator, Dumper>::restore(const RBTreeSnapshotHeader &header, KeyIt it, ShapeReader &shape,
+                                                        const Compar &compar, const Allocator &alloc)
+    {
+        RBTree res(compar, alloc);
+        std::size_t n = (std::size_t) header.count;
+
+        if (!(header.flags & RBTreeSnapshotHeader::HAS_SHAPE))
+        {
+            // Нарушенный порядок в файле — это испорченный файл, а не ошибка вызывающего
+            Node *root;
+            try
+            {
+                root = res.buildSortedRoot(it, n);
+            }
+            catch (const std::invalid_argument &)
+            {
+                throw std::runtime_error("Snapshot is corrupted!");
+            }
+
+            res.resetRoot(root, n);
+            return res;
+        }
+
+        if (!n)
+            return res;
+
+        std::size_t remaining = n;
+        std::size_t bh;
+        const Element *prev = nullptr;
+        Node *root = res.buildShaped(it, shape, remaining, 0, prev, bh);
+        if (remaining || root->isRed())
+        {
+            res.destroySubtree(root);
+            throw std::runtime_error("Snapshot is corrupted!");
+        }
+
+        res.resetRoot(root, n);
+        return res;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename ShapeWriter>
+    void RBTree<Element, Compar, Allocator, Dumper>::saveShape(const Node *nd, ShapeWriter &out)
+    {
+        if (!nd)
+            return;
+
+        out.put((nd->_left ? RBTreeSnapshotHeader::SHAPE_LEFT : 0) |
+                (nd->_right ? RBTreeSnapshotHeader::SHAPE_RIGHT : 0) |
+                (nd->isRed() ? RBTreeSnapshotHeader::SHAPE_RED : 0));
+        saveShape(nd->_left, out);
+        saveShape(nd->_right, out);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename KeyIt, typename ShapeReader>
+    typename RBTree<Element, Compar, Allocator, Dumper>::Node *
+    RBTree<Element, Compar, Allocator, Dumper>::buildShaped(KeyIt &it, ShapeReader &shape, std::size_t &remaining,
+                                                            std::size_t depth, const Element *&prev, std::size_t &bh)
+    {
+        // Высота настоящего красно-черного дерева не больше 2·log2(n + 1): глубже — значит файл испорчен,
+        // и дальше спускаться не стоит хотя бы ради стека
+        if (!remaining || depth > 2 * 8 * sizeof(std::size_t))
+            throw std::runtime_error("Snapshot is corrupted!");
+
+        unsigned bits = shape.next();
+        std::size_t bhLeft = 0, bhRight = 0;
+        Node *left = (bits & RBTreeSnapshotHeader::SHAPE_LEFT) ?
+                     buildShaped(it, shape, remaining, depth + 1, prev, bhLeft) : nullptr;
+
+        Node *nd;
+        try
+        {
+            if (!remaining || (prev && !_compar(*prev, *it)))
+                throw std::runtime_error("Snapshot is corrupted!");
+
+            nd = createNode(*it);
+        }
+        catch (...)
+        {
+            destroySubtree(left);
+            throw;
+        }
+
+        prev = &nd->_key;
+        --remaining;
+        ++it;
+
+        nd->_left = left;
+        if (left)
+            left->_parent = nd;
+        if (bits & RBTreeSnapshotHeader::SHAPE_RED)
+            nd->setRed();
+
+        Node *right;
+        try
+        {
+            right = (bits & RBTreeSnapshotHeader::SHAPE_RIGHT) ?
+                    buildShaped(it, shape, remaining, depth + 1, prev, bhRight) : nullptr;
+        }
+        catch (...)
+        {
+            destroySubtree(nd);
+            throw;
+        }
+
+        nd->_right = right;
+        if (right)
+            right->_parent = nd;
+
+        // Форма из файла должна быть красно-черным деревом: равные черные высоты и нет красного под красным
+        if (bhLeft != bhRight || (nd->isRed() && ((left && left->isRed()) || (right && right->isRed()))))
+        {
+            destroySubtree(nd);
+            throw std::runtime_error("Snapshot is corrupted!");
+        }
+
+        bh = bhLeft + (nd->isBlack() ? 1 : 0);
+        fixSize(nd);
+        return nd;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    RBTree<Element, Compar, Allocator, Dumper>
+    RBTree<Element, Compar, Allocator, Dumper>::join(RBTree &&left, const Element &pivot, RBTree &&right)
+    {
+        if (!(left._nodeAlloc == right._nodeAlloc))
+            throw std::invalid_argument("Can't join trees with different allocators!");
+
+        // Проверка порядка — по одному спуску вдоль крайних ветвей
+        if (left._root && !left._compar(left._rightmost->_key, pivot))
+            throw std::invalid_argument("Left tree must be less than the pivot!");
+        if (right._root && !left._compar(pivot, right._leftmost->_key))
+            throw std::invalid_argument("Right tree must be greater than the pivot!");
+
+        RBTree res(std::move(left));
+        Node *k = res.createNode(pivot);
+
+        Node *l = res._root;
+        Node *r = right._root;
+        std::size_t count = addSizes(addSizes(res.getCount(), right.getCount()), 1);
+        right.resetRoot(nullptr, 0);
+
+        std::size_t bh;
+        res.resetRoot(res.joinNodes(l, blackHeight(l), k, r, blackHeight(r), bh), count);
+
+        return res;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    RBTree<Element, Compar, Allocator, Dumper>
+    RBTree<Element, Compar, Allocator, Dumper>::join(RBTree &&left, RBTree &&right)
+    {
+        if (!(left._nodeAlloc == right._nodeAlloc))
+            throw std::invalid_argument("Can't join trees with different allocators!");
+
+        if (!right._root)
+            return RBTree(std::move(left));
+        if (!left._root)
+            return RBTree(std::move(right));
+
+        if (!left._compar(left._rightmost->_key, right._leftmost->_key))
+            throw std::invalid_argument("Left tree must be less than the right one!");
+
+        // Разделителем станет минимальный узел правого дерева — без новых выделений памяти
+        Node *k = right._leftmost;
+        right.unlinkNode(k);
+
+        RBTree res(std::move(left));
+        Node *l = res._root;
+        Node *r = right._root;
+        std::size_t count = addSizes(addSizes(res.getCount(), right.getCount()), 1);
+        right.resetRoot(nullptr, 0);
+
+        std::size_t bh;
+        res.resetRoot(res.joinNodes(l, blackHeight(l), k, r, blackHeight(r), bh), count);
+
+        return res;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    RBTree<Element, Compar, Allocator, Dumper> RBTree<Element, Compar, Allocator, Dumper>::split(const Element &key, bool *found)
+    {
+        RBTree greater(_compar, _nodeAlloc, SiblingTag());
+
+        Node *t = _root;
+        _root = nullptr;
+
+        Node *l, *r, *mid = nullptr;
+        std::size_t bhL, bhR;
+        splitNodes(t, blackHeight(t), key, l, bhL, r, bhR, mid);
+
+        // Корни частей могли оказаться красными поддеревьями исходного дерева
+        if (l)
+            l->setBlack();
+        if (r)
+            r->setBlack();
+
+        // Сам ключ не достается ни одной из частей
+        if (mid)
+            destroyNode(mid);
+        if (found)
+            *found = (mid != nullptr);
+
+        // Без размеров поддеревьев части не сосчитать без обхода — это сделает size(), если понадобится
+        resetRoot(l, splitCount(l));
+        greater.resetRoot(r, splitCount(r));
+
+        return greater;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    RBTree<Element, Compar, Allocator, Dumper> RBTree<Element, Compar, Allocator, Dumper>::splitFrom(const Element &key)
+    {
+        RBTree greater(_compar, _nodeAlloc, SiblingTag());
+
+        Node *t = _root;
+        _root = nullptr;
+
+        Node *l, *r, *mid = nullptr;
+        std::size_t bhL, bhR;
+        splitNodes(t, blackHeight(t), key, l, bhL, r, bhR, mid);
+
+        if (l)
+            l->setBlack();
+        if (r)
+            r->setBlack();
+
+        // Узел с ключом становится минимумом большей части: join с пустым левым деревом
+        std::size_t bh;
+        if (mid)
+            r = joinNodes(nullptr, 0, mid, r, blackHeight(r), bh);
+
+        resetRoot(l, splitCount(l));
+        greater.resetRoot(r, splitCount(r));
+
+        return greater;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    std::size_t RBTree<Element, Compar, Allocator, Dumper>::blackHeight(const Node *nd)
+    {
+        // Все пути от узла до листьев содержат одинаковое число черных, так что идем по любому
+        std::size_t bh = 0;
+        for (; nd; nd = nd->_left)
+            if (nd->isBlack())
+                ++bh;
+
+        return bh;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    typename RBTree<Element, Compar, Allocator, Dumper>::Node *
+    RBTree<Element, Compar, Allocator, Dumper>::joinNodes(Node *l, std::size_t bhL, Node *k, Node *r, std::size_t bhR,
+                                                          std::size_t &bh)
+    {
+        // Корни частей делаем черными: правила это не нарушает, а черная высота растет на единицу
+        if (l && l->isRed())
+        {
+            l->setBlack();
+            ++bhL;
+        }
+        if (r && r->isRed())
+        {
+            r->setBlack();
+            ++bhR;
+        }
+
+        k->_parent = k->_left = k->_right = nullptr;
+
+        // Одинаковые черные высоты: k просто становится черным корнем над обеими частями
+        if (bhL == bhR)
+        {
+            k->_left = l;
+            if (l)
+                l->_parent = k;
+            k->_right = r;
+            if (r)
+                r->_parent = k;
+
+            k->setBlack();
+            fixSize(k);
+
+            bh = bhL + 1;
+            return k;
+        }
+
+        // Иначе спускаемся по ближней к другой части ветви более высокого дерева
+        // до черного узла той же черной высоты, что у низкого, и подвешиваем k на его место
+        bool tallLeft = bhL > bhR;
+        Node *tall = tallLeft ? l : r;
+        Node *low = tallLeft ? r : l;
+        std::size_t lowBh = tallLeft ? bhR : bhL;
+        std::size_t curBh = tallLeft ? bhL : bhR;
+
+        Node *dad = nullptr;
+        Node *cur = tall;
+        while (cur && (cur->isRed() || curBh > lowBh))
+        {
+            if (cur->isBlack())
+                --curBh;
+            dad = cur;
+            cur = tallLeft ? cur->_right : cur->_left;
+        }
+
+        // k встает между dad и cur, а низкое дерево уходит к нему вторым ребенком
+        (tallLeft ? k->_left : k->_right) = cur;
+        if (cur)
+            cur->_parent = k;
+        (tallLeft ? k->_right : k->_left) = low;
+        if (low)
+            low->_parent = k;
+
+        (tallLeft ? dad->_right : dad->_left) = k;
+        k->_parent = dad;
+
+        fixSize(k);
+        for (Node *p = dad; p; p = p->_parent)
+            fixSize(p);
+
+        // Красный k мог оказаться под красным отцом — это ровно случай вставки
+        _root = tall;
+        bh = (tallLeft ? bhL : bhR) + (rebalance(k) ? 1 : 0);
+
+        return _root;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::splitNodes(Node *t, std::size_t bh, const Element &key,
+                                                                Node *&l, std::size_t &bhL, Node *&r, std::size_t &bhR,
+                                                                Node *&mid)
+    {
+        if (!t)
+        {
+            l = r = nullptr;
+            bhL = bhR = 0;
+            return;
+        }
+
+        // Отрываем узел от детей: дальше он либо станет разделителем при склейке, либо это искомый ключ
+        Node *tl = t->_left;
+        Node *tr = t->_right;
+        std::size_t childBh = bh - (t->isBlack() ? 1 : 0);
+
+        if (tl)
+            tl->_parent = nullptr;
+        if (tr)
+            tr->_parent = nullptr;
+        t->_left = t->_right = nullptr;
+
+        bool less = _compar(key, t->_key);
+        noteSearch(SP_INSERT, 0, less ? 1 : 2);
+
+        if (less)
+        {
+            // Ключ слева: левая часть разреза — левая часть левого поддерева,
+            // правая — остаток левого поддерева, склеенный через t с правым поддеревом
+            Node *rr;
+            std::size_t bhRR;
+            splitNodes(tl, childBh, key, l, bhL, rr, bhRR, mid);
+            r = joinNodes(rr, bhRR, t, tr, childBh, bhR);
+        }
+        else if (_compar(t->_key, key))
+        {
+            Node *ll;
+            std::size_t bhLL;
+            splitNodes(tr, childBh, key, ll, bhLL, r, bhR, mid);
+            l = joinNodes(tl, childBh, t, ll, bhLL, bhL);
+        }
+        else
+        {
+            // Нашли ключ: дети и есть готовые части
+            mid = t;
+            l = tl;
+            bhL = childBh;
+            r = tr;
+            bhR = childBh;
+        }
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    typename RBTree<Element, Compar, Allocator, Dumper>::Node *
+    RBTree<Element, Compar, Allocator, Dumper>::concatNodes(Node *l, std::size_t bhL, Node *r, std::size_t bhR,
+                                                            std::size_t &bh)
+    {
+        if (!l)
+        {
+            bh = bhR;
+            return r;
+        }
+        if (!r)
+        {
+            bh = bhL;
+            return l;
+        }
+
+        // Вынимаем минимум правой части; черная высота ее при этом может измениться
+        _root = r;
+        r->_parent = nullptr;
+        Node *k = (Node *) r->getLeftmost();
+        unlinkNode(k);
+        r = _root;
+
+        return joinNodes(l, bhL, k, r, blackHeight(r), bh);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    RBTree<Element, Compar, Allocator, Dumper>::~RBTree()
+    {
+        // Удаляем корень вместе со всеми детьми и так до листьев
+        clear();
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::clear()
+    {
+        if (!_root)
+            return;
+
+        // Сбросить пул можно только если никому из элементов не нужен деструктор
+        typedef std::integral_constant<bool,
+                std::is_trivially_destructible<Element>::value && AllocatorHasReleaseAll<NodeAllocator>::value>
+                CanReleaseAll;
+
+        if (!releaseAllNodes(CanReleaseAll()))
+            destroySubtree(_root);
+
+        _root = nullptr;
+        _leftmost = _rightmost = nullptr;
+        setCount(0);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    bool RBTree<Element, Compar, Allocator, Dumper>::releaseAllNodes(std::true_type)
+    {
+        return _nodeAlloc.releaseAll();
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename... Args>
+    typename RBTree<Element, Compar, Allocator, Dumper>::Node *RBTree<Element, Compar, Allocator, Dumper>::createNode(Args &&... args)
+    {
+        Node *nd = NodeAllocTraits::allocate(_nodeAlloc, 1);
+
+        // Если конструктор ключа бросит исключение, память надо вернуть аллокатору
+        try
+        {
+            ::new(static_cast<void *>(nd)) Node(typename Node::InPlace(), std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            NodeAllocTraits::deallocate(_nodeAlloc, nd, 1);
+            throw;
+        }
+
+#ifdef RBTREE_WITH_STATS
+        _stats.nodesAllocated.fetch_add(1, std::memory_order_relaxed);
+#endif
+
+        return nd;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::destroyNode(Node *nd)
+    {
+        nd->~Node();
+        NodeAllocTraits::deallocate(_nodeAlloc, nd, 1);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    std::size_t RBTree<Element, Compar, Allocator, Dumper>::destroySubtree(Node *nd)
+    {
+        if (!nd)
+            return 0;
+
+        std::size_t freed = 1;
+        Node *cur = nd;
+        while (true)
+        {
+            // Спускаемся, пока есть куда
+            if (cur->_left)
+                cur = cur->_left;
+            else if (cur->_right)
+                cur = cur->_right;
+            else
+            {
+                // Лист: отцепляем от отца, освобождаем и поднимаемся к отцу
+                if (cur == nd)
+                    break;
+
+                Node *dad = cur->_parent;
+                (dad->_left == cur ? dad->_left : dad->_right) = nullptr;
+                destroyNode(cur);
+                ++freed;
+                cur = dad;
+            }
+        }
+
+        destroyNode(nd);
+        return freed;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::deleteNode(Node *nd)
+    {
+        // Если переданный узел не существует, просто ничего не делаем, т.к. в вызывающем проверок нет
+        if (!nd)
+            return;
+        if (nd == _root)
+            _root = nullptr;
+        else
+            (nd->isLeftChild() ? nd->_parent->_left : nd->_parent->_right) = nullptr;
+        nd->_parent = nullptr;
+        updateExtremes();
+
+        // Отсоединенное поддерево освобождаем целиком
+        std::size_t freed = destroySubtree(nd);
+        if (getCount() != UNKNOWN_SIZE)
+            setCount(getCount() - freed);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::remove(const Element &key)
+    {
+        // Узел, который мы хотим удалить
+        const Node *delNode = findNode(key, SP_REMOVE);
+
+        if (!delNode)
+            throw std::invalid_argument("Node with this key doesn't exist!");
+
+        unlinkNode((Node *) delNode);
+
+        // Сам удаленный узел уже ни с кем не связан, возвращаем его аллокатору
+        destroyNode((Node *) delNode);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    const Element &RBTree<Element, Compar, Allocator, Dumper>::min() const
+    {
+        if (!_leftmost)
+            throw std::out_of_range("Tree is empty!");
+
+        return _leftmost->_key;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    const Element &RBTree<Element, Compar, Allocator, Dumper>::max() const
+    {
+        if (!_rightmost)
+            throw std::out_of_range("Tree is empty!");
+
+        return _rightmost->_key;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    Element RBTree<Element, Compar, Allocator, Dumper>::popMin()
+    {
+        if (!_leftmost)
+            throw std::out_of_range("Tree is empty!");
+
+        return popNode(_leftmost);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    Element RBTree<Element, Compar, Allocator, Dumper>::popMax()
+    {
+        if (!_rightmost)
+            throw std::out_of_range("Tree is empty!");
+
+        return popNode(_rightmost);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    Element RBTree<Element, Compar, Allocator, Dumper>::popNode(Node *nd)
+    {
+        // Элемент забираем до того, как трогать дерево: если перемещение бросит, дерево цело
+        Element res(std::move(nd->_key));
+
+        unlinkNode(nd);
+        destroyNode(nd);
+
+        return res;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    std::size_t RBTree<Element, Compar, Allocator, Dumper>::countNodes(const Node *nd)
+    {
+#ifdef RBTREE_WITH_ORDER_STATISTICS
+        return Node::sizeOf(nd);
+#else
+        // Глубина рекурсии — высота дерева, то есть O(log n)
+        return nd ? 1 + countNodes(nd->_left) + countNodes(nd->_right) : 0;
+#endif
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::unlinkNode(Node *delNode)
+    {
+        // curNode - узел для запоминания цвета и для замены удаляемого
+        // rebNode - узел для утряски дерева, rebParent - его отец
+        Node *curNode = delNode;
+        Node *rebNode;
+        /* rebNode вполне может оказаться nullptr (у удаляемого узла или у его преемника не было детей),
+         * поэтому отца для утряски запоминаем отдельно — у пустого листа его не спросишь */
+        Node *rebParent;
+
+        // Крайний узел уходит — его место занимает сосед, до которого у крайнего узла один шаг вверх или вниз
+        if (delNode == _leftmost)
+            _leftmost = (Node *) delNode->getNext();
+        if (delNode == _rightmost)
+            _rightmost = (Node *) delNode->getPrev();
+        if (getCount() != UNKNOWN_SIZE)
+            setCount(getCount() - 1);
+        noteOperation(SP_REMOVE);
+
+        Color col = curNode->getColor();
+
+        // Если нет левого ребенка, меняем с правым (в том числе и с пустым),
+        if (!delNode->_left)
+        {
+            shrinkPath(delNode->_parent);
+            rebNode = delNode->_right;
+            rebParent = delNode->_parent;
+            transplant(delNode, delNode->_right);
+        }// Иначе если нет правого ребенка, меняем с левым,
+        else if (!delNode->_right)
+        {
+            shrinkPath(delNode->_parent);
+            rebNode = delNode->_left;
+            rebParent = delNode->_parent;
+            transplant(delNode, delNode->_left);
+        }// Иначе находим младшего потомка у правого ребенка delNode.
+        else
+        {
+            curNode = delNode->_right;
+            while (curNode->_left)
+                curNode = curNode->_left;
+
+            col = curNode->getColor();
+            rebNode = curNode->_right;
+
+            // Физически из дерева уходит место преемника, так что от него вверх поддеревья худеют
+            shrinkPath(curNode->_parent);
+
+            if (curNode->_parent != delNode)
+            { /*  Картина примерно такая
+               *      5        7
+               *    2   10 -> 2 10
+               *       7
+               */
+                rebParent = curNode->_parent;
+                transplant(curNode, curNode->_right);
+                curNode->_right = delNode->_right;
+                curNode->_right->_parent = curNode;
+            }
+            else // Преемник — сам правый ребенок, его правое поддерево остается при нем
+                rebParent = curNode;
+
+            // Теперь выталкиваем эту ноду на место удаляемой
+            // И отдаем ей всех левых детей.
+            // reminder: у ноды, которую мы поставили, нет левых детей, потому что она самая левая среди правых.
+            transplant(delNode, curNode);
+            curNode->_left = delNode->_left;
+            curNode->_left->_parent = curNode;
+            curNode->setColor(delNode->getColor());
+            fixSize(curNode);
+        }
+
+        // отладочное событие
+        dumpEvent(RBTreeDumperEvents::DE_AFTER_BST_REMOVE, delNode);
+
+        // Если не было 2 детей и был черный цвет
+        // Или если у ноды, поставленной на место бывшей, черный цвет,
+        // То мы могли нарушить баланс, а значит надо потрясти дерево.
+        if (col == BLACK)
+            rebalanceDel(rebNode, rebParent);
+
+        // Если мы достали снизу красную вершину, то утряска производиться не будет, но корень покрасить надо.
+        if (_root)
+            _root->setBlack();
+
+        // отладочное событие
+        dumpEvent(RBTreeDumperEvents::DE_AFTER_REMOVE, delNode);
+
+        // Отвязываем сам узел окончательно, чтобы он не ссылался на бывших соседей
+        delNode->_parent = delNode->_left = delNode->_right = nullptr;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::transplant(const Node *before, Node *after)
+    {
+        if (!before)
+            throw std::invalid_argument("Can't transplant nullptr!");
+
+        // Тернарка в тернарке тут выглядит слишком страшно, поэтому оставлю if-else
+        if (!before->_parent)
+            _root = after;
+        else
+            (before->isLeftChild() ? before->_parent->_left : before->_parent->_right) = after;
+
+        if (after)
+            after->_parent = before->_parent;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::rebalanceDel(Node *start, Node *parent)
+    {
+        /* Стоит напомнить, что у нас либо не было 2 детей и был черный цвет
+        * Тогда переданный узел - это тот самый ребенок, который пришел на место удаленной ноды
+        * Либо мы достали с самого низа черную ноду, а утряску делаем относительно её бывшего правого ребенка
+        * В обоих случаях узел может быть пустым (nullptr), поэтому его отца таскаем рядом в dad */
+        Node *cur = start;
+        Node *dad = parent;
+        Node *bro;
+
+        // Мы хотим исправить 3 проблемы ( B <-> black; R <-> red )
+        /* 1. После удаления корень стал красным
+         *   x(B)  del(x)    y(R)
+         *  y(R)     ->
+         *
+         * Тут все совсем просто - цикл не выполнится т.к. мы уже в корне
+         * А последняя строка покрасит корень в черный
+         */
+        /* 2. Если появились 2 красных подряд
+         *    a(B)      del(a)       f(B)
+         *b(B)    c(R)     ->    b(B)    c(R)
+         *     f(B)  d(B)              g(R) d(B)
+         *       g(R)
+         */
+        /* 3. Удаление ноды изменяет количество черных вершин до листа
+         *    a(B)      del(a)       f(B)
+         *b(B)    c(R)     ->    b(B)    c(R)
+         *     f(B)  d(B)             null  d(B)
+         *
+         *  f->c->null содержит 1 черную вершину,
+         *  в то время как путь до остальных листьев содержит по 2 черных вершины
+         */
+
+        /* Удалив черную ноду, мы повесили на всех её потомков дополнительный черный цвет
+         * Чтобы отразить это, немножко пересмотрим параметры наших цветов в методе
+         * cur->isBlack значит, что cur черный + дополнительный черный от потерянного родителя
+         * cur->isRed значит, что cur красный + дополнительный черный от потерянного родителя
+         *
+         * Если cur->isRed, то мы можем завершать цикл, т.к. в конце метода cur красится в черный,
+         * А значит баланс будет восстановлен.
+         */
+        // Счетчики для статистики; без RBTREE_WITH_STATS компилятор их выбрасывает
+        std::size_t iterations = 0, rotations = 0, recolors = 0;
+
+        while (cur != _root && (!cur || cur->isBlack()))
+        {   /* Мои любимые тернарки
+            !!! В комментариях рассматривается только левый случай, но правый полностью зеркален !!! */
+
+            /* Пустой cur у отца узнаем по тому, что брат у него точно есть:
+             * удаленная черная вершина оставила в его поддереве хотя бы одну черную */
+            bool isLeft = (dad->_left == cur);
+            ++iterations;
+            // Это брат
+            bro = isLeft ? dad->_right : dad->_left;
+
+            /* Если брат есть и при том он красный,
+             * То сводим эту ситуацию к остальным
+             * Т.е. делаем брата черным */
+            if (bro && bro->isRed())
+            {
+                // Красим семью и проворачиваем брата вверх
+                bro->setBlack();
+                dad->setRed();
+                dumpEvent(RBTreeDumperEvents::DE_AFTER_DEL_RECOLOR1, dad);
+                isLeft ? rotLeft(dad) : rotRight(dad);
+                recolors += 2;
+                ++rotations;
+                bro = isLeft ? dad->_right : dad->_left;
+            }
+
+            /* Если у брата два черных ребенка, то мы его самого красим в красный (nullptr это тоже черные дети)
+             * Таким образом мы "забираем" один черный от себя и от брата, после чего переходим к отцу
+             * Если отец был красным, то цикл заканчивается и он красится в черный
+             * Иначе история повторяется */
+            if ((!bro->_left || bro->_left->isBlack()) && (!bro->_right || bro->_right->isBlack()))
+            {
+                bro->setRed();
+                ++recolors;
+                dumpEvent(RBTreeDumperEvents::DE_AFTER_DEL_RECOLOR2, dad);
+                cur = dad;
+                dad = cur->_parent;
+            } else
+            {
+                /* Если у брата правые дети - черные (или nullptr), и есть левый ребенок
+                 * (который красный - мы это выяснили на прошлом шаге)
+                 * То поворачиваем левым ребенком вверх.
+                 * Это нам гарантирует следующий кейс - левый ребенок черный, а правый - красный */
+                if (isLeft ? (bro->_left && (!bro->_right || bro->_right->isBlack())) :
+                    (bro->_right && (!bro->_left || bro->_left->isBlack())))
+                {
+                    (isLeft ? bro->_left : bro->_right)->setBlack();
+                    bro->setRed();
+                    dumpEvent(RBTreeDumperEvents::DE_AFTER_DEL_RECOLOR3, dad);
+                    isLeft ? rotRight(bro) : rotLeft(bro);
+                    recolors += 2;
+                    ++rotations;
+                    bro = isLeft ? dad->_right : dad->_left;
+                }
+
+                /* Брат черный;
+                 * Левый ребенок брата - черный/nullptr, правый - красный;
+                 * Красим брата в цвет папы, а папу в черный
+                 * Поворачиваем влево относительно папы, тогда брат вылезает вверх,
+                 * Папа забирает на себя лишний черный цвет, заканчиваем цикл. */
+                bro->setColor(dad->getColor());
+                dad->setBlack();
+                /* У брата ТОЧНО есть правый ребенок, поэтому сможем выполнить поворот
+                 * (если бы не было ни одного, выполнился бы второй иф,
+                 * если был бы только левый, то чуть выше мы переводим эту ситуацию к правому ребенку). */
+                (isLeft ? bro->_right : bro->_left)->setBlack();
+                dumpEvent(RBTreeDumperEvents::DE_AFTER_DEL_RECOLOR4, dad);
+                isLeft ? rotLeft(dad) : rotRight(dad);
+                recolors += 3;
+                ++rotations;
+                cur = _root;
+            }
+        }
+
+        if (cur)
+        {
+            if (cur->isRed())
+                ++recolors;
+            cur->setBlack();
+        }
+        noteFixup(SP_REMOVE, iterations, rotations, recolors);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::insert(const Element &key)
+    {
+        if (!tryInsertImpl(key).second)
+            throw std::invalid_argument("Node with this value already exist!");
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::insert(Element &&key)
+    {
+        if (!tryInsertImpl(std::move(key)).second)
+            throw std::invalid_argument("Node with this value already exist!");
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    std::pair<typename RBTree<Element, Compar, Allocator, Dumper>::const_iterator, bool>
+    RBTree<Element, Compar, Allocator, Dumper>::tryInsert(const Element &key)
+    {
+        return tryInsertImpl(key);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    std::pair<typename RBTree<Element, Compar, Allocator, Dumper>::const_iterator, bool>
+    RBTree<Element, Compar, Allocator, Dumper>::tryInsert(Element &&key)
+    {
+        return tryInsertImpl(std::move(key));
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    typename RBTree<Element, Compar, Allocator, Dumper>::const_iterator
+    RBTree<Element, Compar, Allocator, Dumper>::insert(const_iterator hint, const Element &key)
+    {
+        return insertHintImpl(hint, key);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    typename RBTree<Element, Compar, Allocator, Dumper>::const_iterator
+    RBTree<Element, Compar, Allocator, Dumper>::insert(const_iterator hint, Element &&key)
+    {
+        return insertHintImpl(hint, std::move(key));
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename Arg>
+    std::pair<typename RBTree<Element, Compar, Allocator, Dumper>::const_iterator, bool>
+    RBTree<Element, Compar, Allocator, Dumper>::tryInsertImpl(Arg &&key)
+    {
+        Node *parent;
+        bool goLeft;
+        Node *dup = findInsertPos(key, parent, goLeft);
+        if (dup)
+            return std::make_pair(const_iterator(dup, this), false);
+
+        // Место свободно — только теперь тратимся на узел
+        Node *newNode = createNode(std::forward<Arg>(key));
+        attachNode(newNode, parent, goLeft);
+
+        return std::make_pair(const_iterator(newNode, this), true);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename Arg>
+    typename RBTree<Element, Compar, Allocator, Dumper>::const_iterator
+    RBTree<Element, Compar, Allocator, Dumper>::insertHintImpl(const_iterator hint, Arg &&key)
+    {
+        Node *parent;
+        bool goLeft;
+        Node *dup = findInsertPosNear(key, (Node *) hint._node, parent, goLeft);
+        if (dup)
+            return const_iterator(dup, this);
+
+        Node *newNode = createNode(std::forward<Arg>(key));
+        attachNode(newNode, parent, goLeft);
+        return const_iterator(newNode, this);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename... Args>
+    std::pair<typename RBTree<Element, Compar, Allocator, Dumper>::const_iterator, bool>
+    RBTree<Element, Compar, Allocator, Dumper>::emplaceImpl(std::false_type, Args &&... args)
+    {
+        Node *newNode = createNode(std::forward<Args>(args)...);
+
+        Node *parent;
+        bool goLeft;
+        Node *dup = findInsertPos(newNode->_key, parent, goLeft);
+        if (dup)
+        {
+            destroyNode(newNode);
+            return std::make_pair(const_iterator(dup, this), false);
+        }
+
+        attachNode(newNode, parent, goLeft);
+        return std::make_pair(const_iterator(newNode, this), true);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::attachNode(Node *newNode, Node *parent, bool goLeft)
+    {
+        linkNode(newNode, parent, goLeft);
+
+        // отладочное событие
+        dumpEvent(RBTreeDumperEvents::DE_AFTER_BST_INS, newNode);
+
+        rebalance(newNode);
+
+        // отладочное событие
+        dumpEvent(RBTreeDumperEvents::DE_AFTER_INSERT, newNode);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::linkNode(Node *nd, Node *parent, bool goLeft)
+    {
+        if (getCount() != UNKNOWN_SIZE)
+            setCount(getCount() + 1);
+        noteOperation(SP_INSERT);
+
+        if (!parent)
+        {
+            _root = nd;
+            _leftmost = _rightmost = nd;
+            return;
+        }
+
+        (goLeft ? parent->_left : parent->_right) = nd;
+        nd->_parent = parent;
+        growPath(parent);
+
+        if (goLeft && parent == _leftmost)
+            _leftmost = nd;
+        else if (!goLeft && parent == _rightmost)
+            _rightmost = nd;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename K>
+    typename RBTree<Element, Compar, Allocator, Dumper>::Node *
+    RBTree<Element, Compar, Allocator, Dumper>::findInsertPos(const K &key, Node *from, Node *&parent, bool &goLeft,
+                                                              std::true_type) const
+    {
+        parent = nullptr;
+        goLeft = false;
+
+        std::size_t cmps = 0;
+        Node *cur = from;
+        while (cur)
+        {
+            ++cmps;
+            int cmp = _compar.compare(key, cur->_key);
+            if (cmp == 0)
+                break;
+
+            parent = cur;
+            goLeft = cmp < 0;
+            cur = goLeft ? cur->_left : cur->_right;
+        }
+
+        noteSearch(SP_INSERT, cmps, cmps);
+        return cur;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename K>
+    typename RBTree<Element, Compar, Allocator, Dumper>::Node *
+    RBTree<Element, Compar, Allocator, Dumper>::findInsertPos(const K &key, Node *from, Node *&parent, bool &goLeft,
+                                                              std::false_type) const
+    {
+        /* Одно сравнение на уровень, как в lower_bound(), а кандидат в дубликаты — последний
+         * узел, на котором свернули влево */
+        parent = nullptr;
+        goLeft = false;
+
+        std::size_t path = 0;
+        Node *cand = nullptr;
+        Node *cur = from;
+        while (cur)
+        {
+            ++path;
+            parent = cur;
+
+            // Если значение узла меньше, то надо спускаться вправо, иначе влево
+            goLeft = !_compar(cur->_key, key);
+            if (goLeft)
+                cand = cur;
+            cur = goLeft ? cur->_left : cur->_right;
+        }
+
+        noteSearch(SP_INSERT, path, path + (cand ? 1 : 0));
+        if (cand && !_compar(key, cand->_key))
+            return cand;
+
+        return nullptr;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    typename RBTree<Element, Compar, Allocator, Dumper>::Node *
+    RBTree<Element, Compar, Allocator, Dumper>::findInsertPosNear(const Element &key, Node *hint, Node *&parent,
+                                                                  bool &goLeft) const
+    {
+        parent = nullptr;
+        goLeft = false;
+        if (!_root)
+            return nullptr;
+
+        // Сравнения с подсказкой и ее соседями идут в статистику вставки наравне со спуском
+        std::size_t cmps = 0;
+        auto less = [this, &cmps](const Element &a, const Element &b)
+        {
+            ++cmps;
+            return _compar(a, b);
+        };
+
+        Node *res = nullptr;
+        Node *from = nullptr;
+
+        // Подсказка end(): ключ больше максимума — дописываем справа от него без спуска
+        if (!hint && less(_rightmost->_key, key))
+            parent = _rightmost;
+        else
+        {
+            if (!hint)
+                hint = _rightmost;
+
+            if (less(key, hint->_key))
+            {
+                Node *prev = (Node *) hint->getPrev();
+                if (!prev || less(prev->_key, key))
+                {
+                    // Ключ между prev и hint: у одного из них нужная сторона точно свободна
+                    if (!hint->_left)
+                    {
+                        parent = hint;
+                        goLeft = true;
+                    }
+                    else
+                        parent = prev;
+                }
+                else if (!less(key, prev->_key))
+                    res = prev;
+                else
+                {
+                    /* Подсказка велика: поднимаемся, пока не окажемся правым ребенком узла меньше key —
+                     * тогда key лежит в границах текущего поддерева */
+                    from = hint;
+                    while (from->_parent && !(from->isRightChild() && less(from->_parent->_key, key)))
+                        from = from->_parent;
+                }
+            }
+            else if (less(hint->_key, key))
+            {
+                Node *next = (Node *) hint->getNext();
+                if (!next || less(key, next->_key))
+                {
+                    if (!hint->_right)
+                        parent = hint;
+                    else
+                    {
+                        parent = next;
+                        goLeft = true;
+                    }
+                }
+                else if (!less(next->_key, key))
+                    res = next;
+                else
+                {
+                    from = hint;
+                    while (from->_parent && !(from->isLeftChild() && less(key, from->_parent->_key)))
+                        from = from->_parent;
+                }
+            }
+            else
+                res = hint;
+        }
+
+        noteSearch(SP_INSERT, 0, cmps);
+        if (from)
+            return findInsertPos(key, from, parent, goLeft, ComparHasThreeWay<Compar, Element, Element>());
+
+        return res;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename K>
+    const typename RBTree<Element, Compar, Allocator, Dumper>::Node *
+    RBTree<Element, Compar, Allocator, Dumper>::findNode(const K &key, StatPhase phase, std::true_type) const
+    {
+        std::size_t path = 0;
+        const Node *cur = _root;
+        while (cur)
+        {
+            ++path;
+            int cmp = _compar.compare(key, cur->_key);
+            if (cmp == 0)   // Нашли узел с эквивалентным значением
+                break;
+
+            // Если значение меньше, то надо спускаться влево, иначе вправо
+            cur = cmp < 0 ? cur->_left : cur->_right;
+        }
+
+        // Если цикл дошел до листьев, cur пуст, а следовательно такого значения нет
+        noteSearch(phase, path, path);
+        return cur;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename K>
+    const typename RBTree<Element, Compar, Allocator, Dumper>::Node *
+    RBTree<Element, Compar, Allocator, Dumper>::findNode(const K &key, StatPhase phase, std::false_type) const
+    {
+        // Первый не меньший key узел эквивалентен ему, если key не меньше этого узла
+        std::size_t path;
+        const Node *res = lowerBoundNode(key, path);
+        noteSearch(phase, path, path + (res ? 1 : 0));
+        if (res && !_compar(key, res->_key))
+            return res;
+
+        return nullptr;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::findBatch(const Element *keys, std::size_t n, const Node **out) const
+    {
+        // Каждый поиск устроен как lowerBoundNode(): кандидат res и одна проверка эквивалентности в конце
+        const Node *cur[BATCH_GROUP];
+        const Node *res[BATCH_GROUP];
+        std::size_t path[BATCH_GROUP];
+
+        for (std::size_t base = 0; base < n; base += BATCH_GROUP)
+        {
+            std::size_t m = n - base < BATCH_GROUP ? n - base : BATCH_GROUP;
+            const Element *key = keys + base;
+            for (std::size_t i = 0; i < m; ++i)
+            {
+                cur[i] = _root;
+                res[i] = nullptr;
+                path[i] = 0;
+            }
+
+            // Шаг по уровню для всех еще не дошедших до листа; глубже — уже запрошенные узлы
+            for (bool active = _root != nullptr; active;)
+            {
+                active = false;
+                for (std::size_t i = 0; i < m; ++i)
+                {
+                    const Node *nd = cur[i];
+                    if (!nd)
+                        continue;
+
+                    ++path[i];
+                    if (_compar(nd->_key, key[i]))
+                        nd = nd->_right;
+                    else
+                    {
+                        res[i] = nd;
+                        nd = nd->_left;
+                    }
+
+                    if (nd)
+                    {
+                        RBTREE_PREFETCH(nd);
+                        active = true;
+                    }
+                    cur[i] = nd;
+                }
+            }
+
+            for (std::size_t i = 0; i < m; ++i)
+            {
+                noteSearch(SP_LOOKUP, path[i], path[i] + (res[i] ? 1 : 0));
+                out[base + i] = (res[i] && !_compar(key[i], res[i]->_key)) ? res[i] : nullptr;
+            }
+        }
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename K>
+    const typename RBTree<Element, Compar, Allocator, Dumper>::Node *
+    RBTree<Element, Compar, Allocator, Dumper>::lowerBoundNode(const K &key, std::size_t &path) const
+    {
+        // Последний узел, на котором свернули влево, — кандидат в ответ
+        path = 0;
+        const Node *res = nullptr;
+        const Node *cur = _root;
+        while (cur)
+        {
+            ++path;
+            if (_compar(cur->_key, key))
+                cur = cur->_right;
+            else
+            {
+                res = cur;
+                cur = cur->_left;
+            }
+        }
+
+        return res;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename K>
+    const typename RBTree<Element, Compar, Allocator, Dumper>::Node *
+    RBTree<Element, Compar, Allocator, Dumper>::upperBoundNode(const K &key) const
+    {
+        const Node *res = nullptr;
+        const Node *cur = _root;
+        while (cur)
+        {
+            if (_compar(key, cur->_key))
+            {
+                res = cur;
+                cur = cur->_left;
+            }
+            else
+                cur = cur->_right;
+        }
+
+        return res;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename K>
+    std::pair<typename RBTree<Element, Compar, Allocator, Dumper>::const_iterator,
+            typename RBTree<Element, Compar, Allocator, Dumper>::const_iterator>
+    RBTree<Element, Compar, Allocator, Dumper>::equalRange(const K &key) const
+    {
+        const_iterator first(lowerBoundNode(key), this);
+        const_iterator last = first;
+
+        // Дубликатов в дереве нет, так что диапазон либо пуст, либо из одного элемента
+        if (first != end() && !_compar(key, *first))
+            ++last;
+
+        return std::make_pair(first, last);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename Visitor>
+    void RBTree<Element, Compar, Allocator, Dumper>::forEachInRange(const Element &lo, const Element &hi,
+                                                                    Visitor visitor) const
+    {
+        // Пустой или вывернутый диапазон
+        if (!_compar(lo, hi))
+            return;
+
+        visitRange(_root, lo, hi, visitor, false, false);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    template<typename Visitor>
+    void RBTree<Element, Compar, Allocator, Dumper>::visitRange(const Node *nd, const Element &lo, const Element &hi,
+                                                                Visitor &visitor, bool loDone, bool hiDone) const
+    {
+        // Правые поддеревья обходим циклом, а в рекурсию уходим только налево
+        while (nd)
+        {
+            // Узел левее диапазона — вместе с ним отбрасываем и все его левое поддерево
+            if (!loDone && _compar(nd->_key, lo))
+            {
+                nd = nd->_right;
+                continue;
+            }
+
+            // Узел правее диапазона — отбрасываем его вместе с правым поддеревом
+            if (!hiDone && !_compar(nd->_key, hi))
+            {
+                nd = nd->_left;
+                continue;
+            }
+
+            // Узел в диапазоне: слева все меньше него, а значит меньше hi; справа все больше, а значит не меньше lo
+            visitRange(nd->_left, lo, hi, visitor, loDone, true);
+            visitor(nd->_key);
+
+            nd = nd->_right;
+            loDone = true;
+        }
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    std::size_t RBTree<Element, Compar, Allocator, Dumper>::countInRange(const Element &lo, const Element &hi) const
+    {
+#ifdef RBTREE_WITH_ORDER_STATISTICS
+        if (!_compar(lo, hi))
+            return 0;
+
+        return rank(hi) - rank(lo);
+#else
+        struct Counter
+        {
+            std::size_t cnt;
+
+            void operator()(const Element &)
+            { ++cnt; }
+        } counter = {0};
+
+        forEachInRange(lo, hi, std::ref(counter));
+        return counter.cnt;
+#endif
+    }
+
+
+#ifdef RBTREE_WITH_ORDER_STATISTICS
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    typename RBTree<Element, Compar, Allocator, Dumper>::const_iterator
+    RBTree<Element, Compar, Allocator, Dumper>::select(std::size_t k) const
+    {
+        const Node *cur = _root;
+        while (cur)
+        {
+            std::size_t leftSize = Node::sizeOf(cur->_left);
+
+            // k-й лежит слева, в самом узле или справа со сдвигом на левую часть и узел
+            if (k < leftSize)
+                cur = cur->_left;
+            else if (k == leftSize)
+                break;
+            else
+            {
+                k -= leftSize + 1;
+                cur = cur->_right;
+            }
+        }
+
+        return const_iterator(cur, this);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    std::size_t RBTree<Element, Compar, Allocator, Dumper>::rank(const Element &key) const
+    {
+        // Каждый раз, сворачивая направо, пропускаем левое поддерево и сам узел — они меньше key
+        std::size_t res = 0;
+        const Node *cur = _root;
+        while (cur)
+        {
+            if (_compar(cur->_key, key))
+            {
+                res += Node::sizeOf(cur->_left) + 1;
+                cur = cur->_right;
+            }
+            else
+                cur = cur->_left;
+        }
+
+        return res;
+    }
+
+#endif // RBTREE_WITH_ORDER_STATISTICS
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    typename RBTree<Element, Compar, Allocator, Dumper>::Node *
+    RBTree<Element, Compar, Allocator, Dumper>::insertNewBstEl(const Element &key)
+    {
+        /* Ищем место для элемента */
+        Node *parent;
+        bool goLeft;
+        if (findInsertPos(key, parent, goLeft))  // Если в дереве есть такое значение - кидаем исключение
+            throw std::invalid_argument("Node with this value already exist!");
+
+        Node *newNode = createNode(key);
+        linkNode(newNode, parent, goLeft);
+
+        return newNode;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    bool RBTree<Element, Compar, Allocator, Dumper>::rebalance(Node *nd)
+    {
+        // Новый (черный) корень — черная высота пустого дерева выросла с нуля до единицы
+        if (_root == nd)
+            return true;
+
+        nd->setRed();
+
+        if (nd->_parent->isBlack())
+            return false;
+
+        // Счетчики для статистики; без RBTREE_WITH_STATS компилятор их выбрасывает
+        std::size_t iterations = 0, rotations = 0, recolors = 0;
+
+        // Пока папа красный
+        while (nd->_parent->isRed())
+        {
+            ++iterations;
+
+            // Является ли папа левым ребенком
+            bool isLeft = nd->_parent->isLeftChild();
+
+            // Если дядя красный (да-да, так выглядит дядя; если папа левый, то он правый, иначе наоборот)
+            Node *unc = isLeft ? nd->_parent->_parent->_right : nd->_parent->_parent->_left;
+            if (unc && unc->isRed())
+            {   // Перекрашиваем семью
+                nd->_parent->setBlack();
+                unc->setBlack();
+                nd->_parent->_parent->setRed();
+                recolors += 3;
+                dumpEvent(RBTreeDumperEvents::DE_AFTER_RECOLOR1, nd);
+                nd = nd->_parent->_parent; // Переходим к дедушке и проверяем его семью
+                // Если это корень, или если мы ребенок корня, то проверка закончена
+                // Корень гарантированно покрасится в черный в конце, а ребенок у корня может быть любой
+                if (!nd->_parent || nd->_parent->isBlack())
+                    break;
+            } else
+            {// Тернарки схлопывают 2 случая в один c:
+                /* Если у нас не прямая ветка, а изгиб, то выворачиваем ребенка наверх, чтобы выпрямить
+                 *          10         10  |     5          5
+                 *        5     ->    8    |       10   ->    8
+                 *          8       5      |      8             10
+                 */
+                if (isLeft ? nd == nd->_parent->_right : nd == nd->_parent->_left)
+                {
+                    nd = nd->_parent;
+                    isLeft ? rotLeft(nd) : rotRight(nd);
+                    ++rotations;
+                }
+                // А после спокойно делаем поворот
+                nd->_parent->setBlack();
+                dumpEvent(RBTreeDumperEvents::DE_AFTER_RECOLOR3D, nd);
+                nd->_parent->_parent->setRed();
+                dumpEvent(RBTreeDumperEvents::DE_AFTER_RECOLOR3G, nd);
+                isLeft ? rotRight(nd->_parent->_parent) : rotLeft(nd->_parent->_parent);
+                recolors += 2;
+                ++rotations;
+            }
+        }
+
+        // Красным корень мог стать только после перекраски по случаю 1, и тогда,
+        // возвращая ему черный цвет, мы добавляем по черному узлу на все пути
+        bool grew = _root->isRed();
+        _root->setBlack();
+        noteFixup(SP_INSERT, iterations, rotations, recolors + (grew ? 1 : 0));
+        return grew;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::rotLeft(Node *nd)
+    {
+        // Правый потомок, который станет после левого поворота "выше"
+        Node *y = nd->_right;
+
+        if (!y)
+            throw std::invalid_argument("Can't rotate left since the right child is nil");
+
+        /* Перераспределение семейных связей */
+        // y станет родителем для nd
+        y->_parent = nd->_parent;
+
+        // Если это не корень дерева
+        if (y->_parent != nullptr)
+        {
+            // Если nd был левым ребенком, то теперь левым ребенком будет y
+            if (nd->_parent->_left == nd)
+                nd->_parent->_left = y;
+            // Иначе правым
+            else
+                nd->_parent->_right = y;
+        }
+
+        /* Поворот влево */
+        //      nd
+        //        y
+        //       f g
+        nd->_right = y->_left;
+        if (nd->_right)
+            nd->_right->_parent = nd;
+
+        //       y
+        //    nd   g
+        //      f
+        nd->_parent = y;
+        y->_left = nd;
+
+        // y теперь отвечает за все бывшее поддерево nd, а nd потерял правую часть
+        fixSize(nd);
+        fixSize(y);
+
+        if (_root->_parent)
+            _root = _root->_parent;
+
+        // отладочное событие
+        dumpEvent(RBTreeDumperEvents::DE_AFTER_LROT, nd);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::rotRight(Node *nd)
+    {
+        // Левый потомок, который станет после правого поворота "выше"
+        Node *y = nd->_left;
+
+        if (!y)
+            throw std::invalid_argument("Can't rotate left since the right child is nil");
+
+        /* Перераспределение семейных связей */
+        // y станет родителем для nd
+        y->_parent = nd->_parent;
+
+        // Если это не корень дерева
+        if (y->_parent != nullptr)
+        {
+            // Если nd был левым ребенком, то теперь левым ребенком будет y
+            if (nd->_parent->_left == nd)
+                nd->_parent->_left = y;
+            // Иначе правым
+            else
+                nd->_parent->_right = y;
+        }
+
+        /* Поворот влево */
+        //      nd
+        //     y
+        //    f g
+        nd->_left = y->_right;
+        if (nd->_left)
+            nd->_left->_parent = nd;
+
+        //       y
+        //     f   nd
+        //        g
+        nd->_parent = y;
+        y->_right = nd;
+
+        fixSize(nd);
+        fixSize(y);
+
+        if (_root->_parent)
+            _root = _root->_parent;
+
+        // отладочное событие
+        dumpEvent(RBTreeDumperEvents::DE_AFTER_RROT, nd);
+    }
+
+
+#ifdef RBTREE_WITH_STATS
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    RBTreeStats RBTree<Element, Compar, Allocator, Dumper>::getStats() const
+    {
+        RBTreeStats res;
+        RBTreeStats::Phase *phases[3];
+        phases[SP_INSERT] = &res.insert;
+        phases[SP_REMOVE] = &res.remove;
+        phases[SP_LOOKUP] = &res.lookup;
+
+        for (int i = 0; i < 3; ++i)
+        {
+            const PhaseCounters &pc = _stats.phases[i];
+            phases[i]->operations = pc.operations.load(std::memory_order_relaxed);
+            phases[i]->comparisons = pc.comparisons.load(std::memory_order_relaxed);
+            phases[i]->rotations = pc.rotations.load(std::memory_order_relaxed);
+            phases[i]->recolors = pc.recolors.load(std::memory_order_relaxed);
+            phases[i]->fixupIterations = pc.fixupIterations.load(std::memory_order_relaxed);
+        }
+
+        res.nodesAllocated = _stats.nodesAllocated.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < RBTreeStats::PATH_BUCKETS; ++i)
+            res.findPathLength[i] = _stats.findPath[i].load(std::memory_order_relaxed);
+
+        return res;
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::StatsCounters::reset()
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            phases[i].operations.store(0, std::memory_order_relaxed);
+            phases[i].comparisons.store(0, std::memory_order_relaxed);
+            phases[i].rotations.store(0, std::memory_order_relaxed);
+            phases[i].recolors.store(0, std::memory_order_relaxed);
+            phases[i].fixupIterations.store(0, std::memory_order_relaxed);
+        }
+
+        nodesAllocated.store(0, std::memory_order_relaxed);
+        for (std::size_t i = 0; i < RBTreeStats::PATH_BUCKETS; ++i)
+            findPath[i].store(0, std::memory_order_relaxed);
+    }
+
+
+    template<typename Element, typename Compar, typename Allocator, typename Dumper>
+    void RBTree<Element, Compar, Allocator, Dumper>::StatsCounters::add(const StatsCounters &other)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            const PhaseCounters &pc = other.phases[i];
+            phases[i].operations.fetch_add(pc.operations.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            phases[i].comparisons.fetch_add(pc.comparisons.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            phases[i].rotations.fetch_add(pc.rotations.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            phases[i].recolors.fetch_add(pc.recolors.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            phases[i].fixupIterations.fetch_add(pc.fixupIterations.load(std::memory_order_relaxed),
+                                                std::memory_order_relaxed);
+        }
+
+        nodesAllocated.fetch_add(other.nodesAllocated.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        for (std::size_t i = 0; i < RBTreeStats::PATH_BUCKETS; ++i)
+            findPath[i].fetch_add(other.findPath[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+#endif // RBTREE_WITH_STATS
+
+
 } // namespace xi
\ No newline at end of file
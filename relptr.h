@@ -0,0 +1,125 @@
+﻿////////////////////////////////////////////////////////////////////////////////
+/// \file
+/// \brief     Самоотносительный указатель с компактным смещением
+/// \author    Kupchenko Viktor
+/// \version   0.1.0
+/// \date      01.05.2017
+///            This is a part of the course "Algorithms and Data Structures"
+///            provided by  the School of Software Engineering of the Faculty
+///            of Computer Science at the Higher School of Economics.
+///
+/// Указатель хранит не адрес, а расстояние от самого себя до цели. Поэтому
+/// структура из таких указателей, лежащая в одном куске памяти, остается
+/// целой после memcpy, переноса в другой буфер или записи на диск, а само
+/// смещение помещается в 32 бита вместо 64.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef XI_RELPTR_H
+#define XI_RELPTR_H
+
+#include <cassert>
+#include <cstddef>          // std::ptrdiff_t
+#include <cstdint>          // std::int32_t, std::intptr_t
+#include <limits>
+
+
+namespace xi
+{
+
+
+/** \brief Указатель на \c T, хранящий смещение цели относительно собственного адреса.
+ *
+ *  Смещение считается в единицах \c alignof(Offset): и сам указатель, и цель выровнены
+ *  как минимум так же, поэтому младшие биты разности адресов всегда нулевые. Для \c int32_t
+ *  это дает диапазон +-8 ГБ. Нулевое смещение (указатель на самого себя) означает \c nullptr.
+ *
+ *  Целостность смещения проверяется только \c assert: кто пишет в \c RelPtr, сам отвечает за то,
+ *  что цель лежит в том же куске памяти не шире диапазона смещения (см. \c xi::NodeArena).
+ *
+ *  Ведет себя как обычный \c T*: неявно приводится к нему, разыменовывается через \c ->,
+ *  принимает присваивание \c T*. Копирование пересчитывает смещение под новый адрес, так что
+ *  копия указывает туда же, куда и оригинал.
+ *
+ *  \tparam T Тип цели.
+ *  \tparam Offset Знаковый целый тип смещения.
+ */
+    template<typename T, typename Offset = std::int32_t>
+    class RelPtr
+    {
+    public:
+        RelPtr()
+                : _offset(0)
+        {}
+
+        /** \brief Указатель на \c target. Только прямая инициализация: смещение зависит от адреса. */
+        explicit RelPtr(T *target)
+        { set(target); }
+
+        RelPtr(const RelPtr &other)
+        { set(other.get()); }
+
+        RelPtr &operator=(const RelPtr &other)
+        {
+            set(other.get());
+            return *this;
+        }
+
+        RelPtr &operator=(T *target)
+        {
+            set(target);
+            return *this;
+        }
+
+    public:
+        /** \brief Возвращает адрес цели или \c nullptr. */
+        T *get() const
+        {
+            // Без ветвления: маска обнуляет адрес при нулевом смещении
+            std::intptr_t addr = reinterpret_cast<std::intptr_t>(this) + (std::intptr_t) _offset * UNIT;
+            return reinterpret_cast<T *>(addr & -(std::intptr_t) (_offset != 0));
+        }
+
+        operator T *() const
+        { return get(); }
+
+        T *operator->() const
+        { return get(); }
+
+        /** \brief Сырое смещение в единицах выравнивания (0 — \c nullptr). */
+        Offset getOffset() const
+        { return _offset; }
+
+    protected:
+        static const std::intptr_t UNIT = alignof(Offset);
+
+        void set(T *target)
+        {
+            if (!target)
+            {
+                _offset = 0;
+                return;
+            }
+
+            std::intptr_t diff = reinterpret_cast<std::intptr_t>(target) - reinterpret_cast<std::intptr_t>(this);
+
+            /* Цель должна быть выровнена и достаточно близко: узлы одной арены, а не куча вразнобой.
+             * Проверять это на каждой записи связи дорого, поэтому дерево с RBTREE_RELATIVE_LINKS
+             * гарантирует его заранее: принимает только аллокаторы-арены (AllocatorIsArena), а
+             * арена не бывает больше диапазона смещения */
+            assert(diff % UNIT == 0);
+            assert(diff / UNIT >= (std::intptr_t) std::numeric_limits<Offset>::min()
+                   && diff / UNIT <= (std::intptr_t) std::numeric_limits<Offset>::max());
+
+            _offset = (Offset) (diff / UNIT);
+        }
+
+    protected:
+        Offset _offset;                              ///< Расстояние до цели в единицах UNIT.
+    }; // class RelPtr
+
+
+} // namespace xi
+
+
+#endif // XI_RELPTR_H
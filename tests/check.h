@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  check.h
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Общие мелочи для регрессионных тестов: проверка CHECK, которая печатает
+// провалившееся условие и завершает тест с кодом 1, и сверка упорядоченного
+// множества с эталонным std::set.
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef XI_TESTS_CHECK_H
+#define XI_TESTS_CHECK_H
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <vector>
+
+
+#define CHECK(cond)                                                               \
+    do {                                                                          \
+        if (!(cond))                                                              \
+        {                                                                         \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            std::exit(1);                                                         \
+        }                                                                         \
+    } while (0)
+
+
+namespace xitest
+{
+
+
+/** \brief Сверяет множество с эталоном \c expected: размер \c size, элементы \c ordered в порядке
+ *  обхода и поиск каждого элемента эталона через \c contains.
+ */
+template<typename K, typename Contains>
+void checkSameAsSet(std::size_t size, const std::vector<K> &ordered, const std::set<K> &expected, Contains contains)
+{
+    CHECK(size == expected.size());
+    CHECK(ordered == std::vector<K>(expected.begin(), expected.end()));
+    for (typename std::set<K>::const_iterator it = expected.begin(); it != expected.end(); ++it)
+        CHECK(contains(*it));
+}
+
+
+/** \brief То же для дерева с \c size(), \c begin()/end() и \c find(), возвращающим указатель. */
+template<typename Tree, typename K>
+void checkSameAsSet(const Tree &tree, const std::set<K> &expected)
+{
+    checkSameAsSet(tree.size(), std::vector<K>(tree.begin(), tree.end()), expected,
+                   [&tree](const K &k) { return tree.find(k) != nullptr; });
+}
+
+
+} // namespace xitest
+
+
+#endif // XI_TESTS_CHECK_H
@@ -0,0 +1,178 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  test_allocators.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Аллокаторы из nodepool.h: копии и перепривязки к другому типу равны и
+// разделяют память, поэтому деревья, созданные с копиями одного аллокатора,
+// склеиваются (join), объединяются (unionWith) и перераспределяются по
+// шардам ShardedRBTree без исключения "different allocators". Собирается
+// и с RBTREE_RELATIVE_LINKS: тогда проверяется только арена.
+//
+// Запуск: ./test_allocators (код возврата 0 — успех)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+#include "../nodepool.h"
+#include "../rbsetops.h"
+#include "../rbsharded.h"
+#include "../rbtree.h"
+#include "check.h"
+
+
+/** \brief Элементы дерева по возрастанию. */
+template<typename Tree>
+std::vector<int> contents(const Tree &tree)
+{
+    return std::vector<int>(tree.begin(), tree.end());
+}
+
+
+/** \brief Числа [from, to) с шагом \c step. */
+std::vector<int> range(int from, int to, int step = 1)
+{
+    std::vector<int> res;
+    for (int k = from; k < to; k += step)
+        res.push_back(k);
+    return res;
+}
+
+
+/** \brief Копии и перепривязки равны, независимо созданные — нет; память, выданная одной копией,
+ *  освобождается другой.
+ */
+template<typename IntAlloc>
+void checkEquality(const IntAlloc &alloc, const IntAlloc &other)
+{
+    typedef typename std::allocator_traits<IntAlloc>::template rebind_alloc<double> DoubleAlloc;
+
+    IntAlloc copy(alloc);
+    DoubleAlloc rebound(alloc);
+    IntAlloc back(rebound);
+
+    CHECK(copy == alloc);
+    CHECK(rebound == alloc);
+    CHECK(back == alloc);
+    CHECK(!(alloc == other));
+    CHECK(alloc != other);
+
+    int *p = copy.allocate(1);
+    *p = 42;
+    back.deallocate(p, 1);
+    CHECK(IntAlloc(alloc).allocate(1) == p);
+}
+
+
+/** \brief join, unionWith и ShardedRBTree над деревьями с копиями одного аллокатора \c alloc. */
+template<typename IntAlloc>
+void checkTrees(const IntAlloc &alloc)
+{
+    typedef xi::RBTree<int, std::less<int>, IntAlloc> Tree;
+
+    // join с разделителем и без
+    Tree lo(std::less<int>(), alloc), hi(std::less<int>(), alloc), top(std::less<int>(), alloc);
+    for (int k = 0; k < 1000; ++k)
+        lo.insert(k);
+    for (int k = 1001; k < 3000; ++k)
+        hi.insert(k);
+    for (int k = 3000; k < 4000; ++k)
+        top.insert(k);
+
+    Tree joined = Tree::join(std::move(lo), 1000, std::move(hi));
+    joined = Tree::join(std::move(joined), std::move(top));
+    CHECK(contents(joined) == range(0, 4000));
+
+    // Объединение с деревом, построенным из перепривязанной копии
+    typename std::allocator_traits<IntAlloc>::template rebind_alloc<long> longAlloc(alloc);
+    IntAlloc fromLong(longAlloc);
+    Tree odd(std::less<int>(), fromLong);
+    for (int k = 1; k < 8000; k += 2)
+        odd.insert(k);
+    joined.unionWith(std::move(odd));
+    std::vector<int> expected = range(0, 4000);
+    for (int k = 4001; k < 8000; k += 2)
+        expected.push_back(k);
+    CHECK(contents(joined) == expected);
+
+    // Шарды склеиваются при перераспределении и выравнивании
+    xi::ShardedRBTree<int, std::less<int>, IntAlloc> sharded(4, std::less<int>(), alloc);
+    for (int k = 0; k < 20000; ++k)
+        CHECK(sharded.tryInsert(k));
+    sharded.repartition();
+    for (int k = 20000; k < 40000; ++k)
+        CHECK(sharded.tryInsert(k));
+    CHECK(sharded.getRebalanceCount() > 0);
+
+    std::vector<int> seen;
+    sharded.forEach([&seen](int k) { seen.push_back(k); });
+    CHECK(seen == range(0, 40000));
+}
+
+
+int main()
+{
+#ifndef RBTREE_RELATIVE_LINKS
+    {
+        typedef xi::PoolAllocator<int> Alloc;
+        Alloc alloc;
+        checkEquality(alloc, Alloc());
+        checkTrees(alloc);
+
+        // Пул сбрасывается разом, только если набором пулов больше никто не владеет
+        Alloc shared;
+        Alloc copy(shared);
+        CHECK(!copy.releaseAll());
+        CHECK(Alloc().releaseAll());
+    }
+#endif
+
+    {
+        typedef xi::ArenaAllocator<int> Alloc;
+        Alloc alloc(100000);
+        checkEquality(alloc, Alloc(16));
+        checkTrees(alloc);
+
+        // Перепривязка получает арену той же емкости в объектах
+        xi::ArenaAllocator<double> rebound(alloc);
+        CHECK(rebound.getCapacity() == 100000);
+
+        // Арена, до которой 32-битные связи не дотянутся, не создается
+        bool thrown = false;
+        try
+        {
+            xi::ArenaAllocator<char[64]> huge((std::size_t) (xi::NodeArena::MAX_BYTES / 64 + 1));
+        }
+        catch (const std::length_error &)
+        {
+            thrown = true;
+        }
+        CHECK(thrown);
+
+        // Емкость исчерпана: std::bad_alloc, а освобожденное место выдается снова
+        Alloc tiny(2);
+        int *a = tiny.allocate(1), *b = tiny.allocate(1);
+        thrown = false;
+        try
+        {
+            tiny.allocate(1);
+        }
+        catch (const std::bad_alloc &)
+        {
+            thrown = true;
+        }
+        CHECK(thrown);
+        tiny.deallocate(a, 1);
+        CHECK(tiny.allocate(1) == a);
+        tiny.deallocate(b, 1);
+    }
+
+    std::printf("test_allocators: OK\n");
+    return 0;
+}
@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  test_concurrent.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Читатели ConcurrentRBTree ищут ключи, пока писатель вставляет и удаляет
+// нечетные ключи вперемешку с постоянными четными, так что повороты идут
+// прямо под читателями. Постоянные ключи должны находиться всегда, никогда не
+// вставлявшиеся — никогда, а найденный элемент — совпадать с искомым.
+//
+// Гонки данных ловит сборка с -fsanitize=thread:
+// g++ -std=c++17 -g -O1 -pthread -fsanitize=thread -DRBTREE_ATOMIC_LINKS -I.. test_concurrent.cpp -o test_concurrent_tsan
+//
+// Запуск: ./test_concurrent (код возврата 0 — успех)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "../rbconcurrent.h"
+#include "check.h"
+
+
+typedef xi::ConcurrentRBTree<int> Concurrent;
+
+static const int KEYS = 2000;               ///< Постоянные ключи 0, 2, ..., 2 * (KEYS - 1).
+static const int ROUNDS = 20;               ///< Сколько раз писатель вставляет и удаляет все нечетные.
+static const int READERS = 4;
+
+
+/** \brief Читатель: обходит ключи по кругу, пока писатель не закончит. */
+void reader(const Concurrent &tree, const std::atomic<bool> &done, int seed)
+{
+    int k = seed;
+    while (!done.load(std::memory_order_acquire))
+    {
+        k = (k * 1103515245 + 12345) & 0x7fffffff;
+        int key = k % (2 * KEYS + 100);
+
+        int found = -1;
+        bool has = tree.lookup(key, found);
+        if (has)
+            CHECK(found == key);
+
+        if (key % 2 == 0 && key < 2 * KEYS)
+            CHECK(has);
+        if (key >= 2 * KEYS)
+            CHECK(!has);
+    }
+}
+
+
+int main()
+{
+    Concurrent tree;
+    for (int i = 0; i < KEYS; ++i)
+        CHECK(tree.tryInsert(2 * i));
+
+    std::atomic<bool> done(false);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < READERS; ++r)
+        readers.push_back(std::thread(reader, std::cref(tree), std::cref(done), r + 1));
+
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+        // Вставка подряд идущих ключей и их удаление в другом порядке — повороты в обе стороны
+        for (int i = 0; i < KEYS; ++i)
+            CHECK(tree.tryInsert(2 * i + 1));
+        for (int i = KEYS - 1; i >= 0; i -= 2)
+            CHECK(tree.tryRemove(2 * i + 1));
+        for (int i = KEYS - 2; i >= 0; i -= 2)
+            CHECK(tree.tryRemove(2 * i + 1));
+        CHECK(tree.size() == (std::size_t) KEYS);
+    }
+
+    done.store(true, std::memory_order_release);
+    for (std::size_t r = 0; r < readers.size(); ++r)
+        readers[r].join();
+
+    for (int i = 0; i < KEYS; ++i)
+    {
+        CHECK(tree.contains(2 * i));
+        CHECK(!tree.contains(2 * i + 1));
+    }
+
+    std::printf("test_concurrent: OK\n");
+    return 0;
+}
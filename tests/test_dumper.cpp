@@ -0,0 +1,129 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  test_dumper.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Политики отладочных событий: по умолчанию дерево не тратит на них места,
+// а слушатель IRBTreeDumper, подключенный через RBTreeVirtualDumper, видит
+// повороты в обе стороны, перекраски при вставке и удалении и этапы обеих
+// операций. После каждой вставки и каждого удаления дерево проверяется на
+// свойства красно-черного.
+//
+// Запуск: ./test_dumper (код возврата 0 — успех)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "../rbtree.h"
+#include "check.h"
+
+
+typedef xi::RBTreeVirtualDumper<int, std::less<int> > Virtual;
+typedef xi::RBTree<int, std::less<int>, std::allocator<int>, Virtual> Tree;
+typedef xi::IRBTreeDumper<int, std::less<int> > Dumper;
+
+// Слушатель по-прежнему объявляется с двумя параметрами и знает, какому дереву он подходит
+static_assert(std::is_same<Dumper::TTree, Tree>::value, "IRBTreeDumper<E, C>::TTree must be the tree with Virtual");
+
+
+/** \brief Проверяет поддерево: порядок, связи с отцом, нет двух красных подряд.
+ *  \returns черную высоту.
+ */
+int validate(const Tree::Node *nd, const Tree::Node *parent)
+{
+    if (!nd)
+        return 1;
+
+    CHECK(nd->getParent() == parent);
+    if (nd->isRed())
+        CHECK(!parent || parent->isBlack());
+    if (nd->getLeft())
+        CHECK(nd->getLeft()->getKey() < nd->getKey());
+    if (nd->getRight())
+        CHECK(nd->getKey() < nd->getRight()->getKey());
+
+    int bhL = validate(nd->getLeft(), nd);
+    int bhR = validate(nd->getRight(), nd);
+    CHECK(bhL == bhR);
+    return bhL + (nd->isBlack() ? 1 : 0);
+}
+
+
+/** \brief Считает события по типам и проверяет дерево после каждой законченной операции. */
+struct CheckingDumper : Dumper
+{
+    std::vector<std::size_t> counts;
+
+    CheckingDumper()
+            : counts(DE_AFTER_DEL_RECOLOR4 + 1)
+    {}
+
+    void rbTreeEvent(RBTreeDumperEvent ev, TTree *tr, TTreeNode *nd)
+    {
+        ++counts[ev];
+        CHECK(nd != nullptr);
+
+        if (ev == DE_AFTER_INSERT || ev == DE_AFTER_REMOVE)
+        {
+            const Tree::Node *root = tr->getRoot();
+            CHECK(!root || root->isBlack());
+            validate(root, nullptr);
+        }
+    }
+};
+
+
+int main()
+{
+    // Политика по умолчанию пуста и в дереве места не занимает
+    CHECK(sizeof(xi::RBTree<int>) < sizeof(Tree));
+
+    const int N = 2000;
+    CheckingDumper dumper;
+    Tree tree;
+    tree.setDumper(&dumper);
+
+    for (int i = 0; i < N; ++i)
+        tree.insert(i * 7919 % N);
+    CHECK(dumper.counts[Dumper::DE_AFTER_BST_INS] == (std::size_t) N);
+    CHECK(dumper.counts[Dumper::DE_AFTER_INSERT] == (std::size_t) N);
+    CHECK(dumper.counts[Dumper::DE_AFTER_RECOLOR1] > 0);
+    CHECK(dumper.counts[Dumper::DE_AFTER_RECOLOR3D] > 0);
+    CHECK(dumper.counts[Dumper::DE_AFTER_RECOLOR3D] == dumper.counts[Dumper::DE_AFTER_RECOLOR3G]);
+
+    for (int i = 0; i < N; ++i)
+        tree.remove(i * 104729 % N);
+    CHECK(tree.isEmpty());
+    CHECK(dumper.counts[Dumper::DE_AFTER_BST_REMOVE] == (std::size_t) N);
+    CHECK(dumper.counts[Dumper::DE_AFTER_REMOVE] == (std::size_t) N);
+    CHECK(dumper.counts[Dumper::DE_AFTER_DEL_RECOLOR2] > 0);
+    CHECK(dumper.counts[Dumper::DE_AFTER_DEL_RECOLOR4] > 0);
+
+    // Повороты в обе стороны различаются
+    CHECK(dumper.counts[Dumper::DE_AFTER_LROT] > 0);
+    CHECK(dumper.counts[Dumper::DE_AFTER_RROT] > 0);
+
+    // Рабочие деревья split() и join() слушателя не наследуют, а само дерево его сохраняет
+    for (int i = 0; i < N; ++i)
+        tree.insert(i);
+    std::size_t inserts = dumper.counts[Dumper::DE_AFTER_INSERT];
+    Tree upper = tree.split(N / 2);
+    tree = Tree::join(std::move(tree), std::move(upper));
+    CHECK(tree.size() == (std::size_t) N - 1);
+    tree.insert(N / 2);
+    CHECK(dumper.counts[Dumper::DE_AFTER_INSERT] == inserts + 1);
+
+    // Без слушателя дерево с той же политикой работает молча
+    tree.resetDumper();
+    tree.remove(0);
+    CHECK(dumper.counts[Dumper::DE_AFTER_REMOVE] == (std::size_t) N);
+
+    std::printf("test_dumper: OK\n");
+    return 0;
+}
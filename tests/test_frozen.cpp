@@ -0,0 +1,219 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  test_frozen.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Векторный поиск в блоке FrozenRBTree против std::lower_bound для всех его
+// вариантов: знаковые и беззнаковые целые по 4 и 8 байт (беззнаковые — со
+// значениями по обе стороны сдвига на половину диапазона), float и double.
+// Затем целые деревья размеров, не кратных блоку, сверяются с отсортированным
+// массивом по find(), lower_bound() и upper_bound(), в том числе для ключей
+// меньше минимума и больше максимума.
+//
+// Какая ветвь поиска проверяется, решают флаги компиляции, поэтому тест
+// собирается трижды: с флагами по умолчанию (SSE2), с -msse4.2 и с -mavx2.
+//
+// Запуск: ./test_frozen (код возврата 0 — успех)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "../rbfrozen.h"
+#include "check.h"
+
+
+#if defined(__AVX2__)
+static const char *const BRANCH = "AVX2";
+#define CPU_FEATURE "avx2"
+#elif defined(__SSE4_2__)
+static const char *const BRANCH = "SSE4.2";
+#define CPU_FEATURE "sse4.2"
+#elif defined(__SSE2__)
+static const char *const BRANCH = "SSE2";
+#else
+static const char *const BRANCH = "generic";
+#endif
+
+
+/** \brief Случайное целое: весь диапазон, окрестности нуля, краев и середины беззнакового диапазона. */
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value, T>::type randomValue(std::mt19937_64 &rng)
+{
+    typedef typename std::make_unsigned<T>::type U;
+    const U half = (U) (U(1) << (sizeof(T) * 8 - 1));
+    U near = (U) (rng() % 16) - 8;
+
+    switch (rng() % 5)
+    {
+        case 0:
+            return (T) rng();
+        case 1:
+            return (T) near;
+        case 2:
+            return (T) (half + near);
+        case 3:
+            return (T) (std::numeric_limits<T>::min() + (T) (rng() % 8));
+        default:
+            return (T) (std::numeric_limits<T>::max() - (T) (rng() % 8));
+    }
+}
+
+
+/** \brief Случайное число с плавающей точкой: обычные, малые целые, края и денормализованные. */
+template<typename T>
+typename std::enable_if<std::is_floating_point<T>::value, T>::type randomValue(std::mt19937_64 &rng)
+{
+    T sign = (rng() % 2) ? T(1) : T(-1);
+    switch (rng() % 5)
+    {
+        case 0:
+            return std::uniform_real_distribution<T>(-1e6, 1e6)(rng);
+        case 1:
+            return (T) ((int) (rng() % 16) - 8);
+        case 2:
+            return sign * std::numeric_limits<T>::max();
+        case 3:
+            return sign * std::numeric_limits<T>::denorm_min();
+        default:
+            return sign * std::numeric_limits<T>::infinity();
+    }
+}
+
+
+/** \brief Соседи ключа сверху и снизу, чтобы проверять строгость сравнения. */
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value, T>::type stepUp(T x)
+{ return x == std::numeric_limits<T>::max() ? x : (T) (x + 1); }
+
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value, T>::type stepDown(T x)
+{ return x == std::numeric_limits<T>::min() ? x : (T) (x - 1); }
+
+template<typename T>
+typename std::enable_if<std::is_floating_point<T>::value, T>::type stepUp(T x)
+{ return std::nextafter(x, std::numeric_limits<T>::infinity()); }
+
+template<typename T>
+typename std::enable_if<std::is_floating_point<T>::value, T>::type stepDown(T x)
+{ return std::nextafter(x, -std::numeric_limits<T>::infinity()); }
+
+
+/** \brief Ключи для проверки: сами элементы, их соседи, края типа и случайные. */
+template<typename T>
+std::vector<T> probeKeys(const std::vector<T> &elems, std::mt19937_64 &rng)
+{
+    std::vector<T> keys;
+    for (std::size_t i = 0; i < elems.size(); ++i)
+    {
+        keys.push_back(elems[i]);
+        keys.push_back(stepUp(elems[i]));
+        keys.push_back(stepDown(elems[i]));
+    }
+    keys.push_back(std::numeric_limits<T>::lowest());
+    keys.push_back(std::numeric_limits<T>::max());
+    for (int i = 0; i < 16; ++i)
+        keys.push_back(randomValue<T>(rng));
+    return keys;
+}
+
+
+/** \brief Сверяет FrozenBlockSearch с std::lower_bound на случайных отсортированных блоках. */
+template<typename T>
+void checkBlockSearch(std::mt19937_64 &rng)
+{
+    typedef xi::FrozenBlockSearch<T, std::less<T>, 16> Search;
+
+    for (int round = 0; round < 2000; ++round)
+    {
+        // Блок выровнен, как в дереве, и может содержать повторы (добивка последнего блока)
+        alignas(64) T block[16];
+        for (int i = 0; i < 16; ++i)
+            block[i] = randomValue<T>(rng);
+        std::sort(block, block + 16);
+
+        std::vector<T> keys = probeKeys(std::vector<T>(block, block + 16), rng);
+        for (std::size_t i = 0; i < keys.size(); ++i)
+            CHECK(Search::rank(block, keys[i], std::less<T>()) ==
+                  (std::size_t) (std::lower_bound(block, block + 16, keys[i]) - block));
+    }
+}
+
+
+/** \brief Сверяет дерево из \c n элементов с отсортированным массивом. */
+template<typename T>
+void checkTree(std::size_t n, std::mt19937_64 &rng)
+{
+    std::vector<T> elems;
+    while (elems.size() < n)
+    {
+        for (std::size_t i = elems.size(); i < n; ++i)
+            elems.push_back(randomValue<T>(rng));
+        std::sort(elems.begin(), elems.end());
+        elems.erase(std::unique(elems.begin(), elems.end()), elems.end());
+    }
+
+    xi::FrozenRBTree<T> frozen(elems.begin(), n);
+    CHECK(frozen.size() == n);
+    CHECK(std::vector<T>(frozen.begin(), frozen.end()) == elems);
+
+    // Ключи ниже минимума и выше максимума тоже среди проверяемых
+    std::vector<T> keys = probeKeys(elems, rng);
+    for (std::size_t i = 0; i < keys.size(); ++i)
+    {
+        const T &key = keys[i];
+        std::size_t lo = (std::size_t) (std::lower_bound(elems.begin(), elems.end(), key) - elems.begin());
+        std::size_t hi = (std::size_t) (std::upper_bound(elems.begin(), elems.end(), key) - elems.begin());
+        CHECK((std::size_t) (frozen.lower_bound(key) - frozen.begin()) == lo);
+        CHECK((std::size_t) (frozen.upper_bound(key) - frozen.begin()) == hi);
+
+        const T *found = frozen.find(key);
+        CHECK((found != nullptr) == (lo != hi));
+        CHECK(!found || *found == elems[lo]);
+    }
+}
+
+
+template<typename T>
+void checkType(std::mt19937_64 &rng)
+{
+    checkBlockSearch<T>(rng);
+
+    // Размеры не кратны блоку, кроме контрольных, и дают от одного до трех уровней разделителей
+    const std::size_t sizes[] = {0, 1, 2, 15, 16, 17, 31, 255, 256, 257, 1000, 4097, 5000};
+    for (std::size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+        checkTree<T>(sizes[i], rng);
+}
+
+
+int main()
+{
+#if defined(__GNUC__) && defined(CPU_FEATURE)
+    // Сборку с расширенным набором инструкций на процессоре без него проверить нечем
+    if (!__builtin_cpu_supports(CPU_FEATURE))
+    {
+        std::printf("test_frozen (%s): skipped, not supported by the CPU\n", BRANCH);
+        return 0;
+    }
+#endif
+
+    std::mt19937_64 rng(3);
+    checkType<std::int32_t>(rng);
+    checkType<std::uint32_t>(rng);
+    checkType<std::int64_t>(rng);
+    checkType<std::uint64_t>(rng);
+    checkType<float>(rng);
+    checkType<double>(rng);
+
+    std::printf("test_frozen (%s): OK\n", BRANCH);
+    return 0;
+}
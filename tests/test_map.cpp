@@ -0,0 +1,162 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  test_map.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// RBMap против std::map на случайной смеси operator[], insertOrAssign,
+// tryEmplace, at и remove со строковыми ключами и значениями. Отдельно:
+// insertOrAssign на дубликате присваивает, а tryEmplace на дубликате не
+// трогает ни ключ, ни аргументы значения, даже переданные как rvalue.
+//
+// Запуск: ./test_map (код возврата 0 — успех)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "../rbmap.h"
+#include "check.h"
+
+
+typedef xi::RBMap<std::string, std::string> Map;
+typedef std::map<std::string, std::string> StdMap;
+
+
+/** \brief Сверяет словарь с эталоном: размер, пары в порядке обхода, поиск и границы. */
+void verify(const Map &map, const StdMap &expected)
+{
+    CHECK(map.size() == expected.size());
+
+    StdMap::const_iterator e = expected.begin();
+    for (Map::const_iterator it = map.begin(); it != map.end(); ++it, ++e)
+    {
+        CHECK(e != expected.end());
+        CHECK(it->first == e->first && it->second == e->second);
+        CHECK(map.contains(e->first));
+        CHECK(map.at(e->first) == e->second);
+    }
+    CHECK(e == expected.end());
+}
+
+
+std::string keyOf(int k)
+{
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "k%04d", k);
+    return buf;
+}
+
+
+int main()
+{
+    Map map;
+    StdMap expected;
+    std::mt19937 rng(7);
+
+    for (int step = 0; step < 20000; ++step)
+    {
+        std::string key = keyOf((int) (rng() % 500));
+        std::string value = "v" + std::to_string(step);
+
+        switch (rng() % 5)
+        {
+            case 0:
+                map[key] += value;
+                expected[key] += value;
+                break;
+
+            case 1:
+            {
+                std::pair<Map::iterator, bool> r = map.insertOrAssign(key, value);
+                std::pair<StdMap::iterator, bool> s = expected.insert_or_assign(key, value);
+                CHECK(r.second == s.second);
+                CHECK(r.first->first == key && r.first->second == value);
+                break;
+            }
+
+            case 2:
+            {
+                std::pair<Map::iterator, bool> r = map.tryEmplace(key, value);
+                std::pair<StdMap::iterator, bool> s = expected.try_emplace(key, value);
+                CHECK(r.second == s.second);
+                CHECK(r.first->first == key && r.first->second == s.first->second);
+                break;
+            }
+
+            case 3:
+                if (expected.erase(key))
+                    map.remove(key);
+                else
+                {
+                    bool thrown = false;
+                    try
+                    {
+                        map.remove(key);
+                    }
+                    catch (const std::invalid_argument &)
+                    {
+                        thrown = true;
+                    }
+                    CHECK(thrown);
+                }
+                break;
+
+            default:
+            {
+                StdMap::const_iterator s = expected.lower_bound(key);
+                Map::iterator r = map.lower_bound(key);
+                CHECK((s == expected.end()) == (r == map.end()));
+                if (s != expected.end())
+                    CHECK(r->first == s->first);
+                break;
+            }
+        }
+
+        if (step % 1000 == 0)
+            verify(map, expected);
+    }
+    verify(map, expected);
+
+    // Значение меняется через итератор и operator[], ключ остается на месте
+    map.clear();
+    expected.clear();
+    map["a"] = "1";
+    map.find("a")->second = "2";
+    CHECK(map.at("a") == "2");
+
+    // insertOrAssign на дубликате присваивает и не вставляет
+    std::pair<Map::iterator, bool> r = map.insertOrAssign("a", std::string("3"));
+    CHECK(!r.second && r.first->second == "3" && map.size() == 1);
+
+    // tryEmplace на дубликате не трогает ни ключ, ни значение, переданные как rvalue
+    std::string key = "a", value = "long enough to be heap allocated, not SSO";
+    r = map.tryEmplace(std::move(key), std::move(value));
+    CHECK(!r.second && r.first->second == "3");
+    CHECK(key == "a");
+    CHECK(value == "long enough to be heap allocated, not SSO");
+
+    // А на свободном месте забирает их
+    key = "b";
+    r = map.tryEmplace(std::move(key), std::move(value));
+    CHECK(r.second && r.first->first == "b" && r.first->second == "long enough to be heap allocated, not SSO");
+    CHECK(map.size() == 2);
+
+    bool thrown = false;
+    try
+    {
+        map.at("c");
+    }
+    catch (const std::out_of_range &)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    std::printf("test_map: OK\n");
+    return 0;
+}
@@ -0,0 +1,190 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  test_mapped.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Сохранность MappedRBTree при падении процесса. Дочерний процесс делает
+// точку сохранности, затем вставляет и удаляет ключи (узлы прошлой точки
+// перекрашиваются и поворачиваются на месте) и завершается через _exit(),
+// не закрывая дерево. Открытое заново дерево должно совпасть с состоянием
+// точки сохранности. Затем на диске воссоздается sync(), прерванный после
+// фиксации журнала повторения, — журнал должен доиграться при открытии, — и
+// прерванный до нее — тогда файл остается прежним.
+//
+// Запуск: ./test_mapped [каталог для файлов] (код возврата 0 — успех)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>        // std::equal
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>          // std::memcpy, std::memset
+#include <set>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>       // waitpid
+#include <unistd.h>         // fork, _exit
+
+#include "../rbmapped.h"
+#include "check.h"
+
+
+typedef xi::MappedRBTree<int> Mapped;
+
+static const std::size_t CAPACITY = std::size_t(16) << 20;
+
+
+/** \brief Читает файл \c path целиком. */
+std::vector<char> readFile(const std::string &path)
+{
+    std::FILE *f = std::fopen(path.c_str(), "rb");
+    CHECK(f);
+    std::vector<char> data;
+    char buf[65536];
+    for (std::size_t n; (n = std::fread(buf, 1, sizeof(buf), f)) > 0;)
+        data.insert(data.end(), buf, buf + n);
+    std::fclose(f);
+    return data;
+}
+
+
+/** \brief Заменяет содержимое файла \c path на \c data. */
+void writeFile(const std::string &path, const std::vector<char> &data)
+{
+    std::FILE *f = std::fopen(path.c_str(), "wb");
+    CHECK(f);
+    CHECK(std::fwrite(data.data(), 1, data.size(), f) == data.size());
+    CHECK(std::fclose(f) == 0);
+}
+
+
+/** \brief Пишет журнал повторения, переводящий файл \c before в \c after, — таким, каким его
+ *  оставляет \c sync() перед переносом страниц (\c committed) или до записи заголовка.
+ */
+void writeLog(const std::string &path, const std::vector<char> &before, const std::vector<char> &after,
+              bool committed)
+{
+    typedef xi::MappedNodeFile::LogHeader LogHeader;
+    std::size_t page = (std::size_t) ::sysconf(_SC_PAGESIZE);
+    CHECK(before.size() == after.size() && after.size() % page == 0);
+
+    std::vector<char> data(sizeof(LogHeader));
+    std::uint64_t pages = 0;
+    for (std::uint64_t off = 0; off < after.size(); off += page)
+        if (!std::equal(after.begin() + off, after.begin() + off + page, before.begin() + off))
+        {
+            const char *o = reinterpret_cast<const char *>(&off);
+            data.insert(data.end(), o, o + sizeof(off));
+            data.insert(data.end(), after.begin() + off, after.begin() + off + page);
+            ++pages;
+        }
+    CHECK(pages > 0);
+
+    LogHeader lh;
+    std::memset(&lh, 0, sizeof(lh));
+    if (committed)
+    {
+        std::memcpy(lh.magic, "XIRBREDO", sizeof(lh.magic));
+        lh.pageSize = page;
+        lh.pages = pages;
+    }
+    std::memcpy(data.data(), &lh, sizeof(lh));
+    writeFile(path, data);
+}
+
+
+/** \brief Запускает \c body в дочернем процессе, который завершается без деструкторов, как при падении. */
+template<typename F>
+void crashAfter(F body)
+{
+    pid_t pid = ::fork();
+    CHECK(pid >= 0);
+    if (pid == 0)
+    {
+        body();
+        ::_exit(0);
+    }
+
+    int status = 0;
+    CHECK(::waitpid(pid, &status, 0) == pid);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+
+int main(int argc, char **argv)
+{
+    std::string path = std::string(argc > 1 ? argv[1] : ".") + "/test_mapped.tree";
+    std::string log = path + xi::MappedNodeFile::logSuffix();
+    std::remove(path.c_str());
+    std::remove(log.c_str());
+
+    std::set<int> expected;
+    for (int k = 0; k < 3000; ++k)
+        expected.insert(k * 7 % 3000);
+
+    // Изменения после точки сохранности теряются, а сама она цела
+    crashAfter([&]() {
+        // Дерево не закрывается: деструктор сделал бы точку сохранности
+        Mapped &tree = *new Mapped(path.c_str(), CAPACITY);
+        for (std::set<int>::const_iterator it = expected.begin(); it != expected.end(); ++it)
+            tree.insert(*it);
+        tree.sync();
+
+        for (int k = 0; k < 1500; ++k)
+            tree.remove(k * 2);
+        for (int k = 3000; k < 5000; ++k)
+            tree.insert(k);
+    });
+    {
+        Mapped tree(path.c_str(), CAPACITY);
+        xitest::checkSameAsSet(tree, expected);
+
+        // Следующая точка сохранности после падения
+        for (int k = 0; k < 1000; ++k)
+        {
+            tree.remove(k * 3);
+            expected.erase(k * 3);
+        }
+        tree.sync();
+    }
+    {
+        Mapped tree(path.c_str(), CAPACITY);
+        xitest::checkSameAsSet(tree, expected);
+    }
+
+    // Прерванный после фиксации журнала sync(): на диске прежний файл дерева и журнал с новыми страницами
+    std::vector<char> before = readFile(path);
+    {
+        Mapped tree(path.c_str(), CAPACITY);
+        for (int k = 10000; k < 12000; ++k)
+        {
+            tree.insert(k);
+            expected.insert(k);
+        }
+        tree.remove(1);
+        expected.erase(1);
+    }
+    std::vector<char> after = readFile(path);
+
+    writeFile(path, before);
+    writeLog(log, before, after, true);
+    {
+        Mapped tree(path.c_str(), CAPACITY);
+        xitest::checkSameAsSet(tree, expected);
+    }
+    CHECK(readFile(path) == after);
+
+    // Незафиксированный журнал (упал до записи заголовка) не трогает файл
+    writeFile(path, before);
+    writeLog(log, before, after, false);
+    {
+        Mapped tree(path.c_str(), CAPACITY);
+        CHECK(tree.find(10000) == nullptr && tree.find(1) != nullptr);
+    }
+
+    std::remove(path.c_str());
+    std::remove(log.c_str());
+    std::printf("test_mapped: OK\n");
+    return 0;
+}
@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  test_orderstat.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Порядковые статистики (RBTREE_WITH_ORDER_STATISTICS) против std::set:
+// select(k) и rank(key) для всех позиций и ключей, размеры поддеревьев в
+// узлах и size() сверяются после случайных вставок и удалений, после split(),
+// splitFrom() и после обоих вариантов join().
+//
+// Запуск: ./test_orderstat (код возврата 0 — успех)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <cstdio>
+#include <iterator>
+#include <random>
+#include <set>
+#include <utility>
+
+#include "../rbtree.h"
+#include "check.h"
+
+#ifndef RBTREE_WITH_ORDER_STATISTICS
+#error "test_orderstat must be built with RBTREE_WITH_ORDER_STATISTICS"
+#endif
+
+
+typedef xi::RBTree<int> Tree;
+
+static const int KEYS = 600;                ///< Ключи берутся из [0, KEYS).
+
+
+/** \brief Проверяет, что каждый узел хранит размер своего поддерева. \returns размер поддерева. */
+std::size_t checkSizes(const Tree::Node *nd)
+{
+    if (!nd)
+        return 0;
+
+    std::size_t size = 1 + checkSizes(nd->getLeft()) + checkSizes(nd->getRight());
+    CHECK(nd->getSize() == size);
+    return size;
+}
+
+
+/** \brief Сверяет дерево с эталоном: элементы, размеры поддеревьев, select() и rank(). */
+void verify(const Tree &tree, const std::set<int> &expected)
+{
+    xitest::checkSameAsSet(tree, expected);
+    CHECK(checkSizes(tree.getRoot()) == expected.size());
+
+    std::size_t k = 0;
+    for (std::set<int>::const_iterator it = expected.begin(); it != expected.end(); ++it, ++k)
+    {
+        Tree::const_iterator sel = tree.select(k);
+        CHECK(sel != tree.end() && *sel == *it);
+    }
+    CHECK(tree.select(expected.size()) == tree.end());
+
+    // Ранги проверяются и для отсутствующих ключей, и за границами диапазона
+    for (int key = -1; key <= KEYS; ++key)
+        CHECK(tree.rank(key) == (std::size_t) std::distance(expected.begin(), expected.lower_bound(key)));
+}
+
+
+int main()
+{
+    Tree tree;
+    std::set<int> expected;
+    std::mt19937 rng(5);
+
+    for (int step = 0; step < 4000; ++step)
+    {
+        int key = (int) (rng() % KEYS);
+        if (rng() % 3)
+        {
+            if (expected.insert(key).second)
+                tree.insert(key);
+        }
+        else if (expected.erase(key))
+            tree.remove(key);
+
+        if (step % 50 == 0)
+            verify(tree, expected);
+    }
+    verify(tree, expected);
+
+    for (int round = 0; round < 20; ++round)
+    {
+        int key = (int) (rng() % (KEYS + 2)) - 1;
+
+        // split: ключ удаляется, большие уходят во второе дерево
+        bool found = false;
+        Tree upper = tree.split(key, &found);
+        CHECK(found == (expected.count(key) != 0));
+        std::set<int> lowerExp(expected.begin(), expected.lower_bound(key));
+        std::set<int> upperExp(expected.upper_bound(key), expected.end());
+        verify(tree, lowerExp);
+        verify(upper, upperExp);
+
+        // join с разделителем возвращает ключ на место
+        tree = Tree::join(std::move(tree), key, std::move(upper));
+        expected.insert(key);
+        verify(tree, expected);
+
+        // splitFrom оставляет ключ в верхней части, join без разделителя склеивает обратно
+        key = (int) (rng() % KEYS);
+        upper = tree.splitFrom(key);
+        verify(tree, std::set<int>(expected.begin(), expected.lower_bound(key)));
+        verify(upper, std::set<int>(expected.lower_bound(key), expected.end()));
+        tree = Tree::join(std::move(tree), std::move(upper));
+        verify(tree, expected);
+
+        // Между разрезами дерево продолжает меняться
+        for (int i = 0; i < 30; ++i)
+        {
+            int k = (int) (rng() % KEYS);
+            if (expected.erase(k))
+                tree.remove(k);
+            else
+            {
+                expected.insert(k);
+                tree.insert(k);
+            }
+        }
+        verify(tree, expected);
+    }
+
+    std::printf("test_orderstat: OK\n");
+    return 0;
+}
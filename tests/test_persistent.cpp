@@ -0,0 +1,175 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  test_persistent.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// PersistentRBTree против std::set на случайной смеси вставок и удалений.
+// Время от времени с живой версии снимается снимок вместе с копией эталона;
+// каждый снимок должен совпадать со своей копией, сколько бы живая версия ни
+// менялась после него. После каждой операции живая версия проверяется на
+// свойства красно-черного дерева. Узлы считает аллокатор: когда снимков не
+// остается, живых узлов столько же, сколько элементов, а после clear() — ни
+// одного.
+//
+// Запуск: ./test_persistent (код возврата 0 — успех)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "../rbpersistent.h"
+#include "check.h"
+
+
+static std::ptrdiff_t liveNodes = 0;        ///< Выделено и не освобождено узлами дерева.
+
+
+/** \brief std::allocator, считающий живые объекты в \c liveNodes. */
+template<typename T>
+struct CountingAllocator : std::allocator<T>
+{
+    typedef T value_type;
+
+    template<typename U>
+    struct rebind
+    { typedef CountingAllocator<U> other; };
+
+    CountingAllocator()
+    {}
+
+    template<typename U>
+    CountingAllocator(const CountingAllocator<U> &)
+    {}
+
+    T *allocate(std::size_t n)
+    {
+        liveNodes += (std::ptrdiff_t) n;
+        return std::allocator<T>::allocate(n);
+    }
+
+    void deallocate(T *p, std::size_t n)
+    {
+        liveNodes -= (std::ptrdiff_t) n;
+        std::allocator<T>::deallocate(p, n);
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const CountingAllocator<T> &, const CountingAllocator<U> &)
+{ return true; }
+
+template<typename T, typename U>
+bool operator!=(const CountingAllocator<T> &, const CountingAllocator<U> &)
+{ return false; }
+
+
+typedef xi::PersistentRBTree<int, std::less<int>, CountingAllocator<int> > Tree;
+
+
+/** \brief Проверяет поддерево: порядок в границах (lo, hi), нет двух красных подряд.
+ *  \returns черную высоту.
+ */
+int validate(const Tree::Node *nd, const int *lo, const int *hi, bool parentRed)
+{
+    if (!nd)
+        return 1;
+
+    CHECK(!lo || *lo < nd->getKey());
+    CHECK(!hi || nd->getKey() < *hi);
+    CHECK(!(parentRed && nd->isRed()));
+
+    int bhL = validate(nd->getLeft(), lo, &nd->getKey(), nd->isRed());
+    int bhR = validate(nd->getRight(), &nd->getKey(), hi, nd->isRed());
+    CHECK(bhL == bhR);
+    return bhL + (nd->isBlack() ? 1 : 0);
+}
+
+
+/** \brief Сверяет версию с эталоном и проверяет ее свойства красно-черного дерева. */
+void verify(const Tree &tree, const std::set<int> &expected)
+{
+    const Tree::Node *root = tree.getRoot();
+    CHECK(!root || root->isBlack());
+    validate(root, nullptr, nullptr, false);
+
+    std::vector<int> ordered;
+    tree.forEach([&ordered](int k) { ordered.push_back(k); });
+    xitest::checkSameAsSet(tree.size(), ordered, expected, [&tree](int k) { return tree.contains(k); });
+}
+
+
+int main()
+{
+    const int KEYS = 1000;
+    const std::size_t MAX_SNAPSHOTS = 8;
+
+    {
+        Tree tree;
+        std::set<int> expected;
+        std::vector<std::pair<Tree, std::set<int> > > snapshots;
+        std::mt19937 rng(11);
+
+        for (int step = 0; step < 20000; ++step)
+        {
+            int key = (int) (rng() % KEYS);
+            if (rng() % 3)
+                CHECK(tree.tryInsert(key) == expected.insert(key).second);
+            else
+                CHECK(tree.tryRemove(key) == (expected.erase(key) != 0));
+            verify(tree, expected);
+
+            // Снимки появляются и пропадают вперемешку с изменениями живой версии
+            if (step % 97 == 0)
+            {
+                if (snapshots.size() == MAX_SNAPSHOTS)
+                    snapshots.erase(snapshots.begin() + rng() % MAX_SNAPSHOTS);
+                snapshots.push_back(std::make_pair(tree.snapshot(), expected));
+            }
+
+            if (step % 1000 == 999)
+                for (std::size_t i = 0; i < snapshots.size(); ++i)
+                    verify(snapshots[i].first, snapshots[i].second);
+        }
+
+        // Каждый снимок делит с живой версией общие узлы, так что узлов больше, чем элементов
+        CHECK(!snapshots.empty());
+        CHECK(liveNodes > (std::ptrdiff_t) tree.size());
+        for (std::size_t i = 0; i < snapshots.size(); ++i)
+            verify(snapshots[i].first, snapshots[i].second);
+
+        // Без снимков живут только узлы самой версии
+        snapshots.clear();
+        CHECK(liveNodes == (std::ptrdiff_t) tree.size());
+
+        // Снимок, переживший свою версию, держит только свои узлы
+        Tree snap = tree.snapshot();
+        std::set<int> snapExpected = expected;
+        for (int k = 0; k < KEYS; k += 2)
+        {
+            tree.tryRemove(k);
+            expected.erase(k);
+        }
+        tree.clear();
+        expected.clear();
+        verify(tree, expected);
+        verify(snap, snapExpected);
+        CHECK(liveNodes == (std::ptrdiff_t) snap.size());
+
+        // Версия без снимков меняется на месте и лишних узлов не заводит
+        for (int k = 0; k < KEYS; ++k)
+            tree.tryInsert(k);
+        CHECK(liveNodes == (std::ptrdiff_t) (snap.size() + KEYS));
+    }
+
+    CHECK(liveNodes == 0);
+
+    std::printf("test_persistent: OK\n");
+    return 0;
+}
@@ -0,0 +1,87 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  test_sharded.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Выравнивание соседних шардов ShardedRBTree в одном потоке: сначала
+// перегружается левый шард пары, затем правый, и после каждого переноса
+// содержимое сверяется с эталонным std::set — ни один ключ не должен
+// потеряться, задвоиться или встать не на свое место.
+//
+// Запуск: ./test_sharded (код возврата 0 — успех)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <vector>
+
+#include "../rbsharded.h"
+#include "check.h"
+
+
+typedef xi::ShardedRBTree<int> Sharded;
+
+
+/** \brief Сверяет множество с эталоном: размер, порядок обхода, размеры шардов и поиск. */
+void verify(const Sharded &sharded, const std::set<int> &expected)
+{
+    CHECK(sharded.getShardSize(0) + sharded.getShardSize(1) == expected.size());
+
+    std::vector<int> seen;
+    sharded.forEach([&seen](int k) { seen.push_back(k); });
+    xitest::checkSameAsSet(sharded.size(), seen, expected, [&sharded](int k) { return sharded.contains(k); });
+    CHECK(!sharded.contains(-1));
+}
+
+
+/** \brief Досыпает в \c sharded ключи \c from, \c from + 1, ..., пока не случится выравнивание. */
+void fillUntilRebalance(Sharded &sharded, std::set<int> &expected, int from)
+{
+    std::size_t before = sharded.getRebalanceCount();
+    for (int k = from; sharded.getRebalanceCount() == before; ++k)
+    {
+        CHECK(k - from < 1000000);
+        CHECK(sharded.tryInsert(k));
+        expected.insert(k);
+    }
+}
+
+
+int main()
+{
+    // Два шарда с границей 1000000: левый — ключи меньше нее, правый — остальные
+    Sharded sharded(2);
+    std::vector<int> sample;
+    sample.push_back(0);
+    sample.push_back(1000000);
+    sharded.repartition(sample.begin(), sample.end());
+
+    std::set<int> expected;
+    verify(sharded, expected);
+
+    // Больше левый: перенос направо
+    fillUntilRebalance(sharded, expected, 0);
+    CHECK(sharded.getShardSize(1) > 0);
+    verify(sharded, expected);
+
+    // Больше правый: перенос налево
+    std::size_t leftBefore = sharded.getShardSize(0);
+    fillUntilRebalance(sharded, expected, 2000000);
+    CHECK(sharded.getShardSize(0) > leftBefore);
+    verify(sharded, expected);
+
+    // Удаления после переносов видят ключи там, где их оставило выравнивание
+    for (std::set<int>::iterator it = expected.begin(); it != expected.end();)
+    {
+        CHECK(sharded.tryRemove(*it));
+        it = expected.erase(it);
+        if (it != expected.end())
+            ++it;
+    }
+    verify(sharded, expected);
+
+    std::printf("test_sharded: OK\n");
+    return 0;
+}
@@ -0,0 +1,300 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  test_snapshot.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Снимки RBTree::save()/load(). С формой дерево восстанавливается узел в
+// узел, с теми же цветами; без формы — с теми же элементами и свойствами
+// красно-черного дерева. Так же проверяются записи с заданным сериализатором
+// для нетривиально копируемого элемента (они читаются потоком, а не через
+// mmap). Испорченные файлы — обрезанные на любом байте, с перевернутым цветом
+// любого узла и с переставленными элементами — должны отвергаться с
+// std::runtime_error.
+//
+// Запуск: ./test_snapshot [каталог для файлов] (код возврата 0 — успех)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../rbtree.h"
+#include "check.h"
+
+
+/** \brief Нетривиально копируемый элемент: упорядочен по \c id. */
+struct Record
+{
+    int id;
+    std::string name;
+
+    bool operator<(const Record &other) const
+    { return id < other.id; }
+
+    bool operator==(const Record &other) const
+    { return id == other.id && name == other.name; }
+};
+
+
+/** \brief Сериализатор записей: id, длина имени и байты имени. */
+struct RecordSerializer
+{
+    void write(std::ostream &os, const Record &rec) const
+    {
+        std::uint32_t len = (std::uint32_t) rec.name.size();
+        os.write(reinterpret_cast<const char *>(&rec.id), sizeof(rec.id));
+        os.write(reinterpret_cast<const char *>(&len), sizeof(len));
+        os.write(rec.name.data(), (std::streamsize) len);
+    }
+
+    Record read(std::istream &is) const
+    {
+        Record rec = {0, std::string()};
+        std::uint32_t len = 0;
+        is.read(reinterpret_cast<char *>(&rec.id), sizeof(rec.id));
+        is.read(reinterpret_cast<char *>(&len), sizeof(len));
+        if (is && len < 1024)
+        {
+            rec.name.resize(len);
+            is.read(&rec.name[0], (std::streamsize) len);
+        }
+        else
+            is.setstate(std::ios::failbit);
+        return rec;
+    }
+};
+
+
+typedef xi::RBTree<int> IntTree;
+typedef xi::RBTree<Record> RecordTree;
+
+
+/** \brief Читает файл \c path целиком. */
+std::vector<char> readFile(const std::string &path)
+{
+    std::FILE *f = std::fopen(path.c_str(), "rb");
+    CHECK(f);
+    std::vector<char> data;
+    char buf[65536];
+    for (std::size_t n; (n = std::fread(buf, 1, sizeof(buf), f)) > 0;)
+        data.insert(data.end(), buf, buf + n);
+    std::fclose(f);
+    return data;
+}
+
+
+/** \brief Заменяет содержимое файла \c path первыми \c size байтами \c data. */
+void writeFile(const std::string &path, const std::vector<char> &data, std::size_t size)
+{
+    std::FILE *f = std::fopen(path.c_str(), "wb");
+    CHECK(f);
+    CHECK(std::fwrite(data.data(), 1, size, f) == size);
+    CHECK(std::fclose(f) == 0);
+}
+
+
+/** \brief Проверяет поддерево: связи с отцом, порядок, нет двух красных подряд. \returns черную высоту. */
+template<typename Tree>
+int validate(const typename Tree::Node *nd, const typename Tree::Node *parent)
+{
+    if (!nd)
+        return 1;
+
+    CHECK(nd->getParent() == parent);
+    if (nd->isRed())
+        CHECK(!parent || parent->isBlack());
+    if (nd->getLeft())
+        CHECK(nd->getLeft()->getKey() < nd->getKey());
+    if (nd->getRight())
+        CHECK(nd->getKey() < nd->getRight()->getKey());
+
+    int bhL = validate<Tree>(nd->getLeft(), nd);
+    int bhR = validate<Tree>(nd->getRight(), nd);
+    CHECK(bhL == bhR);
+    return bhL + (nd->isBlack() ? 1 : 0);
+}
+
+
+/** \brief Деревья совпадают узел в узел: форма, цвета и элементы. */
+template<typename Tree>
+bool sameShape(const typename Tree::Node *a, const typename Tree::Node *b)
+{
+    if (!a || !b)
+        return a == b;
+
+    return a->getKey() == b->getKey() && a->isRed() == b->isRed() &&
+           sameShape<Tree>(a->getLeft(), b->getLeft()) && sameShape<Tree>(a->getRight(), b->getRight());
+}
+
+
+/** \brief Проверяет, что \c load() отвергает файл именно с \c std::runtime_error. */
+template<typename Load>
+void checkRejected(Load load)
+{
+    bool rejected = false;
+    try
+    {
+        load();
+    }
+    catch (const std::runtime_error &)
+    {
+        rejected = true;
+    }
+    CHECK(rejected);
+}
+
+
+/** \brief Перебирает все испорченные версии файла \c path: обрезанные, с перевернутым цветом
+ *  любого узла формы и с переставленными соседними элементами (смещения элементов — \c keyOffsets).
+ */
+template<typename Load>
+void checkCorruptions(const std::string &path, const std::vector<std::size_t> &keyOffsets, Load load)
+{
+    std::vector<char> good = readFile(path);
+    xi::RBTreeSnapshotHeader header;
+    std::memcpy(&header, good.data(), sizeof(header));
+
+    for (std::size_t size = 0; size < good.size(); ++size)
+    {
+        writeFile(path, good, size);
+        checkRejected(load);
+    }
+
+    // Любой перевернутый цвет ломает либо черный корень, либо равенство черных высот, либо
+    // запрет на красного под красным
+    if (header.flags & xi::RBTreeSnapshotHeader::HAS_SHAPE)
+        for (std::size_t node = 0; node < header.count; ++node)
+        {
+            std::vector<char> bad = good;
+            bad[(std::size_t) header.shapeOffset + node / 2] ^=
+                    (char) (xi::RBTreeSnapshotHeader::SHAPE_RED << (node % 2 ? 4 : 0));
+            writeFile(path, bad, bad.size());
+            checkRejected(load);
+        }
+
+    // Соседние элементы меняются местами, форма и длины записей остаются прежними
+    for (std::size_t i = 0; i + 2 < keyOffsets.size(); ++i)
+    {
+        std::vector<char> bad(good.begin(), good.begin() + (std::ptrdiff_t) keyOffsets[i]);
+        bad.insert(bad.end(), good.begin() + (std::ptrdiff_t) keyOffsets[i + 1],
+                   good.begin() + (std::ptrdiff_t) keyOffsets[i + 2]);
+        bad.insert(bad.end(), good.begin() + (std::ptrdiff_t) keyOffsets[i],
+                   good.begin() + (std::ptrdiff_t) keyOffsets[i + 1]);
+        bad.insert(bad.end(), good.begin() + (std::ptrdiff_t) keyOffsets[i + 2], good.end());
+        writeFile(path, bad, bad.size());
+        checkRejected(load);
+    }
+
+    writeFile(path, good, good.size());
+    load();
+}
+
+
+int main(int argc, char **argv)
+{
+    std::string dir = argc > 1 ? argv[1] : ".";
+    std::string intPath = dir + "/test_snapshot_int.tree";
+    std::string recPath = dir + "/test_snapshot_record.tree";
+
+    // Дерево, построенное вставками и удалениями, а не делением пополам, — его форму
+    // load() без формы не воспроизведет
+    IntTree ints;
+    for (int i = 0; i < 300; ++i)
+        ints.insert(i * 7919 % 1000);
+    for (int i = 0; i < 100; ++i)
+        ints.remove(i * 7919 % 1000);
+
+    for (int withShape = 1; withShape >= 0; --withShape)
+    {
+        ints.save(intPath.c_str(), withShape != 0);
+        IntTree loaded = IntTree::load(intPath.c_str());
+        CHECK(loaded.size() == ints.size());
+        CHECK(std::vector<int>(loaded.begin(), loaded.end()) == std::vector<int>(ints.begin(), ints.end()));
+        CHECK(!loaded.getRoot() || loaded.getRoot()->isBlack());
+        validate<IntTree>(loaded.getRoot(), nullptr);
+        CHECK(sameShape<IntTree>(loaded.getRoot(), ints.getRoot()) == (withShape != 0));
+
+        // Загруженное дерево — обычное дерево
+        loaded.insert(1000);
+        loaded.remove(*ints.begin());
+        validate<IntTree>(loaded.getRoot(), nullptr);
+    }
+
+    // Пустое дерево и дерево из одного элемента
+    for (int n = 0; n < 2; ++n)
+    {
+        IntTree small;
+        if (n)
+            small.insert(42);
+        small.save(intPath.c_str());
+        IntTree loaded = IntTree::load(intPath.c_str());
+        CHECK(loaded.size() == (std::size_t) n);
+        CHECK(sameShape<IntTree>(loaded.getRoot(), small.getRoot()));
+    }
+
+    // Нетривиально копируемые элементы читаются потоком заданным сериализатором
+    RecordTree records;
+    for (int i = 0; i < 200; ++i)
+    {
+        Record rec = {i * 37 % 200, std::string((std::size_t) (i % 13), (char) ('a' + i % 26))};
+        records.insert(rec);
+    }
+
+    for (int withShape = 1; withShape >= 0; --withShape)
+    {
+        records.save(recPath.c_str(), withShape != 0, RecordSerializer());
+        RecordTree loaded = RecordTree::load(recPath.c_str(), std::less<Record>(), std::allocator<Record>(),
+                                             RecordSerializer());
+        CHECK(loaded.size() == records.size());
+        CHECK(std::vector<Record>(loaded.begin(), loaded.end()) ==
+              std::vector<Record>(records.begin(), records.end()));
+        validate<RecordTree>(loaded.getRoot(), nullptr);
+        CHECK(sameShape<RecordTree>(loaded.getRoot(), records.getRoot()) == (withShape != 0));
+    }
+
+    // Испорченные файлы: небольшие деревья, чтобы перебрать все байты
+    IntTree smallInts;
+    for (int i = 0; i < 40; ++i)
+        smallInts.insert(i * 13 % 40);
+    RecordTree smallRecords;
+    for (int i = 0; i < 25; ++i)
+    {
+        Record rec = {i * 11 % 25, std::string((std::size_t) (i % 5 + 1), 'x')};
+        smallRecords.insert(rec);
+    }
+
+    for (int withShape = 1; withShape >= 0; --withShape)
+    {
+        smallInts.save(intPath.c_str(), withShape != 0);
+        std::vector<std::size_t> intOffsets;
+        for (std::size_t i = 0; i <= smallInts.size(); ++i)
+            intOffsets.push_back(sizeof(xi::RBTreeSnapshotHeader) + i * sizeof(int));
+        checkCorruptions(intPath, intOffsets, [&intPath]() { IntTree::load(intPath.c_str()); });
+
+        smallRecords.save(recPath.c_str(), withShape != 0, RecordSerializer());
+        std::vector<std::size_t> recOffsets(1, sizeof(xi::RBTreeSnapshotHeader));
+        for (RecordTree::const_iterator it = smallRecords.begin(); it != smallRecords.end(); ++it)
+            recOffsets.push_back(recOffsets.back() + sizeof(int) + sizeof(std::uint32_t) + it->name.size());
+        checkCorruptions(recPath, recOffsets,
+                         [&recPath]()
+                         {
+                             RecordTree::load(recPath.c_str(), std::less<Record>(), std::allocator<Record>(),
+                                              RecordSerializer());
+                         });
+    }
+
+    std::remove(intPath.c_str());
+    std::remove(recPath.c_str());
+
+    std::printf("test_snapshot: OK\n");
+    return 0;
+}
@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  test_stats.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Счетчики RBTREE_WITH_STATS: вставка, поиск и удаление считаются по одному
+// на операцию, гистограмма путей сходится с числом find(), а
+// теоретико-множественные операции, которые работают на рабочих деревьях,
+// отдают их счетчики дереву-результату — и в одном потоке, и с ветвями на
+// пуле потоков, причем в обоих случаях одинаково.
+//
+// Запуск: ./test_stats (код возврата 0 — успех)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstring>
+#include <set>
+
+#include "../rbsetops.h"
+#include "../rbtree.h"
+#include "../threadpool.h"
+#include "check.h"
+
+
+typedef xi::RBTree<int> Tree;
+
+
+/** \brief Дерево из ключей 0, step, 2·step, ... меньше \c limit. */
+void fill(Tree &tree, int step, int limit)
+{
+    for (int k = 0; k < limit; k += step)
+        tree.insert(k);
+}
+
+
+/** \brief Все ли счетчики двух снимков совпадают. */
+bool sameStats(const xi::RBTreeStats &a, const xi::RBTreeStats &b)
+{
+    return std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+
+/** \brief Пересечение деревьев с шагом 2 и 3, в пуле \c pool или без него. \returns статистику результата. */
+xi::RBTreeStats intersectStats(xi::WorkStealingPool *pool)
+{
+    Tree a, b;
+    fill(a, 2, 1000);
+    fill(b, 3, 1000);
+    a.resetStats();
+
+    a.intersectWith(std::move(b), pool, 16);
+    CHECK(a.size() == 167);
+    return a.getStats();
+}
+
+
+int main()
+{
+    const int N = 1000;
+
+    // Вставка, поиск и удаление: по одной операции на вызов
+    Tree tree;
+    fill(tree, 1, N);
+    xi::RBTreeStats st = tree.getStats();
+    CHECK(st.insert.operations == (std::uint64_t) N);
+    CHECK(st.nodesAllocated == (std::uint64_t) N);
+    CHECK(st.insert.comparisons > 0);
+    CHECK(st.insert.rotations > 0 && st.insert.recolors > 0);
+
+    for (int k = 0; k < N; ++k)
+        CHECK(tree.find(k));
+    CHECK(!tree.find(-1));
+    st = tree.getStats();
+    CHECK(st.lookup.operations == (std::uint64_t) N + 1);
+    std::uint64_t paths = 0;
+    for (std::size_t i = 0; i < xi::RBTreeStats::PATH_BUCKETS; ++i)
+        paths += st.findPathLength[i];
+    CHECK(paths == st.lookup.operations);
+
+    for (int k = 0; k < N; k += 2)
+        tree.remove(k);
+    st = tree.getStats();
+    CHECK(st.remove.operations == (std::uint64_t) N / 2);
+    CHECK(st.remove.comparisons > 0);
+
+    tree.resetStats();
+    st = tree.getStats();
+    CHECK(st.insert.operations == 0 && st.remove.operations == 0 && st.lookup.operations == 0);
+
+    // Разрезание считает сравнения и склейки
+    Tree upper = tree.split(N / 2);
+    st = tree.getStats();
+    CHECK(st.insert.comparisons > 0);
+
+    // Теоретико-множественные операции: счетчики рабочих деревьев доходят до результата
+    xi::RBTreeStats seq = intersectStats(nullptr);
+    CHECK(seq.insert.comparisons > 0);
+    CHECK(seq.insert.rotations + seq.insert.recolors > 0);
+    CHECK(seq.remove.operations > 0);
+
+    // С ветвями на пуле работа та же, и ни одна ветвь не теряется
+    xi::WorkStealingPool pool(3);
+    for (int run = 0; run < 5; ++run)
+        CHECK(sameStats(intersectStats(&pool), seq));
+
+    Tree a, b;
+    fill(a, 2, N);
+    fill(b, 5, N);
+    a.resetStats();
+    a.unionWith(std::move(b), &pool, 16);
+    st = a.getStats();
+    CHECK(a.size() == 600);
+    CHECK(st.insert.comparisons > 0 && st.insert.fixupIterations > 0);
+
+    std::printf("test_stats: OK\n");
+    return 0;
+}
@@ -0,0 +1,86 @@
+////////////////////////////////////////////////////////////////////////////////
+// Module Name:  test_threadpool.cpp
+// Authors:      Kupchenko Viktor
+// Version:      0.1.0
+// Date:         01.05.2017
+//
+// Исключения в WorkStealingPool::invoke(): из какой бы ветви они ни вылетели,
+// invoke() дожидается второй ветви и только потом передает исключение
+// дальше, а пул остается работоспособным.
+//
+// Запуск: ./test_threadpool (код возврата 0 — успех)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <thread>
+
+#include "../threadpool.h"
+#include "check.h"
+
+
+/** \brief Вызывает \c pool.invoke(f, g). \returns признак того, что вылетело \c std::runtime_error. */
+template<typename F, typename G>
+bool throws(xi::WorkStealingPool &pool, F f, G g)
+{
+    try
+    {
+        pool.invoke(f, g);
+    }
+    catch (const std::runtime_error &)
+    {
+        return true;
+    }
+    return false;
+}
+
+
+int main()
+{
+    xi::WorkStealingPool pool(2);
+
+    for (int round = 0; round < 200; ++round)
+    {
+        // f бросает, пока g, возможно, выполняется в другом потоке: к возврату g должна закончиться
+        std::atomic<int> state(0);
+        CHECK(throws(pool,
+                     [&]()
+                     {
+                         if (round % 2)
+                             std::this_thread::sleep_for(std::chrono::microseconds(200));
+                         throw std::runtime_error("f");
+                     },
+                     [&]()
+                     {
+                         state.store(1);
+                         std::this_thread::sleep_for(std::chrono::microseconds(100));
+                         state.store(2);
+                     }));
+        CHECK(state.load() != 1);
+
+        // g бросает: исключение доходит до вызывающего, f выполнена целиком
+        bool fDone = false;
+        CHECK(throws(pool,
+                     [&]() { fDone = true; },
+                     [&]() { throw std::runtime_error("g"); }));
+        CHECK(fDone);
+
+        // Вложенный invoke с исключением внутри не ломает внешний
+        int sum = 0;
+        CHECK(!throws(pool,
+                      [&]() { CHECK(throws(pool, []() { throw std::runtime_error("inner"); }, []() {})); sum += 1; },
+                      [&]() { sum += 0; }));
+        CHECK(sum == 1);
+    }
+
+    // Пул после всего этого по-прежнему выполняет обе ветви
+    int a = 0, b = 0;
+    pool.invoke([&]() { a = 1; }, [&]() { b = 2; });
+    CHECK(a == 1 && b == 2);
+
+    std::printf("test_threadpool: OK\n");
+    return 0;
+}
@@ -0,0 +1,311 @@
+﻿////////////////////////////////////////////////////////////////////////////////
+/// \file
+/// \brief     Пул потоков с перехватом задач (work stealing) для fork-join
+/// \author    Kupchenko Viktor
+/// \version   0.1.0
+/// \date      01.05.2017
+///            This is a part of the course "Algorithms and Data Structures"
+///            provided by  the School of Software Engineering of the Faculty
+///            of Computer Science at the Higher School of Economics.
+///
+/// Пул нужен рекурсивным алгоритмам "разделяй и властвуй" над деревом: ветка
+/// рекурсии кладется в очередь своего потока, а свободные потоки утаскивают
+/// ее с противоположного конца. Поток, ждущий свою ветку, не спит, а выполняет
+/// чужие задачи, поэтому вложенные fork-join не приводят к взаимоблокировке.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef XI_THREADPOOL_H
+#define XI_THREADPOOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace xi
+{
+
+
+/** \brief Пул рабочих потоков с собственными очередями и перехватом задач.
+ *
+ *  Единственная операция — \c invoke(f, g): выполнить две функции, возможно параллельно,
+ *  и дождаться обеих. Поток, вызвавший \c invoke(), сам тоже работает, так что пул из
+ *  \c k потоков вместе с вызывающим дает \c k + 1 исполнителя.
+ */
+    class WorkStealingPool
+    {
+    public:
+        /** \brief Создает пул из \c workers рабочих потоков (0 — все выполняется в вызывающем). */
+        explicit WorkStealingPool(std::size_t workers)
+                : _queues(workers + 1), _stop(false), _pending(0)
+        {
+            for (std::size_t i = 0; i < _queues.size(); ++i)
+                _queues[i].reset(new Queue);
+
+            for (std::size_t i = 0; i < workers; ++i)
+                _threads.push_back(std::thread(&WorkStealingPool::workerLoop, this, i));
+        }
+
+        ~WorkStealingPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_sleepLock);
+                _stop = true;
+            }
+            _wake.notify_all();
+
+            for (std::size_t i = 0; i < _threads.size(); ++i)
+                _threads[i].join();
+        }
+
+    public:
+        /** \brief Число рабочих потоков пула (без учета вызывающего). */
+        std::size_t getWorkerCount() const
+        { return _threads.size(); }
+
+        /** \brief Выполняет \c f и \c g, возможно параллельно, и возвращается, когда выполнены обе.
+         *
+         *  \c g выставляется в очередь текущего потока, \c f выполняется сразу. Если \c g за это время
+         *  никто не перехватил, она тоже выполняется на месте, иначе поток помогает пулу, пока
+         *  перехватчик ее не закончит.
+         *
+         *  Если \c f генерирует исключение, \c g снимается с очереди (а если ее уже перехватили —
+         *  дожидаемся ее), и только потом исключение передается дальше: задача лежит на стеке
+         *  \c invoke() и не должна пережить его. Исключение из \c g передается так же, если \c f
+         *  завершилась нормально.
+         */
+        template<typename F, typename G>
+        void invoke(F &&f, G &&g)
+        {
+            if (_threads.empty())
+            {
+                f();
+                g();
+                return;
+            }
+
+            TaskImpl<G> task(g);
+            std::size_t own = ownQueue();
+            push(own, &task);
+
+            std::exception_ptr error;
+            try
+            {
+                f();
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            // Если задачу не украли, она так и лежит последней в нашей очереди
+            if (popBackIf(own, &task))
+            {
+                if (!error)
+                    task.run();
+            }
+            else
+                while (!task.done.load(std::memory_order_acquire))
+                    if (!runOne(own))
+                        std::this_thread::yield();
+
+            if (!error)
+                error = task.error;
+            if (error)
+                std::rethrow_exception(error);
+        }
+
+    protected:
+        /** \brief Задача в очереди: ссылка на функцию, флаг завершения и исключение, если оно было. */
+        struct Task
+        {
+            std::atomic<bool> done;
+            std::exception_ptr error;               ///< Пишется до \c done, читается после него.
+
+            Task()
+                    : done(false)
+            {}
+
+            virtual void call() = 0;
+
+            /** \brief Выполняет задачу и отмечает ее выполненной; исключение сохраняется для \c invoke(). */
+            void run()
+            {
+                try
+                {
+                    call();
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+                done.store(true, std::memory_order_release);
+            }
+
+        protected:
+            ~Task()
+            {}
+        };
+
+        template<typename G>
+        struct TaskImpl : Task
+        {
+            G &fn;
+
+            explicit TaskImpl(G &g)
+                    : fn(g)
+            {}
+
+            void call()
+            { fn(); }
+        };
+
+        /** \brief Очередь задач одного потока: хозяин работает с хвостом, воры — с головой. */
+        struct Queue
+        {
+            std::mutex lock;
+            std::deque<Task *> tasks;
+        };
+
+    protected:
+        /** \brief Индекс очереди текущего потока; потоки не из пула делят последнюю очередь. */
+        std::size_t ownQueue() const
+        {
+            const ThreadSlot &slot = currentSlot();
+            return slot.pool == this ? slot.index : _queues.size() - 1;
+        }
+
+        void push(std::size_t q, Task *task)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_queues[q]->lock);
+                _queues[q]->tasks.push_back(task);
+            }
+            {
+                std::lock_guard<std::mutex> lock(_sleepLock);
+                ++_pending;
+            }
+            _wake.notify_one();
+        }
+
+        /** \brief Снимает с хвоста очереди \c q задачу \c task, если она там последняя. */
+        bool popBackIf(std::size_t q, Task *task)
+        {
+            std::lock_guard<std::mutex> lock(_queues[q]->lock);
+            std::deque<Task *> &tasks = _queues[q]->tasks;
+            if (tasks.empty() || tasks.back() != task)
+                return false;
+
+            tasks.pop_back();
+            taken();
+            return true;
+        }
+
+        /** \brief Берет задачу: сначала с хвоста своей очереди, затем с голов чужих. */
+        Task *grab(std::size_t own)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_queues[own]->lock);
+                std::deque<Task *> &tasks = _queues[own]->tasks;
+                if (!tasks.empty())
+                {
+                    Task *task = tasks.back();
+                    tasks.pop_back();
+                    taken();
+                    return task;
+                }
+            }
+
+            for (std::size_t i = 1; i < _queues.size(); ++i)
+            {
+                Queue &victim = *_queues[(own + i) % _queues.size()];
+                std::lock_guard<std::mutex> lock(victim.lock);
+                if (!victim.tasks.empty())
+                {
+                    Task *task = victim.tasks.front();
+                    victim.tasks.pop_front();
+                    taken();
+                    return task;
+                }
+            }
+
+            return nullptr;
+        }
+
+        /** \brief Выполняет одну задачу, если нашлась. */
+        bool runOne(std::size_t own)
+        {
+            Task *task = grab(own);
+            if (!task)
+                return false;
+
+            task->run();
+            return true;
+        }
+
+        void taken()
+        {
+            std::lock_guard<std::mutex> lock(_sleepLock);
+            --_pending;
+        }
+
+        void workerLoop(std::size_t index)
+        {
+            currentSlot().pool = this;
+            currentSlot().index = index;
+
+            while (true)
+            {
+                if (runOne(index))
+                    continue;
+
+                std::unique_lock<std::mutex> lock(_sleepLock);
+                if (_stop)
+                    break;
+                if (!_pending)
+                    _wake.wait_for(lock, std::chrono::milliseconds(10));
+            }
+
+            currentSlot().pool = nullptr;
+        }
+
+        /** \brief К какому пулу и очереди привязан текущий поток. */
+        struct ThreadSlot
+        {
+            const WorkStealingPool *pool;
+            std::size_t index;
+        };
+
+        static ThreadSlot &currentSlot()
+        {
+            thread_local ThreadSlot slot = {nullptr, 0};
+            return slot;
+        }
+
+    protected:
+        WorkStealingPool(const WorkStealingPool &);              ///< КК не доступен.
+        WorkStealingPool &operator=(const WorkStealingPool &);   ///< Оператор присваивания недоступен.
+
+    protected:
+        std::vector<std::unique_ptr<Queue> > _queues;            ///< Очереди рабочих и общая внешняя (последняя).
+        std::vector<std::thread> _threads;                       ///< Рабочие потоки.
+
+        std::mutex _sleepLock;                                   ///< Защищает _stop и _pending.
+        std::condition_variable _wake;                           ///< Будит спящих при появлении задач.
+        bool _stop;                                              ///< Пора завершаться.
+        std::size_t _pending;                                    ///< Сколько задач лежит в очередях.
+    }; // class WorkStealingPool
+
+
+} // namespace xi
+
+
+#endif // XI_THREADPOOL_H